@@ -0,0 +1,150 @@
+#include "AffinityCache.h"
+#include "MemoryStats.h"
+#include <cstdint>
+
+AffinityCache::AffinityCache(int maxEntries)
+    : capacity(maxEntries > 0 ? maxEntries : 1), count(0), newest(-1), oldest(-1), freeEntries(0) {
+    entries = trackedArray<AffinityEntry>(MEMORY_AFFINITY, capacity);
+    for (int i = 0; i < capacity; i++) {
+        entries[i].nextByPlate = i + 1 < capacity ? i + 1 : -1;
+    }
+    int buckets = 16;
+    while (buckets < capacity * 2) buckets *= 2;
+    bucketMask = buckets - 1;
+    plateBuckets = trackedArray<int>(MEMORY_AFFINITY, buckets);
+    slotBuckets = trackedArray<int>(MEMORY_AFFINITY, buckets);
+    for (int i = 0; i < buckets; i++) {
+        plateBuckets[i] = -1;
+        slotBuckets[i] = -1;
+    }
+}
+
+AffinityCache::~AffinityCache() {
+    MemoryStats::freed(MEMORY_AFFINITY, 0, count);
+    trackedFree(MEMORY_AFFINITY, entries, capacity);
+    trackedFree(MEMORY_AFFINITY, plateBuckets, bucketMask + 1);
+    trackedFree(MEMORY_AFFINITY, slotBuckets, bucketMask + 1);
+}
+
+unsigned AffinityCache::hashPlate(unsigned plate) {
+    return plate * 2654435761u;
+}
+
+unsigned AffinityCache::hashSlot(const ParkingSlot* slot) {
+    uintptr_t address = (uintptr_t)slot;
+    return (unsigned)(address >> 4) * 2654435761u;
+}
+
+int AffinityCache::findByPlate(unsigned plate) const {
+    for (int i = plateBuckets[hashPlate(plate) & bucketMask]; i >= 0; i = entries[i].nextByPlate) {
+        if (entries[i].plate == plate) return i;
+    }
+    return -1;
+}
+
+int AffinityCache::findBySlot(const ParkingSlot* slot) const {
+    for (int i = slotBuckets[hashSlot(slot) & bucketMask]; i >= 0; i = entries[i].nextBySlot) {
+        if (entries[i].slot == slot) return i;
+    }
+    return -1;
+}
+
+void AffinityCache::unlinkSlot(int index) {
+    int* link = &slotBuckets[hashSlot(entries[index].slot) & bucketMask];
+    while (*link != index) {
+        link = &entries[*link].nextBySlot;
+    }
+    *link = entries[index].nextBySlot;
+}
+
+void AffinityCache::unlinkLru(int index) {
+    AffinityEntry& entry = entries[index];
+    if (entry.newer >= 0) {
+        entries[entry.newer].older = entry.older;
+    } else {
+        newest = entry.older;
+    }
+    if (entry.older >= 0) {
+        entries[entry.older].newer = entry.newer;
+    } else {
+        oldest = entry.newer;
+    }
+}
+
+void AffinityCache::pushNewest(int index) {
+    entries[index].newer = -1;
+    entries[index].older = newest;
+    if (newest >= 0) {
+        entries[newest].newer = index;
+    } else {
+        oldest = index;
+    }
+    newest = index;
+}
+
+void AffinityCache::remove(int index) {
+    int* link = &plateBuckets[hashPlate(entries[index].plate) & bucketMask];
+    while (*link != index) {
+        link = &entries[*link].nextByPlate;
+    }
+    *link = entries[index].nextByPlate;
+    unlinkSlot(index);
+    unlinkLru(index);
+    entries[index].nextByPlate = freeEntries;
+    freeEntries = index;
+    count--;
+    MemoryStats::freed(MEMORY_AFFINITY, 0, 1);
+}
+
+ParkingSlot* AffinityCache::find(unsigned plate) const {
+    int index = findByPlate(plate);
+    return index >= 0 ? entries[index].slot : nullptr;
+}
+
+void AffinityCache::remember(unsigned plate, ParkingSlot* slot) {
+    int index = findByPlate(plate);
+    int holder = findBySlot(slot);
+    if (holder >= 0 && holder != index) {
+        remove(holder);
+    }
+
+    if (index >= 0) {
+        if (entries[index].slot != slot) {
+            unlinkSlot(index);
+            entries[index].slot = slot;
+            unsigned bucket = hashSlot(slot) & bucketMask;
+            entries[index].nextBySlot = slotBuckets[bucket];
+            slotBuckets[bucket] = index;
+        }
+        unlinkLru(index);
+        pushNewest(index);
+        return;
+    }
+
+    if (count == capacity) {
+        remove(oldest);
+    }
+    index = freeEntries;
+    freeEntries = entries[index].nextByPlate;
+    count++;
+    MemoryStats::allocated(MEMORY_AFFINITY, 0, 1);
+
+    AffinityEntry& entry = entries[index];
+    entry.plate = plate;
+    entry.slot = slot;
+    unsigned plateBucket = hashPlate(plate) & bucketMask;
+    entry.nextByPlate = plateBuckets[plateBucket];
+    plateBuckets[plateBucket] = index;
+    unsigned slotBucket = hashSlot(slot) & bucketMask;
+    entry.nextBySlot = slotBuckets[slotBucket];
+    slotBuckets[slotBucket] = index;
+    pushNewest(index);
+}
+
+int AffinityCache::getCount() const {
+    return count;
+}
+
+int AffinityCache::getCapacity() const {
+    return capacity;
+}
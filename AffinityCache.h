@@ -0,0 +1,53 @@
+#ifndef AFFINITYCACHE_H
+#define AFFINITYCACHE_H
+
+class ParkingSlot;
+
+struct AffinityEntry {
+    unsigned plate;
+    ParkingSlot* slot;
+    int newer;              // LRU links, -1 at either end
+    int older;
+    int nextByPlate;        // bucket chains; nextByPlate also links free entries
+    int nextBySlot;
+};
+
+// The slot each recent vehicle was last given, for at most capacity
+// vehicles; the least recently parked one is forgotten first. Entries are
+// found by plate handle and by slot through two chained hash tables over
+// one fixed entry array. A slot belongs to one entry at most: when another
+// vehicle is given it, the first vehicle's entry is dropped.
+class AffinityCache {
+private:
+    AffinityEntry* entries;
+    int capacity;
+    int count;
+    int newest;
+    int oldest;
+    int freeEntries;
+    int* plateBuckets;
+    int* slotBuckets;
+    int bucketMask;
+
+    static unsigned hashPlate(unsigned plate);
+    static unsigned hashSlot(const ParkingSlot* slot);
+    int findByPlate(unsigned plate) const;
+    int findBySlot(const ParkingSlot* slot) const;
+    void unlinkSlot(int index);
+    void unlinkLru(int index);
+    void pushNewest(int index);
+    void remove(int index);
+
+public:
+    explicit AffinityCache(int maxEntries);
+    ~AffinityCache();
+
+    // The slot the vehicle last had, nullptr if it is not remembered. The
+    // slot may have been taken or closed since; callers check.
+    ParkingSlot* find(unsigned plate) const;
+    void remember(unsigned plate, ParkingSlot* slot);
+    int getCount() const;
+    int getCapacity() const;
+};
+
+#endif
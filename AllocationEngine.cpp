@@ -1,67 +1,144 @@
 #include "AllocationEngine.h"
-#include "Zone.h"
-#include "ParkingArea.h"
-#include "ParkingSlot.h"
-#include "ParkingRequest.h"
+#include "AllocationPolicies.h"
+#include "MemoryStats.h"
+#include "AffinityCache.h"
+#include <cstring>
 
-AllocationEngine::AllocationEngine(Zone** zs, int count) 
-    : zones(zs), zoneCount(count) {}
+AllocationEngine::AllocationEngine(Zone** zs, int count, EngineStats* engineStats) 
+    : zones(zs), zoneCount(count), stats(engineStats), zoneTree(nullptr),
+      spatialIndex(nullptr), affinity(nullptr), positionById(nullptr), positionByIdCapacity(0) {
+    indexZones(0);
+}
+
+AllocationEngine::~AllocationEngine() {
+    trackedFree(MEMORY_TOPOLOGY, positionById, positionByIdCapacity);
+}
+
+void AllocationEngine::setZones(Zone** zs, int count) {
+    int from = zoneCount;
+    zones = zs;
+    zoneCount = count;
+    indexZones(from);
+}
 
-bool AllocationEngine::allocateSlot(ParkingRequest* request, long long currentTime) {
-    int requestedZone = request->getRequestedZone();
-    
-    // Try same-zone allocation first
-    ParkingSlot* slot = findSlotInZone(requestedZone);
-    if (slot != nullptr) {
-        slot->occupy();
-        request->allocate(requestedZone, slot->getSlotId(), currentTime, false);
-        return true;
+// ParkingSystem::addZone refuses duplicate IDs, so each ID maps to one zone
+void AllocationEngine::indexZones(int from) {
+    for (int i = from; i < zoneCount; i++) {
+        int zoneId = zones[i]->getZoneId();
+        if (zoneId < 0) continue;
+        if (zoneId >= positionByIdCapacity) {
+            int newCapacity = positionByIdCapacity > 0 ? positionByIdCapacity * 2 : 16;
+            while (newCapacity <= zoneId) newCapacity *= 2;
+            int* grown = trackedArray<int>(MEMORY_TOPOLOGY, newCapacity);
+            for (int j = 0; j < newCapacity; j++) {
+                grown[j] = j < positionByIdCapacity ? positionById[j] : -1;
+            }
+            trackedFree(MEMORY_TOPOLOGY, positionById, positionByIdCapacity);
+            positionById = grown;
+            positionByIdCapacity = newCapacity;
+        }
+        positionById[zoneId] = i;
     }
-    
-    // Try cross-zone allocation
-    int foundZoneId = -1;
-    slot = findSlotInOtherZones(requestedZone, foundZoneId);
-    if (slot != nullptr) {
-        slot->occupy();
-        request->allocate(foundZoneId, slot->getSlotId(), currentTime, true);
-        return true;
+}
+
+AllocationEngine* AllocationEngine::create(AllocationPolicy policy, Zone** zs, int count,
+                                           EngineStats* engineStats) {
+    switch (policy) {
+        case POLICY_NEXT_FIT:
+            return new PolicyAllocationEngine<NextFitPolicy>(zs, count, engineStats);
+        case POLICY_BEST_FIT:
+            return new PolicyAllocationEngine<BestFitPolicy>(zs, count, engineStats);
+        case POLICY_SPREAD:
+            return new PolicyAllocationEngine<SpreadPolicy>(zs, count, engineStats);
+        case POLICY_FIRST_FIT:
+        default:
+            return new PolicyAllocationEngine<FirstFitPolicy>(zs, count, engineStats);
     }
-    
-    return false;
 }
 
-ParkingSlot* AllocationEngine::findSlotInZone(int zoneId) const {
-    Zone* zone = getZone(zoneId);
-    if (zone == nullptr) return nullptr;
-    
-    for (int i = 0; i < zone->getAreaCount(); i++) {
-        ParkingArea* area = zone->getParkingArea(i);
-        ParkingSlot* slot = area->findAvailableSlot();
-        if (slot != nullptr) {
-            return slot;
-        }
+const char* AllocationEngine::policyName(AllocationPolicy policy) {
+    switch (policy) {
+        case POLICY_FIRST_FIT: return "first";
+        case POLICY_NEXT_FIT: return "next";
+        case POLICY_BEST_FIT: return "best";
+        case POLICY_SPREAD: return "spread";
     }
-    return nullptr;
+    return "unknown";
 }
 
-ParkingSlot* AllocationEngine::findSlotInOtherZones(int excludeZoneId, int& foundZoneId) const {
-    for (int i = 0; i < zoneCount; i++) {
-        if (zones[i]->getZoneId() == excludeZoneId) continue;
-        
-        ParkingSlot* slot = findSlotInZone(zones[i]->getZoneId());
-        if (slot != nullptr) {
-            foundZoneId = zones[i]->getZoneId();
-            return slot;
+bool AllocationEngine::parsePolicy(const char* name, AllocationPolicy& policy) {
+    for (int i = 0; i < ALLOCATION_POLICY_COUNT; i++) {
+        if (strcmp(name, policyName((AllocationPolicy)i)) == 0) {
+            policy = (AllocationPolicy)i;
+            return true;
         }
     }
+    return false;
+}
+
+void AllocationEngine::commitAllocation(ParkingRequest* request, ParkingSlot* slot, int zoneId,
+                                        bool crossZone, double distance, long long currentTime,
+                                        ParkingSlot** allocatedSlot) const {
+    slot->occupy();
+    request->allocate(zoneId, slot->getSlotId(), currentTime, crossZone, distance);
+    if (allocatedSlot != nullptr) *allocatedSlot = slot;
+}
+
+// The slot the vehicle last had, if it is free, in the requested zone and
+// of the class asked for. A remembered standard slot stands in for a class
+// request with fallback only when the zone has none of that class left,
+// which is what the policy would have fallen back to.
+ParkingSlot* AllocationEngine::findStickySlot(const ParkingRequest* request, int zoneIndex) const {
+    ParkingSlot* slot = affinity->find(request->getPlate());
+    if (slot == nullptr || !slot->isAvailable() || slot->getArea()->getZone() != zones[zoneIndex]) {
+        return nullptr;
+    }
+    SlotClass slotClass = request->getRequiredClass();
+    if (slot->getSlotClass() == slotClass) return slot;
+    if (request->allowsFallback() && slot->getSlotClass() == SLOT_STANDARD &&
+        zones[zoneIndex]->getAvailableSlots(slotClass) == 0) {
+        return slot;
+    }
     return nullptr;
 }
 
-Zone* AllocationEngine::getZone(int zoneId) const {
+void AllocationEngine::recordAllocation(bool found, bool crossZone, int slotsExamined,
+                                        int areasVisited, int zonesVisited) const {
+    if (stats == nullptr) return;
+    stats->add(STAT_ALLOCATIONS, 1);
+    if (found) {
+        stats->add(crossZone ? STAT_CROSS_ZONE : STAT_SAME_ZONE, 1);
+    } else {
+        stats->add(STAT_FAILED, 1);
+    }
+    stats->recordScan(slotsExamined, areasVisited, zonesVisited);
+}
+
+int AllocationEngine::indexOfZone(int zoneId) const {
+    if (zoneId >= 0) {
+        return zoneId < positionByIdCapacity ? positionById[zoneId] : -1;
+    }
     for (int i = 0; i < zoneCount; i++) {
         if (zones[i]->getZoneId() == zoneId) {
-            return zones[i];
+            return i;
         }
     }
-    return nullptr;
+    return -1;
+}
+
+void AllocationEngine::setZoneTree(const AvailabilityTree* tree) {
+    zoneTree = tree;
+}
+
+void AllocationEngine::setSpatialIndex(const ZoneSpatialIndex* index) {
+    spatialIndex = index;
+}
+
+void AllocationEngine::setAffinityCache(const AffinityCache* cache) {
+    affinity = cache;
+}
+
+Zone* AllocationEngine::getZone(int zoneId) const {
+    int index = indexOfZone(zoneId);
+    return index >= 0 ? zones[index] : nullptr;
 }
@@ -4,19 +4,67 @@
 class Zone;
 class ParkingSlot;
 class ParkingRequest;
+class EngineStats;
+class AvailabilityTree;
+class ZoneSpatialIndex;
+class AffinityCache;
 
+enum AllocationPolicy {
+    POLICY_FIRST_FIT,   // lowest free slot in the zone (original behaviour)
+    POLICY_NEXT_FIT,    // resume after the last slot handed out in the zone
+    POLICY_BEST_FIT,    // fullest area that still has room
+    POLICY_SPREAD       // round-robin across the zone's areas
+};
+
+const int ALLOCATION_POLICY_COUNT = 4;
+
+// Same-zone preference with cross-zone fallback. How a slot is picked inside
+// a zone is decided by PolicyAllocationEngine<Policy> (AllocationPolicies.h);
+// the only virtual call is allocateSlot itself, the scan loop is inlined.
+// Closed zones are skipped both as the requested zone and as a fallback.
 class AllocationEngine {
-private:
+protected:
     Zone** zones;
     int zoneCount;
+    EngineStats* stats;
+    const AvailabilityTree* zoneTree;   // optional: lets cross-zone search skip full zones
+    const ZoneSpatialIndex* spatialIndex;   // optional: cross-zone fallback goes to the nearest zone
+    const AffinityCache* affinity;      // optional: a returning vehicle's last slot is tried first
+    int* positionById;      // zone ID -> index in zones, -1 if none; negative IDs are scanned for
+    int positionByIdCapacity;
+
+    void indexZones(int from);
+    int indexOfZone(int zoneId) const;
+    ParkingSlot* findStickySlot(const ParkingRequest* request, int zoneIndex) const;
+    void commitAllocation(ParkingRequest* request, ParkingSlot* slot, int zoneId, bool crossZone,
+                          double distance, long long currentTime, ParkingSlot** allocatedSlot) const;
+    void recordAllocation(bool found, bool crossZone, int slotsExamined, int areasVisited,
+                          int zonesVisited) const;
 
 public:
-    AllocationEngine(Zone** zs, int count);
+    AllocationEngine(Zone** zs, int count, EngineStats* engineStats = nullptr);
+    virtual ~AllocationEngine();
     
-    bool allocateSlot(ParkingRequest* request, long long currentTime);
-    ParkingSlot* findSlotInZone(int zoneId) const;
-    ParkingSlot* findSlotInOtherZones(int excludeZoneId, int& foundZoneId) const;
+    virtual bool allocateSlot(ParkingRequest* request, long long currentTime,
+                              ParkingSlot** allocatedSlot = nullptr) = 0;
+    // The slot allocateSlot would pick for the request, measured from its
+    // requested zone, without taking it
+    virtual ParkingSlot* findSlot(const ParkingRequest* request, int& zoneId, bool& crossZone,
+                                  double& distance) = 0;
+    virtual ParkingSlot* findSlotInZone(int zoneId) = 0;
+    virtual ParkingSlot* findSlotInOtherZones(int excludeZoneId, int& foundZoneId) = 0;
+    virtual AllocationPolicy getPolicy() const = 0;
+    // Zones were added, possibly into a new array; per-zone state grows in place
+    virtual void setZones(Zone** zs, int count);
     Zone* getZone(int zoneId) const;
+    void setZoneTree(const AvailabilityTree* tree);
+    void setSpatialIndex(const ZoneSpatialIndex* index);
+    void setAffinityCache(const AffinityCache* cache);
+    
+    static AllocationEngine* create(AllocationPolicy policy, Zone** zs, int count,
+                                    EngineStats* engineStats = nullptr);
+    static const char* policyName(AllocationPolicy policy);
+    static bool parsePolicy(const char* name, AllocationPolicy& policy);
 };
 
 #endif
@@ -0,0 +1,327 @@
+#ifndef ALLOCATIONPOLICIES_H
+#define ALLOCATIONPOLICIES_H
+
+#include "AllocationEngine.h"
+#include "Zone.h"
+#include "ParkingArea.h"
+#include "ParkingSlot.h"
+#include "ParkingRequest.h"
+#include "EngineStats.h"
+#include "AvailabilityTree.h"
+#include "ZoneSpatialIndex.h"
+#include "MemoryStats.h"
+
+// A policy picks a free standard slot inside one zone. zoneIndex is the
+// zone's position in the engine's array, for policies that keep per-zone
+// state; resize() only ever grows it and keeps what is there.
+// slotsExamined / areasVisited feed the scan statistics. Special
+// classes (EV, accessible, ...) bypass the policy and come straight off the
+// zone's per-class free list.
+
+// The zone's availability tree answers "lowest free standard slot" in
+// O(log S), the same slot the area-by-area scan would have stopped at
+struct FirstFitPolicy {
+    static const AllocationPolicy kind = POLICY_FIRST_FIT;
+
+    void resize(int) {}
+
+    ParkingSlot* scan(Zone* zone, int, int& slotsExamined, int&) {
+        slotsExamined++;
+        return zone->findFirstFreeSlot(1u << SLOT_STANDARD);
+    }
+};
+
+// Keeps a cursor per zone just past the last slot it handed out, so the
+// occupied prefix is not rescanned on every request. Full areas are skipped
+// on their free counter without touching their slots.
+struct NextFitPolicy {
+    static const AllocationPolicy kind = POLICY_NEXT_FIT;
+
+    int* cursorArea;
+    int* cursorSlot;
+    int capacity;
+
+    NextFitPolicy() : cursorArea(nullptr), cursorSlot(nullptr), capacity(0) {}
+    ~NextFitPolicy() {
+        trackedFree(MEMORY_TOPOLOGY, cursorArea, capacity);
+        trackedFree(MEMORY_TOPOLOGY, cursorSlot, capacity);
+    }
+
+    void resize(int zoneCount) {
+        if (zoneCount <= capacity && cursorArea != nullptr) return;
+        int newCapacity = capacity > 0 ? capacity : 1;
+        while (newCapacity < zoneCount) newCapacity *= 2;
+        int* grownArea = trackedArray<int>(MEMORY_TOPOLOGY, newCapacity);
+        int* grownSlot = trackedArray<int>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < newCapacity; i++) {
+            grownArea[i] = i < capacity ? cursorArea[i] : 0;
+            grownSlot[i] = i < capacity ? cursorSlot[i] : 0;
+        }
+        trackedFree(MEMORY_TOPOLOGY, cursorArea, capacity);
+        trackedFree(MEMORY_TOPOLOGY, cursorSlot, capacity);
+        cursorArea = grownArea;
+        cursorSlot = grownSlot;
+        capacity = newCapacity;
+    }
+
+    ParkingSlot* scan(Zone* zone, int zoneIndex, int& slotsExamined, int& areasVisited) {
+        int areaCount = zone->getAreaCount();
+        if (areaCount == 0 || zone->getAvailableSlots(SLOT_STANDARD) == 0) return nullptr;
+
+        int startArea = cursorArea[zoneIndex] < areaCount ? cursorArea[zoneIndex] : 0;
+        // The last step revisits the starting area's slots before the cursor
+        for (int step = 0; step <= areaCount; step++) {
+            int a = (startArea + step) % areaCount;
+            ParkingArea* area = zone->getParkingArea(a);
+            areasVisited++;
+            if (area->getAvailableSlots(SLOT_STANDARD) == 0) continue;
+
+            int from = step == 0 ? cursorSlot[zoneIndex] : 0;
+            int index = area->findAvailableIndex(from, slotsExamined, SLOT_STANDARD);
+            if (index >= 0) {
+                cursorArea[zoneIndex] = a;
+                cursorSlot[zoneIndex] = index + 1;
+                return area->getSlot(index);
+            }
+        }
+        return nullptr;
+    }
+};
+
+// Fills the area with the fewest free slots first, keeping emptier areas
+// whole for later arrivals (and for closing off areas entirely)
+struct BestFitPolicy {
+    static const AllocationPolicy kind = POLICY_BEST_FIT;
+
+    void resize(int) {}
+
+    ParkingSlot* scan(Zone* zone, int, int& slotsExamined, int& areasVisited) {
+        if (zone->getAvailableSlots(SLOT_STANDARD) == 0) return nullptr;
+
+        ParkingArea* best = nullptr;
+        for (int i = 0; i < zone->getAreaCount(); i++) {
+            ParkingArea* area = zone->getParkingArea(i);
+            areasVisited++;
+            int available = area->getAvailableSlots(SLOT_STANDARD);
+            if (available > 0 && (best == nullptr || available < best->getAvailableSlots(SLOT_STANDARD))) {
+                best = area;
+                if (available == 1) break;
+            }
+        }
+        return best != nullptr ? best->findAvailableSlot(slotsExamined, SLOT_STANDARD) : nullptr;
+    }
+};
+
+// Hands out slots round-robin across the zone's areas so wear and traffic
+// are spread evenly
+struct SpreadPolicy {
+    static const AllocationPolicy kind = POLICY_SPREAD;
+
+    int* nextArea;
+    int capacity;
+
+    SpreadPolicy() : nextArea(nullptr), capacity(0) {}
+    ~SpreadPolicy() {
+        trackedFree(MEMORY_TOPOLOGY, nextArea, capacity);
+    }
+
+    void resize(int zoneCount) {
+        if (zoneCount <= capacity && nextArea != nullptr) return;
+        int newCapacity = capacity > 0 ? capacity : 1;
+        while (newCapacity < zoneCount) newCapacity *= 2;
+        int* grown = trackedArray<int>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < newCapacity; i++) {
+            grown[i] = i < capacity ? nextArea[i] : 0;
+        }
+        trackedFree(MEMORY_TOPOLOGY, nextArea, capacity);
+        nextArea = grown;
+        capacity = newCapacity;
+    }
+
+    ParkingSlot* scan(Zone* zone, int zoneIndex, int& slotsExamined, int& areasVisited) {
+        int areaCount = zone->getAreaCount();
+        if (areaCount == 0 || zone->getAvailableSlots(SLOT_STANDARD) == 0) return nullptr;
+
+        int start = nextArea[zoneIndex] < areaCount ? nextArea[zoneIndex] : 0;
+        for (int step = 0; step < areaCount; step++) {
+            int a = (start + step) % areaCount;
+            ParkingArea* area = zone->getParkingArea(a);
+            areasVisited++;
+            if (area->getAvailableSlots(SLOT_STANDARD) == 0) continue;
+
+            ParkingSlot* slot = area->findAvailableSlot(slotsExamined, SLOT_STANDARD);
+            if (slot != nullptr) {
+                nextArea[zoneIndex] = (a + 1) % areaCount;
+                return slot;
+            }
+        }
+        return nullptr;
+    }
+};
+
+template <typename Policy>
+class PolicyAllocationEngine : public AllocationEngine {
+private:
+    Policy policy;
+
+    ParkingSlot* findInZone(int zoneIndex, SlotClass slotClass, bool fallback,
+                            int& slotsExamined, int& areasVisited) {
+        ParkingSlot* slot;
+        if (slotClass == SLOT_STANDARD) {
+            slot = policy.scan(zones[zoneIndex], zoneIndex, slotsExamined, areasVisited);
+        } else {
+            slotsExamined++;
+            slot = zones[zoneIndex]->peekFreeSlot(slotClass);
+            if (slot == nullptr && fallback) {
+                slot = policy.scan(zones[zoneIndex], zoneIndex, slotsExamined, areasVisited);
+            }
+        }
+        return slot;
+    }
+
+    ParkingSlot* scanOtherZones(int excludeIndex, SlotClass slotClass, bool fallback, int& foundIndex,
+                                int& slotsExamined, int& areasVisited, int& zonesVisited) {
+        unsigned mask = 1u << slotClass;
+        if (fallback) mask |= 1u << SLOT_STANDARD;
+        
+        if (spatialIndex != nullptr && spatialIndex->isActive() && excludeIndex >= 0) {
+            // Nearest zone that has a usable free slot; its mask guarantees a hit
+            Zone* requested = zones[excludeIndex];
+            int i = spatialIndex->findNearest(requested->getX(), requested->getY(), mask,
+                                              excludeIndex);
+            if (i < 0) return nullptr;
+            zonesVisited++;
+            foundIndex = i;
+            return findInZone(i, slotClass, fallback, slotsExamined, areasVisited);
+        }
+        
+        if (zoneTree != nullptr) {
+            // Jump straight between zones that have a usable free slot
+            for (int i = zoneTree->findFirst(0, zoneCount - 1, mask); i >= 0;
+                 i = zoneTree->findFirst(i + 1, zoneCount - 1, mask)) {
+                if (i == excludeIndex) continue;
+                
+                zonesVisited++;
+                ParkingSlot* slot = findInZone(i, slotClass, fallback, slotsExamined, areasVisited);
+                if (slot != nullptr) {
+                    foundIndex = i;
+                    return slot;
+                }
+            }
+            return nullptr;
+        }
+        
+        for (int i = 0; i < zoneCount; i++) {
+            if (i == excludeIndex || zones[i]->isClosed()) continue;
+            
+            zonesVisited++;
+            ParkingSlot* slot = findInZone(i, slotClass, fallback, slotsExamined, areasVisited);
+            if (slot != nullptr) {
+                foundIndex = i;
+                return slot;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+    PolicyAllocationEngine(Zone** zs, int count, EngineStats* engineStats = nullptr)
+        : AllocationEngine(zs, count, engineStats) {
+        policy.resize(count);
+    }
+
+    AllocationPolicy getPolicy() const override {
+        return Policy::kind;
+    }
+
+    void setZones(Zone** zs, int count) override {
+        AllocationEngine::setZones(zs, count);
+        policy.resize(count);
+    }
+
+    bool allocateSlot(ParkingRequest* request, long long currentTime,
+                      ParkingSlot** allocatedSlot = nullptr) override {
+        int zoneId;
+        bool crossZone;
+        double distance;
+        ParkingSlot* slot = PolicyAllocationEngine::findSlot(request, zoneId, crossZone, distance);
+        if (slot == nullptr) return false;
+        commitAllocation(request, slot, zoneId, crossZone, distance, currentTime, allocatedSlot);
+        return true;
+    }
+
+    ParkingSlot* findSlot(const ParkingRequest* request, int& zoneId, bool& crossZone,
+                          double& distance) override {
+        int zoneIndex = indexOfZone(request->getRequestedZone());
+        SlotClass slotClass = request->getRequiredClass();
+        bool fallback = request->allowsFallback();
+        int slotsExamined = 0;
+        int areasVisited = 0;
+        int zonesVisited = 0;
+        ParkingSlot* slot = nullptr;
+        
+        // Try same-zone allocation first, from the vehicle's last slot if
+        // it is still there for it
+        if (zoneIndex >= 0 && !zones[zoneIndex]->isClosed()) {
+            ScopedStatTimer timer(stats, TIMER_FIND_SLOT_IN_ZONE);
+            zonesVisited++;
+            if (affinity != nullptr) {
+                slotsExamined++;
+                slot = findStickySlot(request, zoneIndex);
+                if (stats != nullptr) stats->add(slot != nullptr ? STAT_AFFINITY_HITS : STAT_AFFINITY_MISSES, 1);
+            }
+            if (slot == nullptr) {
+                slot = findInZone(zoneIndex, slotClass, fallback, slotsExamined, areasVisited);
+            }
+        }
+        if (slot != nullptr) {
+            recordAllocation(true, false, slotsExamined, areasVisited, zonesVisited);
+            zoneId = zones[zoneIndex]->getZoneId();
+            crossZone = false;
+            distance = 0;
+            return slot;
+        }
+        
+        // Try cross-zone allocation
+        int foundIndex = -1;
+        {
+            ScopedStatTimer timer(stats, TIMER_FIND_SLOT_IN_OTHER_ZONES);
+            slot = scanOtherZones(zoneIndex, slotClass, fallback, foundIndex, slotsExamined,
+                                  areasVisited, zonesVisited);
+        }
+        recordAllocation(slot != nullptr, true, slotsExamined, areasVisited, zonesVisited);
+        if (slot != nullptr) {
+            zoneId = zones[foundIndex]->getZoneId();
+            crossZone = true;
+            distance = 0;
+            if (spatialIndex != nullptr && spatialIndex->isActive() && zoneIndex >= 0) {
+                distance = spatialIndex->distanceBetween(zoneIndex, foundIndex);
+            }
+        }
+        return slot;
+    }
+
+    ParkingSlot* findSlotInZone(int zoneId) override {
+        int zoneIndex = indexOfZone(zoneId);
+        if (zoneIndex < 0) return nullptr;
+        
+        int slotsExamined = 0;
+        int areasVisited = 0;
+        return policy.scan(zones[zoneIndex], zoneIndex, slotsExamined, areasVisited);
+    }
+
+    ParkingSlot* findSlotInOtherZones(int excludeZoneId, int& foundZoneId) override {
+        int slotsExamined = 0;
+        int areasVisited = 0;
+        int zonesVisited = 0;
+        int foundIndex = -1;
+        ParkingSlot* slot = scanOtherZones(indexOfZone(excludeZoneId), SLOT_STANDARD, false, foundIndex,
+                                           slotsExamined, areasVisited, zonesVisited);
+        if (slot != nullptr) {
+            foundZoneId = zones[foundIndex]->getZoneId();
+        }
+        return slot;
+    }
+};
+
+#endif
@@ -0,0 +1,93 @@
+#include "AvailabilityTree.h"
+#include "MemoryStats.h"
+
+AvailabilityTree::AvailabilityTree() : leafCount(0), size(1) {
+    counts = trackedArray<int>(MEMORY_TOPOLOGY, 2);
+    masks = trackedArray<unsigned char>(MEMORY_TOPOLOGY, 2);
+    counts[0] = counts[1] = 0;
+    masks[0] = masks[1] = 0;
+}
+
+AvailabilityTree::~AvailabilityTree() {
+    trackedFree(MEMORY_TOPOLOGY, counts, 2 * size);
+    trackedFree(MEMORY_TOPOLOGY, masks, 2 * size);
+}
+
+// Grows capacity by doubling and rebuilds the inner nodes; existing leaves
+// keep their values and new leaves start empty
+void AvailabilityTree::resize(int leaves) {
+    if (leaves > size) {
+        int newSize = size;
+        while (newSize < leaves) newSize *= 2;
+        int* newCounts = trackedArray<int>(MEMORY_TOPOLOGY, 2 * newSize);
+        unsigned char* newMasks = trackedArray<unsigned char>(MEMORY_TOPOLOGY, 2 * newSize);
+        for (int i = 0; i < 2 * newSize; i++) {
+            newCounts[i] = 0;
+            newMasks[i] = 0;
+        }
+        for (int i = 0; i < leafCount; i++) {
+            newCounts[newSize + i] = counts[size + i];
+            newMasks[newSize + i] = masks[size + i];
+        }
+        for (int node = newSize - 1; node >= 1; node--) {
+            newCounts[node] = newCounts[2 * node] + newCounts[2 * node + 1];
+            newMasks[node] = newMasks[2 * node] | newMasks[2 * node + 1];
+        }
+        trackedFree(MEMORY_TOPOLOGY, counts, 2 * size);
+        trackedFree(MEMORY_TOPOLOGY, masks, 2 * size);
+        counts = newCounts;
+        masks = newMasks;
+        size = newSize;
+    }
+    if (leaves > leafCount) {
+        leafCount = leaves;
+    }
+}
+
+void AvailabilityTree::set(int position, int count, unsigned mask) {
+    int node = size + position;
+    counts[node] = count;
+    masks[node] = (unsigned char)mask;
+    for (node /= 2; node >= 1; node /= 2) {
+        counts[node] = counts[2 * node] + counts[2 * node + 1];
+        masks[node] = masks[2 * node] | masks[2 * node + 1];
+    }
+}
+
+int AvailabilityTree::getLeafCount() const {
+    return leafCount;
+}
+
+int AvailabilityTree::getCount(int position) const {
+    return counts[size + position];
+}
+
+int AvailabilityTree::count(int first, int last) const {
+    if (first < 0) first = 0;
+    if (last >= leafCount) last = leafCount - 1;
+    int total = 0;
+    // Bottom-up over the half-open range [lo, hi)
+    for (int lo = first + size, hi = last + size + 1; lo < hi; lo /= 2, hi /= 2) {
+        if (lo & 1) total += counts[lo++];
+        if (hi & 1) total += counts[--hi];
+    }
+    return total;
+}
+
+int AvailabilityTree::findFirst(int first, int last, unsigned mask) const {
+    if (first < 0) first = 0;
+    if (last >= leafCount) last = leafCount - 1;
+    if (first > last || (masks[1] & mask) == 0) return -1;
+    return findFirst(1, 0, size - 1, first, last, mask);
+}
+
+int AvailabilityTree::findFirst(int node, int nodeFirst, int nodeLast, int first, int last,
+                                unsigned mask) const {
+    if (nodeLast < first || nodeFirst > last || (masks[node] & mask) == 0) return -1;
+    if (nodeFirst == nodeLast) return nodeFirst;
+
+    int mid = (nodeFirst + nodeLast) / 2;
+    int found = findFirst(2 * node, nodeFirst, mid, first, last, mask);
+    if (found >= 0) return found;
+    return findFirst(2 * node + 1, mid + 1, nodeLast, first, last, mask);
+}
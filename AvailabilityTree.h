@@ -0,0 +1,31 @@
+#ifndef AVAILABILITYTREE_H
+#define AVAILABILITYTREE_H
+
+// Segment tree over a row of leaves, each holding a free count and a bitmask
+// of the slot classes that are free there (bit c = 1 << SlotClass). Parents
+// hold the sum of counts and the OR of masks, so both "how many free in
+// [first, last]" and "first leaf in [first, last] with a free slot of these
+// classes" are O(log n).
+class AvailabilityTree {
+private:
+    int leafCount;      // leaves in use
+    int size;           // leaf capacity, a power of two
+    int* counts;        // 2 * size nodes, root at 1, leaves at size..2*size-1
+    unsigned char* masks;
+
+    int findFirst(int node, int nodeFirst, int nodeLast, int first, int last, unsigned mask) const;
+
+public:
+    AvailabilityTree();
+    ~AvailabilityTree();
+
+    void resize(int leaves);
+    void set(int position, int count, unsigned mask);
+    int getLeafCount() const;
+    int getCount(int position) const;
+
+    int count(int first, int last) const;
+    int findFirst(int first, int last, unsigned mask) const;
+};
+
+#endif
@@ -0,0 +1,365 @@
+#include "BatchRunner.h"
+#include "ParkingSystem.h"
+#include "ParkingRequest.h"
+#include "Zone.h"
+#include "ParkingArea.h"
+#include "ParkingSlot.h"
+#include "OutputBuffer.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+static const int INPUT_BUFFER_SIZE = 1 << 20;
+static const int RESERVATION_TTL_MS = 5000;
+static const int LEASE_TTL_MS = 30000;
+
+static long long nowMillis() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char* nextToken(char*& p, char* end) {
+    while (p < end && isSpace(*p)) p++;
+    if (p >= end) return nullptr;
+    char* start = p;
+    while (p < end && !isSpace(*p)) p++;
+    *p = '\0';
+    if (p < end) p++;
+    return start;
+}
+
+static bool parseInt(const char* token, int& value) {
+    if (token == nullptr || *token == '\0') return false;
+    bool negative = *token == '-';
+    if (negative) token++;
+    if (*token == '\0') return false;
+    long long limit = negative ? 0x80000000LL : 0x7FFFFFFFLL;
+    long long result = 0;
+    for (; *token != '\0'; token++) {
+        if (*token < '0' || *token > '9') return false;
+        result = result * 10 + (*token - '0');
+        if (result > limit) return false;
+    }
+    value = (int)(negative ? -result : result);
+    return true;
+}
+
+static bool parseDouble(const char* token, double& value) {
+    if (token == nullptr || *token == '\0') return false;
+    char* end;
+    value = strtod(token, &end);
+    return *end == '\0';
+}
+
+// Optional class, with a trailing '+' to fall back to standard
+static bool parseClassToken(char* className, SlotClass& slotClass, bool& fallback) {
+    slotClass = SLOT_STANDARD;
+    fallback = false;
+    if (className == nullptr) return true;
+    int len = (int)strlen(className);
+    if (len > 0 && className[len - 1] == '+') {
+        fallback = true;
+        className[len - 1] = '\0';
+    }
+    return parseSlotClass(className, slotClass);
+}
+
+void BatchRunner::appendAllocation(const ParkingRequest* request) {
+    if (request->getState() == OCCUPIED) {
+        out.append(request->hasCrossZonePenalty() ? "CROSS " : "OK ");
+        out.appendInt(request->getRequestId());
+        out.append(' ');
+        out.appendInt(request->getAllocatedZone());
+        out.append(' ');
+        out.appendInt(request->getAllocatedSlotId());
+    } else if (system.isWaiting(request)) {
+        out.append("WAIT ");
+        out.appendInt(request->getRequestId());
+    } else {
+        out.append("FULL ");
+        out.appendInt(request->getRequestId());
+    }
+    out.append('\n');
+}
+
+BatchRunner::BatchRunner(ParkingSystem& sys, OutputBuffer& output)
+    : system(sys), out(output), commandCount(0), errorCount(0) {}
+
+void BatchRunner::executeLine(char* line, int len) {
+    char* p = line;
+    char* end = line + len;
+    char* command = nextToken(p, end);
+    if (command == nullptr || command[0] == '#') return;
+    commandCount++;
+
+    int value = 0;
+    if (command[1] != '\0') {
+        command[0] = '?';
+    }
+    switch (command[0]) {
+        case 'R': {
+            char* vehicleId = nextToken(p, end);
+            int zone;
+            if (vehicleId == nullptr || !parseInt(nextToken(p, end), zone)) break;
+            
+            SlotClass slotClass;
+            bool fallback;
+            int priority = 0;
+            char* priorityToken;
+            if (!parseClassToken(nextToken(p, end), slotClass, fallback) ||
+                ((priorityToken = nextToken(p, end)) != nullptr && !parseInt(priorityToken, priority))) break;
+            appendAllocation(system.createRequest(vehicleId, zone, slotClass, fallback, priority));
+            return;
+        }
+        case 'V': {
+            double x;
+            double y;
+            SlotClass slotClass;
+            bool fallback;
+            if (!parseDouble(nextToken(p, end), x) || !parseDouble(nextToken(p, end), y) ||
+                !parseClassToken(nextToken(p, end), slotClass, fallback)) break;
+            
+            long long now = nowMillis();
+            system.expireReservations(now);
+            ParkingSlot* slot = nullptr;
+            double distance = 0;
+            int token = system.reserveSlot(x, y, slotClass, fallback, now + RESERVATION_TTL_MS,
+                                           &slot, distance);
+            if (token == 0) {
+                out.append("V -\n");
+                return;
+            }
+            char text[32];
+            int len = snprintf(text, sizeof(text), " %.3f\n", distance);
+            out.append("V ");
+            out.appendInt(token);
+            out.append(' ');
+            out.appendInt(slot->getZoneId());
+            out.append(' ');
+            out.appendInt(slot->getSlotId());
+            out.append(text, len);
+            return;
+        }
+        case 'K': {
+            char* vehicleId;
+            int zone;
+            SlotClass slotClass;
+            bool fallback;
+            if (!parseInt(nextToken(p, end), value) || (vehicleId = nextToken(p, end)) == nullptr ||
+                !parseInt(nextToken(p, end), zone) ||
+                !parseClassToken(nextToken(p, end), slotClass, fallback)) break;
+            
+            ParkingRequest* request = system.confirmReservation(value, vehicleId, zone, slotClass,
+                                                                fallback);
+            if (request == nullptr) {
+                out.append("ERR\n");
+            } else {
+                appendAllocation(request);
+            }
+            return;
+        }
+        case 'X':
+            if (!parseInt(nextToken(p, end), value)) break;
+            out.append(system.abortReservation(value) ? "OK\n" : "ERR\n");
+            return;
+        case 'G': {
+            int count;
+            SlotClass slotClass;
+            bool fallback;
+            if (!parseInt(nextToken(p, end), value) || !parseInt(nextToken(p, end), count) ||
+                !parseClassToken(nextToken(p, end), slotClass, fallback)) break;
+            
+            long long now = nowMillis();
+            system.expireLeases(now);
+            int token = system.leaseSlots(value, slotClass, count, now + LEASE_TTL_MS);
+            if (token == 0) {
+                out.append("G -\n");
+                return;
+            }
+            out.append("G ");
+            out.appendInt(token);
+            out.append(' ');
+            out.appendInt(system.getLeaseRemaining(token));
+            out.append('\n');
+            return;
+        }
+        case 'P': {
+            char* vehicleId;
+            if (!parseInt(nextToken(p, end), value) || (vehicleId = nextToken(p, end)) == nullptr) break;
+            ParkingRequest* request = system.parkLeased(value, vehicleId);
+            if (request == nullptr) {
+                out.append("ERR\n");
+            } else {
+                appendAllocation(request);
+            }
+            return;
+        }
+        case 'U':
+            if (!parseInt(nextToken(p, end), value)) break;
+            out.append(system.returnLease(value) ? "OK\n" : "ERR\n");
+            return;
+        case 'C':
+            if (!parseInt(nextToken(p, end), value)) break;
+            out.append(system.cancelRequest(value) ? "OK\n" : "ERR\n");
+            return;
+        case 'L':
+            if (!parseInt(nextToken(p, end), value)) break;
+            out.append(system.releaseParking(value) ? "OK\n" : "ERR\n");
+            return;
+        case 'B':
+            if (!parseInt(nextToken(p, end), value)) break;
+            out.append(system.rollbackAllocations(value) ? "OK\n" : "ERR\n");
+            return;
+        case 'D': {
+            if (!parseInt(nextToken(p, end), value)) break;
+            DrainResult result;
+            if (!system.drainZone(value, &result)) {
+                out.append("ERR\n");
+                return;
+            }
+            out.append("D ");
+            out.appendInt(result.moved);
+            out.append(' ');
+            out.appendInt(result.crossZone);
+            out.append(' ');
+            out.appendInt(result.cancelled);
+            out.append('\n');
+            return;
+        }
+        case 'O':
+            if (!parseInt(nextToken(p, end), value)) break;
+            out.append(system.reopenZone(value) ? "OK\n" : "ERR\n");
+            return;
+        case 'A': {
+            int zone;
+            int slots;
+            if (!parseInt(nextToken(p, end), zone) || !parseInt(nextToken(p, end), slots)) break;
+            SlotClass slotClass = SLOT_STANDARD;
+            double x = 0;
+            double y = 0;
+            char* token = nextToken(p, end);
+            if (token != nullptr && !parseDouble(token, x)) {
+                if (!parseSlotClass(token, slotClass)) break;
+                token = nextToken(p, end);
+            }
+            bool located = token != nullptr;
+            if (located && (!parseDouble(token, x) || !parseDouble(nextToken(p, end), y))) break;
+            
+            ParkingArea* area = system.addArea(zone, slots, slotClass, located, x, y);
+            if (area == nullptr) {
+                out.append("ERR\n");
+                return;
+            }
+            out.append("OK ");
+            out.appendInt(area->getAreaId());
+            out.append(' ');
+            out.appendInt(system.getZone(zone)->getTotalSlots());
+            out.append('\n');
+            return;
+        }
+        case 'Z':
+            out.append('Z');
+            for (int i = 0; i < system.getZoneCount(); i++) {
+                Zone* zone = system.getZoneAt(i);
+                out.append(' ');
+                out.appendInt(zone->getZoneId());
+                out.append(':');
+                out.appendInt(zone->getAvailableSlots());
+                out.append('/');
+                out.appendInt(zone->getTotalSlots());
+            }
+            out.append('\n');
+            return;
+        case 'Q': {
+            int lastZone;
+            if (!parseInt(nextToken(p, end), value) || !parseInt(nextToken(p, end), lastZone)) break;
+            out.append("Q ");
+            out.appendInt(system.countAvailableSlots(value, lastZone));
+            ParkingSlot* slot = system.findFirstFreeSlot(value, lastZone);
+            if (slot != nullptr) {
+                out.append(' ');
+                out.appendInt(slot->getZoneId());
+                out.append(' ');
+                out.appendInt(slot->getSlotId());
+            } else {
+                out.append(" -");
+            }
+            out.append('\n');
+            return;
+        }
+        case 'S': {
+            std::ostringstream json;
+            system.dumpStats(json, STATS_JSON);
+            std::string text = json.str();
+            out.append("S ");
+            out.append(text.c_str(), (int)text.size());
+            return;
+        }
+    }
+
+    errorCount++;
+    out.append("ERR syntax\n");
+}
+
+long long BatchRunner::run(FILE* in) {
+    // One spare byte so the last token of the last line can be terminated
+    char* buffer = new char[INPUT_BUFFER_SIZE + 1];
+    int filled = 0;
+
+    // read() rather than fread() so a socket or pipe is served as lines
+    // arrive instead of once a whole buffer has filled
+    int fd = fileno(in);
+    while (true) {
+        ssize_t got = read(fd, buffer + filled, INPUT_BUFFER_SIZE - filled);
+        if (got < 0 && errno == EINTR) continue;
+        if (got > 0) filled += (int)got;
+        bool atEnd = got <= 0;
+
+        int start = 0;
+        for (int i = start; i < filled; i++) {
+            if (buffer[i] == '\n') {
+                executeLine(buffer + start, i - start);
+                start = i + 1;
+            }
+        }
+
+        if (atEnd) {
+            if (start < filled) {
+                executeLine(buffer + start, filled - start);
+            }
+            break;
+        }
+
+        // Keep the partial last line for the next read; a line longer than the
+        // whole buffer is executed as-is and will be reported as a syntax error
+        if (start == 0 && filled == INPUT_BUFFER_SIZE) {
+            executeLine(buffer, filled);
+            filled = 0;
+        } else {
+            memmove(buffer, buffer + start, filled - start);
+            filled -= start;
+        }
+        out.flush();
+    }
+
+    delete[] buffer;
+    out.flush();
+    return commandCount;
+}
+
+long long BatchRunner::getCommandCount() const {
+    return commandCount;
+}
+
+long long BatchRunner::getErrorCount() const {
+    return errorCount;
+}
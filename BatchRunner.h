@@ -0,0 +1,58 @@
+#ifndef BATCHRUNNER_H
+#define BATCHRUNNER_H
+
+#include <cstdio>
+
+class ParkingSystem;
+class ParkingRequest;
+class OutputBuffer;
+
+// One command per line, one result line per command:
+//   R <vehicle> <zone> [class[+]] [priority]
+//                       request parking  -> OK|CROSS <id> <zone> <slot>, FULL <id>
+//                       (class: ev, accessible, ...; '+' falls back to standard)
+//                       With a waitlist: WAIT <id>, higher priorities (0-15) first
+//   C <id>              cancel request   -> OK | ERR
+//   L <id>              release parking  -> OK | ERR
+//   B <k>               rollback k       -> OK | ERR
+//   D <zone>            drain zone       -> D <moved> <cross-zone> <cancelled> | ERR
+//                       (one rollback step; B 1 right after puts everything back)
+//   O <zone>            reopen zone      -> OK | ERR
+//   A <zone> <slots> [class] [x y]
+//                       open an area of <slots> slots, creating the zone (at x, y)
+//                       if needed        -> OK <area> <zone total slots> | ERR
+//   Z                   zone status      -> Z <zone>:<available>/<total> ...
+//   Q <zone> <zone>     free in range    -> Q <count> <zone> <slot> (first free) or Q <count> -
+//   S                   engine stats     -> S <json>
+// Two-phase allocation on behalf of another shard (see ShardRouter):
+//   V <x> <y> [class[+]]
+//                       reserve the free slot nearest to (x, y)
+//                                        -> V <token> <zone> <slot> <distance> | V -
+//   K <token> <vehicle> <zone> [class[+]]
+//                       confirm as a cross-zone request -> CROSS <id> <zone> <slot> | ERR
+//   X <token>           abort reservation -> OK | ERR
+// Slot leases for a gate (see ParkingSystem::leaseSlots), held 30 s:
+//   G <zone> <count> [class]
+//                       lease up to count free slots -> G <token> <slots> | G -
+//   P <token> <vehicle> park in the next leased slot -> OK <id> <zone> <slot> | ERR
+//   U <token>           return the unused slots      -> OK | ERR
+// Blank lines and lines starting with '#' produce no output.
+class BatchRunner {
+private:
+    ParkingSystem& system;
+    OutputBuffer& out;
+    long long commandCount;
+    long long errorCount;
+
+    void appendAllocation(const ParkingRequest* request);
+
+public:
+    BatchRunner(ParkingSystem& sys, OutputBuffer& output);
+
+    void executeLine(char* line, int len);
+    long long run(FILE* in);
+    long long getCommandCount() const;
+    long long getErrorCount() const;
+};
+
+#endif
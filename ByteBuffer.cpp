@@ -0,0 +1,113 @@
+#include "ByteBuffer.h"
+#include <cstring>
+
+ByteBuffer::ByteBuffer(int initialCapacity)
+    : length(0), capacity(initialCapacity), readOffset(0) {
+    data = new char[initialCapacity];
+}
+
+ByteBuffer::~ByteBuffer() {
+    delete[] data;
+}
+
+void ByteBuffer::reserve(int extra) {
+    if (length + extra <= capacity) return;
+
+    // Reclaim consumed bytes before growing
+    if (readOffset > 0) {
+        memmove(data, data + readOffset, length - readOffset);
+        length -= readOffset;
+        readOffset = 0;
+        if (length + extra <= capacity) return;
+    }
+
+    int newCapacity = capacity * 2;
+    while (newCapacity < length + extra) newCapacity *= 2;
+    char* grown = new char[newCapacity];
+    memcpy(grown, data, length);
+    delete[] data;
+    data = grown;
+    capacity = newCapacity;
+}
+
+void ByteBuffer::append(const char* text) {
+    append(text, (int)strlen(text));
+}
+
+void ByteBuffer::append(const char* bytes, int len) {
+    reserve(len);
+    memcpy(data + length, bytes, len);
+    length += len;
+}
+
+void ByteBuffer::append(char c) {
+    reserve(1);
+    data[length++] = c;
+}
+
+void ByteBuffer::appendInt(long long value) {
+    char digits[24];
+    int count = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value
+                                             : (unsigned long long)value;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    reserve(count + 1);
+    if (value < 0) {
+        data[length++] = '-';
+    }
+    while (count > 0) {
+        data[length++] = digits[--count];
+    }
+}
+
+void ByteBuffer::appendJsonString(const char* text) {
+    static const char hex[] = "0123456789abcdef";
+    append('"');
+    for (const unsigned char* p = (const unsigned char*)text; *p != '\0'; p++) {
+        if (*p == '"' || *p == '\\') {
+            append('\\');
+            append((char)*p);
+        } else if (*p < 0x20) {
+            append("\\u00", 4);
+            append(hex[*p >> 4]);
+            append(hex[*p & 0xF]);
+        } else {
+            append((char)*p);
+        }
+    }
+    append('"');
+}
+
+char* ByteBuffer::writePointer(int minSpace) {
+    reserve(minSpace);
+    return data + length;
+}
+
+void ByteBuffer::commitWrite(int len) {
+    length += len;
+}
+
+const char* ByteBuffer::readPointer() const {
+    return data + readOffset;
+}
+
+int ByteBuffer::readable() const {
+    return length - readOffset;
+}
+
+void ByteBuffer::consume(int len) {
+    readOffset += len;
+    if (readOffset >= length) {
+        readOffset = 0;
+        length = 0;
+    }
+}
+
+void ByteBuffer::clear() {
+    length = 0;
+    readOffset = 0;
+}
@@ -0,0 +1,33 @@
+#ifndef BYTEBUFFER_H
+#define BYTEBUFFER_H
+
+// Growable in-memory byte buffer used for socket I/O and response building
+class ByteBuffer {
+private:
+    char* data;
+    int length;
+    int capacity;
+    int readOffset;
+
+    void reserve(int extra);
+
+public:
+    ByteBuffer(int initialCapacity = 4096);
+    ~ByteBuffer();
+
+    void append(const char* text);
+    void append(const char* bytes, int len);
+    void append(char c);
+    void appendInt(long long value);
+    void appendJsonString(const char* text);
+
+    char* writePointer(int minSpace);
+    void commitWrite(int len);
+
+    const char* readPointer() const;
+    int readable() const;
+    void consume(int len);
+    void clear();
+};
+
+#endif
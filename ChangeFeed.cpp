@@ -0,0 +1,105 @@
+#include "ChangeFeed.h"
+#include "MemoryStats.h"
+
+ChangeFeed::ChangeFeed(int minCapacity) : lastSeq(0) {
+    capacity = 1;
+    while (capacity < minCapacity) capacity <<= 1;
+    ring = trackedArray<ChangeEvent>(MEMORY_HISTORY, capacity);
+    seenCapacity = capacity * 2;
+    seenKeys = trackedArray<long long>(MEMORY_HISTORY, seenCapacity);
+    seenBuckets = trackedArray<int>(MEMORY_HISTORY, capacity);
+    for (int i = 0; i < seenCapacity; i++) {
+        seenKeys[i] = 0;
+    }
+}
+
+ChangeFeed::~ChangeFeed() {
+    trackedFree(MEMORY_HISTORY, ring, capacity);
+    trackedFree(MEMORY_HISTORY, seenKeys, seenCapacity);
+    trackedFree(MEMORY_HISTORY, seenBuckets, capacity);
+}
+
+long long ChangeFeed::keyOf(const ChangeEvent& event) {
+    // Slot ids are unique only within a zone
+    if (event.type == CHANGE_SLOT) {
+        return ((long long)event.zoneId << 32) ^ (unsigned int)event.slotId;
+    }
+    return -(long long)event.requestId - 1;
+}
+
+long long ChangeFeed::append(ChangeEvent& event) {
+    event.seq = ++lastSeq;
+    ring[event.seq & (capacity - 1)] = event;
+    return event.seq;
+}
+
+long long ChangeFeed::getLastSeq() const {
+    return lastSeq;
+}
+
+long long ChangeFeed::getOldestSeq() const {
+    long long oldest = lastSeq - capacity + 1;
+    return oldest > 1 ? oldest : 1;
+}
+
+bool ChangeFeed::covers(long long afterSeq) const {
+    return afterSeq >= 0 && afterSeq <= lastSeq && afterSeq + 1 >= getOldestSeq();
+}
+
+int ChangeFeed::getCapacity() const {
+    return capacity;
+}
+
+int ChangeFeed::readSince(long long afterSeq, ChangeEvent* out, int max) const {
+    if (!covers(afterSeq)) return 0;
+    int count = 0;
+    for (long long seq = afterSeq + 1; seq <= lastSeq && count < max; seq++) {
+        out[count++] = ring[seq & (capacity - 1)];
+    }
+    return count;
+}
+
+int ChangeFeed::readCoalesced(long long afterSeq, ChangeEvent* out, int max) {
+    if (!covers(afterSeq)) return -1;
+
+    // Walk newest to oldest so the first time a key is seen is its latest
+    // state; earlier events for the same key are superseded
+    int count = 0;
+    bool truncated = false;
+    for (long long seq = lastSeq; seq > afterSeq; seq--) {
+        const ChangeEvent& event = ring[seq & (capacity - 1)];
+        long long key = keyOf(event);
+        long long stored = key >= 0 ? key + 1 : key;    // 0 marks an empty bucket
+        unsigned long long h = (unsigned long long)key * 0x9E3779B97F4A7C15ULL;
+        int bucket = (int)(h >> 32) & (seenCapacity - 1);
+        bool seen = false;
+        while (seenKeys[bucket] != 0) {
+            if (seenKeys[bucket] == stored) {
+                seen = true;
+                break;
+            }
+            bucket = (bucket + 1) & (seenCapacity - 1);
+        }
+        if (seen) continue;
+        if (count == max) {
+            truncated = true;
+            break;
+        }
+        seenKeys[bucket] = stored;
+        seenBuckets[count] = bucket;
+        out[count++] = event;
+    }
+
+    // Only the touched buckets need clearing for the next call
+    for (int i = 0; i < count; i++) {
+        seenKeys[seenBuckets[i]] = 0;
+    }
+    if (truncated) return -1;
+
+    for (int i = 0, j = count - 1; i < j; i++, j--) {
+        ChangeEvent temp = out[i];
+        out[i] = out[j];
+        out[j] = temp;
+    }
+    return count;
+}
@@ -0,0 +1,67 @@
+#ifndef CHANGEFEED_H
+#define CHANGEFEED_H
+
+enum ChangeType {
+    CHANGE_SLOT = 1,
+    CHANGE_REQUEST = 2
+};
+
+const int CHANGE_VEHICLE_LEN = 32;
+
+// One delta. Slot events carry the slot's new availability and the zone's
+// free count after the change; request events carry the new state and the
+// allocation so a client never has to refetch the request.
+struct ChangeEvent {
+    long long seq;
+    long long time;
+    int type;
+    int zoneId;
+    int slotId;
+    int requestId;
+    int state;              // slot: 1 available / 0 taken; request: RequestState
+    int zoneAvailable;
+    int slotClass;          // slot: its class; request: the class asked for
+    int classAvailable;     // slot: zone's free count for that class
+    int requestedZone;
+    bool crossZone;
+    double distance;        // request: cross-zone distance, 0 if same zone
+    char vehicleId[CHANGE_VEHICLE_LEN];
+};
+
+// Fixed-size ring of the most recent deltas, numbered from 1. A subscriber
+// that remembers the last sequence it applied can catch up with readSince()
+// as long as it has not fallen further behind than the ring holds; otherwise
+// it must take a fresh snapshot.
+class ChangeFeed {
+private:
+    ChangeEvent* ring;
+    int capacity;           // power of two
+    long long lastSeq;
+
+    // Scratch hash set used by readCoalesced, sized to the ring
+    long long* seenKeys;
+    int* seenBuckets;
+    int seenCapacity;
+
+    static long long keyOf(const ChangeEvent& event);
+
+public:
+    ChangeFeed(int minCapacity = 65536);
+    ~ChangeFeed();
+
+    long long append(ChangeEvent& event);
+    long long getLastSeq() const;
+    long long getOldestSeq() const;
+    bool covers(long long afterSeq) const;
+    int getCapacity() const;
+
+    // Copies events with seq > afterSeq into out (at most max); returns count
+    int readSince(long long afterSeq, ChangeEvent* out, int max) const;
+
+    // Like readSince but keeps only the newest event per slot and request,
+    // in sequence order. Returns -1 if afterSeq has already been overwritten
+    // or the distinct changes do not fit in max; the caller then snapshots.
+    int readCoalesced(long long afterSeq, ChangeEvent* out, int max);
+};
+
+#endif
@@ -0,0 +1,154 @@
+#include "EngineStats.h"
+#include <chrono>
+#include <iostream>
+
+EngineStats::EngineStats() {
+    reset();
+}
+
+void EngineStats::add(StatCounter counter, unsigned long long value) {
+    counters[counter].fetch_add(value, std::memory_order_relaxed);
+}
+
+void EngineStats::addTime(StatTimer timer, unsigned long long nanos) {
+    timerNanos[timer].fetch_add(nanos, std::memory_order_relaxed);
+    timerCalls[timer].fetch_add(1, std::memory_order_relaxed);
+}
+
+void EngineStats::recordScan(int slotsExamined, int areasVisited, int zonesVisited) {
+    counters[STAT_SLOTS_EXAMINED].fetch_add(slotsExamined, std::memory_order_relaxed);
+    counters[STAT_AREAS_VISITED].fetch_add(areasVisited, std::memory_order_relaxed);
+    counters[STAT_ZONES_VISITED].fetch_add(zonesVisited, std::memory_order_relaxed);
+
+    int bucket = 0;
+    while (bucket < SCAN_HISTOGRAM_BUCKETS - 1 && (slotsExamined >> bucket) != 0) {
+        bucket++;
+    }
+    scanHistogram[bucket].fetch_add(1, std::memory_order_relaxed);
+
+    unsigned long long length = (unsigned long long)slotsExamined;
+    unsigned long long seen = maxScanLength.load(std::memory_order_relaxed);
+    while (length > seen &&
+           !maxScanLength.compare_exchange_weak(seen, length, std::memory_order_relaxed)) {
+    }
+}
+
+unsigned long long EngineStats::get(StatCounter counter) const {
+    return counters[counter].load(std::memory_order_relaxed);
+}
+
+unsigned long long EngineStats::getTimerNanos(StatTimer timer) const {
+    return timerNanos[timer].load(std::memory_order_relaxed);
+}
+
+unsigned long long EngineStats::getTimerCalls(StatTimer timer) const {
+    return timerCalls[timer].load(std::memory_order_relaxed);
+}
+
+unsigned long long EngineStats::getMaxScanLength() const {
+    return maxScanLength.load(std::memory_order_relaxed);
+}
+
+void EngineStats::reset() {
+    for (int i = 0; i < STAT_COUNTER_COUNT; i++) {
+        counters[i].store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < STAT_TIMER_COUNT; i++) {
+        timerNanos[i].store(0, std::memory_order_relaxed);
+        timerCalls[i].store(0, std::memory_order_relaxed);
+    }
+    for (int i = 0; i < SCAN_HISTOGRAM_BUCKETS; i++) {
+        scanHistogram[i].store(0, std::memory_order_relaxed);
+    }
+    maxScanLength.store(0, std::memory_order_relaxed);
+}
+
+void EngineStats::write(std::ostream& out, StatsFormat format) const {
+    if (format == STATS_PROMETHEUS) {
+        for (int i = 0; i < STAT_COUNTER_COUNT; i++) {
+            out << "# TYPE parking_" << counterName((StatCounter)i) << "_total counter\n";
+            out << "parking_" << counterName((StatCounter)i) << "_total " << get((StatCounter)i) << "\n";
+        }
+        for (int i = 0; i < STAT_TIMER_COUNT; i++) {
+            out << "# TYPE parking_" << timerName((StatTimer)i) << "_seconds summary\n";
+            out << "parking_" << timerName((StatTimer)i) << "_seconds_sum "
+                << getTimerNanos((StatTimer)i) / 1e9 << "\n";
+            out << "parking_" << timerName((StatTimer)i) << "_seconds_count "
+                << getTimerCalls((StatTimer)i) << "\n";
+        }
+        out << "# TYPE parking_scan_length_slots histogram\n";
+        unsigned long long cumulative = 0;
+        for (int b = 0; b < SCAN_HISTOGRAM_BUCKETS; b++) {
+            cumulative += scanHistogram[b].load(std::memory_order_relaxed);
+            out << "parking_scan_length_slots_bucket{le=\"";
+            if (b == SCAN_HISTOGRAM_BUCKETS - 1) {
+                out << "+Inf";
+            } else {
+                out << ((1ULL << b) - 1);
+            }
+            out << "\"} " << cumulative << "\n";
+        }
+        out << "parking_scan_length_slots_sum " << get(STAT_SLOTS_EXAMINED) << "\n";
+        out << "parking_scan_length_slots_count " << cumulative << "\n";
+        out << "# TYPE parking_scan_length_max_slots gauge\n";
+        out << "parking_scan_length_max_slots " << getMaxScanLength() << "\n";
+        return;
+    }
+
+    out << "{\"counters\":{";
+    for (int i = 0; i < STAT_COUNTER_COUNT; i++) {
+        if (i > 0) out << ",";
+        out << "\"" << counterName((StatCounter)i) << "\":" << get((StatCounter)i);
+    }
+    out << "},\"timers\":{";
+    for (int i = 0; i < STAT_TIMER_COUNT; i++) {
+        if (i > 0) out << ",";
+        out << "\"" << timerName((StatTimer)i) << "\":{\"nanos\":" << getTimerNanos((StatTimer)i)
+            << ",\"calls\":" << getTimerCalls((StatTimer)i) << "}";
+    }
+    out << "},\"scanHistogram\":[";
+    for (int b = 0; b < SCAN_HISTOGRAM_BUCKETS; b++) {
+        if (b > 0) out << ",";
+        out << scanHistogram[b].load(std::memory_order_relaxed);
+    }
+    out << "],\"maxScanLength\":" << getMaxScanLength() << "}";
+}
+
+const char* EngineStats::counterName(StatCounter counter) {
+    switch (counter) {
+        case STAT_ALLOCATIONS: return "allocations";
+        case STAT_SAME_ZONE: return "same_zone_allocations";
+        case STAT_CROSS_ZONE: return "cross_zone_allocations";
+        case STAT_FAILED: return "failed_allocations";
+        case STAT_SLOTS_EXAMINED: return "slots_examined";
+        case STAT_AREAS_VISITED: return "areas_visited";
+        case STAT_ZONES_VISITED: return "zones_visited";
+        case STAT_WAITLISTED: return "waitlisted_requests";
+        case STAT_WAITLIST_ASSIGNED: return "waitlist_assignments";
+        case STAT_DRAIN_MOVED: return "drain_moved";
+        case STAT_DRAIN_CANCELLED: return "drain_cancelled";
+        case STAT_AFFINITY_HITS: return "affinity_hits";
+        case STAT_AFFINITY_MISSES: return "affinity_misses";
+        case STAT_LEASED: return "leased_slots";
+        case STAT_LEASE_PARKS: return "lease_parks";
+        case STAT_LEASE_RECLAIMED: return "lease_reclaimed";
+        case STAT_LEASE_RETURNED: return "lease_returned";
+        default: return "unknown";
+    }
+}
+
+const char* EngineStats::timerName(StatTimer timer) {
+    switch (timer) {
+        case TIMER_FIND_SLOT_IN_ZONE: return "find_slot_in_zone";
+        case TIMER_FIND_SLOT_IN_OTHER_ZONES: return "find_slot_in_other_zones";
+        case TIMER_FIND_REQUEST: return "find_request";
+        case TIMER_RELEASE: return "release";
+        case TIMER_DRAIN: return "drain";
+        default: return "unknown";
+    }
+}
+
+long long EngineStats::now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,92 @@
+#ifndef ENGINESTATS_H
+#define ENGINESTATS_H
+
+#include <atomic>
+#include <iosfwd>
+
+enum StatsFormat {
+    STATS_PROMETHEUS,
+    STATS_JSON
+};
+
+enum StatCounter {
+    STAT_ALLOCATIONS,
+    STAT_SAME_ZONE,
+    STAT_CROSS_ZONE,
+    STAT_FAILED,
+    STAT_SLOTS_EXAMINED,
+    STAT_AREAS_VISITED,
+    STAT_ZONES_VISITED,
+    STAT_WAITLISTED,
+    STAT_WAITLIST_ASSIGNED,
+    STAT_DRAIN_MOVED,           // vehicles moved out of drained zones
+    STAT_DRAIN_CANCELLED,       // ones nothing could be found for
+    STAT_AFFINITY_HITS,         // returning vehicles given their last slot again
+    STAT_AFFINITY_MISSES,       // lookups that fell through to the policy
+    STAT_LEASED,                // slots handed to gates in leases
+    STAT_LEASE_PARKS,           // vehicles parked from a lease, no engine search
+    STAT_LEASE_RECLAIMED,       // leased slots taken back for a request that found nothing
+    STAT_LEASE_RETURNED,        // unused slots back from returned or expired leases
+    STAT_COUNTER_COUNT
+};
+
+enum StatTimer {
+    TIMER_FIND_SLOT_IN_ZONE,
+    TIMER_FIND_SLOT_IN_OTHER_ZONES,
+    TIMER_FIND_REQUEST,
+    TIMER_RELEASE,
+    TIMER_DRAIN,
+    STAT_TIMER_COUNT
+};
+
+// Bucket b counts allocations that examined [2^(b-1), 2^b) slots
+const int SCAN_HISTOGRAM_BUCKETS = 24;
+
+// All counters are relaxed atomics: they are only ever summed, so no
+// ordering with the allocation state is needed.
+class EngineStats {
+private:
+    std::atomic<unsigned long long> counters[STAT_COUNTER_COUNT];
+    std::atomic<unsigned long long> timerNanos[STAT_TIMER_COUNT];
+    std::atomic<unsigned long long> timerCalls[STAT_TIMER_COUNT];
+    std::atomic<unsigned long long> scanHistogram[SCAN_HISTOGRAM_BUCKETS];
+    std::atomic<unsigned long long> maxScanLength;
+
+public:
+    EngineStats();
+
+    void add(StatCounter counter, unsigned long long value);
+    void addTime(StatTimer timer, unsigned long long nanos);
+    void recordScan(int slotsExamined, int areasVisited, int zonesVisited);
+
+    unsigned long long get(StatCounter counter) const;
+    unsigned long long getTimerNanos(StatTimer timer) const;
+    unsigned long long getTimerCalls(StatTimer timer) const;
+    unsigned long long getMaxScanLength() const;
+    void reset();
+
+    void write(std::ostream& out, StatsFormat format) const;
+
+    static const char* counterName(StatCounter counter);
+    static const char* timerName(StatTimer timer);
+    static long long now();
+};
+
+// Adds the lifetime of the enclosing scope to one timer
+class ScopedStatTimer {
+private:
+    EngineStats* stats;
+    StatTimer timer;
+    long long start;
+
+public:
+    ScopedStatTimer(EngineStats* engineStats, StatTimer t)
+        : stats(engineStats), timer(t), start(engineStats != nullptr ? EngineStats::now() : 0) {}
+    ~ScopedStatTimer() {
+        if (stats != nullptr) {
+            stats->addTime(timer, (unsigned long long)(EngineStats::now() - start));
+        }
+    }
+};
+
+#endif
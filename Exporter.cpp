@@ -0,0 +1,340 @@
+#include "Exporter.h"
+#include "OutputBuffer.h"
+#include "ParkingSystem.h"
+#include "ParkingRequest.h"
+#include "RequestStore.h"
+#include "Zone.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <strings.h>
+
+static_assert(sizeof(ExportHeader) == 16, "export header layout");
+static_assert(sizeof(ExportRequestRecord) == 96, "export request record layout");
+static_assert(sizeof(ExportZoneRecord) == 32, "export zone record layout");
+static_assert(sizeof(ExportAnalyticsRecord) == 56, "export analytics record layout");
+
+static const unsigned short EXPORT_VERSION = 1;
+static const char* TABLE_NAMES[] = {"requests", "zones", "analytics"};
+static const char* FORMAT_NAMES[] = {"csv", "binary"};
+
+ExportOptions::ExportOptions()
+    : table(EXPORT_REQUESTS), format(EXPORT_CSV), stateMask(~0u), from(0),
+      to(0x7FFFFFFFFFFFFFFFLL), cursor(1), limit(0) {}
+
+static bool parseNumber(const char* text, int len, long long& value) {
+    if (len <= 0 || len > 20) return false;
+    char digits[24];
+    memcpy(digits, text, len);
+    digits[len] = '\0';
+    char* end;
+    value = strtoll(digits, &end, 10);
+    return *end == '\0';
+}
+
+static int findName(const char* const* names, int count, const char* text, int len) {
+    for (int i = 0; i < count; i++) {
+        if ((int)strlen(names[i]) == len && strncasecmp(names[i], text, len) == 0) return i;
+    }
+    return -1;
+}
+
+bool ExportOptions::parse(const char* text, int len, char* error, int errorSize) {
+    int i = 0;
+    while (i < len) {
+        while (i < len && (text[i] == ' ' || text[i] == '\t' || text[i] == '&')) i++;
+        if (i >= len) break;
+        int start = i;
+        while (i < len && text[i] != ' ' && text[i] != '\t' && text[i] != '&') i++;
+        const char* term = text + start;
+        int termLen = i - start;
+
+        const char* equals = (const char*)memchr(term, '=', termLen);
+        bool ok = equals != nullptr;
+        if (ok) {
+            int nameLen = (int)(equals - term);
+            const char* value = equals + 1;
+            int valueLen = termLen - nameLen - 1;
+            long long number = 0;
+#define NAME_IS(literal) (nameLen == (int)sizeof(literal) - 1 && strncmp(term, literal, nameLen) == 0)
+            if (NAME_IS("table")) {
+                int found = findName(TABLE_NAMES, 3, value, valueLen);
+                ok = found >= 0;
+                if (ok) table = (ExportTable)found;
+            } else if (NAME_IS("format")) {
+                int found = findName(FORMAT_NAMES, 2, value, valueLen);
+                ok = found >= 0;
+                if (ok) format = (ExportFormat)found;
+            } else if (NAME_IS("state")) {
+                stateMask = 0;
+                int partStart = 0;
+                for (int j = 0; ok && j <= valueLen; j++) {
+                    if (j < valueLen && value[j] != ',') continue;
+                    int state = REQUESTED;
+                    while (state <= CANCELLED &&
+                           ((int)strlen(requestStateName((RequestState)state)) != j - partStart ||
+                            strncasecmp(requestStateName((RequestState)state), value + partStart,
+                                        j - partStart) != 0)) {
+                        state++;
+                    }
+                    ok = state <= CANCELLED;
+                    stateMask |= 1u << state;
+                    partStart = j + 1;
+                }
+            } else if (NAME_IS("from")) {
+                ok = parseNumber(value, valueLen, from);
+            } else if (NAME_IS("to")) {
+                ok = parseNumber(value, valueLen, to);
+            } else if (NAME_IS("cursor")) {
+                ok = parseNumber(value, valueLen, number) && number >= 1 && number <= 0x7FFFFFFF;
+                cursor = (int)number;
+            } else if (NAME_IS("limit")) {
+                ok = parseNumber(value, valueLen, number) && number >= 0 && number <= 0x7FFFFFFF;
+                limit = (int)number;
+            } else {
+                ok = false;
+            }
+#undef NAME_IS
+        }
+        if (!ok) {
+            snprintf(error, errorSize, "bad term '%.*s'", termLen, term);
+            return false;
+        }
+    }
+    return true;
+}
+
+const char* Exporter::contentType(ExportFormat format) {
+    return format == EXPORT_CSV ? "text/csv" : "application/octet-stream";
+}
+
+static void writeHeader(OutputBuffer& out, ExportTable table, unsigned recordBytes) {
+    ExportHeader header;
+    memcpy(header.magic, "SPEX", 4);
+    header.version = EXPORT_VERSION;
+    header.table = (unsigned short)table;
+    header.recordBytes = recordBytes;
+    header.reserved = 0;
+    out.append((const char*)&header, sizeof(header));
+}
+
+bool Exporter::matches(const ParkingRequest* request, const ExportOptions& options) {
+    return (options.stateMask & (1u << request->getState())) != 0;
+}
+
+// Quoted only when it has to be
+static void appendCsvText(OutputBuffer& out, const char* text) {
+    if (strpbrk(text, ",\"\r\n") == nullptr) {
+        out.append(text);
+        return;
+    }
+    out.append('"');
+    for (const char* p = text; *p != '\0'; p++) {
+        if (*p == '"') out.append('"');
+        out.append(*p);
+    }
+    out.append('"');
+}
+
+void Exporter::writeRequestCsv(OutputBuffer& out, const ParkingRequest* request) {
+    out.appendInt(request->getRequestId());
+    out.append(',');
+    appendCsvText(out, request->getVehicleId());
+    out.append(',');
+    out.appendInt(request->getRequestedZone());
+    out.append(',');
+    out.append(slotClassName(request->getRequiredClass()));
+    out.append(request->allowsFallback() ? ",1," : ",0,");
+    out.append(requestStateName(request->getState()));
+    out.append(',');
+    out.appendInt(request->getAllocatedZone());
+    out.append(',');
+    out.appendInt(request->getAllocatedSlotId());
+    out.append(',');
+    out.appendInt(request->getRequestTime());
+    out.append(',');
+    out.appendInt(request->getAllocationTime());
+    out.append(',');
+    out.appendInt(request->getReleaseTime());
+    out.append(request->hasCrossZonePenalty() ? ",1," : ",0,");
+    out.appendFixed(request->getCrossZoneDistance(), 2);
+    out.append('\n');
+}
+
+void Exporter::writeRequestBinary(OutputBuffer& out, const ParkingRequest* request) {
+    ExportRequestRecord record;
+    record.requestId = request->getRequestId();
+    record.requestedZone = request->getRequestedZone();
+    record.allocatedZone = request->getAllocatedZone();
+    record.slotId = request->getAllocatedSlotId();
+    record.requestTime = request->getRequestTime();
+    record.allocationTime = request->getAllocationTime();
+    record.releaseTime = request->getReleaseTime();
+    record.crossZoneDistance = (float)request->getCrossZoneDistance();
+    record.state = (unsigned char)request->getState();
+    record.slotClass = (unsigned char)request->getRequiredClass();
+    record.flags = (request->allowsFallback() ? 1 : 0) | (request->hasCrossZonePenalty() ? 2 : 0);
+    const char* plate = request->getVehicleId();
+    int length = (int)strlen(plate);
+    record.plateLength = (unsigned char)(length < 255 ? length : 255);
+    int kept = length < EXPORT_PLATE_BYTES ? length : EXPORT_PLATE_BYTES;
+    memcpy(record.plate, plate, kept);
+    memset(record.plate + kept, 0, EXPORT_PLATE_BYTES - kept);
+    out.append((const char*)&record, sizeof(record));
+}
+
+// First request ID whose request time is at least time
+static int firstAtOrAfter(const RequestStore& requests, long long time) {
+    int low = 1;
+    int high = requests.getCount() + 1;
+    while (low < high) {
+        int middle = low + (high - low) / 2;
+        if (requests.get(middle)->getRequestTime() < time) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    return low;
+}
+
+int Exporter::writeRequests(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options) {
+    const RequestStore& requests = system.getRequests();
+    if (options.format == EXPORT_CSV) {
+        out.append("requestId,vehicleId,requestedZone,slotClass,fallback,state,allocatedZone,"
+                   "slotId,requestTime,allocationTime,releaseTime,crossZone,crossZoneDistance\n");
+    } else {
+        writeHeader(out, EXPORT_REQUESTS, sizeof(ExportRequestRecord));
+    }
+
+    int count = requests.getCount();
+    int id = firstAtOrAfter(requests, options.from);
+    if (id < options.cursor) id = options.cursor;
+    int rows = 0;
+    for (; id <= count; id++) {
+        const ParkingRequest* request = requests.get(id);
+        if (request->getRequestTime() >= options.to) return 0;
+        if (!matches(request, options)) continue;
+        if (options.limit > 0 && rows == options.limit) return id;
+        if (options.format == EXPORT_CSV) {
+            writeRequestCsv(out, request);
+        } else {
+            writeRequestBinary(out, request);
+        }
+        rows++;
+    }
+    return 0;
+}
+
+void Exporter::writeZones(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options) {
+    if (options.format == EXPORT_CSV) {
+        out.append("zoneId,areas,totalSlots,availableSlots,occupiedSlots,utilization,x,y\n");
+    } else {
+        writeHeader(out, EXPORT_ZONES, sizeof(ExportZoneRecord));
+    }
+    for (int i = 0; i < system.getZoneCount(); i++) {
+        const Zone* zone = system.getZoneAt(i);
+        int total = zone->getTotalSlots();
+        int available = zone->getAvailableSlots();
+        if (options.format == EXPORT_CSV) {
+            out.appendInt(zone->getZoneId());
+            out.append(',');
+            out.appendInt(zone->getAreaCount());
+            out.append(',');
+            out.appendInt(total);
+            out.append(',');
+            out.appendInt(available);
+            out.append(',');
+            out.appendInt(total - available);
+            out.append(',');
+            out.appendFixed(total > 0 ? (double)(total - available) / total : 0, 4);
+            out.append(',');
+            out.appendFixed(zone->getX(), 6);
+            out.append(',');
+            out.appendFixed(zone->getY(), 6);
+            out.append('\n');
+        } else {
+            ExportZoneRecord record;
+            record.zoneId = zone->getZoneId();
+            record.areaCount = zone->getAreaCount();
+            record.totalSlots = total;
+            record.availableSlots = available;
+            record.x = zone->getX();
+            record.y = zone->getY();
+            out.append((const char*)&record, sizeof(record));
+        }
+    }
+}
+
+void Exporter::writeAnalytics(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options) {
+    int zoneCount = system.getZoneCount();
+    ExportAnalyticsRecord* zones = new ExportAnalyticsRecord[zoneCount];
+    memset(zones, 0, sizeof(ExportAnalyticsRecord) * zoneCount);
+    for (int i = 0; i < zoneCount; i++) {
+        zones[i].zoneId = system.getZoneAt(i)->getZoneId();
+    }
+
+    const RequestStore& requests = system.getRequests();
+    int count = requests.getCount();
+    for (int id = firstAtOrAfter(requests, options.from); id <= count; id++) {
+        const ParkingRequest* request = requests.get(id);
+        if (request->getRequestTime() >= options.to) break;
+        if (!matches(request, options)) continue;
+        int requested = system.getZonePosition(request->getRequestedZone());
+        if (requested >= 0) {
+            zones[requested].requests++;
+            if (request->getState() == CANCELLED) zones[requested].cancelled++;
+        }
+        int allocated = system.getZonePosition(request->getAllocatedZone());
+        if (allocated >= 0) {
+            zones[allocated].allocations++;
+            if (request->hasCrossZonePenalty()) zones[allocated].crossZoneIn++;
+            if (request->getState() == RELEASED) {
+                zones[allocated].completed++;
+                zones[allocated].totalDuration += request->getParkingDuration();
+            }
+        }
+    }
+
+    if (options.format == EXPORT_CSV) {
+        out.append("zoneId,requests,cancelled,allocations,crossZoneIn,completed,totalDuration,"
+                   "averageDuration\n");
+        for (int i = 0; i < zoneCount; i++) {
+            const ExportAnalyticsRecord& zone = zones[i];
+            out.appendInt(zone.zoneId);
+            out.append(',');
+            out.appendInt(zone.requests);
+            out.append(',');
+            out.appendInt(zone.cancelled);
+            out.append(',');
+            out.appendInt(zone.allocations);
+            out.append(',');
+            out.appendInt(zone.crossZoneIn);
+            out.append(',');
+            out.appendInt(zone.completed);
+            out.append(',');
+            out.appendInt(zone.totalDuration);
+            out.append(',');
+            out.appendFixed(zone.completed > 0 ? (double)zone.totalDuration / zone.completed : 0, 2);
+            out.append('\n');
+        }
+    } else {
+        writeHeader(out, EXPORT_ANALYTICS, sizeof(ExportAnalyticsRecord));
+        out.append((const char*)zones, (int)sizeof(ExportAnalyticsRecord) * zoneCount);
+    }
+    delete[] zones;
+}
+
+int Exporter::write(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options) {
+    switch (options.table) {
+        case EXPORT_REQUESTS:
+            return writeRequests(out, system, options);
+        case EXPORT_ZONES:
+            writeZones(out, system, options);
+            return 0;
+        case EXPORT_ANALYTICS:
+            writeAnalytics(out, system, options);
+            return 0;
+    }
+    return 0;
+}
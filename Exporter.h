@@ -0,0 +1,103 @@
+#ifndef EXPORTER_H
+#define EXPORTER_H
+
+class OutputBuffer;
+class ParkingSystem;
+class ParkingRequest;
+
+enum ExportTable {
+    EXPORT_REQUESTS,
+    EXPORT_ZONES,
+    EXPORT_ANALYTICS        // per zone, over the requests that pass the filter
+};
+
+enum ExportFormat {
+    EXPORT_CSV,
+    EXPORT_BINARY
+};
+
+// Binary exports start with this header, followed by fixed-width
+// little-endian records of recordBytes each
+struct ExportHeader {
+    char magic[4];          // "SPEX"
+    unsigned short version;
+    unsigned short table;
+    unsigned recordBytes;
+    unsigned reserved;
+};
+
+const int EXPORT_PLATE_BYTES = 48;
+
+struct ExportRequestRecord {
+    int requestId;
+    int requestedZone;
+    int allocatedZone;      // -1 if none
+    int slotId;             // -1 if none
+    long long requestTime;
+    long long allocationTime;   // 0 if never allocated
+    long long releaseTime;      // 0 if never released
+    float crossZoneDistance;
+    unsigned char state;
+    unsigned char slotClass;
+    unsigned char flags;    // 1 = fallback allowed, 2 = cross-zone
+    unsigned char plateLength;  // full length, capped at 255
+    char plate[EXPORT_PLATE_BYTES]; // NUL-padded, cut at EXPORT_PLATE_BYTES
+};
+
+struct ExportZoneRecord {
+    int zoneId;
+    int areaCount;
+    int totalSlots;
+    int availableSlots;
+    double x;
+    double y;
+};
+
+struct ExportAnalyticsRecord {
+    int zoneId;
+    int reserved;
+    long long requests;     // requested this zone
+    long long cancelled;
+    long long allocations;  // allocated in this zone
+    long long crossZoneIn;  // of those, requested elsewhere
+    long long completed;
+    long long totalDuration;
+};
+
+// What to export, written as terms like other reports:
+//   table=requests format=csv state=released,cancelled from=1000 to=2000
+// plus cursor=<request ID> and limit=<rows> for paging through requests
+struct ExportOptions {
+    ExportTable table;
+    ExportFormat format;
+    unsigned stateMask;     // 1 << RequestState
+    long long from;         // request time, from <= t < to
+    long long to;
+    int cursor;             // first request ID to look at
+    int limit;              // rows per page, 0 for no limit
+
+    ExportOptions();
+    bool parse(const char* text, int len, char* error, int errorSize);
+};
+
+// Streams tables straight into an OutputBuffer: every field is formatted in
+// place, with no string built per row. Requests are read in ID order, which
+// is also request time order, so a time range starts with a binary search
+// and stops at the first request past it.
+class Exporter {
+private:
+    static bool matches(const ParkingRequest* request, const ExportOptions& options);
+    static void writeRequestCsv(OutputBuffer& out, const ParkingRequest* request);
+    static void writeRequestBinary(OutputBuffer& out, const ParkingRequest* request);
+    static int writeRequests(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options);
+    static void writeZones(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options);
+    static void writeAnalytics(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options);
+
+public:
+    // Header (CSV column names or binary header) then one page of rows.
+    // Returns the cursor for the next page, or 0 once the table is done
+    static int write(OutputBuffer& out, const ParkingSystem& system, const ExportOptions& options);
+    static const char* contentType(ExportFormat format);
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include "FixedParkingSystem.h"
+#include <cstring>
+
+void FixedRequest::reset(int id, const char* vehicle, int reqZone, long long time, SlotClass cls,
+                         bool allowFallback) {
+    requestId = id;
+    requestedZone = reqZone;
+    allocatedZone = -1;
+    allocatedSlotId = -1;
+    slot = -1;
+    requestTime = time;
+    allocationTime = 0;
+    releaseTime = 0;
+    crossZoneDistance = 0;
+    state = REQUESTED;
+    slotClass = (unsigned char)cls;
+    fallback = allowFallback;
+    crossZone = false;
+    strncpy(vehicleId, vehicle, FIXED_PLATE_BYTES - 1);
+    vehicleId[FIXED_PLATE_BYTES - 1] = '\0';
+}
+
+int FixedRequest::getRequestId() const {
+    return requestId;
+}
+
+const char* FixedRequest::getVehicleId() const {
+    return vehicleId;
+}
+
+int FixedRequest::getRequestedZone() const {
+    return requestedZone;
+}
+
+int FixedRequest::getAllocatedZone() const {
+    return allocatedZone;
+}
+
+int FixedRequest::getAllocatedSlotId() const {
+    return allocatedSlotId;
+}
+
+int FixedRequest::getSlotIndex() const {
+    return slot;
+}
+
+RequestState FixedRequest::getState() const {
+    return (RequestState)state;
+}
+
+long long FixedRequest::getRequestTime() const {
+    return requestTime;
+}
+
+long long FixedRequest::getAllocationTime() const {
+    return allocationTime;
+}
+
+long long FixedRequest::getReleaseTime() const {
+    return releaseTime;
+}
+
+bool FixedRequest::hasCrossZonePenalty() const {
+    return crossZone;
+}
+
+double FixedRequest::getCrossZoneDistance() const {
+    return crossZoneDistance;
+}
+
+SlotClass FixedRequest::getRequiredClass() const {
+    return (SlotClass)slotClass;
+}
+
+bool FixedRequest::allowsFallback() const {
+    return fallback;
+}
+
+// Same transitions as ParkingRequest
+bool FixedRequest::transitionTo(RequestState newState) {
+    if ((state == REQUESTED && (newState == ALLOCATED || newState == CANCELLED)) ||
+        (state == ALLOCATED && (newState == OCCUPIED || newState == CANCELLED)) ||
+        (state == OCCUPIED && (newState == RELEASED || newState == CANCELLED))) {
+        state = (unsigned char)newState;
+        return true;
+    }
+    return false;
+}
+
+void FixedRequest::allocate(int zoneId, int slotId, int slotIndex, long long time, bool cross,
+                            double distance) {
+    if (transitionTo(ALLOCATED)) {
+        allocatedZone = zoneId;
+        allocatedSlotId = slotId;
+        slot = slotIndex;
+        allocationTime = time;
+        crossZone = cross;
+        crossZoneDistance = (float)distance;
+    }
+}
+
+void FixedRequest::occupy(long long) {
+    transitionTo(OCCUPIED);
+}
+
+void FixedRequest::release(long long time) {
+    if (transitionTo(RELEASED)) {
+        releaseTime = time;
+    }
+}
+
+void FixedRequest::cancel() {
+    transitionTo(CANCELLED);
+}
+
+long long FixedRequest::getParkingDuration() const {
+    if (state == RELEASED && allocationTime > 0 && releaseTime > 0) {
+        return releaseTime - allocationTime;
+    }
+    return 0;
+}
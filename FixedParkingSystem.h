@@ -0,0 +1,536 @@
+#ifndef FIXEDPARKINGSYSTEM_H
+#define FIXEDPARKINGSYSTEM_H
+
+#include <cmath>
+#include <iostream>
+#include "ParkingRequest.h"
+
+// A lot layout known at compile time. A topology is a type with
+//   static constexpr FixedZoneSpec zones[];   // in zone order
+//   static constexpr FixedAreaSpec areas[];   // zone by zone, in area order
+//   static constexpr FixedSlotSpec slots[];   // area by area, in slot order
+//   static constexpr int requestCapacity;     // request records kept
+//   static constexpr int rollbackCapacity;    // allocations that can be undone
+struct FixedZoneSpec {
+    int zoneId;
+    int areaCount;          // the next areaCount entries of areas
+    double x;
+    double y;
+    bool located;
+};
+
+struct FixedAreaSpec {
+    int areaId;
+    int slotCount;          // the next slotCount entries of slots
+};
+
+struct FixedSlotSpec {
+    int slotId;
+    SlotClass slotClass;
+};
+
+const int FIXED_PLATE_BYTES = 16;
+
+// Request record kept in place in a FixedParkingSystem; same accessors and
+// state machine as ParkingRequest
+class FixedRequest {
+private:
+    int requestId;
+    int requestedZone;
+    int allocatedZone;
+    int allocatedSlotId;
+    int slot;               // slot index in the layout, -1 if none
+    long long requestTime;
+    long long allocationTime;
+    long long releaseTime;
+    float crossZoneDistance;
+    unsigned char state;
+    unsigned char slotClass;
+    bool fallback;
+    bool crossZone;
+    char vehicleId[FIXED_PLATE_BYTES];      // cut at FIXED_PLATE_BYTES - 1
+
+public:
+    void reset(int id, const char* vehicle, int reqZone, long long time, SlotClass cls, bool allowFallback);
+
+    int getRequestId() const;
+    const char* getVehicleId() const;
+    int getRequestedZone() const;
+    int getAllocatedZone() const;
+    int getAllocatedSlotId() const;
+    int getSlotIndex() const;
+    RequestState getState() const;
+    long long getRequestTime() const;
+    long long getAllocationTime() const;
+    long long getReleaseTime() const;
+    bool hasCrossZonePenalty() const;
+    double getCrossZoneDistance() const;
+    SlotClass getRequiredClass() const;
+    bool allowsFallback() const;
+
+    bool transitionTo(RequestState newState);
+    void allocate(int zoneId, int slotId, int slotIndex, long long time, bool cross, double distance);
+    void occupy(long long time);
+    void release(long long time);
+    void cancel();
+    long long getParkingDuration() const;
+};
+
+// Everything derivable from the topology, computed by the compiler: slot
+// ranges per zone, where each (zone, class) free list starts, which slots
+// are standard, and each zone's cross-zone fallback order
+template <typename Topology>
+struct FixedLayout {
+    static constexpr int ZONES = sizeof(Topology::zones) / sizeof(Topology::zones[0]);
+    static constexpr int AREAS = sizeof(Topology::areas) / sizeof(Topology::areas[0]);
+    static constexpr int SLOTS = sizeof(Topology::slots) / sizeof(Topology::slots[0]);
+    static constexpr int WORDS = (SLOTS + 63) / 64;
+
+    int firstSlot[ZONES + 1] = {};      // zone z holds slots firstSlot[z] .. firstSlot[z + 1] - 1
+    int areaFirstSlot[AREAS + 1] = {};
+    int slotZone[SLOTS] = {};
+    int slotArea[SLOTS] = {};
+    int classCount[ZONES][SLOT_CLASS_COUNT] = {};
+    int listStart[ZONES][SLOT_CLASS_COUNT] = {};
+    unsigned long long standardBits[WORDS] = {};
+    int order[ZONES][ZONES] = {};       // other zones, nearest first (all located) or in zone order
+    double distanceSquared[ZONES][ZONES] = {};
+    bool located = true;
+    bool valid = true;
+
+    constexpr FixedLayout() {
+        int area = 0;
+        int slot = 0;
+        for (int z = 0; z < ZONES; z++) {
+            firstSlot[z] = slot;
+            if (!Topology::zones[z].located) located = false;
+            for (int a = 0; a < Topology::zones[z].areaCount && area < AREAS; a++, area++) {
+                areaFirstSlot[area] = slot;
+                for (int s = 0; s < Topology::areas[area].slotCount && slot < SLOTS; s++, slot++) {
+                    slotZone[slot] = z;
+                    slotArea[slot] = area;
+                    classCount[z][Topology::slots[slot].slotClass]++;
+                    if (Topology::slots[slot].slotClass == SLOT_STANDARD) {
+                        standardBits[slot / 64] |= 1ULL << (slot % 64);
+                    }
+                }
+            }
+        }
+        firstSlot[ZONES] = slot;
+        areaFirstSlot[AREAS] = slot;
+        if (area != AREAS || slot != SLOTS) valid = false;
+        for (int a = 0; a < AREAS; a++) {
+            if (areaFirstSlot[a] + Topology::areas[a].slotCount != areaFirstSlot[a + 1]) valid = false;
+        }
+        for (int z = 0; z < ZONES; z++) {
+            if (Topology::zones[z].zoneId < 0) valid = false;
+            for (int other = 0; other < z; other++) {
+                if (Topology::zones[other].zoneId == Topology::zones[z].zoneId) valid = false;
+            }
+        }
+
+        int start = 0;
+        for (int z = 0; z < ZONES; z++) {
+            for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+                listStart[z][c] = start;
+                start += classCount[z][c];
+            }
+        }
+
+        for (int from = 0; from < ZONES; from++) {
+            int count = 0;
+            for (int to = 0; to < ZONES; to++) {
+                double dx = Topology::zones[to].x - Topology::zones[from].x;
+                double dy = Topology::zones[to].y - Topology::zones[from].y;
+                distanceSquared[from][to] = dx * dx + dy * dy;
+                if (to == from) continue;
+                // Insertion by distance; ties keep zone order, as the
+                // spatial index breaks them
+                int i = count++;
+                while (located && i > 0 &&
+                       distanceSquared[from][order[from][i - 1]] > distanceSquared[from][to]) {
+                    order[from][i] = order[from][i - 1];
+                    i--;
+                }
+                order[from][i] = to;
+            }
+        }
+    }
+};
+
+// ParkingSystem for a lot whose layout is fixed at compile time, for gate
+// controllers with no heap to spare. Zones, areas, slots, request records
+// and the rollback stack are arrays sized by the topology; nothing is
+// allocated after construction, and every loop is bounded by a compile-time
+// count, so the compiler sizes and unrolls them for small lots.
+//
+// Allocation matches ParkingSystem with POLICY_FIRST_FIT: the lowest free
+// slot of the requested zone, then the nearest zone with a usable slot.
+// Request records are kept in a ring of requestCapacity: a new request
+// reuses the oldest record unless that one still holds a slot, in which
+// case createRequest returns nullptr. The rollback stack keeps the latest
+// rollbackCapacity allocations. Drains, reservations, the waitlist and the
+// trace/replication hooks are not available.
+template <typename Topology>
+class FixedParkingSystem {
+public:
+    typedef FixedLayout<Topology> Layout;
+    static constexpr int ZONE_COUNT = Layout::ZONES;
+    static constexpr int AREA_COUNT = Layout::AREAS;
+    static constexpr int SLOT_COUNT = Layout::SLOTS;
+    static constexpr int REQUEST_CAPACITY = Topology::requestCapacity;
+    static constexpr int ROLLBACK_CAPACITY = Topology::rollbackCapacity;
+
+private:
+    static constexpr Layout layout = Layout();
+    static_assert(ZONE_COUNT > 0 && SLOT_COUNT > 0, "a fixed topology needs zones and slots");
+    static_assert(layout.valid, "zone area counts and area slot counts must cover the arrays exactly; zone IDs must be unique and non-negative");
+    static_assert(REQUEST_CAPACITY > SLOT_COUNT, "every slot must be able to hold a request with records to spare");
+    static_assert(ROLLBACK_CAPACITY > 0, "rollbackCapacity must be positive");
+
+    struct RollbackEntry {
+        int requestId;
+        int slot;
+    };
+
+    unsigned long long freeBits[Layout::WORDS];
+    int freeList[SLOT_COUNT];                       // (zone, class) stacks at layout.listStart
+    int freeIndex[SLOT_COUNT];                      // position in its stack, -1 if taken
+    int freeCount[ZONE_COUNT][SLOT_CLASS_COUNT];
+    int available[ZONE_COUNT];
+    int areaAvailable[AREA_COUNT];
+    FixedRequest requests[REQUEST_CAPACITY];        // request ID n at (n - 1) % REQUEST_CAPACITY
+    int requestCount;
+    RollbackEntry rollback[ROLLBACK_CAPACITY];      // ring; newest at rollbackTop - 1
+    int rollbackTop;
+    int rollbackDepth;
+    long long currentTime;
+
+    long long getCurrentTime() {
+        return ++currentTime;
+    }
+
+    static int positionOf(int zoneId) {
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            if (Topology::zones[z].zoneId == zoneId) return z;
+        }
+        return -1;
+    }
+
+    void addFree(int slot) {
+        int z = layout.slotZone[slot];
+        SlotClass c = Topology::slots[slot].slotClass;
+        freeIndex[slot] = freeCount[z][c];
+        freeList[layout.listStart[z][c] + freeCount[z][c]++] = slot;
+        freeBits[slot / 64] |= 1ULL << (slot % 64);
+        available[z]++;
+        areaAvailable[layout.slotArea[slot]]++;
+    }
+
+    // Swaps the last free slot of the class into the hole, as Zone does
+    void removeFree(int slot) {
+        int z = layout.slotZone[slot];
+        SlotClass c = Topology::slots[slot].slotClass;
+        int* list = freeList + layout.listStart[z][c];
+        int last = list[--freeCount[z][c]];
+        list[freeIndex[slot]] = last;
+        freeIndex[last] = freeIndex[slot];
+        freeIndex[slot] = -1;
+        freeBits[slot / 64] &= ~(1ULL << (slot % 64));
+        available[z]--;
+        areaAvailable[layout.slotArea[slot]]--;
+    }
+
+    int findFirstStandard(int z) const {
+        int first = layout.firstSlot[z];
+        int end = layout.firstSlot[z + 1];
+        for (int w = first / 64; w * 64 < end; w++) {
+            unsigned long long bits = freeBits[w] & layout.standardBits[w];
+            if (w == first / 64) bits &= ~0ULL << (first % 64);
+            if (bits != 0) {
+                int slot = w * 64 + __builtin_ctzll(bits);
+                return slot < end ? slot : -1;
+            }
+        }
+        return -1;
+    }
+
+    int findInZone(int z, SlotClass slotClass, bool fallback) const {
+        if (slotClass == SLOT_STANDARD) return findFirstStandard(z);
+        int count = freeCount[z][slotClass];
+        if (count > 0) return freeList[layout.listStart[z][slotClass] + count - 1];
+        return fallback ? findFirstStandard(z) : -1;
+    }
+
+    // A zone with a usable slot always yields one from findInZone
+    bool hasUsable(int z, SlotClass slotClass, bool fallback) const {
+        return freeCount[z][slotClass] > 0 || (fallback && freeCount[z][SLOT_STANDARD] > 0);
+    }
+
+    int indexOf(int requestId) const {
+        if (requestId < 1 || requestId > requestCount || requestId <= requestCount - REQUEST_CAPACITY) {
+            return -1;
+        }
+        return (requestId - 1) % REQUEST_CAPACITY;
+    }
+
+public:
+    FixedParkingSystem()
+        : requestCount(0), rollbackTop(0), rollbackDepth(0), currentTime(0) {
+        for (int w = 0; w < Layout::WORDS; w++) {
+            freeBits[w] = 0;
+        }
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            available[z] = 0;
+            for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+                freeCount[z][c] = 0;
+            }
+        }
+        for (int a = 0; a < AREA_COUNT; a++) {
+            areaAvailable[a] = 0;
+        }
+        for (int s = 0; s < SLOT_COUNT; s++) {
+            addFree(s);
+        }
+    }
+
+    // nullptr only when the record to reuse still holds a slot
+    FixedRequest* createRequest(const char* vehicleId, int requestedZone,
+                                SlotClass slotClass = SLOT_STANDARD, bool fallback = false) {
+        FixedRequest* request = &requests[requestCount % REQUEST_CAPACITY];
+        if (requestCount >= REQUEST_CAPACITY) {
+            RequestState state = request->getState();
+            if (state == ALLOCATED || state == OCCUPIED) return nullptr;
+        }
+        long long reqTime = getCurrentTime();
+        requestCount++;
+        request->reset(requestCount, vehicleId, requestedZone, reqTime, slotClass, fallback);
+
+        int requested = positionOf(requestedZone);
+        int found = -1;
+        int slot = -1;
+        if (requested >= 0) {
+            slot = findInZone(requested, slotClass, fallback);
+            found = slot >= 0 ? requested : -1;
+        }
+        bool crossZone = false;
+        double distance = 0;
+        int candidates = requested >= 0 ? ZONE_COUNT - 1 : ZONE_COUNT;
+        for (int i = 0; slot < 0 && i < candidates; i++) {
+            int z = requested >= 0 ? layout.order[requested][i] : i;
+            if (!hasUsable(z, slotClass, fallback)) continue;
+            slot = findInZone(z, slotClass, fallback);
+            found = z;
+            crossZone = true;
+            if (layout.located && requested >= 0) {
+                distance = std::sqrt(layout.distanceSquared[requested][z]);
+            }
+        }
+        if (slot >= 0) {
+            removeFree(slot);
+            request->allocate(Topology::zones[found].zoneId, Topology::slots[slot].slotId, slot, reqTime,
+                              crossZone, distance);
+            rollback[rollbackTop] = {requestCount, slot};
+            rollbackTop = (rollbackTop + 1) % ROLLBACK_CAPACITY;
+            if (rollbackDepth < ROLLBACK_CAPACITY) rollbackDepth++;
+            request->occupy(reqTime);
+        }
+        return request;
+    }
+
+    bool cancelRequest(int requestId) {
+        FixedRequest* request = findRequest(requestId);
+        if (request == nullptr) return false;
+        RequestState state = request->getState();
+        if (state == RELEASED || state == CANCELLED) return false;
+        if (request->getSlotIndex() >= 0) {
+            addFree(request->getSlotIndex());
+        }
+        request->cancel();
+        return true;
+    }
+
+    bool releaseParking(int requestId) {
+        FixedRequest* request = findRequest(requestId);
+        if (request == nullptr || request->getState() != OCCUPIED) return false;
+        if (request->getSlotIndex() >= 0) {
+            addFree(request->getSlotIndex());
+        }
+        request->release(getCurrentTime());
+        return true;
+    }
+
+    // Allocations whose request has since left (or whose record was reused)
+    // are skipped, as in RollbackManager
+    bool rollbackAllocations(int k) {
+        if (k <= 0 || k > rollbackDepth) return false;
+        for (int i = 0; i < k; i++) {
+            rollbackTop = (rollbackTop + ROLLBACK_CAPACITY - 1) % ROLLBACK_CAPACITY;
+            rollbackDepth--;
+            const RollbackEntry& entry = rollback[rollbackTop];
+            FixedRequest* request = findRequest(entry.requestId);
+            if (request == nullptr) continue;
+            RequestState state = request->getState();
+            if (state != ALLOCATED && state != OCCUPIED) continue;
+            addFree(entry.slot);
+            request->cancel();
+        }
+        return true;
+    }
+
+    // nullptr for unknown IDs and for records already reused
+    FixedRequest* findRequest(int requestId) {
+        int index = indexOf(requestId);
+        return index >= 0 ? &requests[index] : nullptr;
+    }
+
+    const FixedRequest* findRequest(int requestId) const {
+        int index = indexOf(requestId);
+        return index >= 0 ? &requests[index] : nullptr;
+    }
+
+    int getZoneCount() const {
+        return ZONE_COUNT;
+    }
+
+    int getZoneId(int position) const {
+        return Topology::zones[position].zoneId;
+    }
+
+    int getAvailableSlots(int zoneId) const {
+        int z = positionOf(zoneId);
+        return z >= 0 ? available[z] : 0;
+    }
+
+    int getTotalSlots(int zoneId) const {
+        int z = positionOf(zoneId);
+        return z >= 0 ? layout.firstSlot[z + 1] - layout.firstSlot[z] : 0;
+    }
+
+    int getAreaAvailableSlots(int areaIndex) const {
+        return areaIndex >= 0 && areaIndex < AREA_COUNT ? areaAvailable[areaIndex] : 0;
+    }
+
+    int countAvailableSlots(int firstZoneId, int lastZoneId) const {
+        int count = 0;
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            int zoneId = Topology::zones[z].zoneId;
+            if (zoneId >= firstZoneId && zoneId <= lastZoneId) count += available[z];
+        }
+        return count;
+    }
+
+    int getRequestCount() const {
+        return requestCount;
+    }
+
+    int getRollbackDepth() const {
+        return rollbackDepth;
+    }
+
+    void displayZoneStatus() const {
+        std::cout << "\n=== Zone Status ===\n";
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            int total = layout.firstSlot[z + 1] - layout.firstSlot[z];
+            std::cout << "Zone " << Topology::zones[z].zoneId << ": " << available[z] << "/" << total
+                      << " available";
+            if (available[z] == 0) {
+                std::cout << " [FULL]";
+            }
+            std::cout << "\n";
+        }
+    }
+
+    // The requests still kept
+    void displayRequestHistory() const {
+        std::cout << "\n=== Request History ===\n";
+        int first = requestCount > REQUEST_CAPACITY ? requestCount - REQUEST_CAPACITY + 1 : 1;
+        for (int id = first; id <= requestCount; id++) {
+            const FixedRequest* req = findRequest(id);
+            std::cout << "Request #" << req->getRequestId()
+                      << " | Vehicle: " << req->getVehicleId()
+                      << " | Requested Zone: " << req->getRequestedZone()
+                      << " | State: " << requestStateName(req->getState());
+            if (req->getAllocatedSlotId() != -1) {
+                std::cout << " | Slot: " << req->getAllocatedSlotId()
+                          << " in Zone " << req->getAllocatedZone();
+                if (req->hasCrossZonePenalty()) {
+                    std::cout << " [CROSS-ZONE PENALTY, " << req->getCrossZoneDistance() << " km]";
+                }
+            }
+            std::cout << "\n";
+        }
+    }
+
+    void displayAnalytics() const {
+        std::cout << "\n=== Analytics ===\n";
+        int totalRequests = 0;
+        int completedRequests = 0;
+        int cancelledRequests = 0;
+        long long totalDuration = 0;
+        int zoneUsage[ZONE_COUNT] = {};
+
+        int first = requestCount > REQUEST_CAPACITY ? requestCount - REQUEST_CAPACITY + 1 : 1;
+        for (int id = first; id <= requestCount; id++) {
+            const FixedRequest* req = findRequest(id);
+            totalRequests++;
+            if (req->getState() == RELEASED) {
+                completedRequests++;
+                totalDuration += req->getParkingDuration();
+            } else if (req->getState() == CANCELLED) {
+                cancelledRequests++;
+            }
+            if (req->getSlotIndex() >= 0) {
+                zoneUsage[layout.slotZone[req->getSlotIndex()]]++;
+            }
+        }
+
+        std::cout << "Total Requests: " << totalRequests << "\n";
+        std::cout << "Completed: " << completedRequests << "\n";
+        std::cout << "Cancelled: " << cancelledRequests << "\n";
+        if (completedRequests > 0) {
+            std::cout << "Average Parking Duration: "
+                      << (totalDuration / completedRequests) << " time units\n";
+        }
+
+        int peakZone = -1;
+        int maxUsage = 0;
+        for (int z = 0; z < ZONE_COUNT; z++) {
+            int total = layout.firstSlot[z + 1] - layout.firstSlot[z];
+            if (zoneUsage[z] > maxUsage) {
+                maxUsage = zoneUsage[z];
+                peakZone = Topology::zones[z].zoneId;
+            }
+            if (total > 0) {
+                double utilization = (double)(total - available[z]) / total * 100.0;
+                std::cout << "Zone " << Topology::zones[z].zoneId << " Utilization: " << utilization << "%\n";
+            }
+        }
+        if (peakZone != -1) {
+            std::cout << "Peak Usage Zone: Zone " << peakZone << " (" << maxUsage << " allocations)\n";
+        }
+    }
+};
+
+// The lot initializeSystem builds: three zones 1 km apart along one street
+struct DefaultLotTopology {
+    static constexpr FixedZoneSpec zones[] = {
+        {1, 2, 0, 0, true},
+        {2, 1, 1, 0, true},
+        {3, 1, 2, 0, true}
+    };
+    static constexpr FixedAreaSpec areas[] = {
+        {1, 2}, {2, 1},
+        {3, 2},
+        {4, 2}
+    };
+    static constexpr FixedSlotSpec slots[] = {
+        {101, SLOT_STANDARD}, {102, SLOT_STANDARD}, {103, SLOT_STANDARD},
+        {201, SLOT_STANDARD}, {202, SLOT_STANDARD},
+        {301, SLOT_STANDARD}, {302, SLOT_STANDARD}
+    };
+    static constexpr int requestCapacity = 256;
+    static constexpr int rollbackCapacity = 64;
+};
+
+#endif
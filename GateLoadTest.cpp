@@ -0,0 +1,270 @@
+#include "GateLoadTest.h"
+#include "GateProtocol.h"
+#include "ByteBuffer.h"
+#include "EngineStats.h"
+#include "NetUtil.h"
+#include "ParkingSystem.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int GATE_LOAD_PLATES = 1000;
+static const int GATE_LOAD_LEASES = 8;
+
+struct GateLoadConnection {
+    int fd;
+    ByteBuffer in;
+    ByteBuffer out;
+    unsigned nextSequence;
+    unsigned expectedSequence;
+    long long* sentAt;          // by sequence % depth, batches answer in order
+    int* releasable;            // ring of request IDs creates were given
+    int releasableHead;
+    int releasableCount;
+    int releasableCapacity;
+    int serial;
+    int leaseTokens[GATE_LOAD_LEASES];  // ring of leases held, oldest first
+    int leaseLeft[GATE_LOAD_LEASES];    // slots not yet parked in by a frame sent
+    int leaseHead;
+    int leaseCount;
+    int leasesPending;
+    int leaseSpare;             // sum of leaseLeft
+    int leaseTarget;            // spare slots kept, enough for a pipeline of creates
+
+    GateLoadConnection()
+        : fd(-1), in(65536), out(65536), nextSequence(0), expectedSequence(0), sentAt(nullptr),
+          releasable(nullptr), releasableHead(0), releasableCount(0), releasableCapacity(0), serial(0),
+          leaseHead(0), leaseCount(0), leasesPending(0), leaseSpare(0), leaseTarget(0) {}
+    ~GateLoadConnection() {
+        delete[] sentAt;
+        delete[] releasable;
+    }
+};
+
+// With leases, each connection is a gate serving one zone: creates park
+// from the oldest lease it holds, and another is asked for while the slots
+// held or asked for would not cover a pipeline of creates
+static void fillFrame(GateLoadConnection& conn, int index, int leaseSize, GateRequest& frame) {
+    memset(&frame, 0, sizeof(frame));
+    int serial = conn.serial++;
+    frame.tag = (unsigned)serial;
+    int plate = (serial / 4) % GATE_LOAD_PLATES;
+    switch (serial % 4) {
+        case 0:
+            if (leaseSize > 0 && conn.leaseSpare + conn.leasesPending * leaseSize < conn.leaseTarget &&
+                conn.leaseCount + conn.leasesPending < GATE_LOAD_LEASES) {
+                frame.op = GATE_LEASE;
+                frame.arg = 1 + index % 3;
+                frame.count = (unsigned char)leaseSize;
+                conn.leasesPending++;
+                return;
+            }
+            if (conn.leaseCount > 0) {
+                frame.op = GATE_PARK_LEASED;
+                frame.arg = conn.leaseTokens[conn.leaseHead];
+                snprintf(frame.plate, sizeof(frame.plate), "G%d-%d", index, plate);
+                conn.leaseSpare--;
+                if (--conn.leaseLeft[conn.leaseHead] == 0) {
+                    conn.leaseHead = (conn.leaseHead + 1) % GATE_LOAD_LEASES;
+                    conn.leaseCount--;
+                }
+                return;
+            }
+            frame.op = GATE_CREATE;
+            frame.arg = 1 + (index + serial / 4) % 3;
+            snprintf(frame.plate, sizeof(frame.plate), "G%d-%d", index, plate);
+            return;
+        case 1:
+            if (conn.releasableCount > 0) {
+                frame.op = GATE_RELEASE;
+                frame.arg = conn.releasable[conn.releasableHead];
+                conn.releasableHead = (conn.releasableHead + 1) % conn.releasableCapacity;
+                conn.releasableCount--;
+                return;
+            }
+            break;
+        case 2:
+            frame.op = GATE_QUERY_PLATE;
+            snprintf(frame.plate, sizeof(frame.plate), "G%d-%d", index, plate);
+            return;
+    }
+    frame.op = GATE_QUERY_ZONE;
+    frame.arg = 1 + serial % 3;
+}
+
+static void sendBatch(GateLoadConnection& conn, int index, int batchSize, int depth, int leaseSize) {
+    int bytes = (int)sizeof(GateBatchHeader) + batchSize * (int)sizeof(GateRequest);
+    char* dst = conn.out.writePointer(bytes);
+    GateBatchHeader header = {GATE_MAGIC, (unsigned short)batchSize, conn.nextSequence};
+    memcpy(dst, &header, sizeof(header));
+    for (int i = 0; i < batchSize; i++) {
+        GateRequest frame;
+        fillFrame(conn, index, leaseSize, frame);
+        memcpy(dst + sizeof(header) + i * sizeof(GateRequest), &frame, sizeof(frame));
+    }
+    conn.out.commitWrite(bytes);
+    conn.sentAt[conn.nextSequence % depth] = EngineStats::now();
+    conn.nextSequence++;
+}
+
+GateLoadTest::GateLoadTest(const char* target, int connections, int batch, int inFlight, int lease)
+    : address(target), connectionCount(connections), batchSize(batch), depth(inFlight), leaseSize(lease) {
+    if (batchSize < 1) batchSize = 1;
+    if (batchSize > GATE_MAX_BATCH) batchSize = GATE_MAX_BATCH;
+    if (depth < 1) depth = 1;
+    if (leaseSize < 0) leaseSize = 0;
+    if (leaseSize > LEASE_MAX_SLOTS) leaseSize = LEASE_MAX_SLOTS;
+}
+
+bool GateLoadTest::run(double seconds, GateLoadReport& report) {
+    report = GateLoadReport();
+    GateLoadConnection* conns = new GateLoadConnection[connectionCount];
+    int epollFd = epoll_create1(0);
+    int responseBytes = (int)sizeof(GateBatchHeader) + batchSize * (int)sizeof(GateResponse);
+
+    for (int i = 0; i < connectionCount; i++) {
+        conns[i].fd = connectAddress(address);
+        if (conns[i].fd < 0) {
+            for (int j = 0; j < i; j++) close(conns[j].fd);
+            delete[] conns;
+            close(epollFd);
+            return false;
+        }
+        conns[i].sentAt = new long long[depth];
+        conns[i].releasableCapacity = batchSize * depth + 1;
+        conns[i].releasable = new int[conns[i].releasableCapacity];
+        conns[i].leaseTarget = batchSize * depth / 4 + leaseSize;
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = (unsigned int)i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, conns[i].fd, &ev);
+    }
+
+    int sampleCapacity = 1 << 16;
+    long long* samples = new long long[sampleCapacity];
+    long long start = EngineStats::now();
+    long long deadline = start + (long long)(seconds * 1e9);
+
+    bool failed = false;
+    for (int i = 0; i < connectionCount && !failed; i++) {
+        for (int d = 0; d < depth; d++) {
+            sendBatch(conns[i], i, batchSize, depth, leaseSize);
+        }
+        failed = !writeFully(conns[i].fd, conns[i].out.readPointer(), conns[i].out.readable());
+        conns[i].out.clear();
+    }
+
+    epoll_event events[256];
+    while (!failed && EngineStats::now() < deadline) {
+        int n = epoll_wait(epollFd, events, 256, 100);
+        for (int e = 0; e < n && !failed; e++) {
+            int index = (int)events[e].data.u32;
+            GateLoadConnection& conn = conns[index];
+            char* dst = conn.in.writePointer(65536);
+            ssize_t got = recv(conn.fd, dst, 65536, 0);
+            if (got <= 0) {
+                if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+                failed = true;
+                break;
+            }
+            conn.in.commitWrite((int)got);
+
+            while (conn.in.readable() >= responseBytes) {
+                const char* data = conn.in.readPointer();
+                GateBatchHeader header;
+                memcpy(&header, data, sizeof(header));
+                if (header.magic != GATE_MAGIC || header.count != batchSize) {
+                    failed = true;
+                    break;
+                }
+                if (header.sequence != conn.expectedSequence) {
+                    report.errors++;
+                }
+                for (int i = 0; i < batchSize; i++) {
+                    GateResponse response;
+                    memcpy(&response, data + sizeof(header) + i * sizeof(GateResponse), sizeof(response));
+                    if (response.status == GATE_BAD_FRAME) {
+                        report.errors++;
+                        continue;
+                    }
+                    if (response.op == GATE_LEASE) {
+                        conn.leasesPending--;
+                        if (response.status == GATE_OK) {
+                            int tail = (conn.leaseHead + conn.leaseCount++) % GATE_LOAD_LEASES;
+                            conn.leaseTokens[tail] = response.requestId;
+                            conn.leaseLeft[tail] = response.available;
+                            conn.leaseSpare += response.available;
+                        }
+                        continue;
+                    }
+                    bool parked = response.status == GATE_OK &&
+                                  (response.op == GATE_CREATE || response.op == GATE_PARK_LEASED);
+                    if (response.op == GATE_PARK_LEASED && parked) {
+                        report.leaseParks++;
+                    }
+                    if (response.op == GATE_CREATE && response.status == GATE_FULL) {
+                        report.full++;
+                    } else if (parked && conn.releasableCount < conn.releasableCapacity) {
+                        int tail = (conn.releasableHead + conn.releasableCount++) % conn.releasableCapacity;
+                        conn.releasable[tail] = response.requestId;
+                    }
+                }
+
+                long long latency = EngineStats::now() - conn.sentAt[header.sequence % depth];
+                if (report.batches == sampleCapacity) {
+                    long long* grown = new long long[sampleCapacity * 2];
+                    memcpy(grown, samples, sizeof(long long) * sampleCapacity);
+                    delete[] samples;
+                    samples = grown;
+                    sampleCapacity *= 2;
+                }
+                samples[report.batches++] = latency;
+                report.frames += batchSize;
+                conn.expectedSequence = header.sequence + 1;
+                conn.in.consume(responseBytes);
+                sendBatch(conn, index, batchSize, depth, leaseSize);
+            }
+            if (conn.out.readable() > 0) {
+                failed = !writeFully(conn.fd, conn.out.readPointer(), conn.out.readable());
+                conn.out.clear();
+            }
+        }
+    }
+
+    long long elapsed = EngineStats::now() - start;
+    report.seconds = elapsed / 1e9;
+    report.framesPerSecond = report.seconds > 0 ? report.frames / report.seconds : 0.0;
+    report.framesPerConnection = connectionCount > 0 ? report.framesPerSecond / connectionCount : 0.0;
+    if (report.batches > 0) {
+        std::sort(samples, samples + report.batches);
+        report.p50Ns = samples[(report.batches - 1) * 50 / 100];
+        report.p99Ns = samples[(report.batches - 1) * 99 / 100];
+        report.maxNs = samples[report.batches - 1];
+    }
+
+    for (int i = 0; i < connectionCount; i++) {
+        close(conns[i].fd);
+    }
+    delete[] samples;
+    delete[] conns;
+    close(epollFd);
+    return !failed;
+}
+
+void GateLoadTest::printReport(const GateLoadReport& report, std::ostream& out) {
+    out << "Frames       : " << report.frames << " in " << report.batches << " batches\n";
+    out << "Full         : " << report.full << "\n";
+    out << "Lease parks  : " << report.leaseParks << "\n";
+    out << "Errors       : " << report.errors << "\n";
+    out << "Elapsed      : " << report.seconds << " s\n";
+    out << "Throughput   : " << (long long)report.framesPerSecond << " frames/s, "
+        << (long long)report.framesPerConnection << " per connection\n";
+    out << "Batch p50    : " << report.p50Ns / 1000 << " us\n";
+    out << "Batch p99    : " << report.p99Ns / 1000 << " us\n";
+    out << "Batch max    : " << report.maxNs / 1000 << " us\n";
+}
@@ -0,0 +1,41 @@
+#ifndef GATELOADTEST_H
+#define GATELOADTEST_H
+
+#include <iosfwd>
+
+struct GateLoadReport {
+    long long frames;
+    long long batches;
+    long long full;             // creates answered GATE_FULL
+    long long leaseParks;       // vehicles parked from a lease
+    long long errors;           // GATE_BAD_FRAME or a reply out of sequence
+    double seconds;
+    double framesPerSecond;
+    double framesPerConnection; // per second
+    long long p50Ns;            // batch round trip
+    long long p99Ns;
+    long long maxNs;
+};
+
+// Gate controller traffic against a running --gate server. Each connection
+// keeps depth batches of batchSize frames in flight, sending a new batch as
+// each reply arrives. Frames cycle through create, release of a request an
+// earlier reply created, plate query and zone query, so occupancy stays
+// level however long the test runs. With lease > 0 each connection parks
+// its creates from leases of that many slots in one zone instead.
+class GateLoadTest {
+private:
+    const char* address;
+    int connectionCount;
+    int batchSize;
+    int depth;
+    int leaseSize;
+
+public:
+    GateLoadTest(const char* target, int connections, int batch, int inFlight, int lease = 0);
+
+    bool run(double seconds, GateLoadReport& report);
+    static void printReport(const GateLoadReport& report, std::ostream& out);
+};
+
+#endif
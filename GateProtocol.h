@@ -0,0 +1,80 @@
+#ifndef GATEPROTOCOL_H
+#define GATEPROTOCOL_H
+
+// Gate controller protocol: fixed-layout little-endian frames over a Unix
+// domain socket or loopback TCP.
+//   client : GateBatchHeader, then count GateRequest frames
+//   server : GateBatchHeader with the same sequence and count, then one
+//            GateResponse per request, in request order
+// Clients may send any number of batches before reading the replies;
+// batches are answered in the order they were sent. Every frame is 32
+// bytes and the header 8, so frames stay 8-byte aligned in a buffer that
+// holds whole batches.
+// A busy gate can take a lease on a block of free slots in its zone and
+// park from it with GATE_PARK_LEASED, which skips the allocator. The lease
+// ends with its last slot; unused slots go back on GATE_UNLEASE or after
+// GATE_LEASE_TTL_MS.
+
+const unsigned short GATE_MAGIC = 0x4750;      // "PG"
+const int GATE_PLATE_BYTES = 16;
+const int GATE_MAX_BATCH = 1024;
+const int GATE_LEASE_TTL_MS = 30000;           // unused leased slots go back after this
+
+enum GateOp {
+    GATE_CREATE = 1,        // plate, zone in arg, class byte, priority
+    GATE_RELEASE,           // request ID in arg
+    GATE_CANCEL,            // request ID in arg
+    GATE_QUERY_PLATE,       // the plate's latest request
+    GATE_QUERY_ZONE,        // zone ID in arg
+    GATE_LEASE,             // zone in arg, class byte, slots asked for in count
+    GATE_PARK_LEASED,       // plate, lease token in arg
+    GATE_UNLEASE            // lease token in arg
+};
+
+enum GateStatus {
+    GATE_OK,
+    GATE_FULL,              // created, but no slot was given (waiting or cancelled);
+                            // lease: no slot to spare
+    GATE_NOT_FOUND,         // no such request, plate or zone
+    GATE_REJECTED,          // the request is not in a state that allows it; park
+                            // leased: the zone is closed
+    GATE_BAD_FRAME          // unknown op, class or priority, or an empty plate
+};
+
+struct GateBatchHeader {
+    unsigned short magic;
+    unsigned short count;   // 1..GATE_MAX_BATCH
+    unsigned sequence;      // echoed in the reply
+};
+
+struct GateRequest {
+    unsigned char op;
+    unsigned char slotClass;    // create: SlotClass, bit 7 = fallback allowed
+    unsigned char priority;     // create: waitlist priority
+    unsigned char count;        // lease: slots asked for, 1..LEASE_MAX_SLOTS
+    unsigned tag;               // echoed in the response
+    int arg;
+    int reserved2;
+    char plate[GATE_PLATE_BYTES];   // NUL-padded; all 16 bytes may be used
+};
+
+struct GateResponse {
+    unsigned char op;
+    unsigned char status;       // GateStatus
+    unsigned char state;        // RequestState; 0 for zone queries
+    unsigned char flags;        // 1 = cross-zone
+    unsigned tag;
+    int requestId;              // 0 for zone queries; lease: the token
+    int zoneId;                 // allocated zone, or the zone queried; -1 if none
+    int slotId;                 // allocated slot, -1 if none; zone query: total slots
+    int available;              // zone query: free slots; lease and park leased:
+                                // slots left in the lease, 0 once it has ended
+    long long time;             // create: allocation time, release: release time,
+                                // cancel and plate query: request time
+};
+
+static_assert(sizeof(GateBatchHeader) == 8, "gate batch header layout");
+static_assert(sizeof(GateRequest) == 32, "gate request layout");
+static_assert(sizeof(GateResponse) == 32, "gate response layout");
+
+#endif
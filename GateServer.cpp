@@ -0,0 +1,347 @@
+#include "GateServer.h"
+#include "ParkingSystem.h"
+#include "ParkingRequest.h"
+#include "ParkingSlot.h"
+#include "Zone.h"
+#include "NetUtil.h"
+#include "EngineStats.h"
+#include <cerrno>
+#include <cstring>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int MAX_EVENTS = 256;
+
+GateServer::GateServer(ParkingSystem& sys)
+    : system(sys), listenFd(-1), epollFd(-1), running(0), connectionCapacity(1024),
+      connectionCount(0), framesServed(0), batchesServed(0) {
+    unixPath[0] = '\0';
+    connections = new GateConnection*[connectionCapacity];
+    for (int i = 0; i < connectionCapacity; i++) {
+        connections[i] = nullptr;
+    }
+}
+
+GateServer::~GateServer() {
+    for (int i = 0; i < connectionCapacity; i++) {
+        if (connections[i] != nullptr) {
+            close(connections[i]->fd);
+            delete connections[i];
+        }
+    }
+    delete[] connections;
+    if (listenFd >= 0) close(listenFd);
+    if (epollFd >= 0) close(epollFd);
+    if (unixPath[0] != '\0') unlink(unixPath);
+}
+
+bool GateServer::start(const char* address) {
+    listenFd = listenAddress(address);
+    if (listenFd < 0 || !setNonBlocking(listenFd)) return false;
+    if (!isPortNumber(address)) {
+        strncpy(unixPath, address, sizeof(unixPath) - 1);
+        unixPath[sizeof(unixPath) - 1] = '\0';
+    }
+
+    epollFd = epoll_create1(0);
+    if (epollFd < 0) return false;
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    running = 1;
+    return true;
+}
+
+void GateServer::run() {
+    epoll_event events[MAX_EVENTS];
+    while (running) {
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, 500);
+        if (n < 0 && errno != EINTR) break;
+        system.expireLeases(EngineStats::now() / 1000000);
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            GateConnection* conn = fd < connectionCapacity ? connections[fd] : nullptr;
+            if (conn == nullptr) continue;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                handleReadable(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (!flushOutput(conn)) {
+                    closeConnection(conn);
+                } else {
+                    updateInterest(conn);
+                }
+            }
+        }
+    }
+}
+
+void GateServer::stop() {
+    running = 0;
+}
+
+int GateServer::getConnectionCount() const {
+    return connectionCount;
+}
+
+long long GateServer::getFramesServed() const {
+    return framesServed;
+}
+
+long long GateServer::getBatchesServed() const {
+    return batchesServed;
+}
+
+void GateServer::acceptConnections() {
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) return;
+        setNonBlocking(fd);
+        if (unixPath[0] == '\0') {
+            setNoDelay(fd);
+        }
+
+        if (fd >= connectionCapacity) {
+            int newCapacity = connectionCapacity * 2;
+            while (newCapacity <= fd) newCapacity *= 2;
+            GateConnection** grown = new GateConnection*[newCapacity];
+            for (int i = 0; i < newCapacity; i++) {
+                grown[i] = i < connectionCapacity ? connections[i] : nullptr;
+            }
+            delete[] connections;
+            connections = grown;
+            connectionCapacity = newCapacity;
+        }
+
+        connections[fd] = new GateConnection(fd);
+        connectionCount++;
+
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void GateServer::handleReadable(GateConnection* conn) {
+    while (true) {
+        char* dst = conn->in.writePointer(65536);
+        ssize_t got = recv(conn->fd, dst, 65536, 0);
+        if (got > 0) {
+            conn->in.commitWrite((int)got);
+            if (got < 65536) break;
+            continue;
+        }
+        if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            closeConnection(conn);
+            return;
+        }
+        break;
+    }
+    if (!processInput(conn) || !flushOutput(conn)) {
+        closeConnection(conn);
+        return;
+    }
+    updateInterest(conn);
+}
+
+// Answers every complete batch in the buffer. The buffer only ever gives up
+// whole batches, which are multiples of 8 bytes, so frames stay aligned and
+// are read where they lie; the send buffer may have been partly sent, so
+// replies are copied in. False on a header that cannot be resynchronised
+// from.
+bool GateServer::processInput(GateConnection* conn) {
+    while (conn->in.readable() >= (int)sizeof(GateBatchHeader)) {
+        const GateBatchHeader* header = (const GateBatchHeader*)conn->in.readPointer();
+        if (header->magic != GATE_MAGIC || header->count == 0 || header->count > GATE_MAX_BATCH) {
+            return false;
+        }
+        int count = header->count;
+        int batchBytes = (int)sizeof(GateBatchHeader) + count * (int)sizeof(GateRequest);
+        if (conn->in.readable() < batchBytes) break;
+
+        const GateRequest* requests = (const GateRequest*)(header + 1);
+        char* reply = conn->out.writePointer(batchBytes);
+        GateBatchHeader replyHeader = {GATE_MAGIC, (unsigned short)count, header->sequence};
+        memcpy(reply, &replyHeader, sizeof(replyHeader));
+        reply += sizeof(replyHeader);
+        for (int i = 0; i < count; i++) {
+            GateResponse response;
+            execute(requests[i], response);
+            memcpy(reply + i * sizeof(GateResponse), &response, sizeof(response));
+        }
+        conn->out.commitWrite(batchBytes);
+        conn->in.consume(batchBytes);
+        framesServed += count;
+        batchesServed++;
+    }
+    return true;
+}
+
+void GateServer::describe(const ParkingRequest* request, GateResponse& response) {
+    response.state = (unsigned char)request->getState();
+    response.flags = request->hasCrossZonePenalty() ? 1 : 0;
+    response.requestId = request->getRequestId();
+    response.zoneId = request->getAllocatedZone();
+    response.slotId = request->getAllocatedSlotId();
+}
+
+void GateServer::execute(const GateRequest& request, GateResponse& response) {
+    memset(&response, 0, sizeof(response));
+    response.op = request.op;
+    response.tag = request.tag;
+    response.zoneId = -1;
+    response.slotId = -1;
+
+    char plate[GATE_PLATE_BYTES + 1];
+    memcpy(plate, request.plate, GATE_PLATE_BYTES);
+    plate[GATE_PLATE_BYTES] = '\0';
+    bool needsPlate = request.op == GATE_CREATE || request.op == GATE_QUERY_PLATE ||
+                      request.op == GATE_PARK_LEASED;
+    if (needsPlate && plate[0] == '\0') {
+        response.status = GATE_BAD_FRAME;
+        return;
+    }
+
+    switch (request.op) {
+        case GATE_CREATE: {
+            int slotClass = request.slotClass & 0x7f;
+            if (slotClass >= SLOT_CLASS_COUNT || request.priority > WAITLIST_MAX_PRIORITY) {
+                response.status = GATE_BAD_FRAME;
+                return;
+            }
+            ParkingRequest* created = system.createRequest(plate, request.arg, (SlotClass)slotClass,
+                                                           (request.slotClass & 0x80) != 0,
+                                                           request.priority);
+            describe(created, response);
+            response.status = created->getState() == OCCUPIED ? GATE_OK : GATE_FULL;
+            response.time = created->getAllocationTime();
+            return;
+        }
+        case GATE_RELEASE:
+        case GATE_CANCEL: {
+            ParkingRequest* found = system.findRequest(request.arg);
+            if (found == nullptr) {
+                response.status = GATE_NOT_FOUND;
+                return;
+            }
+            bool done = request.op == GATE_RELEASE ? system.releaseParking(request.arg)
+                                                   : system.cancelRequest(request.arg);
+            describe(found, response);
+            response.status = done ? GATE_OK : GATE_REJECTED;
+            response.time = request.op == GATE_RELEASE ? found->getReleaseTime() : found->getRequestTime();
+            return;
+        }
+        case GATE_QUERY_PLATE: {
+            ParkingRequest* latest = system.findLatestRequest(plate);
+            if (latest == nullptr) {
+                response.status = GATE_NOT_FOUND;
+                return;
+            }
+            describe(latest, response);
+            response.status = GATE_OK;
+            response.time = latest->getRequestTime();
+            return;
+        }
+        case GATE_QUERY_ZONE: {
+            Zone* zone = system.getZone(request.arg);
+            if (zone == nullptr) {
+                response.status = GATE_NOT_FOUND;
+                return;
+            }
+            response.status = GATE_OK;
+            response.zoneId = zone->getZoneId();
+            response.slotId = zone->getTotalSlots();
+            response.available = zone->getAvailableSlots();
+            return;
+        }
+        case GATE_LEASE: {
+            if (request.slotClass >= SLOT_CLASS_COUNT || request.count == 0 ||
+                request.count > LEASE_MAX_SLOTS) {
+                response.status = GATE_BAD_FRAME;
+                return;
+            }
+            if (system.getZone(request.arg) == nullptr) {
+                response.status = GATE_NOT_FOUND;
+                return;
+            }
+            long long now = EngineStats::now() / 1000000;
+            int token = system.leaseSlots(request.arg, (SlotClass)request.slotClass, request.count,
+                                          now + GATE_LEASE_TTL_MS);
+            response.status = token != 0 ? GATE_OK : GATE_FULL;
+            response.requestId = token;
+            response.zoneId = request.arg;
+            response.available = token != 0 ? system.getLeaseRemaining(token) : 0;
+            return;
+        }
+        case GATE_PARK_LEASED: {
+            if (system.getLeaseRemaining(request.arg) < 0) {
+                response.status = GATE_NOT_FOUND;
+                return;
+            }
+            ParkingRequest* parked = system.parkLeased(request.arg, plate);
+            int remaining = system.getLeaseRemaining(request.arg);
+            response.available = remaining > 0 ? remaining : 0;
+            if (parked == nullptr) {
+                response.status = GATE_REJECTED;
+                return;
+            }
+            describe(parked, response);
+            response.status = GATE_OK;
+            response.time = parked->getAllocationTime();
+            return;
+        }
+        case GATE_UNLEASE:
+            response.status = system.returnLease(request.arg) ? GATE_OK : GATE_NOT_FOUND;
+            return;
+        default:
+            response.status = GATE_BAD_FRAME;
+            return;
+    }
+}
+
+bool GateServer::flushOutput(GateConnection* conn) {
+    while (conn->out.readable() > 0) {
+        ssize_t sent = send(conn->fd, conn->out.readPointer(), conn->out.readable(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        conn->out.consume((int)sent);
+    }
+    return true;
+}
+
+void GateServer::updateInterest(GateConnection* conn) {
+    bool pending = conn->out.readable() > 0;
+    if (pending == conn->wantsWrite) return;
+
+    conn->wantsWrite = pending;
+    epoll_event ev;
+    ev.events = pending ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.fd = conn->fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+void GateServer::closeConnection(GateConnection* conn) {
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    connections[conn->fd] = nullptr;
+    connectionCount--;
+    delete conn;
+}
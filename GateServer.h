@@ -0,0 +1,62 @@
+#ifndef GATESERVER_H
+#define GATESERVER_H
+
+#include <csignal>
+#include "ByteBuffer.h"
+#include "GateProtocol.h"
+
+class ParkingSystem;
+class ParkingRequest;
+
+struct GateConnection {
+    int fd;
+    ByteBuffer in;
+    ByteBuffer out;
+    bool wantsWrite;
+
+    GateConnection(int f) : fd(f), in(65536), out(65536), wantsWrite(false) {}
+};
+
+// Gate protocol server on a non-blocking epoll loop, listening on a Unix
+// socket or a loopback TCP port. Every complete batch in a connection's
+// buffer is answered before anything is written, so a pipelining client
+// gets its replies in as few sends as it sent batches in. Frames are read
+// in place from the receive buffer and replies written straight into the
+// send buffer; each frame maps onto one ParkingSystem call. Expired leases
+// are returned each time the loop wakes.
+class GateServer {
+private:
+    ParkingSystem& system;
+    int listenFd;
+    int epollFd;
+    volatile sig_atomic_t running;
+    char unixPath[108];             // removed on shutdown, empty for TCP
+    GateConnection** connections;   // indexed by file descriptor
+    int connectionCapacity;
+    int connectionCount;
+    long long framesServed;
+    long long batchesServed;
+
+    void acceptConnections();
+    void handleReadable(GateConnection* conn);
+    bool processInput(GateConnection* conn);
+    bool flushOutput(GateConnection* conn);
+    void updateInterest(GateConnection* conn);
+    void closeConnection(GateConnection* conn);
+    void execute(const GateRequest& request, GateResponse& response);
+    static void describe(const ParkingRequest* request, GateResponse& response);
+
+public:
+    GateServer(ParkingSystem& sys);
+    ~GateServer();
+
+    // A port number listens on 127.0.0.1, anything else is a socket path
+    bool start(const char* address);
+    void run();
+    void stop();
+    int getConnectionCount() const;
+    long long getFramesServed() const;
+    long long getBatchesServed() const;
+};
+
+#endif
@@ -0,0 +1,559 @@
+#include "HistoryQuery.h"
+#include "RequestStore.h"
+#include "ByteBuffer.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+#include <strings.h>
+
+static const int MIN_TABLE_CAPACITY = 64;
+static const long long DEFAULT_BUCKET = 3600;
+
+// Open-addressed groups of one thread for one merge partition; a group with
+// a count of 0 is an empty bucket
+struct HistoryPartial {
+    HistoryGroup* groups;
+    int count;
+    int capacity;
+};
+
+static const char* AGGREGATE_NAMES[] = {"count", "sum", "avg", "min", "max"};
+static const char* MEASURE_NAMES[] = {"", "duration", "wait", "distance", "cross"};
+static const char* ORDER_NAMES[] = {"key", "asc", "desc"};
+static const char* KEY_NAMES[] = {"", "zone", "allocated", "state", "class", "plate", "cross", "time"};
+
+static int findName(const char* const* names, int count, const char* text, int len) {
+    for (int i = 0; i < count; i++) {
+        if ((int)strlen(names[i]) == len && strncasecmp(names[i], text, len) == 0) return i;
+    }
+    return -1;
+}
+
+static bool parseNumber(const char* text, int len, long long& value) {
+    if (len <= 0 || len > 20) return false;
+    char digits[24];
+    memcpy(digits, text, len);
+    digits[len] = '\0';
+    char* end;
+    value = strtoll(digits, &end, 10);
+    return *end == '\0';
+}
+
+// Comma-separated names as a bit mask
+static bool parseMask(const char* text, int len, bool states, unsigned& mask) {
+    mask = 0;
+    int start = 0;
+    for (int i = 0; i <= len; i++) {
+        if (i < len && text[i] != ',') continue;
+        int partLen = i - start;
+        char name[32];
+        if (partLen <= 0 || partLen >= (int)sizeof(name)) return false;
+        memcpy(name, text + start, partLen);
+        name[partLen] = '\0';
+        if (states) {
+            int state = REQUESTED;
+            while (state <= CANCELLED && strcasecmp(name, requestStateName((RequestState)state)) != 0) {
+                state++;
+            }
+            if (state > CANCELLED) return false;
+            mask |= 1u << state;
+        } else {
+            SlotClass slotClass;
+            if (!parseSlotClass(name, slotClass)) return false;
+            mask |= 1u << slotClass;
+        }
+        start = i + 1;
+    }
+    return true;
+}
+
+HistoryQuery::HistoryQuery()
+    : stateMask(~0u), classMask(~0u), requestedZone(HISTORY_ANY_ZONE),
+      allocatedZone(HISTORY_ANY_ZONE), from(0), to(0x7FFFFFFFFFFFFFFFLL), cross(-1),
+      bucket(DEFAULT_BUCKET), aggregate(HISTORY_COUNT), measure(HISTORY_MEASURE_NONE),
+      order(HISTORY_ORDER_KEY), limit(0) {
+    for (int i = 0; i < HISTORY_MAX_KEYS; i++) {
+        keys[i] = HISTORY_KEY_NONE;
+    }
+}
+
+bool HistoryQuery::parse(const char* text, int len, char* error, int errorSize) {
+    int i = 0;
+    while (i < len) {
+        while (i < len && (text[i] == ' ' || text[i] == '\t' || text[i] == '&')) i++;
+        if (i >= len) break;
+        int start = i;
+        while (i < len && text[i] != ' ' && text[i] != '\t' && text[i] != '&') i++;
+        const char* term = text + start;
+        int termLen = i - start;
+
+        const char* equals = (const char*)memchr(term, '=', termLen);
+        bool ok = equals != nullptr;
+        if (ok) {
+            int nameLen = (int)(equals - term);
+            const char* value = equals + 1;
+            int valueLen = termLen - nameLen - 1;
+            long long number = 0;
+#define NAME_IS(literal) (nameLen == (int)sizeof(literal) - 1 && strncmp(term, literal, nameLen) == 0)
+            if (NAME_IS("state")) {
+                ok = parseMask(value, valueLen, true, stateMask);
+            } else if (NAME_IS("class")) {
+                ok = parseMask(value, valueLen, false, classMask);
+            } else if (NAME_IS("zone") || NAME_IS("allocated")) {
+                ok = parseNumber(value, valueLen, number) && number > HISTORY_ANY_ZONE &&
+                     number <= 0x7FFFFFFF;
+                (NAME_IS("zone") ? requestedZone : allocatedZone) = (int)number;
+            } else if (NAME_IS("from")) {
+                ok = parseNumber(value, valueLen, from);
+            } else if (NAME_IS("to")) {
+                ok = parseNumber(value, valueLen, to);
+            } else if (NAME_IS("cross")) {
+                if (valueLen == 3 && strncasecmp(value, "yes", 3) == 0) cross = 1;
+                else if (valueLen == 2 && strncasecmp(value, "no", 2) == 0) cross = 0;
+                else ok = false;
+            } else if (NAME_IS("bucket")) {
+                ok = parseNumber(value, valueLen, bucket) && bucket > 0;
+            } else if (NAME_IS("limit")) {
+                ok = parseNumber(value, valueLen, number) && number >= 0 && number <= 0x7FFFFFFF;
+                limit = (int)number;
+            } else if (NAME_IS("order")) {
+                int found = findName(ORDER_NAMES, 3, value, valueLen);
+                ok = found >= 0;
+                if (ok) order = (HistoryOrder)found;
+            } else if (NAME_IS("group")) {
+                // Up to HISTORY_MAX_KEYS comma-separated keys
+                int keyCount = 0;
+                int partStart = 0;
+                for (int j = 0; ok && j <= valueLen; j++) {
+                    if (j < valueLen && value[j] != ',') continue;
+                    int found = findName(KEY_NAMES + 1, 7, value + partStart, j - partStart);
+                    ok = found >= 0 && keyCount < HISTORY_MAX_KEYS;
+                    if (ok) keys[keyCount++] = (HistoryKey)(found + 1);
+                    partStart = j + 1;
+                }
+            } else if (NAME_IS("agg")) {
+                // <aggregate>[:<measure>]; count alone counts every match
+                const char* colon = (const char*)memchr(value, ':', valueLen);
+                int aggLen = colon != nullptr ? (int)(colon - value) : valueLen;
+                int found = findName(AGGREGATE_NAMES, 5, value, aggLen);
+                int measured = colon != nullptr
+                    ? findName(MEASURE_NAMES + 1, 4, colon + 1, valueLen - aggLen - 1) + 1
+                    : HISTORY_MEASURE_NONE;
+                ok = found >= 0 && (colon == nullptr || measured > 0) &&
+                     (found == HISTORY_COUNT || measured > 0);
+                if (ok) {
+                    aggregate = (HistoryAggregate)found;
+                    measure = (HistoryMeasure)measured;
+                }
+            } else {
+                ok = false;
+            }
+#undef NAME_IS
+        }
+        if (!ok) {
+            snprintf(error, errorSize, "bad term '%.*s'", termLen, term);
+            return false;
+        }
+    }
+    return true;
+}
+
+HistoryResult::HistoryResult()
+    : groups(nullptr), groupCount(0), groupCapacity(0), scanned(0), matched(0), threads(0),
+      millis(0) {}
+
+HistoryResult::~HistoryResult() {
+    delete[] groups;
+}
+
+static unsigned long long hashKeys(const long long* keys) {
+    unsigned long long h = (unsigned long long)keys[0] * 0x9E3779B97F4A7C15ULL;
+    h ^= (unsigned long long)keys[1] + 0x632BE59BD9B4E019ULL + (h << 6) + (h >> 2);
+    h *= 0xBF58476D1CE4E5B9ULL;
+    return h ^ (h >> 31);
+}
+
+static void growPartial(HistoryPartial& table);
+
+// The group for keys, created empty if new
+static HistoryGroup& findGroup(HistoryPartial& table, const long long* keys, unsigned long long hash) {
+    if ((table.count + 1) * 2 > table.capacity) {
+        growPartial(table);
+    }
+    int mask = table.capacity - 1;
+    int i = (int)(hash & mask);
+    while (table.groups[i].count != 0) {
+        if (table.groups[i].keys[0] == keys[0] && table.groups[i].keys[1] == keys[1]) {
+            return table.groups[i];
+        }
+        i = (i + 1) & mask;
+    }
+    HistoryGroup& group = table.groups[i];
+    group.keys[0] = keys[0];
+    group.keys[1] = keys[1];
+    group.sum = 0;
+    group.min = 0;
+    group.max = 0;
+    table.count++;
+    return group;
+}
+
+static void growPartial(HistoryPartial& table) {
+    HistoryGroup* old = table.groups;
+    int oldCapacity = table.capacity;
+    table.capacity = oldCapacity > 0 ? oldCapacity * 2 : MIN_TABLE_CAPACITY;
+    table.groups = new HistoryGroup[table.capacity];
+    for (int i = 0; i < table.capacity; i++) {
+        table.groups[i].count = 0;
+    }
+    int mask = table.capacity - 1;
+    for (int i = 0; i < oldCapacity; i++) {
+        if (old[i].count == 0) continue;
+        int j = (int)(hashKeys(old[i].keys) & mask);
+        while (table.groups[j].count != 0) j = (j + 1) & mask;
+        table.groups[j] = old[i];
+    }
+    delete[] old;
+}
+
+static void addValue(HistoryGroup& group, long long count, double sum, double min, double max) {
+    if (group.count == 0 || min < group.min) group.min = min;
+    if (group.count == 0 || max > group.max) group.max = max;
+    group.count += count;
+    group.sum += sum;
+}
+
+HistoryQueryEngine::HistoryQueryEngine(int threads)
+    : threadCount(threads), generation(0), finished(0), stopping(false), store(nullptr),
+      query(nullptr), partials(nullptr), matchedByThread(nullptr), phase(0), nextChunk(0) {
+    if (threadCount <= 0) {
+        threadCount = (int)std::thread::hardware_concurrency();
+        if (threadCount <= 0) threadCount = 1;
+    }
+    // The caller is thread 0
+    this->threads = new std::thread[threadCount - 1];
+    for (int i = 1; i < threadCount; i++) {
+        this->threads[i - 1] = std::thread(&HistoryQueryEngine::work, this, i);
+    }
+}
+
+HistoryQueryEngine::~HistoryQueryEngine() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (int i = 0; i < threadCount - 1; i++) {
+        threads[i].join();
+    }
+    delete[] threads;
+}
+
+int HistoryQueryEngine::getThreadCount() const {
+    return threadCount;
+}
+
+void HistoryQueryEngine::work(int index) {
+    long long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seen; });
+            if (stopping) return;
+            seen = generation;
+        }
+        runPhase(index);
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            finished++;
+        }
+        done.notify_one();
+    }
+}
+
+void HistoryQueryEngine::runPhase(int index) {
+    if (phase == 0) {
+        scan(index);
+    } else {
+        merge(index);
+    }
+}
+
+// Runs a phase on every thread and returns once all have finished it
+void HistoryQueryEngine::dispatch(int newPhase) {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        phase = newPhase;
+        finished = 0;
+        generation++;
+    }
+    wake.notify_all();
+    runPhase(0);
+    std::unique_lock<std::mutex> guard(lock);
+    done.wait(guard, [&] { return finished == threadCount - 1; });
+}
+
+static long long keyOf(HistoryKey key, const ParkingRequest* request, long long time,
+                       long long bucket) {
+    switch (key) {
+        case HISTORY_KEY_NONE: return 0;
+        case HISTORY_KEY_ZONE: return request->getRequestedZone();
+        case HISTORY_KEY_ALLOCATED: return request->getAllocatedZone();
+        case HISTORY_KEY_STATE: return request->getState();
+        case HISTORY_KEY_CLASS: return request->getRequiredClass();
+        case HISTORY_KEY_PLATE: return request->getPlate();
+        case HISTORY_KEY_CROSS: return request->hasCrossZonePenalty() ? 1 : 0;
+        case HISTORY_KEY_TIME: {
+            long long start = time / bucket * bucket;
+            return start > time ? start - bucket : start;
+        }
+    }
+    return 0;
+}
+
+// Whole store chunks at a time, so each thread reads its records in order
+void HistoryQueryEngine::scan(int index) {
+    const HistoryQuery& q = *query;
+    HistoryPartial* tables = partials + index * threadCount;
+    int chunks = store->getChunkCount();
+    long long matched = 0;
+    long long keys[HISTORY_MAX_KEYS];
+
+    int chunk;
+    while ((chunk = nextChunk.fetch_add(1, std::memory_order_relaxed)) < chunks) {
+        int records;
+        const char* record = (const char*)store->getChunk(chunk, records);
+        for (int i = 0; i < records; i++, record += REQUEST_RECORD_BYTES) {
+            const ParkingRequest* request = (const ParkingRequest*)record;
+            RequestState state = request->getState();
+            if ((q.stateMask & (1u << state)) == 0 ||
+                (q.classMask & (1u << request->getRequiredClass())) == 0) continue;
+            if (q.requestedZone != HISTORY_ANY_ZONE && request->getRequestedZone() != q.requestedZone) continue;
+            int allocatedZone = request->getAllocatedZone();
+            if (q.allocatedZone != HISTORY_ANY_ZONE && allocatedZone != q.allocatedZone) continue;
+            if (q.cross >= 0 && request->hasCrossZonePenalty() != (q.cross == 1)) continue;
+            long long time = request->getRequestTime();
+            if (time < q.from || time >= q.to) continue;
+
+            double value = 0;
+            switch (q.measure) {
+                case HISTORY_MEASURE_NONE:
+                    break;
+                case HISTORY_MEASURE_DURATION:
+                    if (state != RELEASED) continue;
+                    value = (double)request->getParkingDuration();
+                    break;
+                case HISTORY_MEASURE_WAIT:
+                    if (request->getAllocationTime() == 0) continue;
+                    value = (double)(request->getAllocationTime() - time);
+                    break;
+                case HISTORY_MEASURE_DISTANCE:
+                    if (allocatedZone < 0) continue;
+                    value = request->getCrossZoneDistance();
+                    break;
+                case HISTORY_MEASURE_CROSS:
+                    if (allocatedZone < 0) continue;
+                    value = request->hasCrossZonePenalty() ? 1 : 0;
+                    break;
+            }
+
+            for (int k = 0; k < HISTORY_MAX_KEYS; k++) {
+                keys[k] = keyOf(q.keys[k], request, time, q.bucket);
+            }
+            unsigned long long hash = hashKeys(keys);
+            HistoryPartial& table = tables[(hash >> 40) % threadCount];
+            addValue(findGroup(table, keys, hash), 1, value, value, value);
+            matched++;
+        }
+    }
+
+    matchedByThread[index] = matched;
+}
+
+// Thread index folds the index-th table of every thread into its own
+void HistoryQueryEngine::merge(int index) {
+    HistoryPartial& target = partials[index];
+    for (int t = 1; t < threadCount; t++) {
+        HistoryPartial& source = partials[t * threadCount + index];
+        for (int i = 0; i < source.capacity; i++) {
+            const HistoryGroup& group = source.groups[i];
+            if (group.count == 0) continue;
+            addValue(findGroup(target, group.keys, hashKeys(group.keys)), group.count, group.sum,
+                     group.min, group.max);
+        }
+        delete[] source.groups;
+        source.groups = nullptr;
+    }
+}
+
+static double aggregateOf(HistoryAggregate aggregate, const HistoryGroup& group) {
+    switch (aggregate) {
+        case HISTORY_COUNT: return (double)group.count;
+        case HISTORY_SUM: return group.sum;
+        case HISTORY_AVG: return group.sum / group.count;
+        case HISTORY_MIN: return group.min;
+        case HISTORY_MAX: return group.max;
+    }
+    return 0;
+}
+
+static bool keyBefore(const HistoryGroup& a, const HistoryGroup& b) {
+    if (a.keys[0] != b.keys[0]) return a.keys[0] < b.keys[0];
+    return a.keys[1] < b.keys[1];
+}
+
+void HistoryQueryEngine::run(const RequestStore& requests, const HistoryQuery& q,
+                             HistoryResult& result) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    store = &requests;
+    query = &q;
+    partials = new HistoryPartial[threadCount * threadCount];
+    for (int i = 0; i < threadCount * threadCount; i++) {
+        partials[i].groups = nullptr;
+        partials[i].count = 0;
+        partials[i].capacity = 0;
+    }
+    matchedByThread = new long long[threadCount];
+    nextChunk = 0;
+
+    dispatch(0);
+    dispatch(1);
+
+    int total = 0;
+    result.matched = 0;
+    for (int i = 0; i < threadCount; i++) {
+        total += partials[i].count;
+        result.matched += matchedByThread[i];
+    }
+    if (total > result.groupCapacity) {
+        delete[] result.groups;
+        result.groups = new HistoryGroup[total];
+        result.groupCapacity = total;
+    }
+    int n = 0;
+    for (int i = 0; i < threadCount; i++) {
+        for (int j = 0; j < partials[i].capacity; j++) {
+            if (partials[i].groups[j].count == 0) continue;
+            result.groups[n] = partials[i].groups[j];
+            result.groups[n].value = aggregateOf(q.aggregate, result.groups[n]);
+            n++;
+        }
+        delete[] partials[i].groups;
+    }
+    delete[] partials;
+    delete[] matchedByThread;
+    partials = nullptr;
+    matchedByThread = nullptr;
+
+    // Only the groups that are kept need to be in order
+    HistoryOrder order = q.order;
+    auto before = [order](const HistoryGroup& a, const HistoryGroup& b) {
+        if (order != HISTORY_ORDER_KEY && a.value != b.value) {
+            return order == HISTORY_ORDER_ASC ? a.value < b.value : a.value > b.value;
+        }
+        return keyBefore(a, b);
+    };
+    result.groupCount = q.limit > 0 && q.limit < n ? q.limit : n;
+    if (result.groupCount < n) {
+        std::partial_sort(result.groups, result.groups + result.groupCount, result.groups + n, before);
+    } else {
+        std::sort(result.groups, result.groups + n, before);
+    }
+
+    result.scanned = requests.getCount();
+    result.threads = threadCount;
+    result.millis = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+const char* HistoryQueryEngine::keyName(HistoryKey key) {
+    return KEY_NAMES[key];
+}
+
+// Key values as text; state, class and plate by name
+static const char* keyText(HistoryKey key, long long value, const RequestStore& requests,
+                           char* buffer, int size) {
+    switch (key) {
+        case HISTORY_KEY_STATE: return requestStateName((RequestState)value);
+        case HISTORY_KEY_CLASS: return slotClassName((SlotClass)value);
+        case HISTORY_KEY_PLATE: return requests.getPlates().lookup((unsigned)value);
+        case HISTORY_KEY_CROSS: return value != 0 ? "yes" : "no";
+        default:
+            snprintf(buffer, size, "%lld", value);
+            return buffer;
+    }
+}
+
+static bool isTextKey(HistoryKey key) {
+    return key == HISTORY_KEY_STATE || key == HISTORY_KEY_CLASS || key == HISTORY_KEY_PLATE ||
+           key == HISTORY_KEY_CROSS;
+}
+
+void HistoryQueryEngine::printResult(const HistoryQuery& query, const HistoryResult& result,
+                                     const RequestStore& requests, std::ostream& out) {
+    char buffer[32];
+    for (int k = 0; k < HISTORY_MAX_KEYS && query.keys[k] != HISTORY_KEY_NONE; k++) {
+        out << KEY_NAMES[query.keys[k]] << "\t";
+    }
+    out << "count";
+    if (query.aggregate != HISTORY_COUNT) {
+        out << "\t" << AGGREGATE_NAMES[query.aggregate] << "(" << MEASURE_NAMES[query.measure] << ")";
+    }
+    out << "\n";
+
+    for (int i = 0; i < result.groupCount; i++) {
+        const HistoryGroup& group = result.groups[i];
+        for (int k = 0; k < HISTORY_MAX_KEYS && query.keys[k] != HISTORY_KEY_NONE; k++) {
+            out << keyText(query.keys[k], group.keys[k], requests, buffer, sizeof(buffer)) << "\t";
+        }
+        out << group.count;
+        if (query.aggregate != HISTORY_COUNT) {
+            snprintf(buffer, sizeof(buffer), "%.2f", group.value);
+            out << "\t" << buffer;
+        }
+        out << "\n";
+    }
+    out << result.groupCount << " group(s), " << result.matched << " of " << result.scanned
+        << " request(s) matched, " << result.millis << " ms on " << result.threads << " thread(s)\n";
+}
+
+void HistoryQueryEngine::writeJson(ByteBuffer& out, const HistoryQuery& query,
+                                   const HistoryResult& result, const RequestStore& requests) {
+    char buffer[32];
+    out.append("{\"scanned\":");
+    out.appendInt(result.scanned);
+    out.append(",\"matched\":");
+    out.appendInt(result.matched);
+    out.append(",\"threads\":");
+    out.appendInt(result.threads);
+    int len = snprintf(buffer, sizeof(buffer), "%.3f", result.millis);
+    out.append(",\"millis\":");
+    out.append(buffer, len);
+    out.append(",\"groups\":[");
+    for (int i = 0; i < result.groupCount; i++) {
+        const HistoryGroup& group = result.groups[i];
+        out.append(i > 0 ? ",{" : "{");
+        for (int k = 0; k < HISTORY_MAX_KEYS && query.keys[k] != HISTORY_KEY_NONE; k++) {
+            out.append('"');
+            out.append(KEY_NAMES[query.keys[k]]);
+            out.append("\":");
+            if (isTextKey(query.keys[k])) {
+                out.appendJsonString(keyText(query.keys[k], group.keys[k], requests, buffer, sizeof(buffer)));
+            } else {
+                out.appendInt(group.keys[k]);
+            }
+            out.append(',');
+        }
+        out.append("\"count\":");
+        out.appendInt(group.count);
+        if (query.aggregate != HISTORY_COUNT) {
+            len = snprintf(buffer, sizeof(buffer), "%.2f", group.value);
+            out.append(",\"value\":");
+            out.append(buffer, len);
+        }
+        out.append('}');
+    }
+    out.append("]}");
+}
@@ -0,0 +1,145 @@
+#ifndef HISTORYQUERY_H
+#define HISTORYQUERY_H
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <iosfwd>
+#include "ParkingRequest.h"
+
+class ByteBuffer;
+class RequestStore;
+
+enum HistoryKey {
+    HISTORY_KEY_NONE,
+    HISTORY_KEY_ZONE,           // requested zone
+    HISTORY_KEY_ALLOCATED,      // allocated zone, -1 if none
+    HISTORY_KEY_STATE,
+    HISTORY_KEY_CLASS,
+    HISTORY_KEY_PLATE,
+    HISTORY_KEY_CROSS,          // 1 for cross-zone allocations
+    HISTORY_KEY_TIME            // request time / bucket
+};
+
+// Requests a measure does not apply to are left out of the aggregate
+enum HistoryMeasure {
+    HISTORY_MEASURE_NONE,
+    HISTORY_MEASURE_DURATION,   // released requests: release - allocation
+    HISTORY_MEASURE_WAIT,       // allocated requests: allocation - request
+    HISTORY_MEASURE_DISTANCE,   // allocated requests: cross-zone distance
+    HISTORY_MEASURE_CROSS       // allocated requests: 1 if cross-zone, else 0
+};
+
+enum HistoryAggregate {
+    HISTORY_COUNT,
+    HISTORY_SUM,
+    HISTORY_AVG,
+    HISTORY_MIN,
+    HISTORY_MAX
+};
+
+enum HistoryOrder {
+    HISTORY_ORDER_KEY,
+    HISTORY_ORDER_ASC,          // by aggregate value
+    HISTORY_ORDER_DESC
+};
+
+const int HISTORY_MAX_KEYS = 2;
+const int HISTORY_ANY_ZONE = -0x7FFFFFFF;
+
+// Filter, group-by and aggregate over every request in a RequestStore.
+// Written as space- or '&'-separated terms, e.g.
+//   group=plate agg=sum:duration order=desc limit=100
+//   state=cancelled group=zone,time bucket=86400
+//   agg=avg:cross group=time bucket=3600
+struct HistoryQuery {
+    unsigned stateMask;         // 1 << RequestState
+    unsigned classMask;         // 1 << SlotClass
+    int requestedZone;          // HISTORY_ANY_ZONE for any
+    int allocatedZone;
+    long long from;             // request time, from <= t < to
+    long long to;
+    int cross;                  // -1 any, 0 same zone only, 1 cross-zone only
+    HistoryKey keys[HISTORY_MAX_KEYS];
+    long long bucket;           // width of HISTORY_KEY_TIME groups, in ticks
+    HistoryAggregate aggregate;
+    HistoryMeasure measure;
+    HistoryOrder order;
+    int limit;                  // 0 for every group
+
+    HistoryQuery();
+    // False, with the offending term in error, if the text does not parse
+    bool parse(const char* text, int len, char* error, int errorSize);
+};
+
+struct HistoryGroup {
+    long long keys[HISTORY_MAX_KEYS];
+    long long count;
+    double sum;
+    double min;
+    double max;
+    double value;               // the aggregate asked for
+};
+
+struct HistoryResult {
+    HistoryGroup* groups;
+    int groupCount;
+    int groupCapacity;
+    long long scanned;
+    long long matched;
+    int threads;
+    double millis;
+
+    HistoryResult();
+    ~HistoryResult();
+};
+
+struct HistoryPartial;
+
+// Runs queries partitioned over the store on a pool of threads; the calling
+// thread takes a share too. Each thread scans whole store chunks, claimed
+// from a shared counter, into partial aggregates hashed into one table per
+// thread; the tables are then merged in parallel, thread i folding the
+// i-th table of every thread. The store must not be written during run().
+class HistoryQueryEngine {
+private:
+    std::thread* threads;
+    int threadCount;            // including the caller
+    std::mutex lock;
+    std::condition_variable wake;
+    std::condition_variable done;
+    long long generation;
+    int finished;
+    bool stopping;
+
+    // The job in progress
+    const RequestStore* store;
+    const HistoryQuery* query;
+    HistoryPartial* partials;   // threadCount x threadCount tables
+    long long* matchedByThread;
+    int phase;
+    std::atomic<int> nextChunk;
+
+    void work(int index);
+    void runPhase(int index);
+    void scan(int index);
+    void merge(int index);
+    void dispatch(int newPhase);
+
+public:
+    // 0 threads means one per hardware thread
+    HistoryQueryEngine(int threads = 0);
+    ~HistoryQueryEngine();
+
+    void run(const RequestStore& requests, const HistoryQuery& query, HistoryResult& result);
+    int getThreadCount() const;
+
+    static void printResult(const HistoryQuery& query, const HistoryResult& result,
+                            const RequestStore& requests, std::ostream& out);
+    static void writeJson(ByteBuffer& out, const HistoryQuery& query, const HistoryResult& result,
+                          const RequestStore& requests);
+    static const char* keyName(HistoryKey key);
+};
+
+#endif
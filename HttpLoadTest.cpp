@@ -0,0 +1,187 @@
+#include "HttpLoadTest.h"
+#include "ByteBuffer.h"
+#include "EngineStats.h"
+#include "NetUtil.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+struct LoadConnection {
+    int fd;
+    ByteBuffer in;
+    int pendingReleaseId;   // LOAD_WRITE: request to release next, 0 = create next
+    long long sentAt;
+    int serial;
+
+    LoadConnection() : fd(-1), pendingReleaseId(0), sentAt(0), serial(0) {}
+};
+
+static void sendNext(LoadConnection& conn, LoadTestMode mode, int index) {
+    char request[256];
+    int len;
+    if (mode == LOAD_READ) {
+        len = snprintf(request, sizeof(request),
+                       "GET /api/zones HTTP/1.1\r\nHost: localhost\r\n\r\n");
+    } else if (conn.pendingReleaseId == 0) {
+        char payload[96];
+        int serial = conn.serial++;
+        int payloadLen = snprintf(payload, sizeof(payload), "{\"vehicleId\":\"LT%d-%d\",\"zone\":%d}",
+                                  index, serial, 1 + (index + serial) % 3);
+        len = snprintf(request, sizeof(request),
+                       "POST /api/requests HTTP/1.1\r\nHost: localhost\r\n"
+                       "Content-Type: application/json\r\nContent-Length: %d\r\n\r\n%s",
+                       payloadLen, payload);
+    } else {
+        len = snprintf(request, sizeof(request),
+                       "POST /api/requests/%d/release HTTP/1.1\r\nHost: localhost\r\n"
+                       "Content-Length: 0\r\n\r\n", conn.pendingReleaseId);
+    }
+    conn.sentAt = EngineStats::now();
+    writeFully(conn.fd, request, len);
+}
+
+static const char* findBounded(const char* data, int len, const char* needle) {
+    int needleLen = (int)strlen(needle);
+    for (int i = 0; i + needleLen <= len; i++) {
+        if (memcmp(data + i, needle, needleLen) == 0) return data + i;
+    }
+    return nullptr;
+}
+
+// Returns the response length if a complete response is buffered, else 0
+static int completeResponse(const ByteBuffer& in, int& status, const char*& body, int& bodyLen) {
+    const char* data = in.readPointer();
+    int len = in.readable();
+    const char* headerEnd = nullptr;
+    for (int i = 3; i < len; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            headerEnd = data + i + 1;
+            break;
+        }
+    }
+    if (headerEnd == nullptr || len < 12) return 0;
+
+    status = atoi(data + 9);
+    int contentLength = 0;
+    const char* found = findBounded(data, (int)(headerEnd - data), "Content-Length: ");
+    if (found != nullptr) {
+        contentLength = atoi(found + 16);
+    }
+    int total = (int)(headerEnd - data) + contentLength;
+    if (len < total) return 0;
+    body = headerEnd;
+    bodyLen = contentLength;
+    return total;
+}
+
+HttpLoadTest::HttpLoadTest(const char* h, int p, int connections, LoadTestMode m)
+    : host(h), port(p), connectionCount(connections), mode(m) {}
+
+bool HttpLoadTest::run(double seconds, LoadTestReport& report) {
+    report = LoadTestReport();
+    LoadConnection* conns = new LoadConnection[connectionCount];
+    int epollFd = epoll_create1(0);
+
+    for (int i = 0; i < connectionCount; i++) {
+        conns[i].fd = connectTcp(host, port);
+        if (conns[i].fd < 0) {
+            for (int j = 0; j < i; j++) close(conns[j].fd);
+            delete[] conns;
+            close(epollFd);
+            return false;
+        }
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.u32 = (unsigned int)i;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, conns[i].fd, &ev);
+    }
+
+    int sampleCapacity = 1 << 16;
+    long long* samples = new long long[sampleCapacity];
+    long long start = EngineStats::now();
+    long long deadline = start + (long long)(seconds * 1e9);
+
+    for (int i = 0; i < connectionCount; i++) {
+        sendNext(conns[i], mode, i);
+    }
+
+    epoll_event events[256];
+    bool failed = false;
+    while (!failed && EngineStats::now() < deadline) {
+        int n = epoll_wait(epollFd, events, 256, 100);
+        for (int e = 0; e < n; e++) {
+            int index = (int)events[e].data.u32;
+            LoadConnection& conn = conns[index];
+            char* dst = conn.in.writePointer(16384);
+            ssize_t got = recv(conn.fd, dst, 16384, 0);
+            if (got <= 0) {
+                if (got < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+                failed = true;
+                break;
+            }
+            conn.in.commitWrite((int)got);
+
+            int status;
+            const char* body;
+            int bodyLen;
+            int consumed = completeResponse(conn.in, status, body, bodyLen);
+            if (consumed == 0) continue;
+
+            long long latency = EngineStats::now() - conn.sentAt;
+            if (report.requests == sampleCapacity) {
+                long long* grown = new long long[sampleCapacity * 2];
+                memcpy(grown, samples, sizeof(long long) * sampleCapacity);
+                delete[] samples;
+                samples = grown;
+                sampleCapacity *= 2;
+            }
+            samples[report.requests++] = latency;
+
+            if (mode == LOAD_WRITE) {
+                if (conn.pendingReleaseId == 0 && status == 200) {
+                    const char* id = findBounded(body, bodyLen, "\"id\":");
+                    conn.pendingReleaseId = id != nullptr ? atoi(id + 5) : 0;
+                } else {
+                    conn.pendingReleaseId = 0;
+                }
+            } else if (status != 200) {
+                report.errors++;
+            }
+            conn.in.consume(consumed);
+            sendNext(conn, mode, index);
+        }
+    }
+
+    long long elapsed = EngineStats::now() - start;
+    report.seconds = elapsed / 1e9;
+    report.requestsPerSecond = report.seconds > 0 ? report.requests / report.seconds : 0.0;
+    if (report.requests > 0) {
+        std::sort(samples, samples + report.requests);
+        report.p50Ns = samples[(report.requests - 1) * 50 / 100];
+        report.p99Ns = samples[(report.requests - 1) * 99 / 100];
+        report.maxNs = samples[report.requests - 1];
+    }
+
+    for (int i = 0; i < connectionCount; i++) {
+        close(conns[i].fd);
+    }
+    delete[] samples;
+    delete[] conns;
+    close(epollFd);
+    return !failed;
+}
+
+void HttpLoadTest::printReport(const LoadTestReport& report, std::ostream& out) {
+    out << "Requests     : " << report.requests << "\n";
+    out << "Errors       : " << report.errors << "\n";
+    out << "Elapsed      : " << report.seconds << " s\n";
+    out << "Throughput   : " << (long long)report.requestsPerSecond << " req/s\n";
+    out << "Latency p50  : " << report.p50Ns / 1000 << " us\n";
+    out << "Latency p99  : " << report.p99Ns / 1000 << " us\n";
+    out << "Latency max  : " << report.maxNs / 1000 << " us\n";
+}
@@ -0,0 +1,37 @@
+#ifndef HTTPLOADTEST_H
+#define HTTPLOADTEST_H
+
+#include <iosfwd>
+
+enum LoadTestMode {
+    LOAD_READ,      // GET /api/zones
+    LOAD_WRITE      // POST create, then POST release of the same request
+};
+
+struct LoadTestReport {
+    long long requests;
+    long long errors;
+    double seconds;
+    double requestsPerSecond;
+    long long p50Ns;
+    long long p99Ns;
+    long long maxNs;
+};
+
+// Closed-loop keep-alive client: every connection keeps exactly one request
+// in flight, all driven from one epoll loop.
+class HttpLoadTest {
+private:
+    const char* host;
+    int port;
+    int connectionCount;
+    LoadTestMode mode;
+
+public:
+    HttpLoadTest(const char* h, int p, int connections, LoadTestMode m);
+
+    bool run(double seconds, LoadTestReport& report);
+    static void printReport(const LoadTestReport& report, std::ostream& out);
+};
+
+#endif
@@ -0,0 +1,1253 @@
+#include "HttpServer.h"
+#include "ParkingSystem.h"
+#include "ParkingRequest.h"
+#include "Zone.h"
+#include "ParkingArea.h"
+#include "ParkingSlot.h"
+#include "ChangeFeed.h"
+#include "NetUtil.h"
+#include "Replica.h"
+#include "SnapshotStore.h"
+#include "QueryPool.h"
+#include "OccupancySeries.h"
+#include "HistoryQuery.h"
+#include "Exporter.h"
+#include "OutputBuffer.h"
+#include "MemoryStats.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int MAX_EVENTS = 256;
+static const int MAX_HEADER_BYTES = 16384;
+static const int MAX_BODY_BYTES = 65536;
+static const int MAX_VEHICLE_ID = 50;
+static const int EXPORT_PAGE_ROWS = 100000;
+static const int PUSH_INTERVAL_MS = 250;
+static const int LONG_POLL_MS = 25000;
+static const int MAX_OCCUPANCY_POINTS = 10000;
+
+static long long nowMillis() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void appendDistance(ByteBuffer& out, double distance) {
+    char text[32];
+    int len = snprintf(text, sizeof(text), "%.2f", distance);
+    out.append(",\"crossZoneDistance\":");
+    out.append(text, len);
+}
+
+static bool startsWith(const char* data, int len, const char* prefix) {
+    int prefixLen = (int)strlen(prefix);
+    return len >= prefixLen && memcmp(data, prefix, prefixLen) == 0;
+}
+
+static bool equals(const char* data, int len, const char* text) {
+    return (int)strlen(text) == len && memcmp(data, text, len) == 0;
+}
+
+static bool headerIs(const char* line, int len, const char* name) {
+    int nameLen = (int)strlen(name);
+    if (len <= nameLen || line[nameLen] != ':') return false;
+    for (int i = 0; i < nameLen; i++) {
+        char c = line[i];
+        if (c >= 'A' && c <= 'Z') c = (char)(c - 'A' + 'a');
+        if (c != name[i]) return false;
+    }
+    return true;
+}
+
+// Locates "key": in a flat JSON object and returns a pointer to its value
+static const char* findJsonValue(const char* json, int len, const char* key) {
+    int keyLen = (int)strlen(key);
+    for (int i = 0; i + keyLen + 2 < len; i++) {
+        if (json[i] == '"' && memcmp(json + i + 1, key, keyLen) == 0 && json[i + 1 + keyLen] == '"') {
+            int j = i + keyLen + 2;
+            while (j < len && (json[j] == ' ' || json[j] == ':')) j++;
+            return j < len ? json + j : nullptr;
+        }
+    }
+    return nullptr;
+}
+
+static bool jsonInt(const char* json, int len, const char* key, int& value) {
+    const char* p = findJsonValue(json, len, key);
+    if (p == nullptr) return false;
+    if (*p == '"') p++;
+    char* end;
+    long parsed = strtol(p, &end, 10);
+    if (end == p) return false;
+    value = (int)parsed;
+    return true;
+}
+
+static bool jsonDouble(const char* json, int len, const char* key, double& value) {
+    const char* p = findJsonValue(json, len, key);
+    if (p == nullptr) return false;
+    char* end;
+    value = strtod(p, &end);
+    return end != p;
+}
+
+static bool jsonBool(const char* json, int len, const char* key) {
+    const char* p = findJsonValue(json, len, key);
+    return p != nullptr && json + len - p >= 4 && memcmp(p, "true", 4) == 0;
+}
+
+static bool jsonString(const char* json, int len, const char* key, char* out, int outSize) {
+    const char* p = findJsonValue(json, len, key);
+    if (p == nullptr || *p != '"') return false;
+    p++;
+    const char* end = json + len;
+    int n = 0;
+    while (p < end && *p != '"') {
+        if (*p == '\\' && p + 1 < end) p++;
+        if (n + 1 >= outSize) return false;
+        out[n++] = *p++;
+    }
+    out[n] = '\0';
+    return p < end && n > 0;
+}
+
+static long long queryLong(const char* query, int len, const char* key, long long fallback) {
+    int keyLen = (int)strlen(key);
+    for (int i = 0; i + keyLen < len; i++) {
+        if ((i == 0 || query[i - 1] == '&') && memcmp(query + i, key, keyLen) == 0 &&
+            query[i + keyLen] == '=') {
+            return strtoll(query + i + keyLen + 1, nullptr, 10);
+        }
+    }
+    return fallback;
+}
+
+static const char* statusText(int status) {
+    switch (status) {
+        case 200: return "OK";
+        case 400: return "Bad Request";
+        case 403: return "Forbidden";
+        case 404: return "Not Found";
+        case 405: return "Method Not Allowed";
+        case 409: return "Conflict";
+        case 413: return "Payload Too Large";
+        default: return "Error";
+    }
+}
+
+HttpServer::HttpServer(ParkingSystem& sys)
+    : system(sys), listenFd(-1), epollFd(-1), running(0), frontendHtml(nullptr),
+      frontendLength(0), connectionCapacity(1024), connectionCount(0), nextConnectionId(1),
+      requestsServed(0), body(65536), waitingCount(0), nextPushTick(0), pushCache(65536),
+      pushCacheSince(-1), replica(nullptr), queryPool(nullptr), historyQueries(nullptr),
+      memoryReportMillis(0), nextMemoryReport(0) {
+    changeScratch = new ChangeEvent[system.getChangeFeed()->getCapacity()];
+    connections = new HttpConnection*[connectionCapacity];
+    for (int i = 0; i < connectionCapacity; i++) {
+        connections[i] = nullptr;
+    }
+}
+
+HttpServer::~HttpServer() {
+    delete queryPool;
+    delete historyQueries;
+    for (int i = 0; i < connectionCapacity; i++) {
+        if (connections[i] != nullptr) {
+            close(connections[i]->fd);
+            delete connections[i];
+        }
+    }
+    delete[] connections;
+    delete[] changeScratch;
+    delete[] frontendHtml;
+    if (listenFd >= 0) close(listenFd);
+    if (epollFd >= 0) close(epollFd);
+}
+
+bool HttpServer::start(int port, const char* frontendPath) {
+    if (frontendPath != nullptr) {
+        FILE* file = fopen(frontendPath, "rb");
+        if (file != nullptr) {
+            fseek(file, 0, SEEK_END);
+            long size = ftell(file);
+            fseek(file, 0, SEEK_SET);
+            frontendHtml = new char[size > 0 ? size : 1];
+            frontendLength = (int)fread(frontendHtml, 1, size, file);
+            fclose(file);
+        }
+    }
+
+    listenFd = listenTcp(port);
+    if (listenFd < 0 || !setNonBlocking(listenFd)) return false;
+
+    epollFd = epoll_create1(0);
+    if (epollFd < 0) return false;
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = listenFd;
+    epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev);
+    if (replica != nullptr && replica->isConnected()) {
+        ev.data.fd = replica->getFd();
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, replica->getFd(), &ev);
+    }
+    if (queryPool != nullptr) {
+        ev.data.fd = queryPool->getDoneFd();
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, queryPool->getDoneFd(), &ev);
+    }
+    running = 1;
+    return true;
+}
+
+void HttpServer::setReplica(Replica* source) {
+    replica = source;
+}
+
+void HttpServer::setQueryThreads(int threads) {
+    if (threads <= 0 || queryPool != nullptr) return;
+    system.enableSnapshots();
+    queryPool = new QueryPool(*system.getSnapshots(), renderQuery, threads);
+}
+
+void HttpServer::setMemoryReport(int seconds) {
+    memoryReportMillis = seconds > 0 ? (long long)seconds * 1000 : 0;
+    nextMemoryReport = nowMillis() + memoryReportMillis;
+}
+
+void HttpServer::run() {
+    epoll_event events[MAX_EVENTS];
+    while (running) {
+        int n = epoll_wait(epollFd, events, MAX_EVENTS, waitingCount > 0 ? PUSH_INTERVAL_MS : 500);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; i++) {
+            int fd = events[i].data.fd;
+            if (fd == listenFd) {
+                acceptConnections();
+                continue;
+            }
+            if (replica != nullptr && fd == replica->getFd()) {
+                // Keep serving the last state if the primary goes away
+                if (!replica->pump()) {
+                    epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+                }
+                continue;
+            }
+            if (queryPool != nullptr && fd == queryPool->getDoneFd()) {
+                completeQueries();
+                continue;
+            }
+            HttpConnection* conn = fd < connectionCapacity ? connections[fd] : nullptr;
+            if (conn == nullptr) continue;
+
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                closeConnection(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) {
+                handleReadable(conn);
+                continue;
+            }
+            if (events[i].events & EPOLLOUT) {
+                if (!flushOutput(conn)) {
+                    closeConnection(conn);
+                } else {
+                    updateInterest(conn);
+                }
+            }
+        }
+
+        long long now = nowMillis();
+        if (waitingCount > 0 && now >= nextPushTick) {
+            pushChanges(now);
+            nextPushTick = now + PUSH_INTERVAL_MS;
+        }
+        if (memoryReportMillis > 0 && now >= nextMemoryReport) {
+            MemoryStats::printReport(std::cerr);
+            nextMemoryReport = now + memoryReportMillis;
+        }
+    }
+}
+
+void HttpServer::stop() {
+    running = 0;
+}
+
+int HttpServer::getConnectionCount() const {
+    return connectionCount;
+}
+
+long long HttpServer::getRequestsServed() const {
+    return requestsServed;
+}
+
+void HttpServer::acceptConnections() {
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) return;
+        setNonBlocking(fd);
+        setNoDelay(fd);
+
+        if (fd >= connectionCapacity) {
+            int newCapacity = connectionCapacity * 2;
+            while (newCapacity <= fd) newCapacity *= 2;
+            HttpConnection** grown = new HttpConnection*[newCapacity];
+            for (int i = 0; i < newCapacity; i++) {
+                grown[i] = i < connectionCapacity ? connections[i] : nullptr;
+            }
+            delete[] connections;
+            connections = grown;
+            connectionCapacity = newCapacity;
+        }
+
+        connections[fd] = new HttpConnection(fd, nextConnectionId++);
+        connectionCount++;
+
+        epoll_event ev;
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev);
+    }
+}
+
+void HttpServer::handleReadable(HttpConnection* conn) {
+    while (true) {
+        char* dst = conn->in.writePointer(16384);
+        ssize_t got = recv(conn->fd, dst, 16384, 0);
+        if (got > 0) {
+            conn->in.commitWrite((int)got);
+            if (got < 16384) break;
+            continue;
+        }
+        if (got == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+            closeConnection(conn);
+            return;
+        }
+        break;
+    }
+    processInput(conn);
+}
+
+void HttpServer::processInput(HttpConnection* conn) {
+    // Answer every complete request in the buffer, then write once. A parked
+    // long-poll or a query on another thread holds back anything pipelined
+    // behind it until it is answered.
+    while (!conn->closeAfterWrite && conn->waitSince < 0 && !conn->queryPending) {
+        HttpRequest request;
+        int consumed = parseRequest(conn, request);
+        if (consumed == 0) break;
+        if (consumed < 0) {
+            writeResponse(conn, consumed == -2 ? 413 : 400, "text/plain", "bad request\n", 12, false);
+            break;
+        }
+        route(request, conn);
+        conn->in.consume(consumed);
+        requestsServed++;
+    }
+
+    if (!flushOutput(conn)) {
+        closeConnection(conn);
+        return;
+    }
+    updateInterest(conn);
+}
+
+bool HttpServer::flushOutput(HttpConnection* conn) {
+    while (conn->out.readable() > 0) {
+        ssize_t sent = send(conn->fd, conn->out.readPointer(), conn->out.readable(), MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return true;
+            if (errno == EINTR) continue;
+            return false;
+        }
+        conn->out.consume((int)sent);
+    }
+    return !conn->closeAfterWrite;
+}
+
+void HttpServer::updateInterest(HttpConnection* conn) {
+    bool pending = conn->out.readable() > 0;
+    if (pending == conn->wantsWrite) return;
+
+    conn->wantsWrite = pending;
+    epoll_event ev;
+    ev.events = pending ? (EPOLLIN | EPOLLOUT) : EPOLLIN;
+    ev.data.fd = conn->fd;
+    epoll_ctl(epollFd, EPOLL_CTL_MOD, conn->fd, &ev);
+}
+
+void HttpServer::closeConnection(HttpConnection* conn) {
+    if (conn->waitSince >= 0) {
+        waitingCount--;
+    }
+    epoll_ctl(epollFd, EPOLL_CTL_DEL, conn->fd, nullptr);
+    close(conn->fd);
+    connections[conn->fd] = nullptr;
+    connectionCount--;
+    delete conn;
+}
+
+// Returns bytes consumed, 0 if the request is incomplete, -1 on a malformed
+// request and -2 when the headers or body exceed the limits
+int HttpServer::parseRequest(HttpConnection* conn, HttpRequest& request) {
+    const char* data = conn->in.readPointer();
+    int len = conn->in.readable();
+
+    int headerEnd = -1;
+    for (int i = 3; i < len; i++) {
+        if (data[i] == '\n' && data[i - 1] == '\r' && data[i - 2] == '\n' && data[i - 3] == '\r') {
+            headerEnd = i + 1;
+            break;
+        }
+    }
+    if (headerEnd < 0) {
+        return len > MAX_HEADER_BYTES ? -2 : 0;
+    }
+
+    // Request line: METHOD SP TARGET SP VERSION
+    const char* lineEnd = (const char*)memchr(data, '\r', headerEnd);
+    const char* sp1 = (const char*)memchr(data, ' ', lineEnd - data);
+    if (sp1 == nullptr) return -1;
+    const char* sp2 = (const char*)memchr(sp1 + 1, ' ', lineEnd - sp1 - 1);
+    if (sp2 == nullptr) return -1;
+
+    request.method = data;
+    request.methodLen = (int)(sp1 - data);
+    request.path = sp1 + 1;
+    request.pathLen = (int)(sp2 - sp1 - 1);
+    request.query = nullptr;
+    request.queryLen = 0;
+    const char* question = (const char*)memchr(request.path, '?', request.pathLen);
+    if (question != nullptr) {
+        request.query = question + 1;
+        request.queryLen = (int)(request.path + request.pathLen - question - 1);
+        request.pathLen = (int)(question - request.path);
+    }
+    request.keepAlive = startsWith(sp2 + 1, (int)(lineEnd - sp2 - 1), "HTTP/1.1");
+
+    int contentLength = 0;
+    const char* line = lineEnd + 2;
+    const char* end = data + headerEnd - 2;
+    while (line < end) {
+        const char* next = (const char*)memchr(line, '\r', end - line);
+        if (next == nullptr) next = end;
+        int lineLen = (int)(next - line);
+        const char* value = (const char*)memchr(line, ':', lineLen);
+        if (value != nullptr) {
+            value++;
+            while (value < next && *value == ' ') value++;
+            int valueLen = (int)(next - value);
+            if (headerIs(line, lineLen, "content-length")) {
+                contentLength = atoi(value);
+            } else if (headerIs(line, lineLen, "connection")) {
+                if (startsWith(value, valueLen, "close")) request.keepAlive = false;
+                if (startsWith(value, valueLen, "keep-alive")) request.keepAlive = true;
+            }
+        }
+        line = next + 2;
+    }
+
+    if (contentLength < 0) return -1;
+    if (contentLength > MAX_BODY_BYTES) return -2;
+    if (len < headerEnd + contentLength) return 0;
+
+    request.body = data + headerEnd;
+    request.bodyLen = contentLength;
+    return headerEnd + contentLength;
+}
+
+void HttpServer::writeResponse(HttpConnection* conn, int status, const char* contentType,
+                               const char* content, int length, bool keepAlive,
+                               const char* extraHeader) {
+    ByteBuffer& out = conn->out;
+    out.append("HTTP/1.1 ");
+    out.appendInt(status);
+    out.append(' ');
+    out.append(statusText(status));
+    out.append("\r\nContent-Type: ");
+    out.append(contentType);
+    out.append("\r\nContent-Length: ");
+    out.appendInt(length);
+    out.append("\r\nAccess-Control-Allow-Origin: *");
+    if (extraHeader != nullptr) {
+        out.append("\r\n");
+        out.append(extraHeader);
+    }
+    out.append(keepAlive ? "\r\nConnection: keep-alive\r\n\r\n" : "\r\nConnection: close\r\n\r\n");
+    out.append(content, length);
+    if (!keepAlive) {
+        conn->closeAfterWrite = true;
+    }
+}
+
+void HttpServer::route(const HttpRequest& request, HttpConnection* conn) {
+    bool isGet = equals(request.method, request.methodLen, "GET");
+    bool isPost = equals(request.method, request.methodLen, "POST");
+    const char* path = request.path;
+    int pathLen = request.pathLen;
+    const char* json = "application/json";
+    body.clear();
+
+    if (isGet && (equals(path, pathLen, "/") || equals(path, pathLen, "/index.html"))) {
+        if (frontendHtml == nullptr) {
+            writeResponse(conn, 404, "text/plain", "Frontend.html not loaded\n", 25, request.keepAlive);
+        } else {
+            writeResponse(conn, 200, "text/html; charset=utf-8", frontendHtml, frontendLength, request.keepAlive);
+        }
+        return;
+    }
+
+    if (isPost && replica != nullptr) {
+        writeResponse(conn, 403, json, "{\"error\":\"read-only replica\"}", 29, request.keepAlive);
+        return;
+    }
+
+    if (isGet && queryPool != nullptr) {
+        int kind = -1;
+        if (equals(path, pathLen, "/api/zones")) kind = QUERY_ZONES;
+        else if (equals(path, pathLen, "/api/requests")) kind = QUERY_REQUESTS;
+        else if (equals(path, pathLen, "/api/analytics")) kind = QUERY_ANALYTICS;
+        else if (equals(path, pathLen, "/api/state")) kind = QUERY_STATE;
+        else if (equals(path, pathLen, "/api/slots")) kind = QUERY_SLOTS;
+        if (kind >= 0) {
+            int zoneId = (int)queryLong(request.query, request.queryLen, "zone", -1);
+            dispatchQuery(conn, kind, zoneId, request.keepAlive);
+            return;
+        }
+    }
+
+    if (isGet && equals(path, pathLen, "/api/zones")) {
+        writeZonesJson(body);
+    } else if (isGet && equals(path, pathLen, "/api/requests")) {
+        writeRequestsJson(body);
+    } else if (isGet && equals(path, pathLen, "/api/analytics")) {
+        writeAnalyticsJson(body);
+    } else if (isGet && equals(path, pathLen, "/api/state")) {
+        body.append("{\"zones\":");
+        writeZonesJson(body);
+        body.append(",\"requests\":");
+        writeRequestsJson(body);
+        body.append(",\"analytics\":");
+        writeAnalyticsJson(body);
+        body.append('}');
+    } else if (isGet && equals(path, pathLen, "/api/slots")) {
+        // /api/slots?zone=<zone>: every slot in the zone with its availability
+        Zone* zone = system.getZone((int)queryLong(request.query, request.queryLen, "zone", -1));
+        if (zone == nullptr) {
+            writeResponse(conn, 404, json, "{\"error\":\"unknown zone\"}", 24, request.keepAlive);
+            return;
+        }
+        writeSlotsJson(body, zone);
+    } else if (isGet && equals(path, pathLen, "/api/occupancy")) {
+        // /api/occupancy?zone=<zone>&from=<ms>&to=<ms>&step=<ms>: occupied slots
+        // over time; defaults to the last hour by minute
+        Zone* zone = system.getZone((int)queryLong(request.query, request.queryLen, "zone", -1));
+        if (system.getOccupancy() == nullptr || zone == nullptr) {
+            writeResponse(conn, 404, json, "{\"error\":\"no occupancy series\"}", 31, request.keepAlive);
+            return;
+        }
+        long long to = queryLong(request.query, request.queryLen, "to", OccupancySeries::nowMillis());
+        long long from = queryLong(request.query, request.queryLen, "from", to - OCCUPANCY_HOUR);
+        long long step = queryLong(request.query, request.queryLen, "step", OCCUPANCY_MINUTE);
+        if (step <= 0 || from < 0) {
+            writeResponse(conn, 400, json, "{\"error\":\"bad range\"}", 21, request.keepAlive);
+            return;
+        }
+        writeOccupancyJson(body, zone, from, to, step);
+    } else if (isGet && equals(path, pathLen, "/api/query")) {
+        // /api/query?group=zone,time&bucket=3600&agg=avg:wait&...: filter,
+        // group-by and aggregate over the whole request history (see
+        // HistoryQuery.h); scans in parallel while the loop waits
+        HistoryQuery query;
+        char error[96];
+        if (!query.parse(request.query, request.queryLen, error, sizeof(error))) {
+            body.append("{\"error\":");
+            body.appendJsonString(error);
+            body.append('}');
+            writeResponse(conn, 400, json, body.readPointer(), body.readable(), request.keepAlive);
+            return;
+        }
+        if (historyQueries == nullptr) {
+            historyQueries = new HistoryQueryEngine();
+        }
+        HistoryResult result;
+        historyQueries->run(system.getRequests(), query, result);
+        HistoryQueryEngine::writeJson(body, query, result, system.getRequests());
+    } else if (isGet && equals(path, pathLen, "/api/export")) {
+        // /api/export?table=requests&format=csv&state=..&from=..&to=..&cursor=<id>&limit=<rows>:
+        // one page of a table (see Exporter.h); X-Next-Cursor names the next page
+        ExportOptions options;
+        options.limit = EXPORT_PAGE_ROWS;
+        char error[96];
+        if (!options.parse(request.query, request.queryLen, error, sizeof(error))) {
+            body.append("{\"error\":");
+            body.appendJsonString(error);
+            body.append('}');
+            writeResponse(conn, 400, json, body.readPointer(), body.readable(), request.keepAlive);
+            return;
+        }
+        char* data = nullptr;
+        size_t size = 0;
+        FILE* memory = open_memstream(&data, &size);
+        int next;
+        {
+            OutputBuffer out(memory);
+            next = Exporter::write(out, system, options);
+        }
+        fclose(memory);
+        char header[96];
+        snprintf(header, sizeof(header), "X-Next-Cursor: %d\r\nAccess-Control-Expose-Headers: X-Next-Cursor", next);
+        writeResponse(conn, 200, Exporter::contentType(options.format), data, (int)size, request.keepAlive,
+                      next > 0 ? header : nullptr);
+        free(data);
+        return;
+    } else if (isGet && equals(path, pathLen, "/api/free")) {
+        // /api/free?from=<zone>&to=<zone>: count and first free slot in the range
+        int from = (int)queryLong(request.query, request.queryLen, "from", 0);
+        int to = (int)queryLong(request.query, request.queryLen, "to", from);
+        ParkingSlot* slot = system.findFirstFreeSlot(from, to);
+        body.append("{\"available\":");
+        body.appendInt(system.countAvailableSlots(from, to));
+        if (slot != nullptr) {
+            body.append(",\"firstFree\":{\"zone\":");
+            body.appendInt(slot->getZoneId());
+            body.append(",\"slotId\":");
+            body.appendInt(slot->getSlotId());
+            body.append(",\"slotClass\":\"");
+            body.append(slotClassName(slot->getSlotClass()));
+            body.append("\"}}");
+        } else {
+            body.append(",\"firstFree\":null}");
+        }
+    } else if (isGet && equals(path, pathLen, "/api/memory")) {
+        std::ostringstream memory;
+        MemoryStats::write(memory, STATS_JSON);
+        std::string text = memory.str();
+        writeResponse(conn, 200, json, text.c_str(), (int)text.size(), request.keepAlive);
+        return;
+    } else if (isGet && equals(path, pathLen, "/api/replication")) {
+        writeReplicationJson(body);
+    } else if (isGet && equals(path, pathLen, "/api/changes")) {
+        subscribeChanges(request, conn);
+        return;
+    } else if (isGet && (equals(path, pathLen, "/api/stats") || equals(path, pathLen, "/metrics"))) {
+        bool prometheus = equals(path, pathLen, "/metrics");
+        std::ostringstream stats;
+        system.dumpStats(stats, prometheus ? STATS_PROMETHEUS : STATS_JSON);
+        if (prometheus && replica != nullptr) {
+            stats << "# TYPE parking_replication_applied_seq gauge\n";
+            stats << "parking_replication_applied_seq " << replica->getAppliedSeq() << "\n";
+            stats << "# TYPE parking_replication_lag_records gauge\n";
+            stats << "parking_replication_lag_records "
+                  << replica->getPrimarySeq() - replica->getAppliedSeq() << "\n";
+            stats << "# TYPE parking_replication_lag_seconds gauge\n";
+            stats << "parking_replication_lag_seconds " << replica->getLagNanos() / 1e9 << "\n";
+            stats << "# TYPE parking_replication_divergences_total counter\n";
+            stats << "parking_replication_divergences_total " << replica->getDivergences() << "\n";
+            stats << "# TYPE parking_replication_connected gauge\n";
+            stats << "parking_replication_connected " << (replica->isConnected() ? 1 : 0) << "\n";
+        }
+        std::string text = stats.str();
+        writeResponse(conn, 200, prometheus ? "text/plain; version=0.0.4" : json,
+                      text.c_str(), (int)text.size(), request.keepAlive);
+        return;
+    } else if (isPost && equals(path, pathLen, "/api/requests")) {
+        char vehicleId[MAX_VEHICLE_ID];
+        int zone;
+        if (!jsonString(request.body, request.bodyLen, "vehicleId", vehicleId, MAX_VEHICLE_ID) ||
+            !jsonInt(request.body, request.bodyLen, "zone", zone)) {
+            body.append("{\"error\":\"vehicleId and zone are required\"}");
+            writeResponse(conn, 400, json, body.readPointer(), body.readable(), request.keepAlive);
+            return;
+        }
+        SlotClass slotClass = SLOT_STANDARD;
+        char className[16];
+        if (jsonString(request.body, request.bodyLen, "vehicleClass", className, sizeof(className)) &&
+            !parseSlotClass(className, slotClass)) {
+            body.append("{\"error\":\"unknown vehicleClass\"}");
+            writeResponse(conn, 400, json, body.readPointer(), body.readable(), request.keepAlive);
+            return;
+        }
+        bool fallback = jsonBool(request.body, request.bodyLen, "fallback");
+        int priority = 0;
+        jsonInt(request.body, request.bodyLen, "priority", priority);
+        writeRequestJson(body, system.createRequest(vehicleId, zone, slotClass, fallback, priority));
+    } else if (isPost && startsWith(path, pathLen, "/api/requests/")) {
+        // /api/requests/{id}/cancel or /api/requests/{id}/release
+        const char* idStart = path + 14;
+        const char* slash = (const char*)memchr(idStart, '/', path + pathLen - idStart);
+        if (slash == nullptr) {
+            writeResponse(conn, 404, json, "{\"error\":\"not found\"}", 21, request.keepAlive);
+            return;
+        }
+        int requestId = atoi(idStart);
+        int actionLen = (int)(path + pathLen - slash - 1);
+        bool ok;
+        if (equals(slash + 1, actionLen, "cancel")) {
+            ok = system.cancelRequest(requestId);
+        } else if (equals(slash + 1, actionLen, "release")) {
+            ok = system.releaseParking(requestId);
+        } else {
+            writeResponse(conn, 404, json, "{\"error\":\"not found\"}", 21, request.keepAlive);
+            return;
+        }
+        ParkingRequest* updated = system.findRequest(requestId);
+        body.append(ok ? "{\"ok\":true,\"request\":" : "{\"ok\":false,\"request\":");
+        if (updated != nullptr) {
+            writeRequestJson(body, updated);
+        } else {
+            body.append("null");
+        }
+        body.append('}');
+        writeResponse(conn, ok ? 200 : 409, json, body.readPointer(), body.readable(), request.keepAlive);
+        return;
+    } else if (isPost && startsWith(path, pathLen, "/api/zones/")) {
+        // /api/zones/{id}/drain, /api/zones/{id}/reopen or /api/zones/{id}/areas
+        const char* idStart = path + 11;
+        const char* slash = (const char*)memchr(idStart, '/', path + pathLen - idStart);
+        if (slash == nullptr) {
+            writeResponse(conn, 404, json, "{\"error\":\"not found\"}", 21, request.keepAlive);
+            return;
+        }
+        int zoneId = atoi(idStart);
+        int actionLen = (int)(path + pathLen - slash - 1);
+        if (equals(slash + 1, actionLen, "areas")) {
+            int slots;
+            SlotClass slotClass = SLOT_STANDARD;
+            char className[16];
+            if (!jsonInt(request.body, request.bodyLen, "slots", slots) ||
+                (jsonString(request.body, request.bodyLen, "vehicleClass", className, sizeof(className)) &&
+                 !parseSlotClass(className, slotClass))) {
+                body.append("{\"error\":\"slots is required, vehicleClass must be known\"}");
+                writeResponse(conn, 400, json, body.readPointer(), body.readable(), request.keepAlive);
+                return;
+            }
+            double x = 0;
+            double y = 0;
+            bool located = jsonDouble(request.body, request.bodyLen, "x", x) &&
+                           jsonDouble(request.body, request.bodyLen, "y", y);
+            ParkingArea* area = system.addArea(zoneId, slots, slotClass, located, x, y);
+            if (area == nullptr) {
+                body.append("{\"ok\":false}");
+                writeResponse(conn, 409, json, body.readPointer(), body.readable(), request.keepAlive);
+                return;
+            }
+            body.append("{\"ok\":true,\"areaId\":");
+            body.appendInt(area->getAreaId());
+            body.append(",\"totalSlots\":");
+            body.appendInt(system.getZone(zoneId)->getTotalSlots());
+            body.append('}');
+            writeResponse(conn, 200, json, body.readPointer(), body.readable(), request.keepAlive);
+            return;
+        }
+        bool ok;
+        DrainResult result = {0, 0, 0};
+        if (equals(slash + 1, actionLen, "drain")) {
+            ok = system.drainZone(zoneId, &result);
+        } else if (equals(slash + 1, actionLen, "reopen")) {
+            ok = system.reopenZone(zoneId);
+        } else {
+            writeResponse(conn, 404, json, "{\"error\":\"not found\"}", 21, request.keepAlive);
+            return;
+        }
+        body.append(ok ? "{\"ok\":true,\"moved\":" : "{\"ok\":false,\"moved\":");
+        body.appendInt(result.moved);
+        body.append(",\"crossZone\":");
+        body.appendInt(result.crossZone);
+        body.append(",\"cancelled\":");
+        body.appendInt(result.cancelled);
+        body.append(",\"rollbackDepth\":");
+        body.appendInt(system.getRollbackDepth());
+        body.append('}');
+        writeResponse(conn, ok ? 200 : 409, json, body.readPointer(), body.readable(), request.keepAlive);
+        return;
+    } else if (isPost && equals(path, pathLen, "/api/rollback")) {
+        int count;
+        if (!jsonInt(request.body, request.bodyLen, "count", count)) {
+            body.append("{\"error\":\"count is required\"}");
+            writeResponse(conn, 400, json, body.readPointer(), body.readable(), request.keepAlive);
+            return;
+        }
+        bool ok = system.rollbackAllocations(count);
+        body.append(ok ? "{\"ok\":true,\"rollbackDepth\":" : "{\"ok\":false,\"rollbackDepth\":");
+        body.appendInt(system.getRollbackDepth());
+        body.append('}');
+        writeResponse(conn, ok ? 200 : 409, json, body.readPointer(), body.readable(), request.keepAlive);
+        return;
+    } else if (isGet || isPost) {
+        writeResponse(conn, 404, json, "{\"error\":\"not found\"}", 21, request.keepAlive);
+        return;
+    } else {
+        writeResponse(conn, 405, json, "{\"error\":\"method not allowed\"}", 30, request.keepAlive);
+        return;
+    }
+
+    writeResponse(conn, 200, json, body.readPointer(), body.readable(), request.keepAlive);
+}
+
+// The snapshot is brought up to date first, so a client sees its own
+// earlier writes. If every query thread is saturated the loop renders the
+// snapshot itself.
+void HttpServer::dispatchQuery(HttpConnection* conn, int kind, int arg, bool keepAlive) {
+    system.publishSnapshot();
+    QueryJob job;
+    job.fd = conn->fd;
+    job.connectionId = conn->id;
+    job.kind = kind;
+    job.arg = arg;
+    job.keepAlive = keepAlive;
+    job.status = 0;
+    job.body = nullptr;
+    if (queryPool->submit(job)) {
+        conn->queryPending = true;
+        return;
+    }
+    SnapshotReader reader(*system.getSnapshots());
+    int status = renderQuery(reader.get(), job, body);
+    writeResponse(conn, status, "application/json", body.readPointer(), body.readable(), keepAlive);
+}
+
+// Answers finished queries whose connection is still the one that asked,
+// then resumes any requests pipelined behind them
+void HttpServer::completeQueries() {
+    QueryJob finished[64];
+    int count;
+    do {
+        count = queryPool->collect(finished, 64);
+        for (int i = 0; i < count; i++) {
+            QueryJob& job = finished[i];
+            HttpConnection* conn = job.fd < connectionCapacity ? connections[job.fd] : nullptr;
+            if (conn != nullptr && conn->id == job.connectionId && conn->queryPending) {
+                conn->queryPending = false;
+                writeResponse(conn, job.status, "application/json", job.body->readPointer(),
+                              job.body->readable(), job.keepAlive);
+                processInput(conn);
+            }
+            delete job.body;
+        }
+    } while (count == 64);
+}
+
+// GET /api/changes?since=N. Without a usable N the client gets a snapshot
+// tagged with the current sequence; otherwise it gets the coalesced deltas
+// after N, either now or at the next push tick, or an empty list when the
+// long-poll times out.
+void HttpServer::subscribeChanges(const HttpRequest& request, HttpConnection* conn) {
+    ChangeFeed* feed = system.getChangeFeed();
+    long long since = queryLong(request.query, request.queryLen, "since", 0);
+    long long now = nowMillis();
+
+    if (since <= 0 || !feed->covers(since) ||
+        (since < feed->getLastSeq() && now >= conn->nextPushAt)) {
+        writeChangesBody(body, since);
+        conn->nextPushAt = now + PUSH_INTERVAL_MS;
+        writeResponse(conn, 200, "application/json", body.readPointer(), body.readable(), request.keepAlive);
+        return;
+    }
+
+    conn->waitSince = since;
+    conn->waitDeadline = now + LONG_POLL_MS;
+    conn->waitKeepAlive = request.keepAlive;
+    waitingCount++;
+}
+
+void HttpServer::writeChangesBody(ByteBuffer& out, long long since) {
+    if (since <= 0 || !writeDeltasJson(out, since)) {
+        out.clear();
+        writeSnapshotJson(out);
+    }
+}
+
+void HttpServer::pushChanges(long long now) {
+    long long lastSeq = system.getChangeFeed()->getLastSeq();
+    pushCacheSince = -1;
+
+    for (int fd = 0; fd < connectionCapacity && waitingCount > 0; fd++) {
+        HttpConnection* conn = connections[fd];
+        if (conn == nullptr || conn->waitSince < 0) continue;
+
+        bool expired = now >= conn->waitDeadline;
+        if (!expired && (conn->waitSince >= lastSeq || now < conn->nextPushAt)) continue;
+
+        // Wall displays tend to sit on the same sequence, so one encoded
+        // body usually serves every subscriber in a tick
+        if (conn->waitSince != pushCacheSince) {
+            pushCache.clear();
+            writeChangesBody(pushCache, conn->waitSince);
+            pushCacheSince = conn->waitSince;
+        }
+        conn->waitSince = -1;
+        conn->nextPushAt = now + PUSH_INTERVAL_MS;
+        waitingCount--;
+        writeResponse(conn, 200, "application/json", pushCache.readPointer(), pushCache.readable(),
+                      conn->waitKeepAlive);
+        processInput(conn);
+    }
+}
+
+void HttpServer::writeSnapshotJson(ByteBuffer& out) const {
+    out.append("{\"seq\":");
+    out.appendInt(system.getChangeFeed()->getLastSeq());
+    out.append(",\"snapshot\":true,\"zones\":");
+    writeZonesJson(out);
+
+    // Finished requests never change again, so the snapshot only carries
+    // the live ones; the totals come from the analytics block
+    out.append(",\"requests\":[");
+    bool first = true;
+    const RequestStore& requests = system.getRequests();
+    for (int id = 1; id <= requests.getCount(); id++) {
+        RequestState state = requests.get(id)->getState();
+        if (state == RELEASED || state == CANCELLED) continue;
+        if (!first) out.append(',');
+        writeRequestJson(out, requests.get(id));
+        first = false;
+    }
+    out.append("],\"analytics\":");
+    writeAnalyticsJson(out);
+    out.append('}');
+}
+
+bool HttpServer::writeDeltasJson(ByteBuffer& out, long long since) {
+    ChangeFeed* feed = system.getChangeFeed();
+    int count = feed->readCoalesced(since, changeScratch, feed->getCapacity());
+    if (count < 0) return false;
+
+    out.append("{\"seq\":");
+    out.appendInt(feed->getLastSeq());
+    out.append(",\"snapshot\":false,\"rollbackDepth\":");
+    out.appendInt(system.getRollbackDepth());
+    out.append(",\"changes\":[");
+    for (int i = 0; i < count; i++) {
+        if (i > 0) out.append(',');
+        writeChangeJson(out, changeScratch[i]);
+    }
+    out.append("]}");
+    return true;
+}
+
+void HttpServer::writeChangeJson(ByteBuffer& out, const ChangeEvent& event) {
+    if (event.type == CHANGE_SLOT) {
+        out.append("{\"type\":\"slot\",\"zone\":");
+        out.appendInt(event.zoneId);
+        out.append(",\"slotId\":");
+        out.appendInt(event.slotId);
+        out.append(event.state ? ",\"available\":true" : ",\"available\":false");
+        out.append(",\"zoneAvailable\":");
+        out.appendInt(event.zoneAvailable);
+        out.append(",\"slotClass\":\"");
+        out.append(slotClassName((SlotClass)event.slotClass));
+        out.append("\",\"classAvailable\":");
+        out.appendInt(event.classAvailable);
+        out.append('}');
+        return;
+    }
+
+    out.append("{\"type\":\"request\",\"id\":");
+    out.appendInt(event.requestId);
+    out.append(",\"vehicleId\":");
+    out.appendJsonString(event.vehicleId);
+    out.append(",\"requestedZone\":");
+    out.appendInt(event.requestedZone);
+    out.append(",\"vehicleClass\":\"");
+    out.append(slotClassName((SlotClass)event.slotClass));
+    out.append('"');
+    if (event.slotId != -1) {
+        out.append(",\"allocatedZone\":");
+        out.appendInt(event.zoneId);
+        out.append(",\"slotId\":");
+        out.appendInt(event.slotId);
+    } else {
+        out.append(",\"allocatedZone\":null,\"slotId\":null");
+    }
+    out.append(",\"state\":\"");
+    out.append(requestStateName((RequestState)event.state));
+    out.append(event.crossZone ? "\",\"crossZonePenalty\":true" : "\",\"crossZonePenalty\":false");
+    appendDistance(out, event.distance);
+    out.append(",\"time\":");
+    out.appendInt(event.time);
+    out.append('}');
+}
+
+void HttpServer::writeReplicationJson(ByteBuffer& out) const {
+    if (replica == nullptr) {
+        out.append("{\"role\":\"primary\"}");
+        return;
+    }
+    out.append("{\"role\":\"replica\",\"connected\":");
+    out.append(replica->isConnected() ? "true" : "false");
+    out.append(",\"appliedSeq\":");
+    out.appendInt(replica->getAppliedSeq());
+    out.append(",\"primarySeq\":");
+    out.appendInt(replica->getPrimarySeq());
+    out.append(",\"lagRecords\":");
+    out.appendInt(replica->getPrimarySeq() - replica->getAppliedSeq());
+    out.append(",\"lagMicros\":");
+    out.appendInt(replica->getLagNanos() / 1000);
+    out.append(",\"maxLagMicros\":");
+    out.appendInt(replica->getMaxLagNanos() / 1000);
+    out.append(",\"divergences\":");
+    out.appendInt(replica->getDivergences());
+    out.append(",\"bytesReceived\":");
+    out.appendInt(replica->getBytesReceived());
+    out.append('}');
+}
+
+// Zones, requests and analytics are written from views so the live state
+// and a snapshot produce the same JSON
+static void writeZoneJson(ByteBuffer& out, const ZoneView& zone) {
+    out.append("{\"id\":");
+    out.appendInt(zone.zoneId);
+    out.append(",\"total\":");
+    out.appendInt(zone.totalSlots);
+    out.append(",\"available\":");
+    out.appendInt(zone.availableSlots);
+    
+    // Only the special classes a zone actually has are listed
+    out.append(",\"classes\":{");
+    bool first = true;
+    for (int c = SLOT_STANDARD + 1; c < SLOT_CLASS_COUNT; c++) {
+        if (zone.totalByClass[c] == 0) continue;
+        if (!first) out.append(',');
+        out.appendJsonString(slotClassName((SlotClass)c));
+        out.append(":{\"total\":");
+        out.appendInt(zone.totalByClass[c]);
+        out.append(",\"available\":");
+        out.appendInt(zone.availableByClass[c]);
+        out.append('}');
+        first = false;
+    }
+    out.append("}}");
+}
+
+static void writeRequestViewJson(ByteBuffer& out, const RequestView& view) {
+    const ParkingRequest* request = view.request;
+    out.append("{\"id\":");
+    out.appendInt(request->getRequestId());
+    out.append(",\"vehicleId\":");
+    out.appendJsonString(request->getVehicleId());
+    out.append(",\"requestedZone\":");
+    out.appendInt(request->getRequestedZone());
+    out.append(",\"vehicleClass\":\"");
+    out.append(slotClassName(request->getRequiredClass()));
+    out.append('"');
+    if (view.allocatedSlotId != -1) {
+        out.append(",\"allocatedZone\":");
+        out.appendInt(view.allocatedZone);
+        out.append(",\"slotId\":");
+        out.appendInt(view.allocatedSlotId);
+    } else {
+        out.append(",\"allocatedZone\":null,\"slotId\":null");
+    }
+    out.append(",\"state\":\"");
+    out.append(requestStateName(view.state));
+    out.append(view.crossZone ? "\",\"crossZonePenalty\":true" : "\",\"crossZonePenalty\":false");
+    appendDistance(out, view.distance);
+    out.append(",\"requestTime\":");
+    out.appendInt(request->getRequestTime());
+    out.append(",\"allocationTime\":");
+    out.appendInt(view.allocationTime);
+    out.append(",\"releaseTime\":");
+    out.appendInt(view.releaseTime);
+    out.append('}');
+}
+
+struct AnalyticsTotals {
+    int total;
+    int active;
+    int completed;
+    int cancelled;
+    int crossZone;
+    long long totalDuration;
+    
+    AnalyticsTotals() : total(0), active(0), completed(0), cancelled(0), crossZone(0), totalDuration(0) {}
+    
+    void add(const RequestView& view) {
+        total++;
+        switch (view.state) {
+            case ALLOCATED:
+            case OCCUPIED:
+                active++;
+                break;
+            case RELEASED:
+                completed++;
+                totalDuration += view.getParkingDuration();
+                break;
+            case CANCELLED:
+                cancelled++;
+                break;
+            default:
+                break;
+        }
+        if (view.crossZone) crossZone++;
+    }
+};
+
+static void writeAnalyticsTotals(ByteBuffer& out, const AnalyticsTotals& totals, int rollbackDepth) {
+    out.append("{\"total\":");
+    out.appendInt(totals.total);
+    out.append(",\"active\":");
+    out.appendInt(totals.active);
+    out.append(",\"completed\":");
+    out.appendInt(totals.completed);
+    out.append(",\"cancelled\":");
+    out.appendInt(totals.cancelled);
+    out.append(",\"crossZone\":");
+    out.appendInt(totals.crossZone);
+    out.append(",\"averageDuration\":");
+    out.appendInt(totals.completed > 0 ? totals.totalDuration / totals.completed : 0);
+    out.append(",\"rollbackDepth\":");
+    out.appendInt(rollbackDepth);
+    out.append('}');
+}
+
+static void writeSlotJson(ByteBuffer& out, int slotId, SlotClass slotClass, bool available) {
+    out.append("{\"id\":");
+    out.appendInt(slotId);
+    out.append(",\"slotClass\":\"");
+    out.append(slotClassName(slotClass));
+    out.append(available ? "\",\"available\":true}" : "\",\"available\":false}");
+}
+
+void HttpServer::writeZonesJson(ByteBuffer& out) const {
+    out.append('[');
+    for (int i = 0; i < system.getZoneCount(); i++) {
+        if (i > 0) out.append(',');
+        ZoneView view;
+        view.captureCounters(system.getZoneAt(i));
+        writeZoneJson(out, view);
+    }
+    out.append(']');
+}
+
+void HttpServer::writeRequestsJson(ByteBuffer& out) const {
+    out.append('[');
+    const RequestStore& requests = system.getRequests();
+    for (int id = 1; id <= requests.getCount(); id++) {
+        if (id > 1) out.append(',');
+        writeRequestJson(out, requests.get(id));
+    }
+    out.append(']');
+}
+
+void HttpServer::writeAnalyticsJson(ByteBuffer& out) const {
+    AnalyticsTotals totals;
+    RequestView view;
+    const RequestStore& requests = system.getRequests();
+    for (int id = 1; id <= requests.getCount(); id++) {
+        view.capture(requests.get(id));
+        totals.add(view);
+    }
+    writeAnalyticsTotals(out, totals, system.getRollbackDepth());
+}
+
+void HttpServer::writeOccupancyJson(ByteBuffer& out, const Zone* zone, long long from, long long to,
+                                    long long step) const {
+    OccupancyPoint* points = new OccupancyPoint[MAX_OCCUPANCY_POINTS];
+    int count = system.getOccupancy()->query(zone->getPosition(), from, to, step,
+                                             OccupancySeries::nowMillis(), points, MAX_OCCUPANCY_POINTS);
+    out.append("{\"zone\":");
+    out.appendInt(zone->getZoneId());
+    out.append(",\"total\":");
+    out.appendInt(zone->getTotalSlots());
+    out.append(",\"step\":");
+    out.appendInt(step);
+    out.append(",\"points\":[");
+    for (int i = 0; i < count; i++) {
+        char text[32];
+        int len = snprintf(text, sizeof(text), "%.2f", points[i].average);
+        if (i > 0) out.append(',');
+        out.append("{\"time\":");
+        out.appendInt(points[i].time);
+        out.append(",\"average\":");
+        out.append(text, len);
+        out.append(",\"min\":");
+        out.appendInt(points[i].min);
+        out.append(",\"max\":");
+        out.appendInt(points[i].max);
+        out.append('}');
+    }
+    out.append("]}");
+    delete[] points;
+}
+
+void HttpServer::writeSlotsJson(ByteBuffer& out, const Zone* zone) const {
+    out.append("{\"zone\":");
+    out.appendInt(zone->getZoneId());
+    out.append(",\"slots\":[");
+    for (int i = 0; i < zone->getTotalSlots(); i++) {
+        ParkingSlot* slot = zone->getSlotAt(i);
+        if (i > 0) out.append(',');
+        writeSlotJson(out, slot->getSlotId(), slot->getSlotClass(), slot->isAvailable());
+    }
+    out.append("]}");
+}
+
+void HttpServer::writeRequestJson(ByteBuffer& out, const ParkingRequest* request) {
+    RequestView view;
+    view.capture(request);
+    writeRequestViewJson(out, view);
+}
+
+// Runs on a query thread: only the pinned snapshot and the fixed fields of
+// requests are read
+int HttpServer::renderQuery(const SystemSnapshot& snapshot, const QueryJob& job, ByteBuffer& out) {
+    bool zones = job.kind == QUERY_ZONES || job.kind == QUERY_STATE;
+    bool requests = job.kind == QUERY_REQUESTS || job.kind == QUERY_STATE;
+    bool analytics = job.kind == QUERY_ANALYTICS || job.kind == QUERY_STATE;
+    
+    if (job.kind == QUERY_SLOTS) {
+        const ZoneView* zone = snapshot.findZone(job.arg);
+        if (zone == nullptr) {
+            out.append("{\"error\":\"unknown zone\"}");
+            return 404;
+        }
+        out.append("{\"zone\":");
+        out.appendInt(zone->zoneId);
+        out.append(",\"slots\":[");
+        for (int i = 0; i < zone->totalSlots; i++) {
+            if (i > 0) out.append(',');
+            writeSlotJson(out, zone->slotIds[i], (SlotClass)zone->slotClasses[i], zone->isSlotFree(i));
+        }
+        out.append("]}");
+        return 200;
+    }
+    
+    if (job.kind == QUERY_STATE) out.append("{\"zones\":");
+    if (zones) {
+        out.append('[');
+        for (int i = 0; i < snapshot.getZoneCount(); i++) {
+            if (i > 0) out.append(',');
+            writeZoneJson(out, snapshot.getZone(i));
+        }
+        out.append(']');
+    }
+    if (job.kind == QUERY_STATE) out.append(",\"requests\":");
+    if (requests) {
+        out.append('[');
+        for (int id = 1; id <= snapshot.getRequestCount(); id++) {
+            if (id > 1) out.append(',');
+            writeRequestViewJson(out, snapshot.getRequest(id));
+        }
+        out.append(']');
+    }
+    if (job.kind == QUERY_STATE) out.append(",\"analytics\":");
+    if (analytics) {
+        AnalyticsTotals totals;
+        for (int id = 1; id <= snapshot.getRequestCount(); id++) {
+            totals.add(snapshot.getRequest(id));
+        }
+        writeAnalyticsTotals(out, totals, snapshot.getRollbackDepth());
+    }
+    if (job.kind == QUERY_STATE) out.append('}');
+    return 200;
+}
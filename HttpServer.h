@@ -0,0 +1,141 @@
+#ifndef HTTPSERVER_H
+#define HTTPSERVER_H
+
+#include <csignal>
+#include "ByteBuffer.h"
+
+class ParkingSystem;
+class ParkingRequest;
+class Replica;
+class Zone;
+class QueryPool;
+class HistoryQueryEngine;
+class SystemSnapshot;
+struct ChangeEvent;
+struct QueryJob;
+
+struct HttpConnection {
+    int fd;
+    long long id;           // tells a reused descriptor apart from the one a query was for
+    ByteBuffer in;
+    ByteBuffer out;
+    bool closeAfterWrite;
+    bool wantsWrite;
+    bool queryPending;      // a query thread is answering; later requests wait
+
+    // Parked /api/changes long-poll; waitSince is -1 when not waiting
+    long long waitSince;
+    long long waitDeadline;
+    long long nextPushAt;
+    bool waitKeepAlive;
+
+    HttpConnection(int f, long long connectionId)
+        : fd(f), id(connectionId), closeAfterWrite(false), wantsWrite(false), queryPending(false),
+          waitSince(-1), waitDeadline(0), nextPushAt(0), waitKeepAlive(true) {}
+};
+
+// Parsed view into a connection's input buffer; nothing is copied
+struct HttpRequest {
+    const char* method;
+    int methodLen;
+    const char* path;
+    int pathLen;
+    const char* query;
+    int queryLen;
+    const char* body;
+    int bodyLen;
+    bool keepAlive;
+};
+
+enum QueryKind {
+    QUERY_ZONES,
+    QUERY_REQUESTS,
+    QUERY_ANALYTICS,
+    QUERY_STATE,
+    QUERY_SLOTS
+};
+
+// Single-threaded HTTP/1.1 server on a non-blocking epoll loop. Connections
+// are keep-alive by default and pipelined requests are answered in order.
+// With query threads, the read-only zone, request and analytics endpoints
+// are rendered from snapshots off the loop, so a large dump never holds up
+// allocations.
+class HttpServer {
+private:
+    ParkingSystem& system;
+    int listenFd;
+    int epollFd;
+    volatile sig_atomic_t running;
+    char* frontendHtml;
+    int frontendLength;
+    HttpConnection** connections;   // indexed by file descriptor
+    int connectionCapacity;
+    int connectionCount;
+    long long nextConnectionId;
+    long long requestsServed;
+    ByteBuffer body;
+
+    // Change feed subscribers are answered at most once per push interval,
+    // with every delta since their last sequence coalesced per slot/request
+    int waitingCount;
+    long long nextPushTick;
+    ChangeEvent* changeScratch;
+    ByteBuffer pushCache;
+    long long pushCacheSince;
+
+    // Set on a read replica: its log is applied from this loop and every
+    // write endpoint is refused
+    Replica* replica;
+    QueryPool* queryPool;
+    HistoryQueryEngine* historyQueries;     // started on the first /api/query
+    long long memoryReportMillis;           // 0 for no periodic memory report
+    long long nextMemoryReport;
+
+    void acceptConnections();
+    void handleReadable(HttpConnection* conn);
+    void processInput(HttpConnection* conn);
+    bool flushOutput(HttpConnection* conn);
+    void updateInterest(HttpConnection* conn);
+    void closeConnection(HttpConnection* conn);
+    int parseRequest(HttpConnection* conn, HttpRequest& request);
+
+    void route(const HttpRequest& request, HttpConnection* conn);
+    void dispatchQuery(HttpConnection* conn, int kind, int arg, bool keepAlive);
+    void completeQueries();
+    void subscribeChanges(const HttpRequest& request, HttpConnection* conn);
+    void pushChanges(long long now);
+    void writeChangesBody(ByteBuffer& out, long long since);
+    void writeResponse(HttpConnection* conn, int status, const char* contentType,
+                       const char* content, int length, bool keepAlive,
+                       const char* extraHeader = nullptr);
+
+    void writeZonesJson(ByteBuffer& out) const;
+    void writeRequestsJson(ByteBuffer& out) const;
+    void writeSnapshotJson(ByteBuffer& out) const;
+    bool writeDeltasJson(ByteBuffer& out, long long since);
+    void writeAnalyticsJson(ByteBuffer& out) const;
+    void writeReplicationJson(ByteBuffer& out) const;
+    void writeSlotsJson(ByteBuffer& out, const Zone* zone) const;
+    void writeOccupancyJson(ByteBuffer& out, const Zone* zone, long long from, long long to,
+                            long long step) const;
+    static void writeRequestJson(ByteBuffer& out, const ParkingRequest* request);
+    static int renderQuery(const SystemSnapshot& snapshot, const QueryJob& job, ByteBuffer& out);
+    static void writeChangeJson(ByteBuffer& out, const ChangeEvent& event);
+
+public:
+    HttpServer(ParkingSystem& sys);
+    ~HttpServer();
+
+    bool start(int port, const char* frontendPath);
+    void setReplica(Replica* source);
+    // Before start(): serve the read endpoints from this many reader threads
+    void setQueryThreads(int threads);
+    // Print the memory report to stderr every so many seconds from the loop
+    void setMemoryReport(int seconds);
+    void run();
+    void stop();
+    int getConnectionCount() const;
+    long long getRequestsServed() const;
+};
+
+#endif
@@ -1,13 +1,62 @@
 #include <iostream>
+#include <cstdlib>
 #include <cstring>
+#include <climits>
 #include "ParkingSystem.h"
 #include "Zone.h"
 #include "ParkingArea.h"
 #include "ParkingSlot.h"
 #include "ParkingRequest.h"
+#include "TraceRecorder.h"
+#include "TraceReplayer.h"
+#include "BatchRunner.h"
+#include "OutputBuffer.h"
+#include "HttpServer.h"
+#include "HttpLoadTest.h"
+#include "GateServer.h"
+#include "GateLoadTest.h"
+#include "AllocationEngine.h"
+#include "EngineStats.h"
+#include "ShardRouter.h"
+#include "ReplicationLog.h"
+#include "ReplicationPublisher.h"
+#include "Replica.h"
+#include "Waitlist.h"
+#include "HistoryQuery.h"
+#include "Simulator.h"
+#include "Exporter.h"
+#include "NetUtil.h"
+#include "MemoryStats.h"
+#include "FixedParkingSystem.h"
+#include <csignal>
+#include <cerrno>
+#include <chrono>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
 
 using namespace std;
 
+struct RunOptions {
+    int gridZones;      // 0 = the default 3-zone layout
+    int gridAreas;
+    int gridSlots;
+    bool slotMix;       // grid areas get EV/accessible/motorcycle/oversize bays
+    bool dumpStats;
+    StatsFormat statsFormat;
+    AllocationPolicy policy;
+    AllocationPolicy comparePolicy;     // second system in --diff
+    const char* replicatePath;          // ship the operation log to replicas here
+    int queryThreads;                   // --serve: render read endpoints off the loop
+    WaitlistMode waitlist;
+    bool occupancy;                     // keep the per-zone occupancy time series
+    const char* historyQuery;           // --replay/--batch: report over the history on exit
+    const char* exportPath;             // and export a table here ("-" for stdout)
+    const char* exportTerms;
+    int memoryReport;                   // --serve: seconds between memory reports, 0 for none
+    int affinity;                       // vehicles whose last slot is remembered, 0 for none
+};
+
 void displayMenu() {
     cout << "\n========================================\n";
     cout << "   SMART PARKING ALLOCATION SYSTEM\n";
@@ -61,6 +110,7 @@ void requestParking(ParkingSystem& system) {
             cout << "Requested Zone   : Zone " << request->getRequestedZone() << " (FULL)\n";
             cout << "Allocated Zone   : Zone " << request->getAllocatedZone() << "\n";
             cout << "Slot ID          : " << request->getAllocatedSlotId() << "\n";
+            cout << "Distance         : " << request->getCrossZoneDistance() << " km\n";
             cout << "\nWARNING: CROSS-ZONE PENALTY APPLIED\n";
             cout << "Additional charges will be applied for cross-zone allocation.\n";
         } else {
@@ -302,7 +352,7 @@ void runAllTests(ParkingSystem& system) {
     cout << "========================================\n";
 }
 
-void initializeSystem(ParkingSystem& system) {
+void buildDefaultTopology(ParkingSystem& system) {
     // Setup Zone 1 with 3 slots
     Zone* zone1 = new Zone(1, 2);
     ParkingArea* area1_1 = new ParkingArea(1, 1, 2);
@@ -328,9 +378,79 @@ void initializeSystem(ParkingSystem& system) {
     area3_1->addSlot(new ParkingSlot(302, 3));
     zone3->addParkingArea(area3_1);
     
+    // Zones sit 1 km apart along one street
+    zone1->setLocation(0, 0);
+    zone2->setLocation(1, 0);
+    zone3->setLocation(2, 0);
+    
     system.addZone(zone1);
     system.addZone(zone2);
     system.addZone(zone3);
+}
+
+// Within every 20 slots of an area: 2 EV, 1 accessible, 1 motorcycle,
+// 1 oversize, 15 standard
+SlotClass mixedSlotClass(int slotIndex) {
+    switch (slotIndex % 20) {
+        case 0:
+        case 1: return SLOT_EV;
+        case 2: return SLOT_ACCESSIBLE;
+        case 3: return SLOT_MOTORCYCLE;
+        case 4: return SLOT_OVERSIZE;
+        default: return SLOT_STANDARD;
+    }
+}
+
+// Synthetic city: zones 1..Z, each with A areas of S slots, laid out row by
+// row on a square grid with 1 km between neighbours
+void gridZoneLocation(int zoneId, int zoneCount, double& x, double& y) {
+    int columns = 1;
+    while (columns * columns < zoneCount) columns++;
+    x = (zoneId - 1) % columns;
+    y = (zoneId - 1) / columns;
+}
+
+// Builds zones firstZone..lastZone of the grid; a shard builds only its own
+void buildGridTopology(ParkingSystem& system, int zoneCount, int areasPerZone, int slotsPerArea,
+                       bool slotMix, int firstZone, int lastZone) {
+    for (int z = firstZone; z <= lastZone; z++) {
+        Zone* zone = new Zone(z, areasPerZone);
+        double x;
+        double y;
+        gridZoneLocation(z, zoneCount, x, y);
+        zone->setLocation(x, y);
+        for (int a = 0; a < areasPerZone; a++) {
+            ParkingArea* area = new ParkingArea((z - 1) * areasPerZone + a + 1, z, slotsPerArea);
+            for (int s = 0; s < slotsPerArea; s++) {
+                SlotClass slotClass = slotMix ? mixedSlotClass(s) : SLOT_STANDARD;
+                area->addSlot(new ParkingSlot(z * 1000000 + a * slotsPerArea + s + 1, z, slotClass));
+            }
+            zone->addParkingArea(area);
+        }
+        system.addZone(zone);
+    }
+}
+
+int zoneCapacityFor(const RunOptions& options) {
+    return options.gridZones > 5 ? options.gridZones : 5;
+}
+
+void buildTopology(ParkingSystem& system, const RunOptions& options) {
+    if (options.gridZones > 0) {
+        buildGridTopology(system, options.gridZones, options.gridAreas, options.gridSlots,
+                          options.slotMix, 1, options.gridZones);
+    } else {
+        buildDefaultTopology(system);
+    }
+    system.enableWaitlist(options.waitlist);
+    system.enableAffinity(options.affinity);
+    if (options.occupancy) {
+        system.enableOccupancy();
+    }
+}
+
+void initializeSystem(ParkingSystem& system) {
+    buildDefaultTopology(system);
     
     cout << "\n========================================\n";
     cout << "  SYSTEM INITIALIZATION COMPLETE\n";
@@ -344,8 +464,1155 @@ void initializeSystem(ParkingSystem& system) {
     cout << "========================================\n";
 }
 
-int main() {
-    ParkingSystem system(5);
+void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options]\n";
+    cout << "  (no options)       Interactive menu\n";
+    cout << "  --record <file>    Interactive menu, recording a workload trace\n";
+    cout << "  --replay <file>    Replay a trace headlessly and report latency\n";
+    cout << "  --diff <file>      Replay a trace against two systems and diff state\n";
+    cout << "  --simulate [terms] Simulated city traffic on a virtual clock, e.g.\n";
+    cout << "                     \"days=7 rate=40 profile=city stay=lognormal:90:0.8 skew=1\"\n";
+    cout << "  --batch [file]     Run one-line commands from a file or stdin\n";
+    cout << "  --serve [port]     Serve Frontend.html and the JSON API (default 8080)\n";
+    cout << "  --query-threads <n> With --serve: answer zone, request and analytics reads from\n";
+    cout << "                     snapshots on n threads instead of the allocating loop\n";
+    cout << "  --occupancy        With --serve: keep per-zone occupancy history for /api/occupancy\n";
+    cout << "  --query <terms>    With --replay, --batch or --simulate: filter/group/aggregate the request\n";
+    cout << "                     history on exit, e.g. \"group=plate agg=sum:duration order=desc limit=100\"\n";
+    cout << "  --export <path> [terms]\n";
+    cout << "                     With --replay, --batch or --simulate: stream a table to path on exit,\n";
+    cout << "                     e.g. \"table=requests format=binary state=released from=0 to=86400000\"\n";
+    cout << "  --http-bench <port> <connections> <seconds> [read|write]\n";
+    cout << "                     Keep-alive load test against a running server\n";
+    cout << "  --gate <path|port> Serve the binary gate protocol on a Unix socket or a loopback port\n";
+    cout << "  --gate-bench <path|port> <connections> <seconds> [batch] [depth] [lease]\n";
+    cout << "                     Gate traffic against a running --gate server, depth batches of\n";
+    cout << "                     batch frames in flight per connection (default 64 x 4); with\n";
+    cout << "                     lease, creates park from leases of that many slots\n";
+    cout << "  --grid <Z> <A> <S> Headless modes: Z zones x A areas x S slots\n";
+    cout << "  --slot-mix         Grid areas include EV, accessible, motorcycle and oversize bays\n";
+    cout << "  --stats <format>   Dump engine stats on exit (json or prometheus)\n";
+    cout << "  --policy <name>    Slot policy: first, next, best or spread\n";
+    cout << "  --against <name>   Policy for the second system in --diff\n";
+    cout << "  --waitlist <mode>  Queue requests nothing fits: zone (requested zone only) or any\n";
+    cout << "  --affinity <n>     Give the last n vehicles to park their previous slot when they return\n";
+    cout << "  --replicate <path> With --batch or --serve: stream the operation log to replicas\n";
+    cout << "  --replica <path>   Follow a primary and serve its state read-only (--serve port, default 8081)\n";
+    cout << "  --shards <n>       Batch mode split across n forked shard processes (needs --grid)\n";
+    cout << "  --shard <path> <first> <last>\n";
+    cout << "                     Batch mode routed to a running shard worker (repeatable)\n";
+    cout << "  --shard-worker <path> <first> <last>\n";
+    cout << "                     Serve grid zones first..last on a Unix socket\n";
+    cout << "  --policy-bench [ops]\n";
+    cout << "                     Churn benchmark of every policy at 95% occupancy\n";
+    cout << "  --memory-report <s> With --serve or --replica: print memory by subsystem to stderr every s seconds\n";
+    cout << "  --memory-check [cycles]\n";
+    cout << "                     Create/release churn at 50% occupancy; fails if memory keeps growing\n";
+    cout << "  --fixed-check [ops] Run one op stream against ParkingSystem and the compile-time\n";
+    cout << "                     FixedParkingSystem of the same lots; fails on any difference\n";
+}
+
+bool parseStatsFormat(const char* name, StatsFormat& format) {
+    if (strcmp(name, "json") == 0) {
+        format = STATS_JSON;
+        return true;
+    }
+    if (strcmp(name, "prometheus") == 0) {
+        format = STATS_PROMETHEUS;
+        return true;
+    }
+    return false;
+}
+
+// Runs --query over everything the system has seen, on every core
+void runHistoryQuery(const ParkingSystem& system, const RunOptions& options) {
+    if (options.historyQuery == nullptr) return;
+    HistoryQuery query;
+    char error[96];
+    if (!query.parse(options.historyQuery, (int)strlen(options.historyQuery), error, sizeof(error))) {
+        cout << "ERROR: --query " << error << "\n";
+        return;
+    }
+    HistoryQueryEngine engine;
+    HistoryResult result;
+    engine.run(system.getRequests(), query, result);
+    HistoryQueryEngine::printResult(query, result, system.getRequests(), cout);
+}
+
+// Streams --export to its file once the run is over
+void runExport(const ParkingSystem& system, const RunOptions& options) {
+    if (options.exportPath == nullptr) return;
+    ExportOptions exportOptions;
+    char error[96];
+    if (!exportOptions.parse(options.exportTerms, (int)strlen(options.exportTerms), error, sizeof(error))) {
+        cout << "ERROR: --export " << error << "\n";
+        return;
+    }
+    bool toStdout = strcmp(options.exportPath, "-") == 0;
+    FILE* file = toStdout ? stdout : fopen(options.exportPath, "wb");
+    if (file == nullptr) {
+        cout << "ERROR: Cannot write export file " << options.exportPath << "\n";
+        return;
+    }
+    cout.flush();
+    {
+        OutputBuffer out(file, 4 << 20);
+        Exporter::write(out, system, exportOptions);
+    }
+    if (!toStdout) {
+        fclose(file);
+    }
+}
+
+int replayTrace(const char* path, const RunOptions& options) {
+    TraceReplayer replayer;
+    if (!replayer.load(path)) {
+        cout << "ERROR: Cannot read trace " << path << "\n";
+        return 1;
+    }
+    
+    ParkingSystem system(zoneCapacityFor(options), options.policy);
+    buildTopology(system, options);
+    ReplayReport report = replayer.replay(system);
+    TraceReplayer::printReport(report, cout);
+    runHistoryQuery(system, options);
+    runExport(system, options);
+    if (options.dumpStats) {
+        system.dumpStats(cout, options.statsFormat);
+    }
+    return report.outcomeMismatches == 0 ? 0 : 2;
+}
+
+int runSimulation(const SimConfig& config, const RunOptions& options) {
+    ParkingSystem system(zoneCapacityFor(options), options.policy);
+    buildTopology(system, options);
+    Simulator simulator(config);
+    SimReport report;
+    simulator.run(system, report);
+    Simulator::printReport(report, cout);
+    runHistoryQuery(system, options);
+    runExport(system, options);
+    if (options.dumpStats) {
+        system.dumpStats(cout, options.statsFormat);
+    }
+    return 0;
+}
+
+int diffTrace(const char* path, const RunOptions& options) {
+    TraceReplayer replayer;
+    if (!replayer.load(path)) {
+        cout << "ERROR: Cannot read trace " << path << "\n";
+        return 1;
+    }
+    
+    ParkingSystem first(zoneCapacityFor(options), options.policy);
+    ParkingSystem second(zoneCapacityFor(options), options.comparePolicy);
+    buildTopology(first, options);
+    buildTopology(second, options);
+    int differences = replayer.diff(first, second, cout);
+    cout << "Replayed " << replayer.getEventCount() << " operations, "
+         << differences << " difference(s)\n";
+    return differences == 0 ? 0 : 2;
+}
+
+struct Replication {
+    ReplicationLog* log;
+    ReplicationPublisher* publisher;
+    
+    Replication() : log(nullptr), publisher(nullptr) {}
+};
+
+// With --replicate, every operation the system applies is appended to an
+// in-memory log that a background thread streams to replicas
+bool startReplication(ParkingSystem& system, const RunOptions& options, Replication& replication) {
+    if (options.replicatePath == nullptr) return true;
+    
+    ReplicationHello hello;
+    hello.gridZones = options.gridZones;
+    hello.gridAreas = options.gridAreas;
+    hello.gridSlots = options.gridSlots;
+    hello.slotMix = options.slotMix ? 1 : 0;
+    hello.policy = options.policy;
+    hello.waitlist = options.waitlist;
+    hello.affinity = options.affinity;
+    replication.log = new ReplicationLog();
+    replication.publisher = new ReplicationPublisher(*replication.log, hello);
+    if (!replication.publisher->start(options.replicatePath)) {
+        cout << "ERROR: Cannot listen for replicas on " << options.replicatePath << "\n";
+        return false;
+    }
+    system.setReplicationLog(replication.log);
+    return true;
+}
+
+void stopReplication(Replication& replication) {
+    if (replication.publisher == nullptr) return;
+    replication.publisher->stop();
+    delete replication.publisher;
+    delete replication.log;
+    replication.publisher = nullptr;
+    replication.log = nullptr;
+}
+
+int runBatch(const char* path, const RunOptions& options) {
+    FILE* in = stdin;
+    if (path != nullptr) {
+        in = fopen(path, "rb");
+        if (in == nullptr) {
+            cout << "ERROR: Cannot read command file " << path << "\n";
+            return 1;
+        }
+    }
+    
+    ParkingSystem system(zoneCapacityFor(options), options.policy);
+    buildTopology(system, options);
+    Replication replication;
+    if (!startReplication(system, options, replication)) {
+        return 1;
+    }
+    
+    OutputBuffer out(stdout);
+    BatchRunner runner(system, out);
+    runner.run(in);
+    out.flush();
+    stopReplication(replication);
+    runHistoryQuery(system, options);
+    runExport(system, options);
+    if (options.dumpStats) {
+        cout.flush();
+        system.dumpStats(cout, options.statsFormat);
+    }
+    
+    if (in != stdin) {
+        fclose(in);
+    }
+    return runner.getErrorCount() == 0 ? 0 : 2;
+}
+
+// Serves one shard - grid zones firstZone..lastZone - to routers connecting
+// on listenFd, one at a time; a forked shard exits after its first router
+int serveShard(int listenFd, int firstZone, int lastZone, const RunOptions& options, bool once) {
+    int count = lastZone - firstZone + 1;
+    ParkingSystem system(count > 5 ? count : 5, options.policy);
+    buildGridTopology(system, options.gridZones, options.gridAreas, options.gridSlots,
+                      options.slotMix, firstZone, lastZone);
+    
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return 1;
+        }
+        FILE* in = fdopen(fd, "r");
+        FILE* reply = fdopen(dup(fd), "w");
+        {
+            OutputBuffer out(reply, 1 << 16);
+            BatchRunner runner(system, out);
+            runner.run(in);
+        }
+        fclose(in);
+        fclose(reply);
+        if (once) return 0;
+    }
+}
+
+int runShardWorker(const char* path, int firstZone, int lastZone, const RunOptions& options) {
+    if (options.gridZones <= 0 || firstZone < 1 || lastZone > options.gridZones || firstZone > lastZone) {
+        cout << "ERROR: --shard-worker needs --grid and a zone range inside it\n";
+        return 1;
+    }
+    int listenFd = listenUnix(path);
+    if (listenFd < 0) {
+        cout << "ERROR: Cannot listen on " << path << "\n";
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    cout << "Shard serving zones " << firstZone << "-" << lastZone << " on " << path << "\n";
+    cout.flush();
+    return serveShard(listenFd, firstZone, lastZone, options, false);
+}
+
+struct ShardSpec {
+    const char* path;
+    int firstZone;
+    int lastZone;
+};
+
+// Batch mode through a ShardRouter. With forkCount > 0 the grid is split into
+// that many contiguous zone ranges, each served by a forked worker on its own
+// socket; otherwise the router connects to already running --shard-worker
+// processes described by specs.
+int runShardedBatch(const char* path, int forkCount, ShardSpec* specs, int specCount,
+                    const RunOptions& options) {
+    if (options.gridZones <= 0 || forkCount > options.gridZones) {
+        cout << "ERROR: Sharded batch mode needs --grid with at least one zone per shard\n";
+        return 1;
+    }
+    FILE* in = stdin;
+    if (path != nullptr) {
+        in = fopen(path, "rb");
+        if (in == nullptr) {
+            cout << "ERROR: Cannot read command file " << path << "\n";
+            return 1;
+        }
+    }
+    signal(SIGPIPE, SIG_IGN);
+    
+    char (*paths)[64] = new char[forkCount > 0 ? forkCount : 1][64];
+    pid_t* children = new pid_t[forkCount > 0 ? forkCount : 1];
+    if (forkCount > 0) {
+        specs = new ShardSpec[forkCount];
+        specCount = forkCount;
+        for (int i = 0; i < forkCount; i++) {
+            snprintf(paths[i], sizeof(paths[i]), "/tmp/parking-shard-%d-%d.sock", (int)getpid(), i);
+            specs[i].path = paths[i];
+            specs[i].firstZone = 1 + (int)((long long)i * options.gridZones / forkCount);
+            specs[i].lastZone = (int)((long long)(i + 1) * options.gridZones / forkCount);
+            
+            // Listen before forking so the router can connect straight away
+            int listenFd = listenUnix(paths[i]);
+            cout.flush();
+            fflush(stdout);
+            children[i] = listenFd >= 0 ? fork() : -1;
+            if (children[i] == 0) {
+                _exit(serveShard(listenFd, specs[i].firstZone, specs[i].lastZone, options, true));
+            }
+            if (listenFd >= 0) close(listenFd);
+        }
+    }
+    
+    int result = 0;
+    {
+        OutputBuffer out(stdout);
+        ShardRouter router(out);
+        for (int z = 1; z <= options.gridZones; z++) {
+            double x;
+            double y;
+            gridZoneLocation(z, options.gridZones, x, y);
+            router.setZoneLocation(z, x, y);
+        }
+        for (int i = 0; i < specCount && result == 0; i++) {
+            if (!router.addShard(specs[i].path, specs[i].firstZone, specs[i].lastZone)) {
+                cerr << "ERROR: Cannot connect to shard " << specs[i].path << "\n";
+                result = 1;
+            }
+        }
+        
+        if (result == 0) {
+            auto start = chrono::steady_clock::now();
+            long long commands = router.run(in);
+            double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+            cerr << "Routed " << commands << " command(s) across " << router.getShardCount()
+                 << " shard(s) in " << seconds << " s (" << (seconds > 0 ? commands / seconds : 0)
+                 << " commands/s, " << router.getCrossShardCount() << " cross-shard)\n";
+            result = router.getErrorCount() == 0 ? 0 : 2;
+        }
+    }
+    
+    // Closing the router's sockets lets each forked shard finish
+    for (int i = 0; i < forkCount; i++) {
+        if (children[i] > 0) waitpid(children[i], nullptr, 0);
+        unlink(paths[i]);
+    }
+    if (forkCount > 0) delete[] specs;
+    delete[] paths;
+    delete[] children;
+    if (in != stdin) {
+        fclose(in);
+    }
+    return result;
+}
+
+HttpServer* activeServer = nullptr;
+
+void stopServer(int) {
+    if (activeServer != nullptr) {
+        activeServer->stop();
+    }
+}
+
+int runServer(int port, const RunOptions& options) {
+    ParkingSystem system(zoneCapacityFor(options), options.policy);
+    buildTopology(system, options);
+    Replication replication;
+    if (!startReplication(system, options, replication)) {
+        return 1;
+    }
+    
+    HttpServer server(system);
+    server.setQueryThreads(options.queryThreads);
+    server.setMemoryReport(options.memoryReport);
+    if (!server.start(port, "Frontend.html")) {
+        cout << "ERROR: Cannot listen on port " << port << "\n";
+        return 1;
+    }
+    activeServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    
+    cout << "Serving on http://127.0.0.1:" << port << "/ (Ctrl+C to stop)\n";
+    cout.flush();
+    server.run();
+    activeServer = nullptr;
+    
+    stopReplication(replication);
+    
+    cout << "\nServed " << server.getRequestsServed() << " request(s)\n";
+    if (options.dumpStats) {
+        system.dumpStats(cout, options.statsFormat);
+    }
+    return 0;
+}
+
+GateServer* activeGate = nullptr;
+
+void stopGate(int) {
+    if (activeGate != nullptr) {
+        activeGate->stop();
+    }
+}
+
+int runGate(const char* address, const RunOptions& options) {
+    ParkingSystem system(zoneCapacityFor(options), options.policy);
+    buildTopology(system, options);
+    Replication replication;
+    if (!startReplication(system, options, replication)) {
+        return 1;
+    }
+    
+    GateServer server(system);
+    if (!server.start(address)) {
+        cout << "ERROR: Cannot listen on " << address << "\n";
+        return 1;
+    }
+    signal(SIGPIPE, SIG_IGN);
+    activeGate = &server;
+    signal(SIGINT, stopGate);
+    signal(SIGTERM, stopGate);
+    
+    cout << "Gate protocol on " << (isPortNumber(address) ? "127.0.0.1:" : "") << address
+         << " (Ctrl+C to stop)\n";
+    cout.flush();
+    server.run();
+    activeGate = nullptr;
+    
+    stopReplication(replication);
+    
+    cout << "\nServed " << server.getFramesServed() << " frame(s) in " << server.getBatchesServed()
+         << " batch(es)\n";
+    if (options.dumpStats) {
+        system.dumpStats(cout, options.statsFormat);
+    }
+    return 0;
+}
+
+int runGateBench(const char* address, int connections, double seconds, int batchSize, int depth,
+                 int leaseSize) {
+    GateLoadTest test(address, connections, batchSize, depth, leaseSize);
+    GateLoadReport report;
+    if (!test.run(seconds, report)) {
+        cout << "ERROR: Gate load test against " << address << " failed\n";
+        return 1;
+    }
+    GateLoadTest::printReport(report, cout);
+    return 0;
+}
+
+// Read replica: rebuilds the primary's topology from the hello, follows its
+// log and serves the read-only HTTP API (writes answer 403)
+int runReplica(const char* path, int port, const RunOptions& options) {
+    Replica replica;
+    if (!replica.connect(path)) {
+        cout << "ERROR: No replication primary at " << path << "\n";
+        return 1;
+    }
+    const ReplicationHello& hello = replica.getHello();
+    RunOptions replicaOptions = options;
+    replicaOptions.gridZones = hello.gridZones;
+    replicaOptions.gridAreas = hello.gridAreas;
+    replicaOptions.gridSlots = hello.gridSlots;
+    replicaOptions.slotMix = hello.slotMix != 0;
+    replicaOptions.policy = (AllocationPolicy)hello.policy;
+    replicaOptions.waitlist = (WaitlistMode)hello.waitlist;
+    replicaOptions.affinity = hello.affinity;
+    
+    ParkingSystem system(zoneCapacityFor(replicaOptions), replicaOptions.policy);
+    buildTopology(system, replicaOptions);
+    replica.attach(&system);
+    
+    HttpServer server(system);
+    server.setReplica(&replica);
+    server.setQueryThreads(options.queryThreads);
+    server.setMemoryReport(options.memoryReport);
+    if (!server.start(port, "Frontend.html")) {
+        cout << "ERROR: Cannot listen on port " << port << "\n";
+        return 1;
+    }
+    activeServer = &server;
+    signal(SIGINT, stopServer);
+    signal(SIGTERM, stopServer);
+    
+    cout << "Replica of " << path << " serving on http://127.0.0.1:" << port << "/ (Ctrl+C to stop)\n";
+    cout.flush();
+    server.run();
+    activeServer = nullptr;
+    
+    cout << "\nApplied " << replica.getAppliedSeq() << " operation(s), "
+         << replica.getDivergences() << " divergence(s)\n";
+    return replica.getDivergences() == 0 ? 0 : 2;
+}
+
+int runHttpBench(int port, int connections, double seconds, LoadTestMode mode) {
+    HttpLoadTest test("127.0.0.1", port, connections, mode);
+    LoadTestReport report;
+    if (!test.run(seconds, report)) {
+        cout << "ERROR: Load test against port " << port << " failed\n";
+        return 1;
+    }
+    HttpLoadTest::printReport(report, cout);
+    return 0;
+}
+
+// Fills the city to 95% and then churns: each step releases a random parked
+// car and requests a slot in a random zone. Every policy sees the same
+// sequence of zones and releases.
+int runPolicyBench(long long operations, const RunOptions& options) {
+    RunOptions benchOptions = options;
+    if (benchOptions.gridZones == 0) {
+        benchOptions.gridZones = 10;
+        benchOptions.gridAreas = 10;
+        benchOptions.gridSlots = 100;
+    }
+    int totalSlots = benchOptions.gridZones * benchOptions.gridAreas * benchOptions.gridSlots;
+    int target = (int)(totalSlots * 0.95);
+    
+    cout << "Policy benchmark: " << benchOptions.gridZones << " zones x " << benchOptions.gridAreas
+         << " areas x " << benchOptions.gridSlots << " slots, " << operations << " operations\n";
+    
+    for (int p = 0; p < ALLOCATION_POLICY_COUNT; p++) {
+        AllocationPolicy policy = (AllocationPolicy)p;
+        ParkingSystem system(zoneCapacityFor(benchOptions), policy);
+        buildTopology(system, benchOptions);
+        
+        int* parked = new int[target + 1];
+        int parkedCount = 0;
+        unsigned int seed = 12345;
+        char vehicleId[16] = "BENCH";
+        
+        while (parkedCount < target) {
+            seed = seed * 1103515245 + 12345;
+            int zone = (int)((seed >> 16) % benchOptions.gridZones) + 1;
+            ParkingRequest* request = system.createRequest(vehicleId, zone);
+            if (request->getState() == OCCUPIED) {
+                parked[parkedCount++] = request->getRequestId();
+            }
+        }
+        
+        const EngineStats* stats = system.getStats();
+        unsigned long long examinedBefore = stats->get(STAT_SLOTS_EXAMINED);
+        unsigned long long allocationsBefore = stats->get(STAT_ALLOCATIONS);
+        unsigned long long crossBefore = stats->get(STAT_CROSS_ZONE);
+        long long start = EngineStats::now();
+        
+        for (long long op = 0; op < operations; op++) {
+            seed = seed * 1103515245 + 12345;
+            int victim = (int)((seed >> 8) % parkedCount);
+            system.releaseParking(parked[victim]);
+            parked[victim] = parked[--parkedCount];
+            
+            seed = seed * 1103515245 + 12345;
+            int zone = (int)((seed >> 16) % benchOptions.gridZones) + 1;
+            ParkingRequest* request = system.createRequest(vehicleId, zone);
+            if (request->getState() == OCCUPIED) {
+                parked[parkedCount++] = request->getRequestId();
+            }
+        }
+        
+        long long elapsed = EngineStats::now() - start;
+        unsigned long long allocations = stats->get(STAT_ALLOCATIONS) - allocationsBefore;
+        unsigned long long examined = stats->get(STAT_SLOTS_EXAMINED) - examinedBefore;
+        cout << "  " << AllocationEngine::policyName(policy)
+             << ": " << (operations > 0 ? elapsed / operations : 0) << " ns/op"
+             << ", " << (allocations > 0 ? (double)examined / allocations : 0) << " slots examined/alloc"
+             << ", " << stats->get(STAT_CROSS_ZONE) - crossBefore << " cross-zone\n";
+        delete[] parked;
+    }
+    return 0;
+}
+
+// Steady-state churn: after a warm-up that touches every plate of a fixed
+// pool, each cycle parks one vehicle and releases the longest-parked one.
+// Bounded subsystems must end where they started; the request history and
+// the rollback stack keep one record per request by design, so they may
+// grow by at most one object a cycle.
+int runMemoryCheck(long long cycles, const RunOptions& options) {
+    RunOptions checkOptions = options;
+    if (checkOptions.gridZones == 0) {
+        checkOptions.gridZones = 10;
+        checkOptions.gridAreas = 10;
+        checkOptions.gridSlots = 100;
+    }
+    checkOptions.occupancy = false;     // its rollups grow with wall-clock time
+    ParkingSystem system(zoneCapacityFor(checkOptions), checkOptions.policy);
+    buildTopology(system, checkOptions);
+    
+    const int plateCount = 1000;
+    int totalSlots = checkOptions.gridZones * checkOptions.gridAreas * checkOptions.gridSlots;
+    int target = totalSlots / 2;
+    int* parked = new int[target + 1];
+    int first = 0;
+    int parkedCount = 0;
+    unsigned int seed = 12345;
+    char vehicleId[16];
+    
+    MemoryUsage before[MEMORY_SUBSYSTEM_COUNT];
+    long long warmup = cycles > plateCount ? cycles : plateCount;
+    for (long long op = 0; op < warmup + cycles; op++) {
+        if (op == warmup) {
+            for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+                before[i] = MemoryStats::get((MemorySubsystem)i);
+            }
+        }
+        snprintf(vehicleId, sizeof(vehicleId), "MEM%04d", (int)(op % plateCount));
+        seed = seed * 1103515245 + 12345;
+        int zone = (int)((seed >> 16) % checkOptions.gridZones) + 1;
+        ParkingRequest* request = system.createRequest(vehicleId, zone);
+        if (request->getState() == OCCUPIED) {
+            parked[(first + parkedCount++) % (target + 1)] = request->getRequestId();
+        }
+        if (parkedCount > target) {
+            system.releaseParking(parked[first]);
+            first = (first + 1) % (target + 1);
+            parkedCount--;
+        }
+    }
+    delete[] parked;
+    
+    cout << "Memory check: " << checkOptions.gridZones << " zones x " << checkOptions.gridAreas
+         << " areas x " << checkOptions.gridSlots << " slots, " << cycles << " create/release cycles after "
+         << warmup << " warm-up\n";
+    MemoryStats::printReport(cout);
+    bool passed = true;
+    for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+        MemorySubsystem subsystem = (MemorySubsystem)i;
+        MemoryUsage after = MemoryStats::get(subsystem);
+        long long bytes = after.liveBytes - before[i].liveBytes;
+        long long objects = after.objects - before[i].objects;
+        bool appendOnly = subsystem == MEMORY_REQUESTS || subsystem == MEMORY_ROLLBACK;
+        bool ok = appendOnly ? objects <= cycles : bytes <= 0 && objects <= 0;
+        cout << "  " << MemoryStats::subsystemName(subsystem) << ": " << (bytes >= 0 ? "+" : "") << bytes
+             << " bytes, " << (objects >= 0 ? "+" : "") << objects << " objects";
+        if (appendOnly) {
+            cout << " (one record per request)";
+        }
+        cout << (ok ? "" : "  GROWING") << "\n";
+        if (!ok) passed = false;
+    }
+    cout << (passed ? "PASS" : "FAIL") << "\n";
+    return passed ? 0 : 1;
+}
+
+// A mixed-class lot whose nearest-zone ties exercise the cross-zone order,
+// with a rollback ring small enough to wrap
+struct MixedLotTopology {
+    static constexpr FixedZoneSpec zones[] = {
+        {1, 2, 0, 0, true},
+        {2, 1, 3, 0, true},
+        {3, 2, 0, 3, true},
+        {4, 1, -3, 0, true}
+    };
+    static constexpr FixedAreaSpec areas[] = {
+        {1, 4}, {2, 3},
+        {3, 3},
+        {4, 2}, {5, 4},
+        {6, 3}
+    };
+    static constexpr FixedSlotSpec slots[] = {
+        {101, SLOT_EV}, {102, SLOT_STANDARD}, {103, SLOT_ACCESSIBLE}, {104, SLOT_STANDARD},
+        {105, SLOT_STANDARD}, {106, SLOT_MOTORCYCLE}, {107, SLOT_EV},
+        {201, SLOT_OVERSIZE}, {202, SLOT_STANDARD}, {203, SLOT_EV},
+        {301, SLOT_STANDARD}, {302, SLOT_STANDARD},
+        {303, SLOT_ACCESSIBLE}, {304, SLOT_EV}, {305, SLOT_STANDARD}, {306, SLOT_OVERSIZE},
+        {401, SLOT_MOTORCYCLE}, {402, SLOT_STANDARD}, {403, SLOT_STANDARD}
+    };
+    static constexpr int requestCapacity = 64;
+    static constexpr int rollbackCapacity = 8;
+};
+
+// Zones with no location, searched in zone order
+struct StreetLotTopology {
+    static constexpr FixedZoneSpec zones[] = {
+        {10, 1, 0, 0, false},
+        {20, 2, 0, 0, false},
+        {30, 1, 0, 0, false}
+    };
+    static constexpr FixedAreaSpec areas[] = {
+        {1, 3},
+        {2, 2}, {3, 2},
+        {4, 3}
+    };
+    static constexpr FixedSlotSpec slots[] = {
+        {11, SLOT_STANDARD}, {12, SLOT_EV}, {13, SLOT_STANDARD},
+        {21, SLOT_STANDARD}, {22, SLOT_STANDARD},
+        {23, SLOT_ACCESSIBLE}, {24, SLOT_STANDARD},
+        {31, SLOT_EV}, {32, SLOT_STANDARD}, {33, SLOT_OVERSIZE}
+    };
+    static constexpr int requestCapacity = 48;
+    static constexpr int rollbackCapacity = 16;
+};
+
+// The same lot built the dynamic way
+template <typename Topology>
+void buildFixedTopology(ParkingSystem& system) {
+    int area = 0;
+    int slot = 0;
+    for (const FixedZoneSpec& zoneSpec : Topology::zones) {
+        Zone* zone = new Zone(zoneSpec.zoneId, zoneSpec.areaCount);
+        for (int a = 0; a < zoneSpec.areaCount; a++, area++) {
+            const FixedAreaSpec& areaSpec = Topology::areas[area];
+            ParkingArea* parkingArea = new ParkingArea(areaSpec.areaId, zoneSpec.zoneId, areaSpec.slotCount);
+            for (int s = 0; s < areaSpec.slotCount; s++, slot++) {
+                parkingArea->addSlot(new ParkingSlot(Topology::slots[slot].slotId, zoneSpec.zoneId,
+                                                     Topology::slots[slot].slotClass));
+            }
+            zone->addParkingArea(parkingArea);
+        }
+        if (zoneSpec.located) {
+            zone->setLocation(zoneSpec.x, zoneSpec.y);
+        }
+        system.addZone(zone);
+    }
+}
+
+int requestCountOf(const ParkingSystem& system) {
+    return system.getRequests().getCount();
+}
+
+template <typename Topology>
+int requestCountOf(const FixedParkingSystem<Topology>& system) {
+    return system.getRequestCount();
+}
+
+// Drives one system through the --fixed-check op stream. Every choice
+// depends only on the seed and on state both systems must agree on, so
+// each can be driven alone for timing. rollbackDepth mirrors the fixed
+// system's bounded stack, which limits how far either may be rolled back.
+template <typename Topology>
+struct FixedCheckDriver {
+    unsigned int seed;
+    int parked[Topology::requestCapacity];      // ring of parked request IDs, oldest at first
+    int first;
+    int parkedCount;
+    int rollbackDepth;
+    char vehicleId[16];
+
+    FixedCheckDriver() : seed(2024), first(0), parkedCount(0), rollbackDepth(0) {}
+
+    unsigned int next() {
+        seed = seed * 1103515245 + 12345;
+        return seed >> 16;
+    }
+
+    // Returns the request the op created or touched, 0 for a rollback
+    template <typename System>
+    int step(System& system, long long op) {
+        const int capacity = Topology::requestCapacity;
+        const int zoneCount = (int)(sizeof(Topology::zones) / sizeof(Topology::zones[0]));
+        int roll = (int)(next() % 100);
+        if (roll < 55 || requestCountOf(system) == 0) {
+            // Free the record the fixed system would reuse, so it never refuses
+            int oldest = requestCountOf(system) + 1 - capacity;
+            if (oldest >= 1 && system.findRequest(oldest)->getState() == OCCUPIED) {
+                system.releaseParking(oldest);
+            }
+            int choice = (int)(next() % (zoneCount * 8 + 1));
+            int zone = choice < zoneCount * 8 ? Topology::zones[choice % zoneCount].zoneId : 999;
+            unsigned int kind = next();
+            SlotClass slotClass = kind % 10 < 6 ? SLOT_STANDARD : (SlotClass)(1 + kind % 4);
+            snprintf(vehicleId, sizeof(vehicleId), "FX%06lld", op % 100000);
+            auto* request = system.createRequest(vehicleId, zone, slotClass, (kind >> 4) % 2 == 0);
+            if (request->getState() == OCCUPIED) {
+                if (parkedCount == capacity) {
+                    first = (first + 1) % capacity;
+                    parkedCount--;
+                }
+                parked[(first + parkedCount++) % capacity] = request->getRequestId();
+                if (rollbackDepth < Topology::rollbackCapacity) rollbackDepth++;
+            }
+            return request->getRequestId();
+        }
+        if (roll < 80) {
+            if (parkedCount == 0) return 0;
+            int requestId = parked[first];
+            first = (first + 1) % capacity;
+            parkedCount--;
+            system.releaseParking(requestId);
+            return requestId;
+        }
+        if (roll < 90) {
+            int count = requestCountOf(system);
+            int requestId = count - (int)(next() % 16);
+            if (requestId < 1) requestId = 1;
+            system.cancelRequest(requestId);
+            return requestId;
+        }
+        int k = 1 + (int)(next() % 3);
+        if (k <= rollbackDepth && system.rollbackAllocations(k)) {
+            rollbackDepth -= k;
+        }
+        return 0;
+    }
+};
+
+bool sameRequest(const ParkingRequest* dynamic, const FixedRequest* fixed) {
+    double distanceGap = dynamic->getCrossZoneDistance() - fixed->getCrossZoneDistance();
+    return dynamic->getRequestId() == fixed->getRequestId() &&
+           dynamic->getState() == fixed->getState() &&
+           dynamic->getAllocatedZone() == fixed->getAllocatedZone() &&
+           dynamic->getAllocatedSlotId() == fixed->getAllocatedSlotId() &&
+           dynamic->hasCrossZonePenalty() == fixed->hasCrossZonePenalty() &&
+           distanceGap < 1e-4 && distanceGap > -1e-4 &&
+           dynamic->getRequestTime() == fixed->getRequestTime() &&
+           dynamic->getAllocationTime() == fixed->getAllocationTime() &&
+           dynamic->getReleaseTime() == fixed->getReleaseTime() &&
+           strncmp(dynamic->getVehicleId(), fixed->getVehicleId(), FIXED_PLATE_BYTES - 1) == 0;
+}
+
+// Runs one op stream against a first-fit ParkingSystem and the fixed build
+// of the same lot, comparing every request touched and every zone's free
+// count, then times each alone. Returns the number of mismatches.
+template <typename Topology>
+long long runFixedCheck(const char* name, long long ops) {
+    typedef FixedParkingSystem<Topology> Fixed;
+    static Fixed checked;
+    static Fixed timed;
+
+    long long trackedBefore = MemoryStats::totalLiveBytes();
+    ParkingSystem system(Fixed::ZONE_COUNT, POLICY_FIRST_FIT);
+    buildFixedTopology<Topology>(system);
+
+    FixedCheckDriver<Topology>* dynamicDriver = new FixedCheckDriver<Topology>();
+    FixedCheckDriver<Topology>* fixedDriver = new FixedCheckDriver<Topology>();
+    long long mismatches = 0;
+    for (long long op = 0; op < ops; op++) {
+        int requestId = dynamicDriver->step(system, op);
+        int fixedRequestId = fixedDriver->step(checked, op);
+        bool same = requestId == fixedRequestId;
+        // Records the ring has reused are no longer comparable
+        const FixedRequest* kept = requestId > 0 ? checked.findRequest(requestId) : nullptr;
+        if (same && kept != nullptr) {
+            same = sameRequest(system.findRequest(requestId), kept);
+        }
+        for (int z = 0; same && z < Fixed::ZONE_COUNT; z++) {
+            int zoneId = Topology::zones[z].zoneId;
+            same = system.getZone(zoneId)->getAvailableSlots() == checked.getAvailableSlots(zoneId);
+        }
+        if (!same) {
+            if (mismatches < 5) {
+                cout << "  MISMATCH at op " << op << " (request " << requestId << ")\n";
+            }
+            mismatches++;
+        }
+    }
+    long long trackedBytes = MemoryStats::totalLiveBytes() - trackedBefore;
+    delete dynamicDriver;
+    delete fixedDriver;
+
+    ParkingSystem timedSystem(Fixed::ZONE_COUNT, POLICY_FIRST_FIT);
+    buildFixedTopology<Topology>(timedSystem);
+    FixedCheckDriver<Topology>* driver = new FixedCheckDriver<Topology>();
+    long long start = EngineStats::now();
+    for (long long op = 0; op < ops; op++) {
+        driver->step(timedSystem, op);
+    }
+    long long dynamicNanos = EngineStats::now() - start;
+    delete driver;
+
+    driver = new FixedCheckDriver<Topology>();
+    start = EngineStats::now();
+    for (long long op = 0; op < ops; op++) {
+        driver->step(timed, op);
+    }
+    long long fixedNanos = EngineStats::now() - start;
+    delete driver;
+
+    cout << "Fixed check: " << name << ", " << Fixed::ZONE_COUNT << " zones, " << Fixed::SLOT_COUNT
+         << " slots, " << ops << " ops\n";
+    cout << "  ParkingSystem:      " << (ops > 0 ? dynamicNanos / ops : 0) << " ns/op, "
+         << trackedBytes << " bytes tracked on the heap\n";
+    cout << "  FixedParkingSystem: " << (ops > 0 ? fixedNanos / ops : 0) << " ns/op, "
+         << sizeof(Fixed) << " bytes static, no heap\n";
+    cout << "  " << mismatches << " mismatches\n";
+    return mismatches;
+}
+
+int runFixedChecks(long long ops) {
+    long long mismatches = runFixedCheck<DefaultLotTopology>("default lot", ops);
+    mismatches += runFixedCheck<MixedLotTopology>("mixed lot", ops);
+    mismatches += runFixedCheck<StreetLotTopology>("street lot", ops);
+    cout << (mismatches == 0 ? "PASS" : "FAIL") << "\n";
+    return mismatches == 0 ? 0 : 1;
+}
+
+int main(int argc, char* argv[]) {
+    const char* recordPath = nullptr;
+    const char* replayPath = nullptr;
+    const char* simulateTerms = nullptr;
+    const char* diffPath = nullptr;
+    const char* batchPath = nullptr;
+    bool batchMode = false;
+    int servePort = 0;
+    int benchPort = 0;
+    int benchConnections = 0;
+    double benchSeconds = 0;
+    LoadTestMode benchMode = LOAD_READ;
+    long long policyBenchOps = 0;
+    long long memoryCheckCycles = 0;
+    long long fixedCheckOps = 0;
+    int forkShards = 0;
+    ShardSpec* shardSpecs = new ShardSpec[argc];
+    int shardSpecCount = 0;
+    ShardSpec workerSpec = {nullptr, 0, 0};
+    const char* replicaPath = nullptr;
+    const char* gateAddress = nullptr;
+    const char* gateBenchAddress = nullptr;
+    int gateBenchConnections = 0;
+    double gateBenchSeconds = 0;
+    int gateBenchBatch = 64;
+    int gateBenchDepth = 4;
+    int gateBenchLease = 0;
+    bool compareSet = false;
+    RunOptions options = {0, 0, 0, false, false, STATS_JSON, POLICY_FIRST_FIT, POLICY_FIRST_FIT,
+                          nullptr, 0, WAITLIST_OFF, false, nullptr, nullptr, "", 0, 0};
+    
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--record") == 0 && i + 1 < argc) {
+            recordPath = argv[++i];
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--simulate") == 0) {
+            simulateTerms = "";
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                simulateTerms = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--diff") == 0 && i + 1 < argc) {
+            diffPath = argv[++i];
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batchMode = true;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                batchPath = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--serve") == 0) {
+            servePort = 8080;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                servePort = atoi(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--http-bench") == 0 && i + 3 < argc) {
+            benchPort = atoi(argv[i + 1]);
+            benchConnections = atoi(argv[i + 2]);
+            benchSeconds = atof(argv[i + 3]);
+            i += 3;
+            if (i + 1 < argc && strcmp(argv[i + 1], "write") == 0) {
+                benchMode = LOAD_WRITE;
+                i++;
+            } else if (i + 1 < argc && strcmp(argv[i + 1], "read") == 0) {
+                i++;
+            }
+        } else if (strcmp(argv[i], "--gate") == 0 && i + 1 < argc) {
+            gateAddress = argv[++i];
+        } else if (strcmp(argv[i], "--gate-bench") == 0 && i + 3 < argc) {
+            gateBenchAddress = argv[i + 1];
+            gateBenchConnections = atoi(argv[i + 2]);
+            gateBenchSeconds = atof(argv[i + 3]);
+            i += 3;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                gateBenchBatch = atoi(argv[++i]);
+                if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                    gateBenchDepth = atoi(argv[++i]);
+                    if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                        gateBenchLease = atoi(argv[++i]);
+                    }
+                }
+            }
+            if (gateBenchConnections <= 0 || gateBenchBatch <= 0 || gateBenchBatch > GATE_MAX_BATCH ||
+                gateBenchDepth <= 0 || gateBenchLease < 0 || gateBenchLease > LEASE_MAX_SLOTS) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--grid") == 0 && i + 3 < argc) {
+            options.gridZones = atoi(argv[i + 1]);
+            options.gridAreas = atoi(argv[i + 2]);
+            options.gridSlots = atoi(argv[i + 3]);
+            i += 3;
+            if (options.gridZones <= 0 || options.gridAreas <= 0 || options.gridSlots <= 0 ||
+                options.gridZones * 1000000LL + (long long)options.gridAreas * options.gridSlots > INT_MAX) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--slot-mix") == 0) {
+            options.slotMix = true;
+        } else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc &&
+                   parseStatsFormat(argv[i + 1], options.statsFormat)) {
+            options.dumpStats = true;
+            i++;
+        } else if (strcmp(argv[i], "--policy") == 0 && i + 1 < argc &&
+                   AllocationEngine::parsePolicy(argv[i + 1], options.policy)) {
+            i++;
+        } else if (strcmp(argv[i], "--against") == 0 && i + 1 < argc &&
+                   AllocationEngine::parsePolicy(argv[i + 1], options.comparePolicy)) {
+            compareSet = true;
+            i++;
+        } else if (strcmp(argv[i], "--waitlist") == 0 && i + 1 < argc &&
+                   Waitlist::parseMode(argv[i + 1], options.waitlist)) {
+            i++;
+        } else if (strcmp(argv[i], "--affinity") == 0 && i + 1 < argc) {
+            options.affinity = atoi(argv[++i]);
+            if (options.affinity <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--occupancy") == 0) {
+            options.occupancy = true;
+        } else if (strcmp(argv[i], "--query") == 0 && i + 1 < argc) {
+            options.historyQuery = argv[++i];
+        } else if (strcmp(argv[i], "--export") == 0 && i + 1 < argc) {
+            options.exportPath = argv[++i];
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                options.exportTerms = argv[++i];
+            }
+        } else if (strcmp(argv[i], "--query-threads") == 0 && i + 1 < argc) {
+            options.queryThreads = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--replicate") == 0 && i + 1 < argc) {
+            options.replicatePath = argv[++i];
+        } else if (strcmp(argv[i], "--replica") == 0 && i + 1 < argc) {
+            replicaPath = argv[++i];
+        } else if (strcmp(argv[i], "--shards") == 0 && i + 1 < argc) {
+            forkShards = atoi(argv[++i]);
+            if (forkShards <= 0) {
+                printUsage(argv[0]);
+                return 1;
+            }
+        } else if ((strcmp(argv[i], "--shard") == 0 || strcmp(argv[i], "--shard-worker") == 0) &&
+                   i + 3 < argc) {
+            ShardSpec spec = {argv[i + 1], atoi(argv[i + 2]), atoi(argv[i + 3])};
+            if (strcmp(argv[i], "--shard") == 0) {
+                shardSpecs[shardSpecCount++] = spec;
+            } else {
+                workerSpec = spec;
+            }
+            i += 3;
+        } else if (strcmp(argv[i], "--memory-report") == 0 && i + 1 < argc) {
+            options.memoryReport = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--memory-check") == 0) {
+            memoryCheckCycles = 100000;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                memoryCheckCycles = atoll(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--fixed-check") == 0) {
+            fixedCheckOps = 200000;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                fixedCheckOps = atoll(argv[++i]);
+            }
+        } else if (strcmp(argv[i], "--policy-bench") == 0) {
+            policyBenchOps = 1000000;
+            if (i + 1 < argc && strncmp(argv[i + 1], "--", 2) != 0) {
+                policyBenchOps = atoll(argv[++i]);
+            }
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    
+    if (!compareSet) {
+        options.comparePolicy = options.policy;
+    }
+    
+    if (options.historyQuery != nullptr) {
+        HistoryQuery query;
+        char error[96];
+        if (!query.parse(options.historyQuery, (int)strlen(options.historyQuery), error, sizeof(error))) {
+            cout << "ERROR: --query " << error << "\n";
+            return 1;
+        }
+    }
+    
+    if (options.exportPath != nullptr) {
+        ExportOptions exportOptions;
+        char error[96];
+        if (!exportOptions.parse(options.exportTerms, (int)strlen(options.exportTerms), error, sizeof(error))) {
+            cout << "ERROR: --export " << error << "\n";
+            return 1;
+        }
+    }
+    if (policyBenchOps > 0) {
+        return runPolicyBench(policyBenchOps, options);
+    }
+    if (memoryCheckCycles > 0) {
+        return runMemoryCheck(memoryCheckCycles, options);
+    }
+    if (fixedCheckOps > 0) {
+        return runFixedChecks(fixedCheckOps);
+    }
+    if (replayPath != nullptr) {
+        return replayTrace(replayPath, options);
+    }
+    if (diffPath != nullptr) {
+        return diffTrace(diffPath, options);
+    }
+    if (simulateTerms != nullptr) {
+        SimConfig config;
+        char error[96];
+        if (!config.parse(simulateTerms, error, sizeof(error))) {
+            cout << "ERROR: --simulate " << error << "\n";
+            return 1;
+        }
+        if (options.waitlist != WAITLIST_OFF) {
+            cout << "ERROR: --waitlist is not supported with --simulate\n";
+            return 1;
+        }
+        return runSimulation(config, options);
+    }
+    if (replicaPath != nullptr) {
+        return runReplica(replicaPath, servePort > 0 ? servePort : 8081, options);
+    }
+    if (options.waitlist != WAITLIST_OFF &&
+        (workerSpec.path != nullptr || forkShards > 0 || shardSpecCount > 0)) {
+        cout << "ERROR: --waitlist is not supported with sharded zones\n";
+        return 1;
+    }
+    if (workerSpec.path != nullptr) {
+        return runShardWorker(workerSpec.path, workerSpec.firstZone, workerSpec.lastZone, options);
+    }
+    if (batchMode && (forkShards > 0 || shardSpecCount > 0)) {
+        return runShardedBatch(batchPath, forkShards, shardSpecs, shardSpecCount, options);
+    }
+    if (batchMode) {
+        return runBatch(batchPath, options);
+    }
+    if (servePort > 0) {
+        return runServer(servePort, options);
+    }
+    if (gateAddress != nullptr) {
+        return runGate(gateAddress, options);
+    }
+    if (benchPort > 0) {
+        return runHttpBench(benchPort, benchConnections, benchSeconds, benchMode);
+    }
+    if (gateBenchAddress != nullptr) {
+        return runGateBench(gateBenchAddress, gateBenchConnections, gateBenchSeconds, gateBenchBatch,
+                            gateBenchDepth, gateBenchLease);
+    }
+    
+    ParkingSystem system(5, options.policy);
+    TraceRecorder recorder;
+    if (recordPath != nullptr) {
+        if (!recorder.open(recordPath)) {
+            cout << "ERROR: Cannot open trace file " << recordPath << "\n";
+            return 1;
+        }
+        system.setTraceRecorder(&recorder);
+    }
     
     cout << "\n========================================\n";
     cout << "  SMART PARKING ALLOCATION SYSTEM\n";
@@ -353,6 +1620,8 @@ int main() {
     cout << "========================================\n";
     
     initializeSystem(system);
+    system.enableWaitlist(options.waitlist);
+    system.enableAffinity(options.affinity);
     
     int choice;
     bool running = true;
@@ -408,5 +1677,8 @@ int main() {
         }
     }
     
+    if (options.dumpStats) {
+        system.dumpStats(cout, options.statsFormat);
+    }
     return 0;
 }
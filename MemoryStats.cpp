@@ -0,0 +1,133 @@
+#include "MemoryStats.h"
+#include <atomic>
+#include <cstdio>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+
+static std::atomic<long long> liveBytes[MEMORY_SUBSYSTEM_COUNT];
+static std::atomic<long long> liveObjects[MEMORY_SUBSYSTEM_COUNT];
+static std::atomic<long long> peakBytes[MEMORY_SUBSYSTEM_COUNT];
+
+void MemoryStats::allocated(MemorySubsystem subsystem, long long bytes, long long objects) {
+    long long live = liveBytes[subsystem].fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (objects != 0) {
+        liveObjects[subsystem].fetch_add(objects, std::memory_order_relaxed);
+    }
+    long long seen = peakBytes[subsystem].load(std::memory_order_relaxed);
+    while (live > seen &&
+           !peakBytes[subsystem].compare_exchange_weak(seen, live, std::memory_order_relaxed)) {
+    }
+}
+
+void MemoryStats::freed(MemorySubsystem subsystem, long long bytes, long long objects) {
+    liveBytes[subsystem].fetch_sub(bytes, std::memory_order_relaxed);
+    if (objects != 0) {
+        liveObjects[subsystem].fetch_sub(objects, std::memory_order_relaxed);
+    }
+}
+
+void* MemoryStats::allocateObject(MemorySubsystem subsystem, std::size_t size) {
+    void* pointer = ::operator new(size);
+    allocated(subsystem, (long long)size, 1);
+    return pointer;
+}
+
+void MemoryStats::freeObject(MemorySubsystem subsystem, void* pointer, std::size_t size) {
+    freed(subsystem, (long long)size, 1);
+    ::operator delete(pointer);
+}
+
+MemoryUsage MemoryStats::get(MemorySubsystem subsystem) {
+    MemoryUsage usage;
+    usage.liveBytes = liveBytes[subsystem].load(std::memory_order_relaxed);
+    usage.objects = liveObjects[subsystem].load(std::memory_order_relaxed);
+    usage.peakBytes = peakBytes[subsystem].load(std::memory_order_relaxed);
+    return usage;
+}
+
+long long MemoryStats::totalLiveBytes() {
+    long long total = 0;
+    for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+        total += liveBytes[i].load(std::memory_order_relaxed);
+    }
+    return total;
+}
+
+long long MemoryStats::residentBytes() {
+    FILE* file = fopen("/proc/self/statm", "r");
+    if (file == nullptr) {
+        return 0;
+    }
+    long long pages = 0;
+    long long resident = 0;
+    int read = fscanf(file, "%lld %lld", &pages, &resident);
+    fclose(file);
+    if (read != 2) {
+        return 0;
+    }
+    return resident * (long long)sysconf(_SC_PAGESIZE);
+}
+
+void MemoryStats::write(std::ostream& out, StatsFormat format) {
+    if (format == STATS_PROMETHEUS) {
+        out << "# TYPE parking_memory_live_bytes gauge\n";
+        for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+            out << "parking_memory_live_bytes{subsystem=\"" << subsystemName((MemorySubsystem)i)
+                << "\"} " << get((MemorySubsystem)i).liveBytes << "\n";
+        }
+        out << "# TYPE parking_memory_objects gauge\n";
+        for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+            out << "parking_memory_objects{subsystem=\"" << subsystemName((MemorySubsystem)i)
+                << "\"} " << get((MemorySubsystem)i).objects << "\n";
+        }
+        out << "# TYPE parking_memory_peak_bytes gauge\n";
+        for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+            out << "parking_memory_peak_bytes{subsystem=\"" << subsystemName((MemorySubsystem)i)
+                << "\"} " << get((MemorySubsystem)i).peakBytes << "\n";
+        }
+        out << "# TYPE parking_memory_resident_bytes gauge\n";
+        out << "parking_memory_resident_bytes " << residentBytes() << "\n";
+        return;
+    }
+
+    out << "{\"subsystems\":{";
+    for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+        MemoryUsage usage = get((MemorySubsystem)i);
+        if (i > 0) out << ",";
+        out << "\"" << subsystemName((MemorySubsystem)i) << "\":{\"liveBytes\":" << usage.liveBytes
+            << ",\"objects\":" << usage.objects << ",\"peakBytes\":" << usage.peakBytes << "}";
+    }
+    out << "},\"trackedBytes\":" << totalLiveBytes()
+        << ",\"residentBytes\":" << residentBytes() << "}";
+}
+
+void MemoryStats::printReport(std::ostream& out) {
+    out << std::left << std::setw(10) << "subsystem" << std::right
+        << std::setw(14) << "live bytes" << std::setw(12) << "objects"
+        << std::setw(14) << "peak bytes" << "\n";
+    for (int i = 0; i < MEMORY_SUBSYSTEM_COUNT; i++) {
+        MemoryUsage usage = get((MemorySubsystem)i);
+        out << std::left << std::setw(10) << subsystemName((MemorySubsystem)i) << std::right
+            << std::setw(14) << usage.liveBytes << std::setw(12) << usage.objects
+            << std::setw(14) << usage.peakBytes << "\n";
+    }
+    out << std::left << std::setw(10) << "tracked" << std::right
+        << std::setw(14) << totalLiveBytes() << "\n";
+    out << std::left << std::setw(10) << "resident" << std::right
+        << std::setw(14) << residentBytes() << "\n";
+}
+
+const char* MemoryStats::subsystemName(MemorySubsystem subsystem) {
+    switch (subsystem) {
+        case MEMORY_REQUESTS: return "requests";
+        case MEMORY_STRINGS: return "strings";
+        case MEMORY_HISTORY: return "history";
+        case MEMORY_ROLLBACK: return "rollback";
+        case MEMORY_TOPOLOGY: return "topology";
+        case MEMORY_WAITLIST: return "waitlist";
+        case MEMORY_AFFINITY: return "affinity";
+        case MEMORY_HOLDS: return "holds";
+        default: return "unknown";
+    }
+}
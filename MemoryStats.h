@@ -0,0 +1,77 @@
+#ifndef MEMORYSTATS_H
+#define MEMORYSTATS_H
+
+#include <cstddef>
+#include <iosfwd>
+#include "EngineStats.h"
+
+enum MemorySubsystem {
+    MEMORY_REQUESTS,        // request records and the request -> slot index
+    MEMORY_STRINGS,         // interned plates
+    MEMORY_HISTORY,         // change feed and occupancy series
+    MEMORY_ROLLBACK,        // undo records, drains included
+    MEMORY_TOPOLOGY,        // zones, areas, slots and the indexes over them
+    MEMORY_WAITLIST,
+    MEMORY_AFFINITY,        // remembered slots of returning vehicles
+    MEMORY_HOLDS,           // cross-shard reservations and gate leases
+    MEMORY_SUBSYSTEM_COUNT
+};
+
+struct MemoryUsage {
+    long long liveBytes;
+    long long objects;
+    long long peakBytes;
+};
+
+// Process-wide accounting of what the parking structures allocate, by
+// subsystem. Like EngineStats the counters are relaxed atomics; the
+// high-water mark is raised with a compare-and-swap. Objects count the
+// things a subsystem holds (requests, plates, records, slots), not blocks.
+class MemoryStats {
+public:
+    static void allocated(MemorySubsystem subsystem, long long bytes, long long objects = 0);
+    static void freed(MemorySubsystem subsystem, long long bytes, long long objects = 0);
+    // One counted object's worth of raw storage
+    static void* allocateObject(MemorySubsystem subsystem, std::size_t size);
+    static void freeObject(MemorySubsystem subsystem, void* pointer, std::size_t size);
+
+    static MemoryUsage get(MemorySubsystem subsystem);
+    static long long totalLiveBytes();
+    // Resident set of the whole process, from /proc; 0 where unavailable
+    static long long residentBytes();
+
+    static void write(std::ostream& out, StatsFormat format);
+    static void printReport(std::ostream& out);
+    static const char* subsystemName(MemorySubsystem subsystem);
+};
+
+// new[] / delete[] charged to a subsystem; the count freed must be the
+// count allocated
+template <typename T>
+T* trackedArray(MemorySubsystem subsystem, long long count) {
+    MemoryStats::allocated(subsystem, count * (long long)sizeof(T));
+    return new T[count];
+}
+
+template <typename T>
+void trackedFree(MemorySubsystem subsystem, T* array, long long count) {
+    if (array == nullptr) {
+        return;
+    }
+    MemoryStats::freed(subsystem, count * (long long)sizeof(T));
+    delete[] array;
+}
+
+// Base for classes whose heap instances are counted, one object each
+template <MemorySubsystem Subsystem>
+class Tracked {
+public:
+    static void* operator new(std::size_t size) {
+        return MemoryStats::allocateObject(Subsystem, size);
+    }
+    static void operator delete(void* pointer, std::size_t size) {
+        MemoryStats::freeObject(Subsystem, pointer, size);
+    }
+};
+
+#endif
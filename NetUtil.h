@@ -0,0 +1,19 @@
+#ifndef NETUTIL_H
+#define NETUTIL_H
+
+// Thin helpers over the POSIX socket calls shared by the servers and load
+// generators. All return -1 on failure.
+bool setNonBlocking(int fd);
+void setNoDelay(int fd);
+int listenTcp(int port, int backlog = 1024);
+int connectTcp(const char* host, int port);
+int listenUnix(const char* path, int backlog = 1024);
+int connectUnix(const char* path);
+// A port number is loopback TCP, anything else a Unix socket path
+bool isPortNumber(const char* address);
+int listenAddress(const char* address, int backlog = 1024);
+int connectAddress(const char* address);
+bool writeFully(int fd, const char* data, int len);
+bool readFully(int fd, char* data, int len);
+
+#endif
@@ -0,0 +1,399 @@
+#include "OccupancySeries.h"
+#include <climits>
+#include <ctime>
+#include "MemoryStats.h"
+
+static void initRollup(OccupancyRollup& rollup, long long width, int limit) {
+    rollup.width = width;
+    rollup.limit = limit;
+    rollup.buckets = nullptr;
+    rollup.allocated = 0;
+    rollup.firstBucket = 0;
+    rollup.nextBucket = 0;
+    rollup.openStart = 0;
+    rollup.accumulatedTo = 0;
+    rollup.area = 0;
+    rollup.min = 0;
+    rollup.max = 0;
+}
+
+static void startRollup(OccupancyRollup& rollup, long long time, int value) {
+    rollup.firstBucket = time / rollup.width;
+    rollup.nextBucket = rollup.firstBucket;
+    rollup.openStart = time;
+    rollup.accumulatedTo = time;
+    rollup.area = 0;
+    rollup.min = value;
+    rollup.max = value;
+}
+
+static void ensureBytes(unsigned char*& data, int& capacity, int used, int needed) {
+    if (used + needed <= capacity) return;
+    int newCapacity = capacity > 0 ? capacity * 2 : 256;
+    while (newCapacity < used + needed) newCapacity *= 2;
+    unsigned char* grown = trackedArray<unsigned char>(MEMORY_HISTORY, newCapacity);
+    for (int i = 0; i < used; i++) {
+        grown[i] = data[i];
+    }
+    trackedFree(MEMORY_HISTORY, data, capacity);
+    data = grown;
+    capacity = newCapacity;
+}
+
+static int writeVarint(unsigned char* out, unsigned long long value) {
+    int len = 0;
+    while (value >= 0x80) {
+        out[len++] = (unsigned char)(value & 0x7F) | 0x80;
+        value >>= 7;
+    }
+    out[len++] = (unsigned char)value;
+    return len;
+}
+
+static unsigned long long readVarint(const unsigned char*& p) {
+    unsigned long long value = 0;
+    int shift = 0;
+    while (*p & 0x80) {
+        value |= (unsigned long long)(*p++ & 0x7F) << shift;
+        shift += 7;
+    }
+    value |= (unsigned long long)*p++ << shift;
+    return value;
+}
+
+OccupancySeries::OccupancySeries() : zones(nullptr), zoneCapacity(0) {}
+
+OccupancySeries::~OccupancySeries() {
+    for (int i = 0; i < zoneCapacity; i++) {
+        for (int b = 0; b < OCCUPANCY_RAW_BLOCKS; b++) {
+            trackedFree(MEMORY_HISTORY, zones[i].blocks[b].times, zones[i].blocks[b].timeCapacity);
+            trackedFree(MEMORY_HISTORY, zones[i].blocks[b].values, zones[i].blocks[b].valueCapacity);
+        }
+        trackedFree(MEMORY_HISTORY, zones[i].minutes.buckets, zones[i].minutes.allocated);
+        trackedFree(MEMORY_HISTORY, zones[i].hours.buckets, zones[i].hours.allocated);
+    }
+    trackedFree(MEMORY_HISTORY, zones, zoneCapacity);
+}
+
+long long OccupancySeries::nowMillis() {
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+void OccupancySeries::coverZone(int zonePosition) {
+    if (zonePosition < zoneCapacity) return;
+    int newCapacity = zoneCapacity > 0 ? zoneCapacity * 2 : 16;
+    while (newCapacity <= zonePosition) newCapacity *= 2;
+    ZoneOccupancy* grown = trackedArray<ZoneOccupancy>(MEMORY_HISTORY, newCapacity);
+    for (int i = 0; i < newCapacity; i++) {
+        if (i < zoneCapacity) {
+            grown[i] = zones[i];
+            continue;
+        }
+        ZoneOccupancy& zone = grown[i];
+        zone.started = false;
+        zone.lastTime = 0;
+        zone.lastValue = 0;
+        zone.firstBlock = 0;
+        zone.blockCount = 0;
+        for (int b = 0; b < OCCUPANCY_RAW_BLOCKS; b++) {
+            zone.blocks[b].times = nullptr;
+            zone.blocks[b].timeCapacity = 0;
+            zone.blocks[b].values = nullptr;
+            zone.blocks[b].valueCapacity = 0;
+        }
+        initRollup(zone.minutes, OCCUPANCY_MINUTE, OCCUPANCY_MINUTE_BUCKETS);
+        initRollup(zone.hours, OCCUPANCY_HOUR, OCCUPANCY_HOUR_BUCKETS);
+    }
+    trackedFree(MEMORY_HISTORY, zones, zoneCapacity);
+    zones = grown;
+    zoneCapacity = newCapacity;
+}
+
+// The oldest block is recycled once the ring is full
+void OccupancySeries::appendRaw(ZoneOccupancy& zone, long long time, int value) {
+    OccupancyBlock* block = nullptr;
+    if (zone.blockCount > 0) {
+        block = &zone.blocks[(zone.firstBlock + zone.blockCount - 1) % OCCUPANCY_RAW_BLOCKS];
+    }
+    if (block == nullptr || block->count == OCCUPANCY_BLOCK_POINTS) {
+        if (zone.blockCount == OCCUPANCY_RAW_BLOCKS) {
+            zone.firstBlock = (zone.firstBlock + 1) % OCCUPANCY_RAW_BLOCKS;
+            zone.blockCount--;
+        }
+        block = &zone.blocks[(zone.firstBlock + zone.blockCount) % OCCUPANCY_RAW_BLOCKS];
+        zone.blockCount++;
+        block->firstTime = time;
+        block->lastTime = time;
+        block->firstValue = value;
+        block->lastValue = value;
+        block->count = 1;
+        block->timeBytes = 0;
+        block->valueBytes = 0;
+        return;
+    }
+
+    ensureBytes(block->times, block->timeCapacity, block->timeBytes, 10);
+    ensureBytes(block->values, block->valueCapacity, block->valueBytes, 5);
+    block->timeBytes += writeVarint(block->times + block->timeBytes,
+                                    (unsigned long long)(time - block->lastTime));
+    int delta = value - block->lastValue;
+    block->valueBytes += writeVarint(block->values + block->valueBytes,
+                                     ((unsigned int)delta << 1) ^ (unsigned int)(delta >> 31));
+    block->lastTime = time;
+    block->lastValue = value;
+    block->count++;
+}
+
+void OccupancySeries::closeBucket(OccupancyRollup& rollup) {
+    long long index = rollup.nextBucket - rollup.firstBucket;
+    if (index >= rollup.allocated && rollup.allocated < rollup.limit) {
+        int newAllocated = rollup.allocated > 0 ? rollup.allocated * 2 : 64;
+        while (newAllocated <= index && newAllocated < rollup.limit) newAllocated *= 2;
+        if (newAllocated > rollup.limit) newAllocated = rollup.limit;
+        OccupancyBucket* grown = trackedArray<OccupancyBucket>(MEMORY_HISTORY, newAllocated);
+        for (int i = 0; i < rollup.allocated; i++) {
+            grown[i] = rollup.buckets[i];
+        }
+        trackedFree(MEMORY_HISTORY, rollup.buckets, rollup.allocated);
+        rollup.buckets = grown;
+        rollup.allocated = newAllocated;
+    }
+    OccupancyBucket& bucket = rollup.buckets[index % rollup.limit];
+    bucket.average = (float)(rollup.area / (rollup.accumulatedTo - rollup.openStart));
+    bucket.min = rollup.min;
+    bucket.max = rollup.max;
+    rollup.nextBucket++;
+}
+
+// Closes every bucket that ended by 'time'; the value in between was lastValue
+void OccupancySeries::advance(OccupancyRollup& rollup, long long time, int lastValue) {
+    long long bucket = time / rollup.width;
+    if (bucket - rollup.nextBucket > rollup.limit) {
+        // Anything older than the window would be overwritten anyway
+        rollup.nextBucket = bucket - rollup.limit;
+        rollup.openStart = rollup.nextBucket * rollup.width;
+        rollup.accumulatedTo = rollup.openStart;
+        rollup.area = 0;
+        rollup.min = lastValue;
+        rollup.max = lastValue;
+    }
+    while (rollup.nextBucket < bucket) {
+        long long end = (rollup.nextBucket + 1) * rollup.width;
+        rollup.area += (double)lastValue * (end - rollup.accumulatedTo);
+        rollup.accumulatedTo = end;
+        closeBucket(rollup);
+        rollup.openStart = end;
+        rollup.area = 0;
+        rollup.min = lastValue;
+        rollup.max = lastValue;
+    }
+    rollup.area += (double)lastValue * (time - rollup.accumulatedTo);
+    rollup.accumulatedTo = time;
+}
+
+void OccupancySeries::record(int zonePosition, long long time, int occupied) {
+    if (zonePosition < 0) return;
+    coverZone(zonePosition);
+    ZoneOccupancy& zone = zones[zonePosition];
+    if (!zone.started) {
+        zone.started = true;
+        zone.lastTime = time;
+        zone.lastValue = occupied;
+        startRollup(zone.minutes, time, occupied);
+        startRollup(zone.hours, time, occupied);
+        appendRaw(zone, time, occupied);
+        return;
+    }
+    if (occupied == zone.lastValue) return;
+    if (time < zone.lastTime) time = zone.lastTime;
+
+    advance(zone.minutes, time, zone.lastValue);
+    advance(zone.hours, time, zone.lastValue);
+    if (occupied < zone.minutes.min) zone.minutes.min = occupied;
+    if (occupied > zone.minutes.max) zone.minutes.max = occupied;
+    if (occupied < zone.hours.min) zone.hours.min = occupied;
+    if (occupied > zone.hours.max) zone.hours.max = occupied;
+    appendRaw(zone, time, occupied);
+    zone.lastTime = time;
+    zone.lastValue = occupied;
+}
+
+// One bucket of a rollup as of 'now': closed, still open, or not yet
+// reached (the last value carried forward)
+bool OccupancySeries::bucketAt(const OccupancyRollup& rollup, long long bucket, long long now,
+                               int lastValue, long long lastTime, OccupancyBucket& out,
+                               long long& covered) {
+    if (bucket < rollup.firstBucket) return false;
+    if (bucket < rollup.nextBucket) {
+        if (rollup.nextBucket - bucket > rollup.limit) return false;
+        out = rollup.buckets[(bucket - rollup.firstBucket) % rollup.limit];
+        covered = rollup.width;
+        return true;
+    }
+    long long start = bucket * rollup.width;
+    long long end = start + rollup.width;
+    if (end > now) end = now;
+    if (bucket == rollup.nextBucket) {
+        if (end < rollup.accumulatedTo) end = rollup.accumulatedTo;
+        if (end <= rollup.openStart) return false;
+        double area = rollup.area + (double)lastValue * (end - rollup.accumulatedTo);
+        out.average = (float)(area / (end - rollup.openStart));
+        out.min = rollup.min;
+        out.max = rollup.max;
+        covered = end - rollup.openStart;
+        return true;
+    }
+    if (end <= start || start < lastTime) return false;
+    out.average = (float)lastValue;
+    out.min = lastValue;
+    out.max = lastValue;
+    covered = end - start;
+    return true;
+}
+
+int OccupancySeries::rollupQuery(const ZoneOccupancy& zone, const OccupancyRollup& rollup,
+                                 long long from, long long to, long long step, long long now,
+                                 OccupancyPoint* out, int maxPoints) {
+    int count = 0;
+    for (long long time = from; time < to && count < maxPoints; time += step) {
+        double area = 0;
+        long long covered = 0;
+        int min = INT_MAX;
+        int max = INT_MIN;
+        long long last = (time + step) / rollup.width;
+        for (long long b = time / rollup.width; b < last; b++) {
+            OccupancyBucket bucket;
+            long long bucketCovered;
+            if (!bucketAt(rollup, b, now, zone.lastValue, zone.lastTime, bucket, bucketCovered)) continue;
+            area += (double)bucket.average * bucketCovered;
+            covered += bucketCovered;
+            if (bucket.min < min) min = bucket.min;
+            if (bucket.max > max) max = bucket.max;
+        }
+        if (covered == 0) continue;
+        out[count].time = time;
+        out[count].average = area / covered;
+        out[count].min = min;
+        out[count].max = max;
+        count++;
+    }
+    return count;
+}
+
+// Adds a value held over [start, end) to the steps it overlaps
+static void spread(OccupancyPoint* out, double* area, long long* covered, long long from,
+                   long long step, long long start, long long end, int value) {
+    for (long long s = start; s < end;) {
+        int index = (int)((s - from) / step);
+        long long stepEnd = from + (index + 1) * step;
+        long long until = stepEnd < end ? stepEnd : end;
+        area[index] += (double)value * (until - s);
+        covered[index] += until - s;
+        if (value < out[index].min) out[index].min = value;
+        if (value > out[index].max) out[index].max = value;
+        s = until;
+    }
+}
+
+// Walks the retained changes in order, spreading each value over the steps
+// it was in force for
+int OccupancySeries::rawQuery(const ZoneOccupancy& zone, long long from, long long to, long long step,
+                              long long now, OccupancyPoint* out, int maxPoints) {
+    long long steps = (to - from + step - 1) / step;
+    int n = steps < maxPoints ? (int)steps : maxPoints;
+    if (n <= 0) return 0;
+    long long end = from + n * step;
+    double* area = new double[n];
+    long long* covered = new long long[n];
+    for (int i = 0; i < n; i++) {
+        area[i] = 0;
+        covered[i] = 0;
+        out[i].min = INT_MAX;
+        out[i].max = INT_MIN;
+    }
+
+    bool have = false;
+    long long prevTime = 0;
+    int prevValue = 0;
+    for (int k = 0; k < zone.blockCount; k++) {
+        const OccupancyBlock& block = zone.blocks[(zone.firstBlock + k) % OCCUPANCY_RAW_BLOCKS];
+        if (block.firstTime >= end) break;
+        if (k + 1 < zone.blockCount &&
+            zone.blocks[(zone.firstBlock + k + 1) % OCCUPANCY_RAW_BLOCKS].firstTime <= from) {
+            // Entirely before the range; only its last value carries over
+            have = true;
+            prevTime = block.lastTime;
+            prevValue = block.lastValue;
+            continue;
+        }
+        const unsigned char* times = block.times;
+        const unsigned char* values = block.values;
+        long long time = block.firstTime;
+        int value = block.firstValue;
+        for (int i = 0; i < block.count; i++) {
+            if (i > 0) {
+                time += (long long)readVarint(times);
+                unsigned int zigzag = (unsigned int)readVarint(values);
+                value += (int)((zigzag >> 1) ^ (0u - (zigzag & 1)));
+            }
+            if (have) {
+                spread(out, area, covered, from, step, prevTime > from ? prevTime : from,
+                       time < end ? time : end, prevValue);
+            }
+            if (time >= from && time < end) {
+                int index = (int)((time - from) / step);
+                if (value < out[index].min) out[index].min = value;
+                if (value > out[index].max) out[index].max = value;
+            }
+            have = true;
+            prevTime = time;
+            prevValue = value;
+        }
+    }
+    if (have) {
+        spread(out, area, covered, from, step, prevTime > from ? prevTime : from,
+               now < end ? now : end, prevValue);
+    }
+
+    int count = 0;
+    for (int i = 0; i < n; i++) {
+        if (covered[i] == 0) continue;
+        out[count].time = from + i * step;
+        out[count].average = area[i] / covered[i];
+        out[count].min = out[i].min;
+        out[count].max = out[i].max;
+        count++;
+    }
+    delete[] area;
+    delete[] covered;
+    return count;
+}
+
+int OccupancySeries::query(int zonePosition, long long from, long long to, long long step,
+                           long long now, OccupancyPoint* out, int maxPoints) const {
+    if (zonePosition < 0 || zonePosition >= zoneCapacity || step <= 0 || from < 0) return 0;
+    const ZoneOccupancy& zone = zones[zonePosition];
+    if (!zone.started) return 0;
+    from -= from % step;
+    if (step % OCCUPANCY_HOUR == 0) {
+        return rollupQuery(zone, zone.hours, from, to, step, now, out, maxPoints);
+    }
+    if (step % OCCUPANCY_MINUTE == 0) {
+        return rollupQuery(zone, zone.minutes, from, to, step, now, out, maxPoints);
+    }
+    return rawQuery(zone, from, to, step, now, out, maxPoints);
+}
+
+long long OccupancySeries::getMemoryBytes() const {
+    long long bytes = (long long)sizeof(*this) + (long long)zoneCapacity * sizeof(ZoneOccupancy);
+    for (int i = 0; i < zoneCapacity; i++) {
+        for (int b = 0; b < OCCUPANCY_RAW_BLOCKS; b++) {
+            bytes += zones[i].blocks[b].timeCapacity + zones[i].blocks[b].valueCapacity;
+        }
+        bytes += (long long)(zones[i].minutes.allocated + zones[i].hours.allocated) *
+                 sizeof(OccupancyBucket);
+    }
+    return bytes;
+}
@@ -0,0 +1,109 @@
+#ifndef OCCUPANCYSERIES_H
+#define OCCUPANCYSERIES_H
+
+// Occupied slots per zone over time, in milliseconds since the epoch.
+// Every change is appended to delta-encoded blocks (a time column and a
+// value column of varints), and rolled up into 1-minute and 1-hour
+// buckets holding the time-weighted average, minimum and maximum. Each
+// level keeps a fixed window, so storage is bounded however long it runs:
+//   raw     : the last OCCUPANCY_RAW_BLOCKS blocks of changes per zone
+//   minutes : 31 days
+//   hours   : 400 days
+
+const int OCCUPANCY_BLOCK_POINTS = 4096;
+const int OCCUPANCY_RAW_BLOCKS = 16;
+const long long OCCUPANCY_MINUTE = 60000;
+const long long OCCUPANCY_HOUR = 3600000;
+const int OCCUPANCY_MINUTE_BUCKETS = 31 * 24 * 60;
+const int OCCUPANCY_HOUR_BUCKETS = 400 * 24;
+
+struct OccupancyBlock {
+    long long firstTime;
+    long long lastTime;
+    int firstValue;
+    int lastValue;
+    int count;
+    unsigned char* times;       // varint deltas from the previous point
+    int timeBytes;
+    int timeCapacity;
+    unsigned char* values;      // zigzag varint deltas from the previous point
+    int valueBytes;
+    int valueCapacity;
+};
+
+struct OccupancyBucket {
+    float average;
+    int min;
+    int max;
+};
+
+// One rollup resolution. Closed buckets run contiguously from firstBucket
+// up to nextBucket; quiet periods are filled with the value carried over.
+// The bucket array grows by doubling up to limit and is then a ring.
+struct OccupancyRollup {
+    long long width;
+    int limit;
+    OccupancyBucket* buckets;
+    int allocated;
+    long long firstBucket;
+    long long nextBucket;       // the open bucket
+    long long openStart;        // when the open bucket's data starts
+    long long accumulatedTo;
+    double area;                // value x milliseconds since openStart
+    int min;
+    int max;
+};
+
+struct ZoneOccupancy {
+    bool started;
+    long long lastTime;
+    int lastValue;
+    OccupancyBlock blocks[OCCUPANCY_RAW_BLOCKS];    // ring, oldest at firstBlock
+    int firstBlock;
+    int blockCount;
+    OccupancyRollup minutes;
+    OccupancyRollup hours;
+};
+
+struct OccupancyPoint {
+    long long time;             // start of the step
+    double average;
+    int min;
+    int max;
+};
+
+class OccupancySeries {
+private:
+    ZoneOccupancy* zones;       // by zone position
+    int zoneCapacity;
+
+    void coverZone(int zonePosition);
+    static void appendRaw(ZoneOccupancy& zone, long long time, int value);
+    static void advance(OccupancyRollup& rollup, long long time, int lastValue);
+    static void closeBucket(OccupancyRollup& rollup);
+    static bool bucketAt(const OccupancyRollup& rollup, long long bucket, long long now, int lastValue,
+                         long long lastTime, OccupancyBucket& out, long long& covered);
+    static int rollupQuery(const ZoneOccupancy& zone, const OccupancyRollup& rollup, long long from,
+                           long long to, long long step, long long now, OccupancyPoint* out,
+                           int maxPoints);
+    static int rawQuery(const ZoneOccupancy& zone, long long from, long long to, long long step,
+                        long long now, OccupancyPoint* out, int maxPoints);
+
+public:
+    OccupancySeries();
+    ~OccupancySeries();
+
+    // Times must not go backwards per zone; earlier ones are taken as the last
+    void record(int zonePosition, long long time, int occupied);
+    // Points every step milliseconds from 'from' (rounded down to a multiple
+    // of step) until 'to', as of 'now'. Steps that are whole hours or whole
+    // minutes read the rollups, shorter ones the raw blocks. Steps with no
+    // data are left out. Returns the number of points written.
+    int query(int zonePosition, long long from, long long to, long long step, long long now,
+              OccupancyPoint* out, int maxPoints) const;
+    long long getMemoryBytes() const;
+
+    static long long nowMillis();
+};
+
+#endif
@@ -0,0 +1,98 @@
+#include "OutputBuffer.h"
+#include <cstring>
+
+OutputBuffer::OutputBuffer(FILE* f, int bufferSize)
+    : file(f), capacity(bufferSize), length(0) {
+    buffer = new char[bufferSize];
+}
+
+OutputBuffer::~OutputBuffer() {
+    flush();
+    delete[] buffer;
+}
+
+void OutputBuffer::append(const char* text) {
+    append(text, (int)strlen(text));
+}
+
+void OutputBuffer::append(const char* data, int len) {
+    if (length + len > capacity) {
+        flush();
+        if (len > capacity) {
+            fwrite(data, 1, len, file);
+            return;
+        }
+    }
+    memcpy(buffer + length, data, len);
+    length += len;
+}
+
+void OutputBuffer::append(char c) {
+    if (length == capacity) {
+        flush();
+    }
+    buffer[length++] = c;
+}
+
+void OutputBuffer::appendInt(long long value) {
+    char digits[24];
+    int count = 0;
+    unsigned long long magnitude = value < 0 ? 0ULL - (unsigned long long)value
+                                             : (unsigned long long)value;
+    do {
+        digits[count++] = (char)('0' + magnitude % 10);
+        magnitude /= 10;
+    } while (magnitude != 0);
+
+    if (length + count + 1 > capacity) {
+        flush();
+    }
+    if (value < 0) {
+        buffer[length++] = '-';
+    }
+    while (count > 0) {
+        buffer[length++] = digits[--count];
+    }
+}
+
+void OutputBuffer::appendFixed(double value, int places) {
+    long long scale = 1;
+    for (int i = 0; i < places; i++) {
+        scale *= 10;
+    }
+    bool negative = value < 0;
+    double magnitude = (negative ? -value : value) * scale + 0.5;
+    if (magnitude >= 9e18) {
+        // Past what fits in the integer path
+        char text[64];
+        append(text, snprintf(text, sizeof(text), "%.*f", places, value));
+        return;
+    }
+    long long scaled = (long long)magnitude;
+    if (negative && scaled != 0) {
+        append('-');
+    }
+    appendInt(scaled / scale);
+    if (places > 0) {
+        char digits[16];
+        long long fraction = scaled % scale;
+        for (int i = places - 1; i >= 0; i--) {
+            digits[i] = (char)('0' + fraction % 10);
+            fraction /= 10;
+        }
+        append('.');
+        append(digits, places);
+    }
+}
+
+void OutputBuffer::flush() {
+    if (length > 0) {
+        fwrite(buffer, 1, length, file);
+        length = 0;
+    }
+    fflush(file);
+}
+
+int OutputBuffer::getLength() const {
+    return length;
+}
@@ -0,0 +1,29 @@
+#ifndef OUTPUTBUFFER_H
+#define OUTPUTBUFFER_H
+
+#include <cstdio>
+
+// Large append-only output buffer that formats integers itself and only
+// touches the FILE* when the buffer fills up or flush() is called.
+class OutputBuffer {
+private:
+    FILE* file;
+    char* buffer;
+    int capacity;
+    int length;
+
+public:
+    OutputBuffer(FILE* f, int bufferSize = 1 << 20);
+    ~OutputBuffer();
+
+    void append(const char* text);
+    void append(const char* data, int len);
+    void append(char c);
+    void appendInt(long long value);
+    // Rounded to the given number of decimal places (at most 9)
+    void appendFixed(double value, int places);
+    void flush();
+    int getLength() const;
+};
+
+#endif
@@ -0,0 +1,124 @@
+#include "ParkingArea.h"
+#include "ParkingSlot.h"
+#include "Zone.h"
+#include "MemoryStats.h"
+
+ParkingArea::ParkingArea(int aId, int zId, int initialSlots)
+    : areaId(aId), zoneId(zId), slotCount(0), slotCapacity(initialSlots > 0 ? initialSlots : 1),
+      availableCount(0), zone(nullptr) {
+    for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+        availableByClass[c] = 0;
+    }
+    slots = trackedArray<ParkingSlot*>(MEMORY_TOPOLOGY, slotCapacity);
+    for (int i = 0; i < slotCapacity; i++) {
+        slots[i] = nullptr;
+    }
+}
+
+ParkingArea::~ParkingArea() {
+    for (int i = 0; i < slotCount; i++) {
+        delete slots[i];
+    }
+    trackedFree(MEMORY_TOPOLOGY, slots, slotCapacity);
+}
+
+int ParkingArea::getAreaId() const {
+    return areaId;
+}
+
+int ParkingArea::getZoneId() const {
+    return zoneId;
+}
+
+bool ParkingArea::addSlot(ParkingSlot* slot) {
+    if (slotCount == slotCapacity) {
+        int newCapacity = slotCapacity * 2;
+        ParkingSlot** grown = trackedArray<ParkingSlot*>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < slotCount; i++) {
+            grown[i] = slots[i];
+        }
+        trackedFree(MEMORY_TOPOLOGY, slots, slotCapacity);
+        slots = grown;
+        slotCapacity = newCapacity;
+    }
+    slots[slotCount++] = slot;
+    slot->setArea(this);
+    if (slot->isAvailable()) {
+        availableCount++;
+        availableByClass[slot->getSlotClass()]++;
+    }
+    if (zone != nullptr) {
+        zone->onSlotAdded(slot);
+    }
+    return true;
+}
+
+ParkingSlot* ParkingArea::getSlot(int index) const {
+    if (index >= 0 && index < slotCount) {
+        return slots[index];
+    }
+    return nullptr;
+}
+
+ParkingSlot* ParkingArea::findAvailableSlot() const {
+    int examined = 0;
+    return findAvailableSlot(examined);
+}
+
+ParkingSlot* ParkingArea::findAvailableSlot(int& examined) const {
+    for (int i = 0; i < slotCount; i++) {
+        examined++;
+        if (slots[i]->isAvailable()) {
+            return slots[i];
+        }
+    }
+    return nullptr;
+}
+
+ParkingSlot* ParkingArea::findAvailableSlot(int& examined, SlotClass slotClass) const {
+    int index = findAvailableIndex(0, examined, slotClass);
+    return index >= 0 ? slots[index] : nullptr;
+}
+
+int ParkingArea::findAvailableIndex(int start, int& examined, SlotClass slotClass) const {
+    for (int i = start; i < slotCount; i++) {
+        examined++;
+        if (slots[i]->isAvailable() && slots[i]->getSlotClass() == slotClass) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int ParkingArea::getSlotCount() const {
+    return slotCount;
+}
+
+int ParkingArea::getTotalSlots() const {
+    return slotCount;
+}
+
+int ParkingArea::getAvailableSlots() const {
+    return availableCount;
+}
+
+int ParkingArea::getAvailableSlots(SlotClass slotClass) const {
+    return availableByClass[slotClass];
+}
+
+Zone* ParkingArea::getZone() const {
+    return zone;
+}
+
+void ParkingArea::setZone(Zone* parent) {
+    zone = parent;
+}
+
+void ParkingArea::onSlotChanged(ParkingSlot* slot) {
+    int delta = slot->isAvailable() ? 1 : -1;
+    availableCount += delta;
+    availableByClass[slot->getSlotClass()] += delta;
+    if (zone != nullptr) {
+        zone->onSlotChanged(slot);
+    }
+}
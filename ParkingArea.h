@@ -1,18 +1,24 @@
 #ifndef PARKINGAREA_H
 #define PARKINGAREA_H
 
-class ParkingSlot;
+#include "ParkingSlot.h"
 
-class ParkingArea {
+class Zone;
+
+class ParkingArea : public Tracked<MEMORY_TOPOLOGY> {
 private:
     int areaId;
     int zoneId;
     ParkingSlot** slots;
     int slotCount;
     int slotCapacity;
+    int availableCount;
+    int availableByClass[SLOT_CLASS_COUNT];
+    Zone* zone;
 
 public:
-    ParkingArea(int aId, int zId, int maxSlots);
+    // initialSlots is a capacity hint; the area grows as slots are added
+    ParkingArea(int aId, int zId, int initialSlots);
     ~ParkingArea();
     
     int getAreaId() const;
@@ -20,9 +26,17 @@ public:
     bool addSlot(ParkingSlot* slot);
     ParkingSlot* getSlot(int index) const;
     ParkingSlot* findAvailableSlot() const;
+    ParkingSlot* findAvailableSlot(int& examined) const;
+    ParkingSlot* findAvailableSlot(int& examined, SlotClass slotClass) const;
+    int findAvailableIndex(int start, int& examined, SlotClass slotClass) const;
     int getSlotCount() const;
     int getTotalSlots() const;
     int getAvailableSlots() const;
+    int getAvailableSlots(SlotClass slotClass) const;
+    
+    Zone* getZone() const;
+    void setZone(Zone* parent);
+    void onSlotChanged(ParkingSlot* slot);
 };
 
 #endif
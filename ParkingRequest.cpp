@@ -1,32 +1,58 @@
 #include "ParkingRequest.h"
-#include <cstring>
+#include "RequestStore.h"
+#include <cstdint>
+
+const char* requestStateName(RequestState state) {
+    switch (state) {
+        case REQUESTED: return "REQUESTED";
+        case ALLOCATED: return "ALLOCATED";
+        case OCCUPIED: return "OCCUPIED";
+        case RELEASED: return "RELEASED";
+        case CANCELLED: return "CANCELLED";
+    }
+    return "UNKNOWN";
+}
+
+static const int ZONE_LIMIT = 1 << 27;
+static const long long MAX_DELTA = 0xFFFFFFFELL;
 
-ParkingRequest::ParkingRequest(int reqId, const char* vId, int reqZone, long long reqTime)
-    : requestId(reqId), requestedZone(reqZone), allocatedZone(-1), 
-      allocatedSlotId(-1), state(REQUESTED), requestTime(reqTime),
-      allocationTime(0), releaseTime(0), crossZonePenalty(false) {
-    vehicleId = new char[strlen(vId) + 1];
-    strcpy(vehicleId, vId);
+// Requested zones outside the 28 bits kept are recorded as -1; no zone can
+// have such an ID
+ParkingRequest::ParkingRequest(unsigned plateHandle, int reqZone, unsigned relativeTime,
+                               SlotClass cls, bool fallback)
+    : plate(plateHandle), requestTime(relativeTime), allocationTime(0), releaseTime(0),
+      allocatedSlotId(-1), allocatedZoneAndState(REQUESTED), crossZoneDistance(0) {
+    if (reqZone < -ZONE_LIMIT || reqZone >= ZONE_LIMIT) reqZone = -1;
+    requestedZoneAndClass = (int)((unsigned)reqZone << 4) | (fallback ? 8 : 0) | cls;
 }
 
-ParkingRequest::~ParkingRequest() {
-    delete[] vehicleId;
+const RequestChunkHeader* ParkingRequest::header() const {
+    return (const RequestChunkHeader*)((uintptr_t)this & ~(uintptr_t)(REQUEST_CHUNK_BYTES - 1));
+}
+
+void ParkingRequest::setState(RequestState newState) {
+    allocatedZoneAndState = (allocatedZoneAndState & ~7u) | newState;
 }
 
 int ParkingRequest::getRequestId() const {
-    return requestId;
+    const RequestChunkHeader* chunk = header();
+    return (int)(chunk->firstId + ((const char*)this - (const char*)chunk) / REQUEST_RECORD_BYTES - 1);
 }
 
 const char* ParkingRequest::getVehicleId() const {
-    return vehicleId;
+    return header()->plates->lookup(plate);
+}
+
+unsigned ParkingRequest::getPlate() const {
+    return plate;
 }
 
 int ParkingRequest::getRequestedZone() const {
-    return requestedZone;
+    return requestedZoneAndClass >> 4;
 }
 
 int ParkingRequest::getAllocatedZone() const {
-    return allocatedZone;
+    return (int)(allocatedZoneAndState >> 4) - 1;
 }
 
 int ParkingRequest::getAllocatedSlotId() const {
@@ -34,58 +60,82 @@ int ParkingRequest::getAllocatedSlotId() const {
 }
 
 RequestState ParkingRequest::getState() const {
-    return state;
+    return (RequestState)(allocatedZoneAndState & 7);
 }
 
 long long ParkingRequest::getRequestTime() const {
-    return requestTime;
+    return header()->timeBase + requestTime;
 }
 
 long long ParkingRequest::getAllocationTime() const {
-    return allocationTime;
+    return allocationTime == 0 ? 0 : getRequestTime() + allocationTime - 1;
 }
 
 long long ParkingRequest::getReleaseTime() const {
-    return releaseTime;
+    return releaseTime == 0 ? 0 : getRequestTime() + releaseTime - 1;
 }
 
 bool ParkingRequest::hasCrossZonePenalty() const {
-    return crossZonePenalty;
+    return (allocatedZoneAndState & 8) != 0;
+}
+
+double ParkingRequest::getCrossZoneDistance() const {
+    return crossZoneDistance;
+}
+
+SlotClass ParkingRequest::getRequiredClass() const {
+    return (SlotClass)(requestedZoneAndClass & 7);
+}
+
+bool ParkingRequest::allowsFallback() const {
+    return (requestedZoneAndClass & 8) != 0;
 }
 
 bool ParkingRequest::transitionTo(RequestState newState) {
+    RequestState state = getState();
+
     // Valid transitions
     if (state == REQUESTED && (newState == ALLOCATED || newState == CANCELLED)) {
-        state = newState;
+        setState(newState);
         return true;
     }
     if (state == ALLOCATED && (newState == OCCUPIED || newState == CANCELLED)) {
-        state = newState;
+        setState(newState);
         return true;
     }
-    if (state == OCCUPIED && newState == RELEASED) {
-        state = newState;
+    if (state == OCCUPIED && (newState == RELEASED || newState == CANCELLED)) {
+        setState(newState);
         return true;
     }
     return false;
 }
 
-void ParkingRequest::allocate(int zoneId, int slotId, long long time, bool crossZone) {
+// Times are kept relative to the request time; a gap of more than four
+// billion ticks is clamped
+static unsigned relativeTo(long long time, long long since) {
+    long long delta = time - since;
+    if (delta < 0) delta = 0;
+    if (delta > MAX_DELTA) delta = MAX_DELTA;
+    return (unsigned)delta + 1;
+}
+
+void ParkingRequest::allocate(int zoneId, int slotId, long long time, bool crossZone,
+                              double distance) {
     if (transitionTo(ALLOCATED)) {
-        allocatedZone = zoneId;
+        allocatedZoneAndState = ((unsigned)(zoneId + 1) << 4) | (crossZone ? 8 : 0) | ALLOCATED;
         allocatedSlotId = slotId;
-        allocationTime = time;
-        crossZonePenalty = crossZone;
+        allocationTime = relativeTo(time, getRequestTime());
+        crossZoneDistance = (float)distance;
     }
 }
 
-void ParkingRequest::occupy(long long time) {
+void ParkingRequest::occupy(long long) {
     transitionTo(OCCUPIED);
 }
 
 void ParkingRequest::release(long long time) {
     if (transitionTo(RELEASED)) {
-        releaseTime = time;
+        releaseTime = relativeTo(time, getRequestTime());
     }
 }
 
@@ -93,9 +143,23 @@ void ParkingRequest::cancel() {
     transitionTo(CANCELLED);
 }
 
+void ParkingRequest::relocate(int zoneId, int slotId, bool crossZone, double distance) {
+    RequestState state = getState();
+    if (state != ALLOCATED && state != OCCUPIED) return;
+    allocatedZoneAndState = ((unsigned)(zoneId + 1) << 4) | (crossZone ? 8 : 0) | state;
+    allocatedSlotId = slotId;
+    crossZoneDistance = (float)distance;
+}
+
+void ParkingRequest::reinstate(RequestState state) {
+    if (getState() == CANCELLED && (state == ALLOCATED || state == OCCUPIED)) {
+        setState(state);
+    }
+}
+
 long long ParkingRequest::getParkingDuration() const {
-    if (state == RELEASED && allocationTime > 0 && releaseTime > 0) {
-        return releaseTime - allocationTime;
+    if (getState() == RELEASED && allocationTime > 0 && releaseTime > 0) {
+        return (long long)releaseTime - allocationTime;
     }
     return 0;
 }
@@ -1,6 +1,8 @@
 #ifndef PARKINGREQUEST_H
 #define PARKINGREQUEST_H
 
+#include "ParkingSlot.h"
+
 enum RequestState {
     REQUESTED,
     ALLOCATED,
@@ -9,25 +11,39 @@ enum RequestState {
     CANCELLED
 };
 
+const char* requestStateName(RequestState state);
+
+struct RequestChunkHeader;
+
+// 32-byte record stored contiguously by ID in a RequestStore. The ID, the
+// plate text and the full request time come from the header of the chunk
+// the record sits in; everything else is packed in place. Fields fixed at
+// creation and fields that change live in separate words, so readers of
+// the fixed ones never race the writer.
 class ParkingRequest {
 private:
-    int requestId;
-    char* vehicleId;
-    int requestedZone;
-    int allocatedZone;
+    // Fixed at creation
+    unsigned plate;                 // handle into the store's PlateTable
+    int requestedZoneAndClass;      // requested zone << 4 | fallback << 3 | class
+    unsigned requestTime;           // ticks after the chunk's time base
+
+    // Changing; times are ticks after requestTime plus one, 0 when unset
+    unsigned allocationTime;
+    unsigned releaseTime;
     int allocatedSlotId;
-    RequestState state;
-    long long requestTime;
-    long long allocationTime;
-    long long releaseTime;
-    bool crossZonePenalty;
+    unsigned allocatedZoneAndState; // (allocated zone + 1) << 4 | penalty << 3 | state
+    float crossZoneDistance;        // from the requested zone to the allocated one
+
+    const RequestChunkHeader* header() const;
+    void setState(RequestState newState);
 
 public:
-    ParkingRequest(int reqId, const char* vId, int reqZone, long long reqTime);
-    ~ParkingRequest();
-    
+    ParkingRequest(unsigned plateHandle, int reqZone, unsigned relativeTime,
+                   SlotClass cls = SLOT_STANDARD, bool fallback = false);
+
     int getRequestId() const;
     const char* getVehicleId() const;
+    unsigned getPlate() const;      // PlateTable handle, equal for equal plates
     int getRequestedZone() const;
     int getAllocatedZone() const;
     int getAllocatedSlotId() const;
@@ -36,12 +52,19 @@ public:
     long long getAllocationTime() const;
     long long getReleaseTime() const;
     bool hasCrossZonePenalty() const;
-    
+    double getCrossZoneDistance() const;
+    SlotClass getRequiredClass() const;
+    bool allowsFallback() const;
+
     bool transitionTo(RequestState newState);
-    void allocate(int zoneId, int slotId, long long time, bool crossZone);
+    void allocate(int zoneId, int slotId, long long time, bool crossZone, double distance = 0);
     void occupy(long long time);
     void release(long long time);
     void cancel();
+    // Moves an active allocation to another slot, keeping its state and times
+    void relocate(int zoneId, int slotId, bool crossZone, double distance);
+    // Takes back a cancel of an active allocation (undoing a zone drain)
+    void reinstate(RequestState state);
     long long getParkingDuration() const;
 };
 
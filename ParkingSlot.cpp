@@ -1,7 +1,31 @@
 #include "ParkingSlot.h"
+#include "ParkingArea.h"
+#include <cstring>
 
-ParkingSlot::ParkingSlot(int sId, int zId) 
-    : slotId(sId), zoneId(zId), available(true) {}
+const char* slotClassName(SlotClass slotClass) {
+    switch (slotClass) {
+        case SLOT_STANDARD: return "standard";
+        case SLOT_EV: return "ev";
+        case SLOT_ACCESSIBLE: return "accessible";
+        case SLOT_MOTORCYCLE: return "motorcycle";
+        case SLOT_OVERSIZE: return "oversize";
+    }
+    return "unknown";
+}
+
+bool parseSlotClass(const char* name, SlotClass& slotClass) {
+    for (int i = 0; i < SLOT_CLASS_COUNT; i++) {
+        if (strcmp(name, slotClassName((SlotClass)i)) == 0) {
+            slotClass = (SlotClass)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+ParkingSlot::ParkingSlot(int sId, int zId, SlotClass cls) 
+    : slotId(sId), zoneId(zId), available(true), slotClass(cls), area(nullptr), freeIndex(-1),
+      zonePosition(-1), occupant(0) {}
 
 int ParkingSlot::getSlotId() const {
     return slotId;
@@ -16,13 +40,57 @@ bool ParkingSlot::isAvailable() const {
 }
 
 void ParkingSlot::setAvailable(bool status) {
+    if (available == status) return;
     available = status;
+    
+    // Every availability change funnels through here so the area and zone
+    // counters (and whoever listens to the zone) stay exact
+    if (area != nullptr) {
+        area->onSlotChanged(this);
+    }
 }
 
 void ParkingSlot::occupy() {
-    available = false;
+    setAvailable(false);
 }
 
 void ParkingSlot::release() {
-    available = true;
+    occupant = 0;
+    setAvailable(true);
+}
+
+SlotClass ParkingSlot::getSlotClass() const {
+    return slotClass;
+}
+
+ParkingArea* ParkingSlot::getArea() const {
+    return area;
+}
+
+void ParkingSlot::setArea(ParkingArea* parent) {
+    area = parent;
+}
+
+int ParkingSlot::getFreeIndex() const {
+    return freeIndex;
+}
+
+void ParkingSlot::setFreeIndex(int index) {
+    freeIndex = index;
+}
+
+int ParkingSlot::getZonePosition() const {
+    return zonePosition;
+}
+
+void ParkingSlot::setZonePosition(int position) {
+    zonePosition = position;
+}
+
+int ParkingSlot::getOccupant() const {
+    return occupant;
+}
+
+void ParkingSlot::setOccupant(int requestId) {
+    occupant = requestId;
 }
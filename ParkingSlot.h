@@ -1,14 +1,37 @@
 #ifndef PARKINGSLOT_H
 #define PARKINGSLOT_H
 
-class ParkingSlot {
+#include "MemoryStats.h"
+
+class ParkingArea;
+
+enum SlotClass {
+    SLOT_STANDARD,
+    SLOT_EV,            // has a charger
+    SLOT_ACCESSIBLE,
+    SLOT_MOTORCYCLE,
+    SLOT_OVERSIZE
+};
+
+const int SLOT_CLASS_COUNT = 5;
+const unsigned ALL_SLOT_CLASSES = (1u << SLOT_CLASS_COUNT) - 1;
+
+const char* slotClassName(SlotClass slotClass);
+bool parseSlotClass(const char* name, SlotClass& slotClass);
+
+class ParkingSlot : public Tracked<MEMORY_TOPOLOGY> {
 private:
     int slotId;
     int zoneId;
     bool available;
+    SlotClass slotClass;
+    ParkingArea* area;
+    int freeIndex;          // position in the zone's free list for its class, -1 if taken
+    int zonePosition;       // order the slot was added to its zone
+    int occupant;           // ID of the request holding the slot, 0 if free or reserved
 
 public:
-    ParkingSlot(int sId, int zId);
+    ParkingSlot(int sId, int zId, SlotClass cls = SLOT_STANDARD);
     
     int getSlotId() const;
     int getZoneId() const;
@@ -16,6 +39,16 @@ public:
     void setAvailable(bool status);
     void occupy();
     void release();
+    SlotClass getSlotClass() const;
+    
+    ParkingArea* getArea() const;
+    void setArea(ParkingArea* parent);
+    int getFreeIndex() const;
+    void setFreeIndex(int index);
+    int getZonePosition() const;
+    void setZonePosition(int position);
+    int getOccupant() const;
+    void setOccupant(int requestId);
 };
 
 #endif
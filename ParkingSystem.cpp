@@ -5,17 +5,44 @@
 #include "ParkingRequest.h"
 #include "AllocationEngine.h"
 #include "RollbackManager.h"
+#include "TraceRecorder.h"
+#include "ChangeFeed.h"
+#include "ReplicationLog.h"
+#include "SnapshotStore.h"
+#include "OccupancySeries.h"
+#include "AffinityCache.h"
+#include "MemoryStats.h"
 #include <iostream>
+#include <cstring>
 #include <ctime>
+#include <cmath>
+#include <climits>
 
-ParkingSystem::ParkingSystem(int maxZones) 
-    : zoneCount(0), zoneCapacity(maxZones), requestHistoryHead(nullptr),
-      requestHistoryTail(nullptr), nextRequestId(1), currentTime(0) {
-    zones = new Zone*[maxZones];
-    for (int i = 0; i < maxZones; i++) {
+ParkingSystem::ParkingSystem(int initialZones, AllocationPolicy policy) 
+    : zoneCount(0), zoneCapacity(initialZones > 0 ? initialZones : 1), areaCount(0),
+      allocationPolicy(policy),
+      currentTime(0),
+      virtualClock(false), recorder(nullptr), replicationLog(nullptr), snapshots(nullptr), waitlist(nullptr),
+      occupancy(nullptr), affinity(nullptr), reservations(nullptr),
+      nextReservationToken(1), leases(nullptr), nextLeaseToken(1) {
+    stats = new EngineStats();
+    changeFeed = new ChangeFeed();
+    zonePositionByIdCapacity = 16;
+    zonePositionById = trackedArray<int>(MEMORY_TOPOLOGY, zonePositionByIdCapacity);
+    for (int i = 0; i < zonePositionByIdCapacity; i++) {
+        zonePositionById[i] = -1;
+    }
+    allocatedSlotsCapacity = 1024;
+    allocatedSlots = trackedArray<ParkingSlot*>(MEMORY_REQUESTS, allocatedSlotsCapacity);
+    latestByPlateCapacity = 1024;
+    latestByPlate = trackedArray<int>(MEMORY_REQUESTS, latestByPlateCapacity);
+    zones = trackedArray<Zone*>(MEMORY_TOPOLOGY, zoneCapacity);
+    for (int i = 0; i < zoneCapacity; i++) {
         zones[i] = nullptr;
     }
-    engine = new AllocationEngine(zones, zoneCount);
+    engine = AllocationEngine::create(allocationPolicy, zones, zoneCount, stats);
+    engine->setZoneTree(&zoneTree);
+    engine->setSpatialIndex(&zoneIndex);
     rollbackMgr = new RollbackManager();
 }
 
@@ -23,61 +50,190 @@ ParkingSystem::~ParkingSystem() {
     for (int i = 0; i < zoneCount; i++) {
         delete zones[i];
     }
-    delete[] zones;
+    trackedFree(MEMORY_TOPOLOGY, zones, zoneCapacity);
     delete engine;
     delete rollbackMgr;
-    
-    RequestNode* current = requestHistoryHead;
-    while (current != nullptr) {
-        RequestNode* temp = current;
-        current = current->next;
-        delete temp->request;
+    delete stats;
+    delete changeFeed;
+    delete snapshots;
+    delete waitlist;
+    delete occupancy;
+    delete affinity;
+    trackedFree(MEMORY_TOPOLOGY, zonePositionById, zonePositionByIdCapacity);
+    trackedFree(MEMORY_REQUESTS, allocatedSlots, allocatedSlotsCapacity);
+    trackedFree(MEMORY_REQUESTS, latestByPlate, latestByPlateCapacity);
+    while (reservations != nullptr) {
+        ReservationNode* temp = reservations;
+        reservations = reservations->next;
+        delete temp;
+    }
+    while (leases != nullptr) {
+        LeaseNode* temp = leases;
+        leases = leases->next;
         delete temp;
     }
 }
 
+// Zones may be added while serving: the zone array doubles when full, and
+// the engine, trees and index take the new zone in place. A zone whose ID
+// is already taken is refused and stays the caller's
 bool ParkingSystem::addZone(Zone* zone) {
-    if (zoneCount < zoneCapacity) {
-        zones[zoneCount++] = zone;
-        delete engine;
-        engine = new AllocationEngine(zones, zoneCount);
-        return true;
+    if (getZone(zone->getZoneId()) != nullptr) return false;
+    if (zoneCount == zoneCapacity) {
+        int newCapacity = zoneCapacity * 2;
+        Zone** grown = trackedArray<Zone*>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < newCapacity; i++) {
+            grown[i] = i < zoneCount ? zones[i] : nullptr;
+        }
+        trackedFree(MEMORY_TOPOLOGY, zones, zoneCapacity);
+        zones = grown;
+        zoneCapacity = newCapacity;
     }
-    return false;
+    int zoneId = zone->getZoneId();
+    if (zoneId >= 0 && zoneId >= zonePositionByIdCapacity) {
+        int newCapacity = zonePositionByIdCapacity * 2;
+        while (newCapacity <= zoneId) newCapacity *= 2;
+        int* grown = trackedArray<int>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < newCapacity; i++) {
+            grown[i] = i < zonePositionByIdCapacity ? zonePositionById[i] : -1;
+        }
+        trackedFree(MEMORY_TOPOLOGY, zonePositionById, zonePositionByIdCapacity);
+        zonePositionById = grown;
+        zonePositionByIdCapacity = newCapacity;
+    }
+    if (zoneId >= 0) {
+        zonePositionById[zoneId] = zoneCount;
+    }
+    
+    zone->setPosition(zoneCount);
+    zones[zoneCount++] = zone;
+    areaCount += zone->getAreaCount();
+    zone->setListener(this);
+    zoneTree.resize(zoneCount);
+    zoneIndex.insert(zones, zoneCount);
+    refreshZone(zone);
+    if (snapshots != nullptr) {
+        snapshots->markZone(zone->getPosition());
+    }
+    recordOccupancy(zone);
+    engine->setZones(zones, zoneCount);
+    return true;
 }
 
-ParkingRequest* ParkingSystem::createRequest(const char* vehicleId, int requestedZone) {
+ParkingArea* ParkingSystem::addArea(int zoneId, int slotCount, SlotClass slotClass, bool located,
+                                    double x, double y) {
+    ParkingArea* area = addAreaInternal(zoneId, slotCount, slotClass, located, x, y);
+    if (recorder != nullptr) {
+        recorder->recordAddArea(zoneId, slotCount, slotClass, located, x, y, area != nullptr);
+    }
+    if (replicationLog != nullptr) {
+        char payload[sizeof(int) + 2 * sizeof(double)];
+        int payloadLen = sizeof(int);
+        memcpy(payload, &slotCount, sizeof(int));
+        if (located) {
+            memcpy(payload + payloadLen, &x, sizeof(double));
+            memcpy(payload + payloadLen + sizeof(double), &y, sizeof(double));
+            payloadLen += 2 * sizeof(double);
+        }
+        replicationLog->appendPayload(TRACE_ADD_AREA, area != nullptr, zoneId, payload, payloadLen,
+                                      slotClass | (located ? 0x80 : 0));
+    }
+    afterWrite();
+    return area;
+}
+
+// Slot IDs carry on from the zone's highest, or start at zoneId * 1000000 + 1
+// like the grid's; area IDs carry on from the number of areas so far, which
+// is how every topology numbers them. nullptr when the IDs would not fit in
+// an int
+ParkingArea* ParkingSystem::addAreaInternal(int zoneId, int slotCount, SlotClass slotClass,
+                                            bool located, double x, double y) {
+    if (zoneId < 0 || slotCount <= 0) return nullptr;
+    Zone* zone = getZone(zoneId);
+    int total = zone != nullptr ? zone->getTotalSlots() : 0;
+    long long firstSlotId = total > 0 ? zone->getSlotAt(total - 1)->getSlotId() + 1LL
+                                      : zoneId * 1000000LL + 1;
+    if (firstSlotId + slotCount - 1 > INT_MAX) return nullptr;
+    bool created = zone == nullptr;
+    if (created) {
+        zone = new Zone(zoneId, 1);
+        if (located) zone->setLocation(x, y);
+    }
+    
+    int areaId = areaCount + 1;
+    ParkingArea* area = new ParkingArea(areaId, zoneId, slotCount);
+    for (int i = 0; i < slotCount; i++) {
+        area->addSlot(new ParkingSlot((int)firstSlotId + i, zoneId, slotClass));
+    }
+    zone->addParkingArea(area);
+    if (created) {
+        addZone(zone);
+    } else {
+        areaCount++;
+    }
+    for (int i = 0; i < slotCount; i++) {
+        assignFromWaitlist(area->getSlot(i));
+    }
+    return area;
+}
+
+ParkingRequest* ParkingSystem::createRequest(const char* vehicleId, int requestedZone,
+                                             SlotClass slotClass, bool fallback, int priority) {
+    if (priority < 0) priority = 0;
+    if (priority > WAITLIST_MAX_PRIORITY) priority = WAITLIST_MAX_PRIORITY;
     long long reqTime = getCurrentTime();
-    ParkingRequest* request = new ParkingRequest(nextRequestId++, vehicleId, requestedZone, reqTime);
-    addToHistory(request);
+    ParkingRequest* request = newRequest(vehicleId, requestedZone, reqTime, slotClass, fallback);
     
     // Automatic allocation
-    if (engine->allocateSlot(request, reqTime)) {
-        ParkingSlot* slot = nullptr;
-        Zone* zone = getZone(request->getAllocatedZone());
-        if (zone != nullptr) {
-            for (int i = 0; i < zone->getAreaCount(); i++) {
-                ParkingArea* area = zone->getParkingArea(i);
-                for (int j = 0; j < area->getSlotCount(); j++) {
-                    ParkingSlot* s = area->getSlot(j);
-                    if (s->getSlotId() == request->getAllocatedSlotId()) {
-                        slot = s;
-                        break;
-                    }
-                }
-                if (slot != nullptr) break;
-            }
-        }
-        if (slot != nullptr) {
-            rollbackMgr->pushAllocation(request, slot);
-        }
+    ParkingSlot* slot = nullptr;
+    bool allocated = engine->allocateSlot(request, reqTime, &slot);
+    while (!allocated && leases != nullptr) {
+        ParkingSlot* leased = reclaimLeasedSlot(request);
+        if (leased == nullptr) break;
+        freeSlot(leased);
+        allocated = engine->allocateSlot(request, reqTime, &slot);
+    }
+    if (allocated) {
+        allocatedSlots[request->getRequestId()] = slot;
+        slot->setOccupant(request->getRequestId());
+        rememberSlot(request, slot);
+        rollbackMgr->pushAllocation(request, slot);
         request->occupy(reqTime);
+    } else if (waitlist != nullptr) {
+        if (waitlist->add(request, getZonePosition(requestedZone), priority)) {
+            stats->add(STAT_WAITLISTED, 1);
+        } else {
+            request->cancel();
+        }
     }
+    publishRequest(request);
     
+    if (recorder != nullptr) {
+        recorder->recordCreate(vehicleId, requestedZone, slotClass, fallback, priority,
+                               request->getState() == OCCUPIED);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_CREATE, request->getState() == OCCUPIED, requestedZone,
+                               vehicleId, slotClass | priority << 3 | (fallback ? 0x80 : 0),
+                               allocated ? slot->getSlotId() : 0);
+    }
+    afterWrite();
     return request;
 }
 
 bool ParkingSystem::cancelRequest(int requestId) {
+    bool result = cancelRequestInternal(requestId);
+    if (recorder != nullptr) {
+        recorder->recordCancel(requestId, result);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_CANCEL, result, requestId, nullptr, 0);
+    }
+    afterWrite();
+    return result;
+}
+
+bool ParkingSystem::cancelRequestInternal(int requestId) {
     ParkingRequest* request = findRequest(requestId);
     if (request == nullptr) return false;
     
@@ -91,22 +247,18 @@ bool ParkingSystem::cancelRequest(int requestId) {
     
     // Can cancel if REQUESTED, ALLOCATED, or OCCUPIED
     if (state == REQUESTED || state == ALLOCATED || state == OCCUPIED) {
-        if (request->getAllocatedSlotId() != -1) {
-            Zone* zone = getZone(request->getAllocatedZone());
-            if (zone != nullptr) {
-                for (int i = 0; i < zone->getAreaCount(); i++) {
-                    ParkingArea* area = zone->getParkingArea(i);
-                    for (int j = 0; j < area->getSlotCount(); j++) {
-                        ParkingSlot* slot = area->getSlot(j);
-                        if (slot->getSlotId() == request->getAllocatedSlotId()) {
-                            slot->release();
-                            break;
-                        }
-                    }
-                }
-            }
+        if (isWaiting(request)) {
+            waitlist->leave();
+        }
+        ParkingSlot* slot = findAllocatedSlot(requestId);
+        if (slot != nullptr) {
+            slot->release();
         }
         request->cancel();
+        publishRequest(request);
+        if (slot != nullptr) {
+            assignFromWaitlist(slot);
+        }
         return true;
     }
     
@@ -114,31 +266,522 @@ bool ParkingSystem::cancelRequest(int requestId) {
 }
 
 bool ParkingSystem::releaseParking(int requestId) {
+    bool result = releaseParkingInternal(requestId);
+    if (recorder != nullptr) {
+        recorder->recordRelease(requestId, result);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_RELEASE, result, requestId, nullptr, 0);
+    }
+    afterWrite();
+    return result;
+}
+
+bool ParkingSystem::releaseParkingInternal(int requestId) {
+    ScopedStatTimer timer(stats, TIMER_RELEASE);
     ParkingRequest* request = findRequest(requestId);
     if (request == nullptr) return false;
     
     if (request->getState() == OCCUPIED) {
-        Zone* zone = getZone(request->getAllocatedZone());
-        if (zone != nullptr) {
-            for (int i = 0; i < zone->getAreaCount(); i++) {
-                ParkingArea* area = zone->getParkingArea(i);
-                for (int j = 0; j < area->getSlotCount(); j++) {
-                    ParkingSlot* slot = area->getSlot(j);
-                    if (slot->getSlotId() == request->getAllocatedSlotId()) {
-                        slot->release();
-                        break;
-                    }
-                }
-            }
+        ParkingSlot* slot = findAllocatedSlot(requestId);
+        if (slot != nullptr) {
+            slot->release();
         }
         request->release(getCurrentTime());
+        publishRequest(request);
+        if (slot != nullptr) {
+            assignFromWaitlist(slot);
+        }
         return true;
     }
     return false;
 }
 
 bool ParkingSystem::rollbackAllocations(int k) {
-    return rollbackMgr->rollback(k);
+    bool result = k > 0 && k <= rollbackMgr->getStackSize();
+    
+    // Waiters get the freed slots once the rollback is done, so a waiter
+    // served here is not undone by the same rollback
+    ParkingSlot** freed = result && waitlist != nullptr ? new ParkingSlot*[k] : nullptr;
+    int freedCount = 0;
+    DrainRecord* undone = nullptr;
+    for (int i = 0; result && i < k; i++) {
+        DrainRecord* drain = rollbackMgr->popDrain();
+        if (drain != nullptr) {
+            undoDrain(drain);
+            drain->next = undone;
+            undone = drain;
+            continue;
+        }
+        ParkingRequest* request;
+        ParkingSlot* slot;
+        rollbackMgr->popAllocation(request, slot);
+        
+        // Requests released or cancelled since their allocation already
+        // returned the slot; undoing them again would free an occupied slot
+        RequestState state = request->getState();
+        if (state != ALLOCATED && state != OCCUPIED) continue;
+        
+        // A drain may have moved the vehicle, and the slot it was allocated
+        // may since have gone to someone else: free the one it holds now
+        slot = allocatedSlots[request->getRequestId()];
+        if (slot != nullptr) {
+            slot->release();
+            if (freed != nullptr) freed[freedCount++] = slot;
+        }
+        request->cancel();
+        publishRequest(request);
+    }
+    for (int i = 0; i < freedCount; i++) {
+        assignFromWaitlist(freed[i]);
+    }
+    delete[] freed;
+    while (undone != nullptr) {
+        DrainRecord* drain = undone;
+        undone = drain->next;
+        for (int m = 0; m < drain->moveCount; m++) {
+            if (drain->moves[m].to != nullptr) assignFromWaitlist(drain->moves[m].to);
+        }
+        serveWaitlist(getZone(drain->zoneId));
+        delete drain;
+    }
+    if (recorder != nullptr) {
+        recorder->recordRollback(k, result);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_ROLLBACK, result, k, nullptr, 0);
+    }
+    afterWrite();
+    return result;
+}
+
+bool ParkingSystem::drainZone(int zoneId, DrainResult* result) {
+    DrainResult counts = {0, 0, 0};
+    bool drained = drainZoneInternal(zoneId, counts);
+    if (result != nullptr) *result = counts;
+    if (recorder != nullptr) {
+        recorder->recordDrain(zoneId, drained);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_DRAIN, drained, zoneId, nullptr, 0);
+    }
+    afterWrite();
+    return drained;
+}
+
+// Each vehicle is placed from the zone it asked for, so one sent here
+// cross-zone can go back home and lose its penalty. Moves are made one
+// after another on the writer thread: every placement changes what the
+// next one sees, and each costs one engine search
+bool ParkingSystem::drainZoneInternal(int zoneId, DrainResult& result) {
+    Zone* zone = getZone(zoneId);
+    if (zone == nullptr || zone->isClosed()) return false;
+    ScopedStatTimer timer(stats, TIMER_DRAIN);
+    zone->setClosed(true);
+    refreshZone(zone);
+    
+    // One pass over the zone's slots; reserved slots have no occupant and
+    // stay with their reservation
+    int occupied = zone->getTotalSlots() - zone->getAvailableSlots();
+    int moveCapacity = occupied > 0 ? occupied : 1;
+    DrainMove* moves = trackedArray<DrainMove>(MEMORY_ROLLBACK, moveCapacity);
+    int moveCount = 0;
+    for (int i = 0; i < zone->getTotalSlots(); i++) {
+        ParkingSlot* slot = zone->getSlotAt(i);
+        if (slot->isAvailable() || slot->getOccupant() == 0) continue;
+        ParkingRequest* request = requests.get(slot->getOccupant());
+        DrainMove& move = moves[moveCount++];
+        move.request = request;
+        move.from = slot;
+        move.to = nullptr;
+        move.state = request->getState();
+        move.crossZone = request->hasCrossZonePenalty();
+        move.distance = (float)request->getCrossZoneDistance();
+    }
+    
+    for (int i = 0; i < moveCount; i++) {
+        DrainMove& move = moves[i];
+        ParkingRequest* request = move.request;
+        int requestId = request->getRequestId();
+        int foundZone;
+        bool crossZone;
+        double distance;
+        move.to = engine->findSlot(request, foundZone, crossZone, distance);
+        if (move.to != nullptr) {
+            move.to->occupy();
+            move.to->setOccupant(requestId);
+            move.from->release();
+            request->relocate(foundZone, move.to->getSlotId(), crossZone, distance);
+            allocatedSlots[requestId] = move.to;
+            result.moved++;
+            if (crossZone) result.crossZone++;
+        } else {
+            move.from->release();
+            request->cancel();
+            result.cancelled++;
+        }
+        publishRequest(request);
+    }
+    stats->add(STAT_DRAIN_MOVED, result.moved);
+    stats->add(STAT_DRAIN_CANCELLED, result.cancelled);
+    rollbackMgr->pushDrain(zoneId, moves, moveCount, moveCapacity);
+    return true;
+}
+
+// Puts every vehicle the drain moved or cancelled back in its old slot,
+// unless it has left since or the slot was taken after a reopen. Moves
+// that freed nothing have their to cleared
+void ParkingSystem::undoDrain(DrainRecord* drain) {
+    Zone* zone = getZone(drain->zoneId);
+    zone->setClosed(false);
+    refreshZone(zone);
+    for (int i = drain->moveCount - 1; i >= 0; i--) {
+        DrainMove& move = drain->moves[i];
+        ParkingRequest* request = move.request;
+        int requestId = request->getRequestId();
+        RequestState state = request->getState();
+        if (!move.from->isAvailable()) {
+            // The old slot went to someone else after a reopen; the vehicle
+            // stays where it is, and its allocation record must say so
+            if (move.to != nullptr && (state == ALLOCATED || state == OCCUPIED)) {
+                rollbackMgr->relocate(request, allocatedSlots[requestId]);
+            }
+            move.to = nullptr;
+            continue;
+        }
+        if (move.to != nullptr) {
+            if ((state != ALLOCATED && state != OCCUPIED) || allocatedSlots[requestId] != move.to) {
+                move.to = nullptr;
+                continue;
+            }
+            move.from->occupy();
+            move.to->release();
+            request->relocate(drain->zoneId, move.from->getSlotId(), move.crossZone, move.distance);
+        } else {
+            if (state != CANCELLED) continue;
+            move.from->occupy();
+            request->reinstate(move.state);
+        }
+        move.from->setOccupant(requestId);
+        allocatedSlots[requestId] = move.from;
+        publishRequest(request);
+    }
+}
+
+bool ParkingSystem::reopenZone(int zoneId) {
+    bool result = reopenZoneInternal(zoneId);
+    if (recorder != nullptr) {
+        recorder->recordReopen(zoneId, result);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_REOPEN, result, zoneId, nullptr, 0);
+    }
+    afterWrite();
+    return result;
+}
+
+// Vehicles stay where the drain put them; waiters get the zone's free slots
+bool ParkingSystem::reopenZoneInternal(int zoneId) {
+    Zone* zone = getZone(zoneId);
+    if (zone == nullptr || !zone->isClosed()) return false;
+    zone->setClosed(false);
+    refreshZone(zone);
+    serveWaitlist(zone);
+    return true;
+}
+
+// Holds the usable free slot nearest to (x, y) - a point in another shard -
+// by occupying it without a request. Returns the token, or 0 if nothing fits.
+int ParkingSystem::reserveSlot(double x, double y, SlotClass slotClass, bool fallback,
+                               long long expiresAt, ParkingSlot** reservedSlot, double& distance) {
+    unsigned mask = 1u << slotClass;
+    if (fallback) mask |= 1u << SLOT_STANDARD;
+    int position = zoneIndex.isActive() ? zoneIndex.findNearest(x, y, mask, -1)
+                                        : zoneTree.findFirst(0, zoneCount - 1, mask);
+    if (position < 0) return 0;
+    
+    Zone* zone = zones[position];
+    ParkingSlot* slot = nullptr;
+    if (slotClass != SLOT_STANDARD) {
+        slot = zone->peekFreeSlot(slotClass);
+    }
+    if (slot == nullptr && (slotClass == SLOT_STANDARD || fallback)) {
+        slot = engine->findSlotInZone(zone->getZoneId());
+    }
+    if (slot == nullptr) return 0;
+    
+    slot->occupy();
+    ReservationNode* node = new ReservationNode;
+    node->token = nextReservationToken++;
+    node->slot = slot;
+    node->zoneId = zone->getZoneId();
+    node->distance = 0;
+    if (zone->hasLocation()) {
+        double dx = zone->getX() - x;
+        double dy = zone->getY() - y;
+        node->distance = sqrt(dx * dx + dy * dy);
+    }
+    node->expiresAt = expiresAt;
+    node->next = reservations;
+    reservations = node;
+    
+    if (reservedSlot != nullptr) *reservedSlot = slot;
+    distance = node->distance;
+    return node->token;
+}
+
+ReservationNode* ParkingSystem::takeReservation(int token) {
+    ReservationNode** link = &reservations;
+    while (*link != nullptr) {
+        if ((*link)->token == token) {
+            ReservationNode* node = *link;
+            *link = node->next;
+            return node;
+        }
+        link = &(*link)->next;
+    }
+    return nullptr;
+}
+
+// Turns a reservation into an occupied cross-zone request owned by this shard
+ParkingRequest* ParkingSystem::confirmReservation(int token, const char* vehicleId,
+                                                  int requestedZone, SlotClass slotClass,
+                                                  bool fallback) {
+    ReservationNode* node = takeReservation(token);
+    if (node == nullptr) return nullptr;
+    
+    long long reqTime = getCurrentTime();
+    ParkingRequest* request = newRequest(vehicleId, requestedZone, reqTime, slotClass, fallback);
+    request->allocate(node->zoneId, node->slot->getSlotId(), reqTime, true, node->distance);
+    request->occupy(reqTime);
+    allocatedSlots[request->getRequestId()] = node->slot;
+    node->slot->setOccupant(request->getRequestId());
+    rememberSlot(request, node->slot);
+    rollbackMgr->pushAllocation(request, node->slot);
+    publishRequest(request);
+    delete node;
+    afterWrite();
+    return request;
+}
+
+bool ParkingSystem::abortReservation(int token) {
+    ReservationNode* node = takeReservation(token);
+    if (node == nullptr) return false;
+    freeSlot(node->slot);
+    delete node;
+    return true;
+}
+
+// Releases reservations whose coordinator never came back
+int ParkingSystem::expireReservations(long long now) {
+    int expired = 0;
+    ReservationNode** link = &reservations;
+    while (*link != nullptr) {
+        ReservationNode* node = *link;
+        if (node->expiresAt <= now) {
+            *link = node->next;
+            freeSlot(node->slot);
+            delete node;
+            expired++;
+        } else {
+            link = &node->next;
+        }
+    }
+    return expired;
+}
+
+int ParkingSystem::getReservationCount() const {
+    int count = 0;
+    for (ReservationNode* node = reservations; node != nullptr; node = node->next) {
+        count++;
+    }
+    return count;
+}
+
+// Slots are taken the way the engine would hand them out in the zone and
+// parked in that order, so a gate's vehicles end up where central
+// allocation would have put them
+int ParkingSystem::leaseSlots(int zoneId, SlotClass slotClass, int count, long long expiresAt) {
+    if (count < 1) return 0;
+    if (count > LEASE_MAX_SLOTS) count = LEASE_MAX_SLOTS;
+    int asked = count;
+    Zone* zone = getZone(zoneId);
+    if (zone == nullptr || zone->isClosed()) {
+        count = 0;
+    } else if (count > zone->getAvailableSlots(slotClass) / 2) {
+        count = zone->getAvailableSlots(slotClass) / 2;
+    }
+    
+    int token = 0;
+    if (count > 0) {
+        LeaseNode* lease = new LeaseNode;
+        lease->token = token = nextLeaseToken++;
+        lease->zoneId = zoneId;
+        lease->slotClass = slotClass;
+        lease->count = 0;
+        lease->expiresAt = expiresAt;
+        ParkingSlot* picked[LEASE_MAX_SLOTS];
+        while (lease->count < count) {
+            ParkingSlot* slot = slotClass == SLOT_STANDARD ? engine->findSlotInZone(zoneId)
+                                                           : zone->peekFreeSlot(slotClass);
+            if (slot == nullptr) break;
+            slot->occupy();
+            picked[lease->count++] = slot;
+        }
+        for (int i = 0; i < lease->count; i++) {
+            lease->slots[i] = picked[lease->count - 1 - i];
+        }
+        lease->next = leases;
+        leases = lease;
+        stats->add(STAT_LEASED, lease->count);
+    }
+    
+    if (recorder != nullptr) {
+        recorder->recordLease(zoneId, slotClass, asked, token != 0);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_LEASE, token != 0, zoneId, nullptr, slotClass | (asked - 1) << 3);
+    }
+    afterWrite();
+    return token;
+}
+
+LeaseNode* ParkingSystem::findLease(int token) const {
+    for (LeaseNode* lease = leases; lease != nullptr; lease = lease->next) {
+        if (lease->token == token) return lease;
+    }
+    return nullptr;
+}
+
+// The gate's allocation: the next leased slot, with no search and nothing
+// else in the system looked at. A lease that runs out is gone; the gate
+// asks for another
+ParkingRequest* ParkingSystem::parkLeased(int token, const char* vehicleId) {
+    LeaseNode* lease = findLease(token);
+    ParkingRequest* request = nullptr;
+    if (lease != nullptr && lease->count > 0 && !getZone(lease->zoneId)->isClosed()) {
+        long long reqTime = getCurrentTime();
+        ParkingSlot* slot = lease->slots[--lease->count];
+        request = newRequest(vehicleId, lease->zoneId, reqTime, lease->slotClass, false);
+        request->allocate(lease->zoneId, slot->getSlotId(), reqTime, false, 0);
+        request->occupy(reqTime);
+        allocatedSlots[request->getRequestId()] = slot;
+        slot->setOccupant(request->getRequestId());
+        rememberSlot(request, slot);
+        rollbackMgr->pushAllocation(request, slot);
+        stats->add(STAT_LEASE_PARKS, 1);
+        publishRequest(request);
+        if (lease->count == 0) {
+            LeaseNode** link = &leases;
+            while (*link != lease) link = &(*link)->next;
+            unlease(link);
+        }
+    }
+    
+    if (recorder != nullptr) {
+        recorder->recordLeasePark(token, vehicleId, request != nullptr);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_LEASE_PARK, request != nullptr, token, vehicleId, 0,
+                               request != nullptr ? request->getAllocatedSlotId() : 0);
+    }
+    afterWrite();
+    return request;
+}
+
+// Unlinks the lease and frees what it still holds, waiters first
+int ParkingSystem::unlease(LeaseNode** link) {
+    LeaseNode* lease = *link;
+    *link = lease->next;
+    int returned = lease->count;
+    while (lease->count > 0) {
+        freeSlot(lease->slots[--lease->count]);
+    }
+    stats->add(STAT_LEASE_RETURNED, returned);
+    delete lease;
+    return returned;
+}
+
+bool ParkingSystem::returnLease(int token) {
+    LeaseNode** link = &leases;
+    while (*link != nullptr && (*link)->token != token) {
+        link = &(*link)->next;
+    }
+    bool result = *link != nullptr;
+    if (result) {
+        unlease(link);
+    }
+    if (recorder != nullptr) {
+        recorder->recordUnlease(token, result);
+    }
+    if (replicationLog != nullptr) {
+        replicationLog->append(TRACE_UNLEASE, result, token, nullptr, 0);
+    }
+    afterWrite();
+    return result;
+}
+
+// Each expiry is recorded as a return, so replicas and replays give the
+// slots back at the same point whatever their clocks say
+int ParkingSystem::expireLeases(long long now) {
+    int expired = 0;
+    LeaseNode** link = &leases;
+    while (*link != nullptr) {
+        LeaseNode* lease = *link;
+        if (lease->expiresAt > now) {
+            link = &lease->next;
+            continue;
+        }
+        int token = lease->token;
+        unlease(link);
+        if (recorder != nullptr) {
+            recorder->recordUnlease(token, true);
+        }
+        if (replicationLog != nullptr) {
+            replicationLog->append(TRACE_UNLEASE, true, token, nullptr, 0);
+        }
+        expired++;
+    }
+    if (expired > 0) {
+        afterWrite();
+    }
+    return expired;
+}
+
+int ParkingSystem::getLeaseRemaining(int token) const {
+    LeaseNode* lease = findLease(token);
+    return lease != nullptr ? lease->count : -1;
+}
+
+int ParkingSystem::getLeasedSlotCount() const {
+    int count = 0;
+    for (LeaseNode* lease = leases; lease != nullptr; lease = lease->next) {
+        count += lease->count;
+    }
+    return count;
+}
+
+// Pressure: a request the allocator found nothing for takes a slot back
+// from a lease, one in the zone it asked for if there is one
+ParkingSlot* ParkingSystem::reclaimLeasedSlot(const ParkingRequest* request) {
+    unsigned mask = 1u << request->getRequiredClass();
+    if (request->allowsFallback()) mask |= 1u << SLOT_STANDARD;
+    LeaseNode** found = nullptr;
+    for (LeaseNode** link = &leases; *link != nullptr; link = &(*link)->next) {
+        LeaseNode* lease = *link;
+        if ((mask & 1u << lease->slotClass) == 0 || getZone(lease->zoneId)->isClosed()) continue;
+        found = link;
+        if (lease->zoneId == request->getRequestedZone()) break;
+    }
+    if (found == nullptr) return nullptr;
+    
+    LeaseNode* lease = *found;
+    ParkingSlot* slot = lease->slots[--lease->count];
+    if (lease->count == 0) {
+        unlease(found);
+    }
+    stats->add(STAT_LEASE_RECLAIMED, 1);
+    return slot;
 }
 
 void ParkingSystem::displayZoneStatus() const {
@@ -157,9 +800,8 @@ void ParkingSystem::displayZoneStatus() const {
 
 void ParkingSystem::displayRequestHistory() const {
     std::cout << "\n=== Request History ===\n";
-    RequestNode* current = requestHistoryHead;
-    while (current != nullptr) {
-        ParkingRequest* req = current->request;
+    for (int id = 1; id <= requests.getCount(); id++) {
+        ParkingRequest* req = requests.get(id);
         std::cout << "Request #" << req->getRequestId() 
                   << " | Vehicle: " << req->getVehicleId()
                   << " | Requested Zone: " << req->getRequestedZone()
@@ -175,11 +817,10 @@ void ParkingSystem::displayRequestHistory() const {
             std::cout << " | Slot: " << req->getAllocatedSlotId()
                       << " in Zone " << req->getAllocatedZone();
             if (req->hasCrossZonePenalty()) {
-                std::cout << " [CROSS-ZONE PENALTY]";
+                std::cout << " [CROSS-ZONE PENALTY, " << req->getCrossZoneDistance() << " km]";
             }
         }
         std::cout << "\n";
-        current = current->next;
     }
 }
 
@@ -192,9 +833,8 @@ void ParkingSystem::displayAnalytics() const {
     long long totalDuration = 0;
     int zoneUsage[10] = {0};
     
-    RequestNode* current = requestHistoryHead;
-    while (current != nullptr) {
-        ParkingRequest* req = current->request;
+    for (int id = 1; id <= requests.getCount(); id++) {
+        ParkingRequest* req = requests.get(id);
         totalRequests++;
         
         if (req->getState() == RELEASED) {
@@ -207,8 +847,6 @@ void ParkingSystem::displayAnalytics() const {
         if (req->getAllocatedZone() >= 0 && req->getAllocatedZone() < 10) {
             zoneUsage[req->getAllocatedZone()]++;
         }
-        
-        current = current->next;
     }
     
     std::cout << "Total Requests: " << totalRequests << "\n";
@@ -242,34 +880,356 @@ void ParkingSystem::displayAnalytics() const {
     }
 }
 
-Zone* ParkingSystem::getZone(int zoneId) const {
-    for (int i = 0; i < zoneCount; i++) {
-        if (zones[i]->getZoneId() == zoneId) {
-            return zones[i];
+void ParkingSystem::dumpStats(std::ostream& out, StatsFormat format) const {
+    if (format == STATS_PROMETHEUS) {
+        stats->write(out, format);
+        out << "# TYPE parking_zone_available_slots gauge\n";
+        for (int i = 0; i < zoneCount; i++) {
+            out << "parking_zone_available_slots{zone=\"" << zones[i]->getZoneId() << "\"} "
+                << zones[i]->getAvailableSlots() << "\n";
+        }
+        out << "# TYPE parking_zone_total_slots gauge\n";
+        for (int i = 0; i < zoneCount; i++) {
+            out << "parking_zone_total_slots{zone=\"" << zones[i]->getZoneId() << "\"} "
+                << zones[i]->getTotalSlots() << "\n";
+        }
+        out << "# TYPE parking_allocation_policy_info gauge\n";
+        out << "parking_allocation_policy_info{policy=\"" << AllocationEngine::policyName(allocationPolicy)
+            << "\"} 1\n";
+        out << "# TYPE parking_rollback_depth gauge\n";
+        out << "parking_rollback_depth " << rollbackMgr->getStackSize() << "\n";
+        if (waitlist != nullptr) {
+            out << "# TYPE parking_waitlist_waiting gauge\n";
+            out << "parking_waitlist_waiting " << waitlist->getWaitingCount() << "\n";
         }
+        MemoryStats::write(out, format);
+        return;
+    }
+    
+    out << "{\"engine\":";
+    stats->write(out, format);
+    out << ",\"zones\":[";
+    for (int i = 0; i < zoneCount; i++) {
+        if (i > 0) out << ",";
+        out << "{\"zone\":" << zones[i]->getZoneId()
+            << ",\"available\":" << zones[i]->getAvailableSlots()
+            << ",\"total\":" << zones[i]->getTotalSlots() << "}";
+    }
+    out << "],\"policy\":\"" << AllocationEngine::policyName(allocationPolicy)
+        << "\",\"rollbackDepth\":" << rollbackMgr->getStackSize();
+    if (waitlist != nullptr) {
+        out << ",\"waitlist\":{\"mode\":\"" << Waitlist::modeName(waitlist->getMode())
+            << "\",\"waiting\":" << waitlist->getWaitingCount() << "}";
+    }
+    out << ",\"memory\":";
+    MemoryStats::write(out, format);
+    out << "}\n";
+}
+
+const EngineStats* ParkingSystem::getStats() const {
+    return stats;
+}
+
+Zone* ParkingSystem::getZone(int zoneId) const {
+    int position = getZonePosition(zoneId);
+    return position >= 0 ? zones[position] : nullptr;
+}
+
+int ParkingSystem::getZonePosition(int zoneId) const {
+    if (zoneId < 0 || zoneId >= zonePositionByIdCapacity) return -1;
+    return zonePositionById[zoneId];
+}
+
+// Ranges run in zone order (the order zones were added), from the first
+// zone through the last one inclusive
+int ParkingSystem::countAvailableSlots(int firstZoneId, int lastZoneId) const {
+    int first = getZonePosition(firstZoneId);
+    int last = getZonePosition(lastZoneId);
+    if (first < 0 || last < 0) return 0;
+    return zoneTree.count(first, last);
+}
+
+ParkingSlot* ParkingSystem::findFirstFreeSlot(int firstZoneId, int lastZoneId, unsigned classMask) const {
+    int first = getZonePosition(firstZoneId);
+    int last = getZonePosition(lastZoneId);
+    if (first < 0 || last < 0) return nullptr;
+    
+    int position = zoneTree.findFirst(first, last, classMask);
+    return position >= 0 ? zones[position]->findFirstFreeSlot(classMask) : nullptr;
+}
+
+Zone* ParkingSystem::getZoneAt(int index) const {
+    if (index >= 0 && index < zoneCount) {
+        return zones[index];
     }
     return nullptr;
 }
 
+int ParkingSystem::getZoneCount() const {
+    return zoneCount;
+}
+
+const RequestStore& ParkingSystem::getRequests() const {
+    return requests;
+}
+
+int ParkingSystem::getRollbackDepth() const {
+    return rollbackMgr->getStackSize();
+}
+
+AllocationPolicy ParkingSystem::getAllocationPolicy() const {
+    return allocationPolicy;
+}
+
+void ParkingSystem::setTraceRecorder(TraceRecorder* traceRecorder) {
+    recorder = traceRecorder;
+}
+
+void ParkingSystem::setReplicationLog(ReplicationLog* log) {
+    replicationLog = log;
+}
+
+void ParkingSystem::enableWaitlist(WaitlistMode mode) {
+    if (waitlist != nullptr || mode == WAITLIST_OFF) return;
+    waitlist = new Waitlist(requests, mode);
+}
+
+const Waitlist* ParkingSystem::getWaitlist() const {
+    return waitlist;
+}
+
+void ParkingSystem::enableOccupancy() {
+    if (occupancy != nullptr) return;
+    occupancy = new OccupancySeries();
+    for (int i = 0; i < zoneCount; i++) {
+        recordOccupancy(zones[i]);
+    }
+}
+
+const OccupancySeries* ParkingSystem::getOccupancy() const {
+    return occupancy;
+}
+
+void ParkingSystem::enableAffinity(int entries) {
+    if (affinity != nullptr || entries <= 0) return;
+    affinity = new AffinityCache(entries);
+    engine->setAffinityCache(affinity);
+}
+
+const AffinityCache* ParkingSystem::getAffinityCache() const {
+    return affinity;
+}
+
+void ParkingSystem::rememberSlot(const ParkingRequest* request, ParkingSlot* slot) {
+    if (affinity != nullptr) {
+        affinity->remember(request->getPlate(), slot);
+    }
+}
+
+void ParkingSystem::recordOccupancy(const Zone* zone) {
+    if (occupancy != nullptr) {
+        occupancy->record(zone->getPosition(), virtualClock ? currentTime : OccupancySeries::nowMillis(),
+                          zone->getTotalSlots() - zone->getAvailableSlots());
+    }
+}
+
+// Every request still REQUESTED is waiting: with a waitlist, ones that
+// cannot wait are cancelled at once
+bool ParkingSystem::isWaiting(const ParkingRequest* request) const {
+    return waitlist != nullptr && request->getState() == REQUESTED;
+}
+
+void ParkingSystem::freeSlot(ParkingSlot* slot) {
+    slot->release();
+    assignFromWaitlist(slot);
+}
+
+// Hands a slot that just became free to the head waiter that can use it
+void ParkingSystem::assignFromWaitlist(ParkingSlot* slot) {
+    if (waitlist == nullptr || !slot->isAvailable()) return;
+    int position = getZonePosition(slot->getZoneId());
+    if (zones[position]->isClosed()) return;
+    int requestId = waitlist->take(position, slot->getSlotClass());
+    if (requestId == 0) return;
+    
+    ParkingRequest* request = requests.get(requestId);
+    int requestedPosition = getZonePosition(request->getRequestedZone());
+    bool crossZone = requestedPosition != position;
+    double distance = 0;
+    if (crossZone && requestedPosition >= 0 && zoneIndex.isActive()) {
+        distance = zoneIndex.distanceBetween(requestedPosition, position);
+    }
+    slot->occupy();
+    request->allocate(slot->getZoneId(), slot->getSlotId(), currentTime, crossZone, distance);
+    request->occupy(currentTime);
+    allocatedSlots[requestId] = slot;
+    slot->setOccupant(requestId);
+    rememberSlot(request, slot);
+    rollbackMgr->pushAllocation(request, slot);
+    stats->add(STAT_WAITLIST_ASSIGNED, 1);
+    publishRequest(request);
+}
+
+void ParkingSystem::serveWaitlist(Zone* zone) {
+    if (waitlist == nullptr) return;
+    for (int i = 0; i < zone->getTotalSlots(); i++) {
+        assignFromWaitlist(zone->getSlotAt(i));
+    }
+}
+
+ChangeFeed* ParkingSystem::getChangeFeed() const {
+    return changeFeed;
+}
+
+void ParkingSystem::enableSnapshots() {
+    if (snapshots != nullptr) return;
+    snapshots = new SnapshotStore();
+    for (int i = 0; i < zoneCount; i++) {
+        snapshots->markZone(i);
+    }
+    for (int id = 1; id <= requests.getCount(); id++) {
+        snapshots->markRequest(id);
+    }
+    publishSnapshot();
+}
+
+SnapshotStore* ParkingSystem::getSnapshots() const {
+    return snapshots;
+}
+
+bool ParkingSystem::publishSnapshot() {
+    if (snapshots == nullptr) return false;
+    return snapshots->publish(zones, zoneCount, requests, currentTime,
+                              rollbackMgr->getStackSize());
+}
+
+void ParkingSystem::afterWrite() {
+    if (snapshots != nullptr && snapshots->due()) {
+        publishSnapshot();
+    }
+}
+
+// A closed zone shows no free slots to the allocator, whatever it holds
+void ParkingSystem::refreshZone(Zone* zone) {
+    bool open = !zone->isClosed();
+    unsigned mask = open ? zone->getFreeClassMask() : 0;
+    zoneTree.set(zone->getPosition(), open ? zone->getAvailableSlots() : 0, mask);
+    zoneIndex.update(zone->getPosition(), mask);
+}
+
+void ParkingSystem::onSlotAdded(Zone* zone, ParkingSlot*) {
+    refreshZone(zone);
+    if (snapshots != nullptr) {
+        snapshots->markZone(zone->getPosition());
+    }
+    recordOccupancy(zone);
+}
+
+void ParkingSystem::onSlotChanged(Zone* zone, ParkingSlot* slot) {
+    refreshZone(zone);
+    if (snapshots != nullptr) {
+        snapshots->markZone(zone->getPosition());
+    }
+    recordOccupancy(zone);
+    
+    ChangeEvent event;
+    event.time = currentTime;
+    event.type = CHANGE_SLOT;
+    event.zoneId = zone->getZoneId();
+    event.slotId = slot->getSlotId();
+    event.requestId = 0;
+    event.state = slot->isAvailable() ? 1 : 0;
+    event.zoneAvailable = zone->getAvailableSlots();
+    event.slotClass = slot->getSlotClass();
+    event.classAvailable = zone->getAvailableSlots(slot->getSlotClass());
+    event.requestedZone = -1;
+    event.crossZone = false;
+    event.distance = 0;
+    event.vehicleId[0] = '\0';
+    changeFeed->append(event);
+}
+
+void ParkingSystem::publishRequest(const ParkingRequest* request) {
+    if (snapshots != nullptr) {
+        snapshots->markRequest(request->getRequestId());
+    }
+    ChangeEvent event;
+    event.time = currentTime;
+    event.type = CHANGE_REQUEST;
+    event.zoneId = request->getAllocatedZone();
+    event.slotId = request->getAllocatedSlotId();
+    event.requestId = request->getRequestId();
+    event.state = request->getState();
+    event.zoneAvailable = -1;
+    event.slotClass = request->getRequiredClass();
+    event.classAvailable = -1;
+    event.requestedZone = request->getRequestedZone();
+    event.crossZone = request->hasCrossZonePenalty();
+    event.distance = request->getCrossZoneDistance();
+    strncpy(event.vehicleId, request->getVehicleId(), CHANGE_VEHICLE_LEN - 1);
+    event.vehicleId[CHANGE_VEHICLE_LEN - 1] = '\0';
+    changeFeed->append(event);
+}
+
 ParkingRequest* ParkingSystem::findRequest(int requestId) const {
-    RequestNode* current = requestHistoryHead;
-    while (current != nullptr) {
-        if (current->request->getRequestId() == requestId) {
-            return current->request;
-        }
-        current = current->next;
-    }
- return nullptr;
- }
- void ParkingSystem::addToHistory(ParkingRequest* request) {
-    RequestNode* newNode = new RequestNode(request);
-if (requestHistoryTail == nullptr) {
- requestHistoryHead = requestHistoryTail = newNode;
- } else {
-    requestHistoryTail->next = newNode;
-     requestHistoryTail = newNode;
-      }
-      }
+    ScopedStatTimer timer(stats, TIMER_FIND_REQUEST);
+    if (requestId <= 0 || requestId > requests.getCount()) return nullptr;
+    return requests.get(requestId);
+}
+
+ParkingRequest* ParkingSystem::findLatestRequest(const char* vehicleId) const {
+    int plate = requests.getPlates().find(vehicleId);
+    if (plate < 0) return nullptr;
+    return requests.get(latestByPlate[plate]);
+}
+
+ParkingSlot* ParkingSystem::findAllocatedSlot(int requestId) const {
+    if (requestId <= 0 || requestId > requests.getCount()) return nullptr;
+    return allocatedSlots[requestId];
+}
+
+ParkingRequest* ParkingSystem::newRequest(const char* vehicleId, int requestedZone, long long reqTime,
+                                          SlotClass slotClass, bool fallback) {
+    ParkingRequest* request = requests.create(vehicleId, requestedZone, reqTime, slotClass, fallback);
+    
+    // Request IDs are sequential, so the slot index is a plain array by ID
+    int requestId = request->getRequestId();
+    if (requestId >= allocatedSlotsCapacity) {
+        int newCapacity = allocatedSlotsCapacity * 2;
+        while (newCapacity <= requestId) newCapacity *= 2;
+        ParkingSlot** grown = trackedArray<ParkingSlot*>(MEMORY_REQUESTS, newCapacity);
+        for (int i = 0; i < allocatedSlotsCapacity; i++) {
+            grown[i] = allocatedSlots[i];
+        }
+        trackedFree(MEMORY_REQUESTS, allocatedSlots, allocatedSlotsCapacity);
+        allocatedSlots = grown;
+        allocatedSlotsCapacity = newCapacity;
+    }
+    allocatedSlots[requestId] = nullptr;
+    
+    unsigned plate = request->getPlate();
+    if (plate >= (unsigned)latestByPlateCapacity) {
+        int newCapacity = latestByPlateCapacity * 2;
+        while ((unsigned)newCapacity <= plate) newCapacity *= 2;
+        int* grown = trackedArray<int>(MEMORY_REQUESTS, newCapacity);
+        for (int i = 0; i < latestByPlateCapacity; i++) {
+            grown[i] = latestByPlate[i];
+        }
+        trackedFree(MEMORY_REQUESTS, latestByPlate, latestByPlateCapacity);
+        latestByPlate = grown;
+        latestByPlateCapacity = newCapacity;
+    }
+    latestByPlate[plate] = requestId;
+    return request;
+}
+
 long long ParkingSystem::getCurrentTime() {
-    return ++currentTime;
+    return virtualClock ? currentTime : ++currentTime;
+}
+
+void ParkingSystem::setVirtualTime(long long time) {
+    virtualClock = true;
+    if (time > currentTime) {
+        currentTime = time;
+    }
 }
\ No newline at end of file
@@ -1,49 +1,220 @@
 #ifndef PARKINGSYSTEM_H
 #define PARKINGSYSTEM_H
 
-class Zone;
+#include <iosfwd>
+#include "EngineStats.h"
+#include "Zone.h"
+#include "AllocationEngine.h"
+#include "AvailabilityTree.h"
+#include "ZoneSpatialIndex.h"
+#include "RequestStore.h"
+#include "Waitlist.h"
+#include "MemoryStats.h"
+
+class ParkingSlot;
+class ParkingArea;
 class ParkingRequest;
-class AllocationEngine;
 class RollbackManager;
+class TraceRecorder;
+class ChangeFeed;
+class ReplicationLog;
+class SnapshotStore;
+class OccupancySeries;
+class AffinityCache;
+struct DrainRecord;
 
-struct RequestNode {
-    ParkingRequest* request;
-    RequestNode* next;
-    
-    RequestNode(ParkingRequest* req) : request(req), next(nullptr) {}
+// A slot held for another shard's request until it is confirmed, aborted or
+// expires (two-phase cross-shard allocation)
+struct ReservationNode : public Tracked<MEMORY_HOLDS> {
+    int token;
+    ParkingSlot* slot;
+    int zoneId;
+    double distance;
+    long long expiresAt;
+    ReservationNode* next;
+};
+
+const int LEASE_MAX_SLOTS = 32;
+
+// Free slots of one class in one zone held for a gate, which parks vehicles
+// in them without an engine search. The slots are occupied with no
+// occupant, like a reservation's, until a vehicle is parked in one or the
+// lease gives it back
+struct LeaseNode : public Tracked<MEMORY_HOLDS> {
+    int token;
+    int zoneId;
+    SlotClass slotClass;
+    ParkingSlot* slots[LEASE_MAX_SLOTS];
+    int count;              // unused slots left, handed out from the end
+    long long expiresAt;
+    LeaseNode* next;
+};
+
+// What a zone drain did with the vehicles parked in the zone
+struct DrainResult {
+    int moved;
+    int crossZone;          // of those moved, ones that ended up outside their requested zone
+    int cancelled;          // nothing could take them
 };
 
-class ParkingSystem {
+class ParkingSystem : public SlotListener {
 private:
     Zone** zones;
     int zoneCount;
     int zoneCapacity;
+    int areaCount;                  // across zones, as added through the system
     AllocationEngine* engine;
+    AllocationPolicy allocationPolicy;
     RollbackManager* rollbackMgr;
-    RequestNode* requestHistoryHead;
-    RequestNode* requestHistoryTail;
-    int nextRequestId;
+    RequestStore requests;          // every request by ID, in creation order
+    ParkingSlot** allocatedSlots;   // by request ID, nullptr if none
+    int allocatedSlotsCapacity;
+    int* latestByPlate;             // by plate handle, the plate's newest request ID
+    int latestByPlateCapacity;
     long long currentTime;
+    bool virtualClock;              // currentTime is set by a simulation, not ticked
+    TraceRecorder* recorder;
+    ReplicationLog* replicationLog;
+    SnapshotStore* snapshots;       // published views for readers on other threads
+    Waitlist* waitlist;             // requests waiting for a slot, nullptr if disabled
+    OccupancySeries* occupancy;     // occupied slots per zone over time, nullptr if disabled
+    AffinityCache* affinity;        // last slot of returning vehicles, nullptr if disabled
+    EngineStats* stats;
+    ChangeFeed* changeFeed;
+    AvailabilityTree zoneTree;      // free slots per zone, in zone array order
+    ZoneSpatialIndex zoneIndex;     // zones by location, active once every zone has one
+    int* zonePositionById;
+    int zonePositionByIdCapacity;
+    ReservationNode* reservations;
+    int nextReservationToken;
+    LeaseNode* leases;
+    int nextLeaseToken;
 
 public:
-    ParkingSystem(int maxZones);
+    // initialZones is a capacity hint; zones, areas and slots can be added
+    // at any time
+    ParkingSystem(int initialZones, AllocationPolicy policy = POLICY_FIRST_FIT);
     ~ParkingSystem();
     
     bool addZone(Zone* zone);
-    ParkingRequest* createRequest(const char* vehicleId, int requestedZone);
+    // Opens a new area of slotCount slots in a zone while serving, creating
+    // the zone (at x, y if located) when it does not exist; waiters that can
+    // use the new slots get them at once. nullptr for a bad zone or count
+    ParkingArea* addArea(int zoneId, int slotCount, SlotClass slotClass = SLOT_STANDARD,
+                         bool located = false, double x = 0, double y = 0);
+    ParkingRequest* createRequest(const char* vehicleId, int requestedZone,
+                                  SlotClass slotClass = SLOT_STANDARD, bool fallback = false,
+                                  int priority = 0);
     bool cancelRequest(int requestId);
     bool releaseParking(int requestId);
     bool rollbackAllocations(int k);
     
+    // Closes a zone to the allocator and moves every vehicle parked there
+    // to the slot it would be given now; vehicles with nowhere to go are
+    // cancelled. The whole drain is one rollback step, which reopens the zone
+    bool drainZone(int zoneId, DrainResult* result = nullptr);
+    bool reopenZone(int zoneId);
+    
+    int reserveSlot(double x, double y, SlotClass slotClass, bool fallback, long long expiresAt,
+                    ParkingSlot** reservedSlot, double& distance);
+    ParkingRequest* confirmReservation(int token, const char* vehicleId, int requestedZone,
+                                       SlotClass slotClass, bool fallback);
+    bool abortReservation(int token);
+    int expireReservations(long long now);
+    int getReservationCount() const;
+    
+    // Slot leases for busy gates. A lease holds up to count (at most
+    // LEASE_MAX_SLOTS) free slots of the class in the zone, but never more
+    // than half of them; 0 if that is none. parkLeased parks a vehicle in
+    // one of them with no search, nullptr for a closed zone or an unknown
+    // token; the lease ends with its last slot. Unused slots go back when the
+    // lease is returned or expires, and one at a time when a request would
+    // otherwise find nothing
+    int leaseSlots(int zoneId, SlotClass slotClass, int count, long long expiresAt);
+    ParkingRequest* parkLeased(int token, const char* vehicleId);
+    bool returnLease(int token);
+    int expireLeases(long long now);
+    int getLeaseRemaining(int token) const;     // -1 for an unknown token
+    int getLeasedSlotCount() const;
+    
     void displayZoneStatus() const;
     void displayRequestHistory() const;
     void displayAnalytics() const;
+    void dumpStats(std::ostream& out, StatsFormat format) const;
+    const EngineStats* getStats() const;
     
     Zone* getZone(int zoneId) const;
+    Zone* getZoneAt(int index) const;
+    int getZoneCount() const;
+    int getZonePosition(int zoneId) const;
+    int countAvailableSlots(int firstZoneId, int lastZoneId) const;
+    ParkingSlot* findFirstFreeSlot(int firstZoneId, int lastZoneId,
+                                   unsigned classMask = ALL_SLOT_CLASSES) const;
     ParkingRequest* findRequest(int requestId) const;
+    // The vehicle's most recent request, nullptr if it never made one
+    ParkingRequest* findLatestRequest(const char* vehicleId) const;
+    ParkingSlot* findAllocatedSlot(int requestId) const;
+    const RequestStore& getRequests() const;
+    int getRollbackDepth() const;
+    AllocationPolicy getAllocationPolicy() const;
+    
+    // From now on operations are stamped with the time given here, in
+    // milliseconds, instead of one tick each; time never goes backwards
+    void setVirtualTime(long long time);
+    
+    void setTraceRecorder(TraceRecorder* traceRecorder);
+    void setReplicationLog(ReplicationLog* log);
+    
+    // With a waitlist, requests nothing can be found for wait (still
+    // REQUESTED) and are handed the first usable slot that is released,
+    // cancelled or rolled back; requests with nowhere to wait are cancelled
+    void enableWaitlist(WaitlistMode mode);
+    const Waitlist* getWaitlist() const;
+    bool isWaiting(const ParkingRequest* request) const;
+    
+    // Records every zone's occupied count, against the wall clock, on each change
+    // (against the virtual clock once one is set)
+    void enableOccupancy();
+    const OccupancySeries* getOccupancy() const;
+    
+    // Remembers the slot each of the last `entries` vehicles parked in and
+    // gives it back when the vehicle returns to that zone and it is free.
+    // Slots a drain moves vehicles to are not remembered.
+    void enableAffinity(int entries);
+    const AffinityCache* getAffinityCache() const;
+    
+    // Readers on other threads query published snapshots instead of the
+    // live structures; writes publish at most about once a millisecond,
+    // publishSnapshot() brings the view up to date immediately
+    void enableSnapshots();
+    SnapshotStore* getSnapshots() const;
+    bool publishSnapshot();
+    ChangeFeed* getChangeFeed() const;
+    void onSlotChanged(Zone* zone, ParkingSlot* slot) override;
+    void onSlotAdded(Zone* zone, ParkingSlot* slot) override;
     
 private:
-    void addToHistory(ParkingRequest* request);
+    bool cancelRequestInternal(int requestId);
+    bool releaseParkingInternal(int requestId);
+    bool drainZoneInternal(int zoneId, DrainResult& result);
+    bool reopenZoneInternal(int zoneId);
+    ParkingArea* addAreaInternal(int zoneId, int slotCount, SlotClass slotClass, bool located,
+                                 double x, double y);
+    void undoDrain(DrainRecord* drain);
+    ParkingRequest* newRequest(const char* vehicleId, int requestedZone, long long reqTime,
+                               SlotClass slotClass, bool fallback);
+    ReservationNode* takeReservation(int token);
+    LeaseNode* findLease(int token) const;
+    int unlease(LeaseNode** link);
+    ParkingSlot* reclaimLeasedSlot(const ParkingRequest* request);
+    void freeSlot(ParkingSlot* slot);
+    void assignFromWaitlist(ParkingSlot* slot);
+    void rememberSlot(const ParkingRequest* request, ParkingSlot* slot);
+    void serveWaitlist(Zone* zone);
+    void refreshZone(Zone* zone);
+    void publishRequest(const ParkingRequest* request);
+    void recordOccupancy(const Zone* zone);
+    void afterWrite();
     long long getCurrentTime();
 };
 
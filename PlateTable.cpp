@@ -0,0 +1,157 @@
+#include "PlateTable.h"
+#include <cstring>
+#include "MemoryStats.h"
+
+static const int ARENA_BYTES = 65536;
+
+PlateTable::PlateTable()
+    : blockCapacity(PLATE_INITIAL_BLOCKS), directoryCount(1), count(0), arena(nullptr), arenaUsed(0),
+      arenaSize(0), arenaCount(0), arenaCapacity(16), textBytes(0), bucketCapacity(1024) {
+    directories[0] = trackedArray<const char**>(MEMORY_STRINGS, blockCapacity);
+    for (int i = 0; i < blockCapacity; i++) {
+        directories[0][i] = nullptr;
+    }
+    blocks.store(directories[0], std::memory_order_relaxed);
+    arenas = trackedArray<char*>(MEMORY_STRINGS, arenaCapacity);
+    buckets = trackedArray<unsigned>(MEMORY_STRINGS, bucketCapacity);
+    for (int i = 0; i < bucketCapacity; i++) {
+        buckets[i] = 0;
+    }
+}
+
+PlateTable::~PlateTable() {
+    const char*** directory = blocks.load(std::memory_order_relaxed);
+    for (int i = 0; i < blockCapacity && directory[i] != nullptr; i++) {
+        trackedFree(MEMORY_STRINGS, directory[i], PLATE_BLOCK_SIZE);
+    }
+    for (int i = 0; i < directoryCount; i++) {
+        trackedFree(MEMORY_STRINGS, directories[i], PLATE_INITIAL_BLOCKS << i);
+    }
+    for (int i = 0; i < arenaCount; i++) {
+        delete[] arenas[i];
+    }
+    MemoryStats::freed(MEMORY_STRINGS, textBytes, count);
+    trackedFree(MEMORY_STRINGS, arenas, arenaCapacity);
+    trackedFree(MEMORY_STRINGS, buckets, bucketCapacity);
+}
+
+// FNV-1a
+unsigned PlateTable::hash(const char* text) {
+    unsigned h = 2166136261u;
+    for (const char* p = text; *p != '\0'; p++) {
+        h = (h ^ (unsigned char)*p) * 16777619u;
+    }
+    return h;
+}
+
+const char* PlateTable::store(const char* text, int len) {
+    if (arenaUsed + len + 1 > arenaSize) {
+        int size = len + 1 > ARENA_BYTES ? len + 1 : ARENA_BYTES;
+        if (arenaCount == arenaCapacity) {
+            int newCapacity = arenaCapacity * 2;
+            char** grown = trackedArray<char*>(MEMORY_STRINGS, newCapacity);
+            for (int i = 0; i < arenaCount; i++) {
+                grown[i] = arenas[i];
+            }
+            trackedFree(MEMORY_STRINGS, arenas, arenaCapacity);
+            arenas = grown;
+            arenaCapacity = newCapacity;
+        }
+        arena = new char[size];
+        arenas[arenaCount++] = arena;
+        arenaUsed = 0;
+        arenaSize = size;
+        textBytes += size;
+        MemoryStats::allocated(MEMORY_STRINGS, size);
+    }
+    char* copy = arena + arenaUsed;
+    memcpy(copy, text, len + 1);
+    arenaUsed += len + 1;
+    return copy;
+}
+
+void PlateTable::growBuckets() {
+    int newCapacity = bucketCapacity * 2;
+    unsigned* grown = trackedArray<unsigned>(MEMORY_STRINGS, newCapacity);
+    for (int i = 0; i < newCapacity; i++) {
+        grown[i] = 0;
+    }
+    for (int i = 0; i < bucketCapacity; i++) {
+        if (buckets[i] == 0) continue;
+        unsigned b = hash(lookup(buckets[i] - 1)) & (newCapacity - 1);
+        while (grown[b] != 0) b = (b + 1) & (newCapacity - 1);
+        grown[b] = buckets[i];
+    }
+    trackedFree(MEMORY_STRINGS, buckets, bucketCapacity);
+    buckets = grown;
+    bucketCapacity = newCapacity;
+}
+
+// Readers may still hold the old directory; it stays valid for every
+// handle it covered until the table is destroyed
+void PlateTable::growDirectory() {
+    const char*** current = blocks.load(std::memory_order_relaxed);
+    int newCapacity = blockCapacity * 2;
+    const char*** grown = trackedArray<const char**>(MEMORY_STRINGS, newCapacity);
+    for (int i = 0; i < newCapacity; i++) {
+        grown[i] = i < blockCapacity ? current[i] : nullptr;
+    }
+    directories[directoryCount++] = grown;
+    blockCapacity = newCapacity;
+    blocks.store(grown, std::memory_order_release);
+}
+
+unsigned PlateTable::intern(const char* plate) {
+    unsigned b = hash(plate) & (bucketCapacity - 1);
+    while (buckets[b] != 0) {
+        if (strcmp(lookup(buckets[b] - 1), plate) == 0) return buckets[b] - 1;
+        b = (b + 1) & (bucketCapacity - 1);
+    }
+
+    unsigned handle = count;
+    int block = handle >> PLATE_BLOCK_BITS;
+    if (block == blockCapacity) {
+        growDirectory();
+    }
+    const char*** directory = blocks.load(std::memory_order_relaxed);
+    if (directory[block] == nullptr) {
+        directory[block] = trackedArray<const char*>(MEMORY_STRINGS, PLATE_BLOCK_SIZE);
+    }
+    directory[block][handle & (PLATE_BLOCK_SIZE - 1)] = store(plate, (int)strlen(plate));
+    count++;
+    MemoryStats::allocated(MEMORY_STRINGS, 0, 1);
+    buckets[b] = handle + 1;
+    if (count * 2 > bucketCapacity) {
+        growBuckets();
+    }
+    return handle;
+}
+
+int PlateTable::find(const char* plate) const {
+    unsigned b = hash(plate) & (bucketCapacity - 1);
+    while (buckets[b] != 0) {
+        if (strcmp(lookup(buckets[b] - 1), plate) == 0) return (int)(buckets[b] - 1);
+        b = (b + 1) & (bucketCapacity - 1);
+    }
+    return -1;
+}
+
+const char* PlateTable::lookup(unsigned handle) const {
+    const char*** directory = blocks.load(std::memory_order_acquire);
+    return directory[handle >> PLATE_BLOCK_BITS][handle & (PLATE_BLOCK_SIZE - 1)];
+}
+
+int PlateTable::getCount() const {
+    return count;
+}
+
+long long PlateTable::getMemoryBytes() const {
+    long long blockBytes = (long long)((count + PLATE_BLOCK_SIZE - 1) / PLATE_BLOCK_SIZE) *
+                           PLATE_BLOCK_SIZE * sizeof(const char*);
+    long long directoryBytes = 0;
+    for (int i = 0; i < directoryCount; i++) {
+        directoryBytes += (long long)(PLATE_INITIAL_BLOCKS << i) * sizeof(const char**);
+    }
+    return (long long)sizeof(*this) + directoryBytes + blockBytes + textBytes +
+           (long long)bucketCapacity * sizeof(unsigned);
+}
@@ -0,0 +1,54 @@
+#ifndef PLATETABLE_H
+#define PLATETABLE_H
+
+#include <atomic>
+
+const int PLATE_BLOCK_BITS = 16;
+const int PLATE_BLOCK_SIZE = 1 << PLATE_BLOCK_BITS;
+const int PLATE_INITIAL_BLOCKS = 64;
+const int PLATE_MAX_DIRECTORIES = 16;    // 64 << 15 blocks covers every 32-bit handle
+
+// Interns vehicle plates: each distinct plate is stored once and requests
+// keep a 32-bit handle to it. Handles resolve through a directory of
+// blocks. When the directory fills, a copy twice the size is published and
+// the old one is kept, so readers on other threads can look up any handle
+// they were handed while the writer keeps adding plates.
+class PlateTable {
+private:
+    std::atomic<const char***> blocks;          // current directory
+    int blockCapacity;
+    const char*** directories[PLATE_MAX_DIRECTORIES];   // every directory, freed with the table
+    int directoryCount;
+    int count;
+
+    // Plate text, packed into arenas that are never reallocated
+    char* arena;
+    int arenaUsed;
+    int arenaSize;
+    char** arenas;
+    int arenaCount;
+    int arenaCapacity;
+    long long textBytes;
+
+    // Open-addressed handle + 1 per bucket, 0 when empty; writer only
+    unsigned* buckets;
+    int bucketCapacity;
+
+    static unsigned hash(const char* text);
+    const char* store(const char* text, int len);
+    void growBuckets();
+    void growDirectory();
+
+public:
+    PlateTable();
+    ~PlateTable();
+
+    unsigned intern(const char* plate);
+    // Handle of a plate already interned, -1 if it never was; writer only
+    int find(const char* plate) const;
+    const char* lookup(unsigned handle) const;
+    int getCount() const;
+    long long getMemoryBytes() const;
+};
+
+#endif
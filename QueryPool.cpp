@@ -0,0 +1,122 @@
+#include "QueryPool.h"
+#include "ByteBuffer.h"
+#include "SnapshotStore.h"
+#include <cerrno>
+#include <cstdint>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+static const int QUEUE_DEPTH = 256;
+
+QueryRing::QueryRing(int capacity) : mask(capacity - 1), head(0), tail(0) {
+    jobs = new QueryJob[capacity];
+}
+
+QueryRing::~QueryRing() {
+    delete[] jobs;
+}
+
+bool QueryRing::push(const QueryJob& job) {
+    unsigned long long t = tail.load(std::memory_order_relaxed);
+    if (t - head.load(std::memory_order_acquire) > mask) return false;
+    jobs[t & mask] = job;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+bool QueryRing::pop(QueryJob& job) {
+    unsigned long long h = head.load(std::memory_order_relaxed);
+    if (h == tail.load(std::memory_order_acquire)) return false;
+    job = jobs[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+}
+
+static void notify(int fd) {
+    uint64_t one = 1;
+    while (write(fd, &one, sizeof(one)) < 0 && errno == EINTR) {}
+}
+
+QueryPool::QueryPool(SnapshotStore& snapshots, QueryRenderer renderer, int threads)
+    : store(snapshots), render(renderer), workerCount(threads), nextWorker(0), running(true) {
+    doneFd = eventfd(0, EFD_NONBLOCK);
+    workers = new QueryWorker[workerCount];
+    for (int i = 0; i < workerCount; i++) {
+        workers[i].jobs = new QueryRing(QUEUE_DEPTH);
+        workers[i].done = new QueryRing(QUEUE_DEPTH);
+        workers[i].wakeFd = eventfd(0, 0);
+        workers[i].inFlight = 0;
+        workers[i].thread = std::thread(&QueryPool::work, this, &workers[i]);
+    }
+}
+
+QueryPool::~QueryPool() {
+    running = false;
+    for (int i = 0; i < workerCount; i++) {
+        notify(workers[i].wakeFd);
+        workers[i].thread.join();
+    }
+    QueryJob job;
+    for (int i = 0; i < workerCount; i++) {
+        while (workers[i].done->pop(job)) {
+            delete job.body;
+        }
+        delete workers[i].jobs;
+        delete workers[i].done;
+        close(workers[i].wakeFd);
+    }
+    delete[] workers;
+    close(doneFd);
+}
+
+void QueryPool::work(QueryWorker* worker) {
+    QueryJob job;
+    while (true) {
+        if (worker->jobs->pop(job)) {
+            job.body = new ByteBuffer(65536);
+            {
+                SnapshotReader reader(store);
+                job.status = render(reader.get(), job, *job.body);
+            }
+            // inFlight keeps the done ring from filling
+            worker->done->push(job);
+            notify(doneFd);
+            continue;
+        }
+        if (!running) break;
+        uint64_t wakeups;
+        while (read(worker->wakeFd, &wakeups, sizeof(wakeups)) < 0 && errno == EINTR) {}
+    }
+}
+
+// Round-robin over workers with room
+bool QueryPool::submit(const QueryJob& job) {
+    for (int tried = 0; tried < workerCount; tried++) {
+        QueryWorker& worker = workers[nextWorker];
+        nextWorker = (nextWorker + 1) % workerCount;
+        if (worker.inFlight < QUEUE_DEPTH && worker.jobs->push(job)) {
+            worker.inFlight++;
+            notify(worker.wakeFd);
+            return true;
+        }
+    }
+    return false;
+}
+
+int QueryPool::getDoneFd() const {
+    return doneFd;
+}
+
+int QueryPool::collect(QueryJob* out, int max) {
+    uint64_t ignored;
+    while (read(doneFd, &ignored, sizeof(ignored)) < 0 && errno == EINTR) {}
+
+    int count = 0;
+    for (int i = 0; i < workerCount && count < max; i++) {
+        while (count < max && workers[i].done->pop(out[count])) {
+            workers[i].inFlight--;
+            count++;
+        }
+    }
+    return count;
+}
@@ -0,0 +1,75 @@
+#ifndef QUERYPOOL_H
+#define QUERYPOOL_H
+
+#include <atomic>
+#include <thread>
+
+class ByteBuffer;
+class SnapshotStore;
+class SystemSnapshot;
+
+struct QueryJob {
+    int fd;
+    long long connectionId;
+    int kind;
+    int arg;
+    bool keepAlive;
+    int status;             // set with body by the worker
+    ByteBuffer* body;
+};
+
+// Renders one job from a pinned snapshot; returns the HTTP status
+typedef int (*QueryRenderer)(const SystemSnapshot& snapshot, const QueryJob& job, ByteBuffer& out);
+
+// Single-producer single-consumer ring; the owner thread of each end never
+// blocks on the other
+class QueryRing {
+private:
+    QueryJob* jobs;
+    unsigned mask;
+    std::atomic<unsigned long long> head;
+    std::atomic<unsigned long long> tail;
+
+public:
+    QueryRing(int capacity);
+    ~QueryRing();
+
+    bool push(const QueryJob& job);
+    bool pop(QueryJob& job);
+};
+
+struct QueryWorker {
+    std::thread thread;
+    QueryRing* jobs;
+    QueryRing* done;
+    int wakeFd;             // eventfd the worker sleeps on
+    int inFlight;           // owned by the submitting thread
+};
+
+// Reader threads for expensive queries. The event loop submits a job and
+// goes back to allocating; a worker pins the newest snapshot, renders the
+// response and hands it back through doneFd, which the loop polls.
+class QueryPool {
+private:
+    SnapshotStore& store;
+    QueryRenderer render;
+    QueryWorker* workers;
+    int workerCount;
+    int nextWorker;
+    int doneFd;
+    std::atomic<bool> running;
+
+    void work(QueryWorker* worker);
+
+public:
+    QueryPool(SnapshotStore& snapshots, QueryRenderer renderer, int threads);
+    ~QueryPool();
+
+    // False when every worker already has a full queue
+    bool submit(const QueryJob& job);
+    int getDoneFd() const;
+    // Finished jobs, oldest first per worker; the caller deletes each body
+    int collect(QueryJob* out, int max);
+};
+
+#endif
@@ -0,0 +1,201 @@
+#include "Replica.h"
+#include "ParkingSystem.h"
+#include "ParkingRequest.h"
+#include "NetUtil.h"
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <unistd.h>
+
+static const int REPLICA_BUFFER_SIZE = 1 << 20;
+
+Replica::Replica()
+    : fd(-1), system(nullptr), filled(0), connected(false), appliedSeq(0), primarySeq(0),
+      lastLagNanos(0), maxLagNanos(0), divergences(0), bytesReceived(0) {
+    memset(&hello, 0, sizeof(hello));
+    buffer = new char[REPLICA_BUFFER_SIZE];
+}
+
+Replica::~Replica() {
+    if (fd >= 0) close(fd);
+    delete[] buffer;
+}
+
+bool Replica::connect(const char* socketPath) {
+    fd = connectUnix(socketPath);
+    if (fd < 0) return false;
+    if (!readFully(fd, (char*)&hello, sizeof(hello)) || memcmp(hello.magic, "SPRL", 4) != 0 ||
+        hello.version != REPLICATION_VERSION) {
+        close(fd);
+        fd = -1;
+        return false;
+    }
+    setNonBlocking(fd);
+    connected = true;
+    return true;
+}
+
+const ReplicationHello& Replica::getHello() const {
+    return hello;
+}
+
+void Replica::attach(ParkingSystem* target) {
+    system = target;
+}
+
+int Replica::getFd() const {
+    return fd;
+}
+
+// Bounded so a primary streaming faster than we apply cannot starve the
+// queries served from the same loop; the rest is picked up next time
+bool Replica::pump() {
+    for (int reads = 0; connected && reads < 16; reads++) {
+        ssize_t n = read(fd, buffer + filled, REPLICA_BUFFER_SIZE - filled);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) break;
+        if (n <= 0) {
+            connected = false;
+            break;
+        }
+        filled += (int)n;
+        bytesReceived += n;
+
+        int start = 0;
+        while (filled - start >= REPLICATION_RECORD_HEADER) {
+            int idLen = (unsigned char)buffer[start + 19];
+            if (idLen >= TRACE_MAX_VEHICLE_ID) {
+                // No primary writes a payload this long; the stream is not ours
+                connected = false;
+                break;
+            }
+            if (filled - start < REPLICATION_RECORD_HEADER + idLen) break;
+            apply(buffer + start, idLen);
+            start += REPLICATION_RECORD_HEADER + idLen;
+        }
+        memmove(buffer, buffer + start, filled - start);
+        filled -= start;
+    }
+    return connected;
+}
+
+int Replica::slotIdOf(const ParkingRequest* request) const {
+    if (request == nullptr) return 0;
+    ParkingSlot* slot = system->findAllocatedSlot(request->getRequestId());
+    return slot != nullptr ? slot->getSlotId() : 0;
+}
+
+void Replica::apply(const char* record, int idLen) {
+    long long seq;
+    long long nanos;
+    int arg;
+    int slotId;
+    memcpy(&seq, record, 8);
+    memcpy(&nanos, record + 8, 8);
+    memcpy(&arg, record + 20, 4);
+    memcpy(&slotId, record + 24, 4);
+    int op = record[16];
+    bool expected = record[17] != 0;
+    int classByte = (unsigned char)record[18];
+
+    if (seq > primarySeq) primarySeq = seq;
+    lastLagNanos = ReplicationLog::nowNanos() - nanos;
+    if (op == REPLICATION_HEARTBEAT) return;
+    if (lastLagNanos > maxLagNanos) maxLagNanos = lastLagNanos;
+
+    // Creates and leased parks must also land in the primary's slot
+    bool result = false;
+    int replicaSlotId = 0;
+    switch (op) {
+        case TRACE_CREATE: {
+            char vehicleId[TRACE_MAX_VEHICLE_ID];
+            memcpy(vehicleId, record + REPLICATION_RECORD_HEADER, idLen);
+            vehicleId[idLen] = '\0';
+            ParkingRequest* request = system->createRequest(vehicleId, arg,
+                                                            (SlotClass)(classByte & 0x07),
+                                                            (classByte & 0x80) != 0,
+                                                            (classByte >> 3) & 0x0F);
+            result = request->getState() == OCCUPIED;
+            replicaSlotId = slotIdOf(request);
+            break;
+        }
+        case TRACE_CANCEL:
+            result = system->cancelRequest(arg);
+            break;
+        case TRACE_RELEASE:
+            result = system->releaseParking(arg);
+            break;
+        case TRACE_ROLLBACK:
+            result = system->rollbackAllocations(arg);
+            break;
+        case TRACE_DRAIN:
+            result = system->drainZone(arg);
+            break;
+        case TRACE_REOPEN:
+            result = system->reopenZone(arg);
+            break;
+        case TRACE_LEASE:
+            result = system->leaseSlots(arg, (SlotClass)(classByte & 0x07), (classByte >> 3) + 1,
+                                        LLONG_MAX) != 0;
+            break;
+        case TRACE_LEASE_PARK: {
+            char vehicleId[TRACE_MAX_VEHICLE_ID];
+            memcpy(vehicleId, record + REPLICATION_RECORD_HEADER, idLen);
+            vehicleId[idLen] = '\0';
+            ParkingRequest* request = system->parkLeased(arg, vehicleId);
+            result = request != nullptr;
+            replicaSlotId = slotIdOf(request);
+            break;
+        }
+        case TRACE_ADD_AREA: {
+            int slotCount = 0;
+            double x = 0;
+            double y = 0;
+            bool located = (classByte & 0x80) != 0;
+            if (idLen >= (int)sizeof(int)) {
+                memcpy(&slotCount, record + REPLICATION_RECORD_HEADER, sizeof(int));
+            }
+            if (located && idLen >= (int)(sizeof(int) + 2 * sizeof(double))) {
+                memcpy(&x, record + REPLICATION_RECORD_HEADER + sizeof(int), sizeof(double));
+                memcpy(&y, record + REPLICATION_RECORD_HEADER + sizeof(int) + sizeof(double),
+                       sizeof(double));
+            }
+            result = system->addArea(arg, slotCount, (SlotClass)(classByte & 0x07), located, x, y) !=
+                     nullptr;
+            break;
+        }
+        case TRACE_UNLEASE:
+            result = system->returnLease(arg);
+            break;
+    }
+    if (result != expected || replicaSlotId != slotId) divergences++;
+    appliedSeq = seq;
+}
+
+bool Replica::isConnected() const {
+    return connected;
+}
+
+long long Replica::getAppliedSeq() const {
+    return appliedSeq;
+}
+
+long long Replica::getPrimarySeq() const {
+    return primarySeq;
+}
+
+long long Replica::getLagNanos() const {
+    return lastLagNanos;
+}
+
+long long Replica::getMaxLagNanos() const {
+    return maxLagNanos;
+}
+
+long long Replica::getDivergences() const {
+    return divergences;
+}
+
+long long Replica::getBytesReceived() const {
+    return bytesReceived;
+}
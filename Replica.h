@@ -0,0 +1,55 @@
+#ifndef REPLICA_H
+#define REPLICA_H
+
+#include "ReplicationLog.h"
+
+class ParkingSystem;
+class ParkingRequest;
+
+// Follows a primary's ReplicationLog and re-applies every operation to a
+// local ParkingSystem built from the same topology and policy. The engine is
+// deterministic, so the replica reaches the same state; each recorded
+// outcome, and the slot each create or leased park was given, is checked
+// and any mismatch counted as a divergence.
+class Replica {
+private:
+    int fd;
+    ReplicationHello hello;
+    ParkingSystem* system;
+    char* buffer;
+    int filled;
+    bool connected;
+
+    long long appliedSeq;
+    long long primarySeq;       // newest seq the primary has announced
+    long long lastLagNanos;     // primary append to replica apply, last record
+    long long maxLagNanos;
+    long long divergences;
+    long long bytesReceived;
+
+    void apply(const char* record, int idLen);
+    int slotIdOf(const ParkingRequest* request) const;
+
+public:
+    Replica();
+    ~Replica();
+
+    // Connects and reads the hello; the caller builds the system it describes
+    bool connect(const char* socketPath);
+    const ReplicationHello& getHello() const;
+    void attach(ParkingSystem* target);
+    int getFd() const;
+
+    // Applies everything that has arrived; false once the primary has gone
+    bool pump();
+
+    bool isConnected() const;
+    long long getAppliedSeq() const;
+    long long getPrimarySeq() const;
+    long long getLagNanos() const;
+    long long getMaxLagNanos() const;
+    long long getDivergences() const;
+    long long getBytesReceived() const;
+};
+
+#endif
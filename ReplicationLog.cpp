@@ -0,0 +1,119 @@
+#include "ReplicationLog.h"
+#include <cstring>
+#include <ctime>
+
+ReplicationLog::ReplicationLog() : tailUsed(0), length(0), published(0), lastSeq(0) {
+    head = tail = new LogBlock;
+    head->next = nullptr;
+}
+
+ReplicationLog::~ReplicationLog() {
+    while (head != nullptr) {
+        LogBlock* next = head->next;
+        delete head;
+        head = next;
+    }
+}
+
+long long ReplicationLog::nowNanos() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+int ReplicationLog::encodeRecord(char* out, long long seq, long long nanos, int op, bool result,
+                                 int classByte, int arg, int slotId, const char* payload,
+                                 int payloadLen) {
+    memcpy(out, &seq, 8);
+    memcpy(out + 8, &nanos, 8);
+    out[16] = (char)op;
+    out[17] = result ? 1 : 0;
+    out[18] = (char)classByte;
+    out[19] = (char)payloadLen;
+    memcpy(out + 20, &arg, 4);
+    memcpy(out + 24, &slotId, 4);
+    if (payloadLen > 0) memcpy(out + REPLICATION_RECORD_HEADER, payload, payloadLen);
+    return REPLICATION_RECORD_HEADER + payloadLen;
+}
+
+// Records may straddle blocks; the new block is linked before any byte in
+// it is published
+void ReplicationLog::write(const void* data, int len) {
+    const char* bytes = (const char*)data;
+    while (len > 0) {
+        if (tailUsed == LogBlock::SIZE) {
+            LogBlock* block = new LogBlock;
+            block->next = nullptr;
+            tail->next = block;
+            tail = block;
+            tailUsed = 0;
+        }
+        int chunk = LogBlock::SIZE - tailUsed;
+        if (chunk > len) chunk = len;
+        memcpy(tail->data + tailUsed, bytes, chunk);
+        tailUsed += chunk;
+        bytes += chunk;
+        len -= chunk;
+        length += chunk;
+    }
+}
+
+void ReplicationLog::append(TraceOp op, bool result, int arg, const char* vehicleId, int classByte,
+                            int slotId) {
+    int idLen = 0;
+    if (vehicleId != nullptr) {
+        idLen = (int)strlen(vehicleId);
+        if (idLen > TRACE_MAX_VEHICLE_ID - 1) idLen = TRACE_MAX_VEHICLE_ID - 1;
+    }
+    appendPayload(op, result, arg, vehicleId, idLen, classByte, slotId);
+}
+
+// Payloads stay under TRACE_MAX_VEHICLE_ID bytes, which replicas check
+void ReplicationLog::appendPayload(TraceOp op, bool result, int arg, const char* payload,
+                                   int payloadLen, int classByte, int slotId) {
+    char record[REPLICATION_RECORD_HEADER + TRACE_MAX_VEHICLE_ID];
+    long long seq = lastSeq.load(std::memory_order_relaxed) + 1;
+    int len = encodeRecord(record, seq, nowNanos(), op, result, classByte, arg, slotId, payload,
+                           payloadLen);
+    write(record, len);
+    lastSeq.store(seq, std::memory_order_relaxed);
+    published.store(length, std::memory_order_release);
+}
+
+long long ReplicationLog::getLastSeq() const {
+    return lastSeq.load(std::memory_order_relaxed);
+}
+
+long long ReplicationLog::getPublished() const {
+    return published.load(std::memory_order_acquire);
+}
+
+void ReplicationLog::openCursor(LogCursor& cursor) const {
+    cursor.block = head;
+    cursor.offset = 0;
+    cursor.position = 0;
+}
+
+int ReplicationLog::peek(const LogCursor& cursor, const char** data) const {
+    long long available = published.load(std::memory_order_acquire) - cursor.position;
+    if (available <= 0) return 0;
+    LogBlock* block = cursor.block;
+    int offset = cursor.offset;
+    if (offset == LogBlock::SIZE) {
+        block = block->next;
+        offset = 0;
+    }
+    int run = LogBlock::SIZE - offset;
+    if (run > available) run = (int)available;
+    *data = block->data + offset;
+    return run;
+}
+
+void ReplicationLog::advance(LogCursor& cursor, int len) const {
+    if (cursor.offset == LogBlock::SIZE) {
+        cursor.block = cursor.block->next;
+        cursor.offset = 0;
+    }
+    cursor.offset += len;
+    cursor.position += len;
+}
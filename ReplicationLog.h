@@ -0,0 +1,88 @@
+#ifndef REPLICATIONLOG_H
+#define REPLICATIONLOG_H
+
+#include <atomic>
+#include "TraceRecorder.h"
+
+// Replication stream, primary to replica over a Unix socket on one host:
+//   hello   : ReplicationHello, sent once on connect
+//   record  : u64 seq | i64 primary CLOCK_MONOTONIC nanos | u8 op | u8 result
+//             | u8 class byte (bit 7 = fallback, bits 3-6 = waitlist priority;
+//               lease: bits 3-7 = slots asked for - 1; add area: bit 7 = located)
+//             | u8 payload length
+//             | i32 argument (zone, request id, k or lease token)
+//             | i32 slot ID a create or leased park was given, 0 for none | payload
+// The payload is the vehicle id of a create or leased park, and the i32 slot
+// count of an add area followed, when located, by x and y as doubles.
+// op is a TraceOp; op 0 is a heartbeat carrying the primary's latest seq,
+// sent while a replica is caught up.
+
+const int REPLICATION_VERSION = 7;
+const int REPLICATION_RECORD_HEADER = 28;
+const int REPLICATION_HEARTBEAT = 0;
+
+// Everything a replica needs to build the same starting state
+struct ReplicationHello {
+    char magic[4];          // "SPRL"
+    int version;
+    int gridZones;          // 0 = default topology
+    int gridAreas;
+    int gridSlots;
+    int slotMix;
+    int policy;
+    int waitlist;           // WaitlistMode
+    int affinity;           // affinity cache size, 0 = off
+};
+
+struct LogBlock {
+    static const int SIZE = 1 << 20;
+    char data[SIZE];
+    LogBlock* next;
+};
+
+// Read position of one replica; record boundaries never move backwards
+struct LogCursor {
+    LogBlock* block;
+    int offset;
+    long long position;
+};
+
+// Append-only log of every state-changing operation with its outcome, in
+// the order the primary applied them. The allocating thread appends and
+// publishes each record with one release store; the shipper thread reads
+// anything published without a lock. Blocks are kept for the life of the
+// log so a replica can join at any time and replay from the start.
+class ReplicationLog {
+private:
+    LogBlock* head;
+    LogBlock* tail;
+    int tailUsed;
+    long long length;                       // bytes written by the producer
+    std::atomic<long long> published;      // bytes visible to readers
+    std::atomic<long long> lastSeq;
+
+    void write(const void* data, int len);
+
+public:
+    ReplicationLog();
+    ~ReplicationLog();
+
+    void append(TraceOp op, bool result, int arg, const char* vehicleId, int classByte,
+                int slotId = 0);
+    void appendPayload(TraceOp op, bool result, int arg, const char* payload, int payloadLen,
+                       int classByte, int slotId = 0);
+    long long getLastSeq() const;
+    long long getPublished() const;
+
+    void openCursor(LogCursor& cursor) const;
+    // Longest run of published bytes readable in place at the cursor
+    int peek(const LogCursor& cursor, const char** data) const;
+    void advance(LogCursor& cursor, int len) const;
+
+    static long long nowNanos();
+    static int encodeRecord(char* out, long long seq, long long nanos, int op, bool result,
+                            int classByte, int arg, int slotId, const char* payload,
+                            int payloadLen);
+};
+
+#endif
@@ -0,0 +1,174 @@
+#include "ReplicationPublisher.h"
+#include "NetUtil.h"
+#include <cerrno>
+#include <cstring>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+static const int IDLE_POLL_MS = 1;
+static const long long HEARTBEAT_NANOS = 100000000LL;
+static const long long DRAIN_NANOS = 2000000000LL;
+
+ReplicationPublisher::ReplicationPublisher(ReplicationLog& replicationLog,
+                                           const ReplicationHello& startState)
+    : log(replicationLog), hello(startState), listenFd(-1), running(false), replicaCount(0),
+      linkCount(0), linkCapacity(8) {
+    memcpy(hello.magic, "SPRL", 4);
+    hello.version = REPLICATION_VERSION;
+    replicas = new ReplicaLink[linkCapacity];
+}
+
+ReplicationPublisher::~ReplicationPublisher() {
+    stop();
+    for (int i = 0; i < linkCount; i++) {
+        close(replicas[i].fd);
+    }
+    delete[] replicas;
+}
+
+bool ReplicationPublisher::start(const char* socketPath) {
+    listenFd = listenUnix(socketPath);
+    if (listenFd < 0 || !setNonBlocking(listenFd)) return false;
+    running = true;
+    shipper = std::thread(&ReplicationPublisher::run, this);
+    return true;
+}
+
+void ReplicationPublisher::stop() {
+    running = false;
+    if (shipper.joinable()) {
+        shipper.join();
+    }
+    if (listenFd >= 0) {
+        close(listenFd);
+        listenFd = -1;
+    }
+}
+
+int ReplicationPublisher::getReplicaCount() const {
+    return replicaCount.load(std::memory_order_relaxed);
+}
+
+bool ReplicationPublisher::allCaughtUp() const {
+    long long published = log.getPublished();
+    for (int i = 0; i < linkCount; i++) {
+        if (replicas[i].cursor.position < published ||
+            replicas[i].pendingOffset < replicas[i].pendingLength) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ReplicationPublisher::run() {
+    pollfd* fds = new pollfd[linkCapacity + 1];
+    int fdCapacity = linkCapacity;
+    long long stopDeadline = 0;
+
+    while (true) {
+        long long now = ReplicationLog::nowNanos();
+        if (!running.load()) {
+            if (stopDeadline == 0) stopDeadline = now + DRAIN_NANOS;
+            if (allCaughtUp() || now >= stopDeadline) break;
+        }
+        if (fdCapacity < linkCapacity) {
+            delete[] fds;
+            fds = new pollfd[linkCapacity + 1];
+            fdCapacity = linkCapacity;
+        }
+
+        long long published = log.getPublished();
+        fds[0].fd = listenFd;
+        fds[0].events = POLLIN;
+        fds[0].revents = 0;
+        bool busy = false;
+        for (int i = 0; i < linkCount; i++) {
+            ReplicaLink& link = replicas[i];
+            bool behind = link.cursor.position < published || link.pendingOffset < link.pendingLength;
+            fds[i + 1].fd = link.fd;
+            fds[i + 1].events = behind ? POLLOUT : 0;
+            fds[i + 1].revents = 0;
+            busy = busy || behind;
+        }
+        // A caught-up replica is only woken for new records every millisecond
+        if (poll(fds, linkCount + 1, busy ? 100 : IDLE_POLL_MS) < 0 && errno != EINTR) break;
+
+        int polled = linkCount;
+        now = ReplicationLog::nowNanos();
+        for (int i = polled - 1; i >= 0; i--) {
+            short revents = fds[i + 1].revents;
+            if ((revents & (POLLERR | POLLHUP)) || !ship(replicas[i], now)) {
+                closeReplica(i);
+            }
+        }
+        if (fds[0].revents & POLLIN) {
+            acceptReplicas();
+        }
+    }
+    delete[] fds;
+}
+
+void ReplicationPublisher::acceptReplicas() {
+    while (true) {
+        int fd = accept(listenFd, nullptr, nullptr);
+        if (fd < 0) return;
+        setNonBlocking(fd);
+
+        if (linkCount == linkCapacity) {
+            int newCapacity = linkCapacity * 2;
+            ReplicaLink* grown = new ReplicaLink[newCapacity];
+            for (int i = 0; i < linkCount; i++) {
+                grown[i] = replicas[i];
+            }
+            delete[] replicas;
+            replicas = grown;
+            linkCapacity = newCapacity;
+        }
+        ReplicaLink& link = replicas[linkCount++];
+        link.fd = fd;
+        log.openCursor(link.cursor);
+        memcpy(link.pending, &hello, sizeof(hello));
+        link.pendingLength = sizeof(hello);
+        link.pendingOffset = 0;
+        link.lastHeartbeat = 0;
+        replicaCount.store(linkCount, std::memory_order_relaxed);
+    }
+}
+
+// Writes as much as the socket takes; false when the replica has gone.
+// MSG_NOSIGNAL keeps a vanished replica from raising SIGPIPE in the primary.
+bool ReplicationPublisher::ship(ReplicaLink& link, long long now) {
+    // Heartbeats only go out at record boundaries, i.e. when caught up
+    if (link.pendingOffset == link.pendingLength && link.cursor.position == log.getPublished() &&
+        now - link.lastHeartbeat >= HEARTBEAT_NANOS) {
+        link.pendingLength = ReplicationLog::encodeRecord(link.pending, log.getLastSeq(), now,
+                                                          REPLICATION_HEARTBEAT, true, 0, 0, 0,
+                                                          nullptr, 0);
+        link.pendingOffset = 0;
+        link.lastHeartbeat = now;
+    }
+
+    while (link.pendingOffset < link.pendingLength) {
+        ssize_t n = send(link.fd, link.pending + link.pendingOffset,
+                         link.pendingLength - link.pendingOffset, MSG_NOSIGNAL);
+        if (n < 0) return errno == EAGAIN || errno == EINTR;
+        link.pendingOffset += (int)n;
+    }
+
+    const char* data;
+    int run;
+    while ((run = log.peek(link.cursor, &data)) > 0) {
+        ssize_t n = send(link.fd, data, run, MSG_NOSIGNAL);
+        if (n < 0) return errno == EAGAIN || errno == EINTR;
+        log.advance(link.cursor, (int)n);
+        if (n < run) break;
+    }
+    return true;
+}
+
+void ReplicationPublisher::closeReplica(int index) {
+    close(replicas[index].fd);
+    replicas[index] = replicas[--linkCount];
+    replicaCount.store(linkCount, std::memory_order_relaxed);
+}
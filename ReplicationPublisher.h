@@ -0,0 +1,48 @@
+#ifndef REPLICATIONPUBLISHER_H
+#define REPLICATIONPUBLISHER_H
+
+#include <atomic>
+#include <thread>
+#include "ReplicationLog.h"
+
+struct ReplicaLink {
+    int fd;
+    LogCursor cursor;
+    char pending[64];       // hello or heartbeat not yet written
+    int pendingLength;
+    int pendingOffset;
+    long long lastHeartbeat;
+};
+
+// Ships a ReplicationLog to every connected replica from its own thread, so
+// the allocating thread only ever appends to memory. Replicas start from
+// the first record; one that stops reading only falls behind itself.
+class ReplicationPublisher {
+private:
+    ReplicationLog& log;
+    ReplicationHello hello;
+    int listenFd;
+    std::atomic<bool> running;
+    std::atomic<int> replicaCount;
+    std::thread shipper;
+    ReplicaLink* replicas;
+    int linkCount;
+    int linkCapacity;
+
+    void run();
+    void acceptReplicas();
+    bool ship(ReplicaLink& link, long long now);
+    void closeReplica(int index);
+    bool allCaughtUp() const;
+
+public:
+    ReplicationPublisher(ReplicationLog& replicationLog, const ReplicationHello& startState);
+    ~ReplicationPublisher();
+
+    bool start(const char* socketPath);
+    // Gives connected replicas up to two seconds to catch up, then stops
+    void stop();
+    int getReplicaCount() const;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "RequestStore.h"
+#include <new>
+#include "MemoryStats.h"
+
+static_assert(sizeof(ParkingRequest) == REQUEST_RECORD_BYTES, "request record must stay packed");
+static_assert(sizeof(RequestChunkHeader) == REQUEST_RECORD_BYTES, "header takes one record slot");
+
+RequestStore::RequestStore()
+    : chunkCount(0), chunkCapacity(16), lastChunkRecords(0), uniform(true), count(0) {
+    chunks = trackedArray<char*>(MEMORY_REQUESTS, chunkCapacity);
+    chunkFirstIds = trackedArray<int>(MEMORY_REQUESTS, chunkCapacity);
+}
+
+RequestStore::~RequestStore() {
+    for (int i = 0; i < chunkCount; i++) {
+        operator delete(chunks[i], std::align_val_t(REQUEST_CHUNK_BYTES));
+    }
+    MemoryStats::freed(MEMORY_REQUESTS, (long long)chunkCount * REQUEST_CHUNK_BYTES, count);
+    trackedFree(MEMORY_REQUESTS, chunks, chunkCapacity);
+    trackedFree(MEMORY_REQUESTS, chunkFirstIds, chunkCapacity);
+}
+
+ParkingRequest* RequestStore::create(const char* vehicleId, int requestedZone, long long requestTime,
+                                     SlotClass slotClass, bool fallback) {
+    long long offset = chunkCount > 0
+        ? requestTime - ((const RequestChunkHeader*)chunks[chunkCount - 1])->timeBase : 0;
+    bool outOfRange = offset < 0 || offset > 0xFFFFFFFFLL;
+    if (chunkCount == 0 || lastChunkRecords == REQUESTS_PER_CHUNK || outOfRange) {
+        if (chunkCount == chunkCapacity) {
+            int newCapacity = chunkCapacity * 2;
+            char** grown = trackedArray<char*>(MEMORY_REQUESTS, newCapacity);
+            int* grownIds = trackedArray<int>(MEMORY_REQUESTS, newCapacity);
+            for (int i = 0; i < chunkCount; i++) {
+                grown[i] = chunks[i];
+                grownIds[i] = chunkFirstIds[i];
+            }
+            trackedFree(MEMORY_REQUESTS, chunks, chunkCapacity);
+            trackedFree(MEMORY_REQUESTS, chunkFirstIds, chunkCapacity);
+            chunks = grown;
+            chunkFirstIds = grownIds;
+            chunkCapacity = newCapacity;
+        }
+        if (chunkCount > 0 && lastChunkRecords < REQUESTS_PER_CHUNK) {
+            uniform = false;
+        }
+        char* chunk = (char*)operator new(REQUEST_CHUNK_BYTES, std::align_val_t(REQUEST_CHUNK_BYTES));
+        MemoryStats::allocated(MEMORY_REQUESTS, REQUEST_CHUNK_BYTES);
+        RequestChunkHeader* header = (RequestChunkHeader*)chunk;
+        header->firstId = count + 1;
+        header->timeBase = requestTime;
+        header->plates = &plates;
+        header->reserved = 0;
+        chunkFirstIds[chunkCount] = count + 1;
+        chunks[chunkCount++] = chunk;
+        lastChunkRecords = 0;
+        offset = 0;
+    }
+
+    void* slot = chunks[chunkCount - 1] + (lastChunkRecords + 1) * REQUEST_RECORD_BYTES;
+    lastChunkRecords++;
+    count++;
+    MemoryStats::allocated(MEMORY_REQUESTS, 0, 1);
+    return new (slot) ParkingRequest(plates.intern(vehicleId), requestedZone, (unsigned)offset,
+                                     slotClass, fallback);
+}
+
+// The last chunk whose first ID is at most requestId
+int RequestStore::findChunk(int requestId) const {
+    int low = 0;
+    int high = chunkCount - 1;
+    while (low < high) {
+        int mid = (low + high + 1) / 2;
+        if (chunkFirstIds[mid] <= requestId) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+    return low;
+}
+
+ParkingRequest* RequestStore::get(int requestId) const {
+    int index = requestId - 1;
+    int chunk = index / REQUESTS_PER_CHUNK;
+    int offset = index % REQUESTS_PER_CHUNK;
+    if (!uniform) {
+        chunk = findChunk(requestId);
+        offset = requestId - chunkFirstIds[chunk];
+    }
+    return (ParkingRequest*)(chunks[chunk] + (offset + 1) * REQUEST_RECORD_BYTES);
+}
+
+int RequestStore::getChunkCount() const {
+    return chunkCount;
+}
+
+ParkingRequest* RequestStore::getChunk(int chunk, int& records) const {
+    records = chunk + 1 < chunkCount ? chunkFirstIds[chunk + 1] - chunkFirstIds[chunk] : lastChunkRecords;
+    return (ParkingRequest*)(chunks[chunk] + REQUEST_RECORD_BYTES);
+}
+
+int RequestStore::getCount() const {
+    return count;
+}
+
+const PlateTable& RequestStore::getPlates() const {
+    return plates;
+}
+
+long long RequestStore::getMemoryBytes() const {
+    return (long long)chunkCount * REQUEST_CHUNK_BYTES + (long long)chunkCapacity * (sizeof(char*) + sizeof(int)) +
+           plates.getMemoryBytes();
+}
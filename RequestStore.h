@@ -0,0 +1,54 @@
+#ifndef REQUESTSTORE_H
+#define REQUESTSTORE_H
+
+#include "ParkingRequest.h"
+#include "PlateTable.h"
+
+const int REQUEST_CHUNK_BYTES = 1 << 20;
+const int REQUEST_RECORD_BYTES = 32;
+const int REQUESTS_PER_CHUNK = REQUEST_CHUNK_BYTES / REQUEST_RECORD_BYTES - 1;
+
+// First 32 bytes of every chunk. Chunks are aligned to their size, so a
+// record finds its header by masking its own address.
+struct RequestChunkHeader {
+    long long firstId;
+    long long timeBase;             // request time of the chunk's first record
+    const PlateTable* plates;
+    long long reserved;
+};
+
+// Every request the system has seen, by ID from 1, in 1 MB chunks of
+// packed records. Records never move once created. Record times are 32-bit
+// offsets from the chunk's time base, so a chunk is closed early when a
+// request comes more than 2^32 ticks after it; IDs are then found by a
+// search of the chunks' first IDs instead of by division.
+class RequestStore {
+private:
+    char** chunks;
+    int* chunkFirstIds;             // parallel to chunks
+    int chunkCount;
+    int chunkCapacity;
+    int lastChunkRecords;
+    bool uniform;                   // every chunk but the last is full
+    int count;
+    PlateTable plates;
+
+    int findChunk(int requestId) const;
+
+public:
+    RequestStore();
+    ~RequestStore();
+
+    ParkingRequest* create(const char* vehicleId, int requestedZone, long long requestTime,
+                           SlotClass slotClass, bool fallback);
+    // requestId must be in 1..getCount()
+    ParkingRequest* get(int requestId) const;
+    int getChunkCount() const;
+    // The chunk's first record; records follow it contiguously
+    ParkingRequest* getChunk(int chunk, int& records) const;
+    int getCount() const;
+    const PlateTable& getPlates() const;
+    long long getMemoryBytes() const;
+};
+
+#endif
@@ -15,27 +15,69 @@ void RollbackManager::pushAllocation(ParkingRequest* request, ParkingSlot* slot)
     stackSize++;
 }
 
+bool RollbackManager::popAllocation(ParkingRequest*& request, ParkingSlot*& slot) {
+    if (top == nullptr || top->drain != nullptr) return false;
+    
+    AllocationRecord* record = top;
+    request = record->request;
+    slot = record->slot;
+    top = top->next;
+    delete record;
+    stackSize--;
+    return true;
+}
+
+void RollbackManager::pushDrain(int zoneId, DrainMove* moves, int moveCount, int moveCapacity) {
+    AllocationRecord* newRecord = new AllocationRecord(nullptr, nullptr);
+    newRecord->drain = new DrainRecord(zoneId, moves, moveCount, moveCapacity);
+    newRecord->next = top;
+    top = newRecord;
+    stackSize++;
+}
+
+DrainRecord* RollbackManager::popDrain() {
+    if (top == nullptr || top->drain == nullptr) return nullptr;
+    
+    AllocationRecord* record = top;
+    DrainRecord* drain = record->drain;
+    top = top->next;
+    delete record;
+    stackSize--;
+    return drain;
+}
+
+void RollbackManager::relocate(const ParkingRequest* request, ParkingSlot* slot) {
+    for (AllocationRecord* record = top; record != nullptr; record = record->next) {
+        if (record->request == request) {
+            record->slot = slot;
+            return;
+        }
+    }
+}
+
+// Drains need the zone reopened and are only undone by ParkingSystem
 bool RollbackManager::rollback(int k) {
     if (k <= 0 || k > stackSize) return false;
+    AllocationRecord* record = top;
+    for (int i = 0; i < k; i++, record = record->next) {
+        if (record->drain != nullptr) return false;
+    }
     
     for (int i = 0; i < k; i++) {
-        if (top == nullptr) return false;
-        
-        AllocationRecord* record = top;
+        ParkingRequest* request;
+        ParkingSlot* slot;
+        if (!popAllocation(request, slot)) return false;
         
-        // Restore slot availability
-        if (record->slot != nullptr) {
-            record->slot->release();
-        }
+        // Only allocations that still hold their slot are undone; a request
+        // released or cancelled since then gave the slot back already
+        if (request == nullptr) continue;
+        RequestState state = request->getState();
+        if (state != ALLOCATED && state != OCCUPIED) continue;
         
-        // Cancel the request
-        if (record->request != nullptr) {
-            record->request->cancel();
+        if (slot != nullptr) {
+            slot->release();
         }
-        
-        top = top->next;
-        delete record;
-        stackSize--;
+        request->cancel();
     }
     
     return true;
@@ -49,6 +91,7 @@ void RollbackManager::clear() {
     while (top != nullptr) {
         AllocationRecord* temp = top;
         top = top->next;
+        delete temp->drain;
         delete temp;
     }
     stackSize = 0;
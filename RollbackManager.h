@@ -1,16 +1,45 @@
 #ifndef ROLLBACKMANAGER_H
 #define ROLLBACKMANAGER_H
 
-class ParkingRequest;
+#include "ParkingRequest.h"
+#include "MemoryStats.h"
+
 class ParkingSlot;
 
-struct AllocationRecord {
+// One vehicle moved out of a drained zone; to is nullptr if nothing could
+// take it and the request was cancelled
+struct DrainMove {
+    ParkingRequest* request;
+    ParkingSlot* from;
+    ParkingSlot* to;
+    RequestState state;     // before the drain
+    bool crossZone;
+    float distance;
+};
+
+struct DrainRecord : public Tracked<MEMORY_ROLLBACK> {
+    int zoneId;
+    DrainMove* moves;       // trackedArray of moveCapacity
+    int moveCount;
+    int moveCapacity;
+    DrainRecord* next;      // free for the owner once popped
+    
+    DrainRecord(int zone, DrainMove* zoneMoves, int count, int capacity)
+        : zoneId(zone), moves(zoneMoves), moveCount(count), moveCapacity(capacity), next(nullptr) {}
+    ~DrainRecord() {
+        trackedFree(MEMORY_ROLLBACK, moves, moveCapacity);
+    }
+};
+
+// A single allocation, or a whole zone drain when drain is set
+struct AllocationRecord : public Tracked<MEMORY_ROLLBACK> {
     ParkingRequest* request;
     ParkingSlot* slot;
+    DrainRecord* drain;
     AllocationRecord* next;
     
     AllocationRecord(ParkingRequest* req, ParkingSlot* s) 
-        : request(req), slot(s), next(nullptr) {}
+        : request(req), slot(s), drain(nullptr), next(nullptr) {}
 };
 
 class RollbackManager {
@@ -23,6 +52,15 @@ public:
     ~RollbackManager();
     
     void pushAllocation(ParkingRequest* request, ParkingSlot* slot);
+    bool popAllocation(ParkingRequest*& request, ParkingSlot*& slot);
+    // Takes ownership of moves; the drain counts as one step
+    void pushDrain(int zoneId, DrainMove* moves, int moveCount, int moveCapacity);
+    // The drain on top of the stack, now owned by the caller, or nullptr if
+    // the top is an allocation
+    DrainRecord* popDrain();
+    // Points the request's newest allocation record at the slot it holds
+    // now, so undoing it frees that slot rather than one it has left
+    void relocate(const ParkingRequest* request, ParkingSlot* slot);
     bool rollback(int k);
     int getStackSize() const;
     void clear();
@@ -0,0 +1,722 @@
+#include "ShardRouter.h"
+#include "OutputBuffer.h"
+#include "NetUtil.h"
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <poll.h>
+#include <unistd.h>
+
+static const int INPUT_BUFFER_SIZE = 1 << 20;
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static char* nextToken(char*& p, char* end) {
+    while (p < end && isSpace(*p)) p++;
+    if (p >= end) return nullptr;
+    char* start = p;
+    while (p < end && !isSpace(*p)) p++;
+    *p = '\0';
+    if (p < end) p++;
+    return start;
+}
+
+static bool parseInt(const char* token, int& value) {
+    if (token == nullptr || *token == '\0') return false;
+    bool negative = *token == '-';
+    if (negative) token++;
+    long long result = 0;
+    for (; *token != '\0'; token++) {
+        if (*token < '0' || *token > '9' || result > 0x7FFFFFFF) return false;
+        result = result * 10 + (*token - '0');
+    }
+    value = (int)(negative ? -result : result);
+    return true;
+}
+
+// Grows a char buffer so that `needed` more bytes fit after `length`
+static void reserveBytes(char*& buffer, int& capacity, int length, int needed) {
+    if (length + needed <= capacity) return;
+    int newCapacity = capacity > 0 ? capacity * 2 : 4096;
+    while (newCapacity < length + needed) newCapacity *= 2;
+    char* grown = new char[newCapacity];
+    if (length > 0) memcpy(grown, buffer, length);
+    delete[] buffer;
+    buffer = grown;
+    capacity = newCapacity;
+}
+
+ShardRouter::ShardRouter(OutputBuffer& output)
+    : shards(nullptr), shardCount(0), shardCapacity(0), out(output),
+      exchanges(nullptr), exchangeCount(0), exchangeCapacity(0), entryCount(0),
+      lineArena(nullptr), lineArenaLength(0), lineArenaCapacity(0),
+      responseArena(nullptr), responseArenaLength(0), responseArenaCapacity(0),
+      routeCapacity(1024), nextGlobalId(1), stackSize(0), stackCapacity(1024),
+      zoneX(nullptr), zoneY(nullptr), zoneLocated(nullptr), zoneCapacity(0),
+      commandCount(0), errorCount(0), crossShardCount(0), failed(false) {
+    entries = new RouterEntry[WINDOW];
+    routes = new ShardRoute[routeCapacity];
+    allocationStack = new int[stackCapacity];
+}
+
+ShardRouter::~ShardRouter() {
+    for (int i = 0; i < shardCount; i++) {
+        close(shards[i].fd);
+        delete[] shards[i].sendBuffer;
+        delete[] shards[i].receiveBuffer;
+    }
+    delete[] shards;
+    delete[] exchanges;
+    delete[] entries;
+    delete[] lineArena;
+    delete[] responseArena;
+    delete[] routes;
+    delete[] allocationStack;
+    delete[] zoneX;
+    delete[] zoneY;
+    delete[] zoneLocated;
+}
+
+bool ShardRouter::addShard(const char* socketPath, int firstZone, int lastZone) {
+    int fd = connectUnix(socketPath);
+    if (fd < 0 || !setNonBlocking(fd)) {
+        if (fd >= 0) close(fd);
+        return false;
+    }
+
+    if (shardCount == shardCapacity) {
+        int newCapacity = shardCapacity > 0 ? shardCapacity * 2 : 4;
+        ShardLink* grown = new ShardLink[newCapacity];
+        for (int i = 0; i < shardCount; i++) {
+            grown[i] = shards[i];
+        }
+        delete[] shards;
+        shards = grown;
+        shardCapacity = newCapacity;
+    }
+
+    ShardLink& shard = shards[shardCount++];
+    shard.fd = fd;
+    shard.firstZone = firstZone;
+    shard.lastZone = lastZone;
+    shard.sendBuffer = nullptr;
+    shard.sendLength = 0;
+    shard.sendOffset = 0;
+    shard.sendCapacity = 0;
+    shard.receiveBuffer = nullptr;
+    shard.receiveLength = 0;
+    shard.receiveCapacity = 0;
+    shard.waitingHead = -1;
+    shard.waitingTail = -1;
+    return true;
+}
+
+void ShardRouter::setZoneLocation(int zoneId, double x, double y) {
+    if (zoneId < 0) return;
+    if (zoneId >= zoneCapacity) {
+        int newCapacity = zoneCapacity > 0 ? zoneCapacity * 2 : 64;
+        while (newCapacity <= zoneId) newCapacity *= 2;
+        double* grownX = new double[newCapacity];
+        double* grownY = new double[newCapacity];
+        bool* grownLocated = new bool[newCapacity];
+        for (int i = 0; i < newCapacity; i++) {
+            grownX[i] = i < zoneCapacity ? zoneX[i] : 0;
+            grownY[i] = i < zoneCapacity ? zoneY[i] : 0;
+            grownLocated[i] = i < zoneCapacity ? zoneLocated[i] : false;
+        }
+        delete[] zoneX;
+        delete[] zoneY;
+        delete[] zoneLocated;
+        zoneX = grownX;
+        zoneY = grownY;
+        zoneLocated = grownLocated;
+        zoneCapacity = newCapacity;
+    }
+    zoneX[zoneId] = x;
+    zoneY[zoneId] = y;
+    zoneLocated[zoneId] = true;
+}
+
+int ShardRouter::getShardCount() const {
+    return shardCount;
+}
+
+int ShardRouter::shardOfZone(int zoneId) const {
+    for (int i = 0; i < shardCount; i++) {
+        if (zoneId >= shards[i].firstZone && zoneId <= shards[i].lastZone) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Queues one command line (without its newline) for a shard; the response
+// is available through responseOf() after the next drain()
+int ShardRouter::send(int shard, const char* text, int len) {
+    ShardLink& link = shards[shard];
+    reserveBytes(link.sendBuffer, link.sendCapacity, link.sendLength, len + 1);
+    memcpy(link.sendBuffer + link.sendLength, text, len);
+    link.sendBuffer[link.sendLength + len] = '\n';
+    link.sendLength += len + 1;
+
+    if (exchangeCount == exchangeCapacity) {
+        int newCapacity = exchangeCapacity > 0 ? exchangeCapacity * 2 : WINDOW * 2;
+        ShardExchange* grown = new ShardExchange[newCapacity];
+        for (int i = 0; i < exchangeCount; i++) {
+            grown[i] = exchanges[i];
+        }
+        delete[] exchanges;
+        exchanges = grown;
+        exchangeCapacity = newCapacity;
+    }
+    int index = exchangeCount++;
+    exchanges[index].shard = shard;
+    exchanges[index].responseOffset = -1;
+    exchanges[index].responseLength = 0;
+    exchanges[index].nextWaiting = -1;
+    if (link.waitingTail >= 0) {
+        exchanges[link.waitingTail].nextWaiting = index;
+    } else {
+        link.waitingHead = index;
+    }
+    link.waitingTail = index;
+    return index;
+}
+
+// Writes every queued command and reads every owed response, all shards at
+// once, so a slow shard never stops the others from making progress
+bool ShardRouter::drain() {
+    if (failed) return false;
+    pollfd* fds = new pollfd[shardCount];
+    int* shardOf = new int[shardCount];
+
+    while (true) {
+        int count = 0;
+        for (int i = 0; i < shardCount; i++) {
+            ShardLink& link = shards[i];
+            short events = 0;
+            if (link.sendOffset < link.sendLength) events |= POLLOUT;
+            if (link.waitingHead >= 0) events |= POLLIN;
+            if (events == 0) continue;
+            fds[count].fd = link.fd;
+            fds[count].events = events;
+            fds[count].revents = 0;
+            shardOf[count++] = i;
+        }
+        if (count == 0) break;
+
+        if (poll(fds, count, -1) < 0) {
+            if (errno == EINTR) continue;
+            failed = true;
+            break;
+        }
+        for (int j = 0; j < count && !failed; j++) {
+            ShardLink& link = shards[shardOf[j]];
+            if (fds[j].revents & POLLOUT) {
+                ssize_t n = write(link.fd, link.sendBuffer + link.sendOffset,
+                                  link.sendLength - link.sendOffset);
+                if (n > 0) {
+                    link.sendOffset += (int)n;
+                    if (link.sendOffset == link.sendLength) {
+                        link.sendOffset = link.sendLength = 0;
+                    }
+                } else if (n < 0 && errno != EAGAIN && errno != EINTR) {
+                    failed = true;
+                }
+            }
+            if (fds[j].revents & (POLLIN | POLLHUP | POLLERR)) {
+                if (!receive(shardOf[j])) failed = true;
+            }
+        }
+        if (failed) break;
+    }
+
+    delete[] fds;
+    delete[] shardOf;
+    if (failed) {
+        std::cerr << "ERROR: Lost connection to a shard\n";
+    }
+    return !failed;
+}
+
+// Reads what a shard has sent and hands each complete line to the oldest
+// exchange still waiting on that shard
+bool ShardRouter::receive(int shard) {
+    ShardLink& link = shards[shard];
+    reserveBytes(link.receiveBuffer, link.receiveCapacity, link.receiveLength, 65536);
+    ssize_t n = read(link.fd, link.receiveBuffer + link.receiveLength,
+                     link.receiveCapacity - link.receiveLength);
+    if (n < 0) return errno == EAGAIN || errno == EINTR;
+    if (n == 0) return false;
+    link.receiveLength += (int)n;
+
+    int start = 0;
+    for (int i = 0; i < link.receiveLength; i++) {
+        if (link.receiveBuffer[i] != '\n') continue;
+        int index = link.waitingHead;
+        if (index < 0) return false;
+
+        int len = i - start;
+        reserveBytes(responseArena, responseArenaCapacity, responseArenaLength, len + 1);
+        memcpy(responseArena + responseArenaLength, link.receiveBuffer + start, len);
+        responseArena[responseArenaLength + len] = '\0';
+        exchanges[index].responseOffset = responseArenaLength;
+        exchanges[index].responseLength = len;
+        responseArenaLength += len + 1;
+
+        link.waitingHead = exchanges[index].nextWaiting;
+        if (link.waitingHead < 0) link.waitingTail = -1;
+        start = i + 1;
+    }
+    memmove(link.receiveBuffer, link.receiveBuffer + start, link.receiveLength - start);
+    link.receiveLength -= start;
+    return true;
+}
+
+const char* ShardRouter::responseOf(int exchange, int& len) const {
+    len = exchanges[exchange].responseLength;
+    return responseArena + exchanges[exchange].responseOffset;
+}
+
+void ShardRouter::addEntry(char command, int exchange, const char* line, int len) {
+    RouterEntry& entry = entries[entryCount++];
+    entry.command = command;
+    entry.exchange = exchange;
+    entry.lineOffset = (int)(line - lineArena);
+    entry.lineLength = len;
+}
+
+void ShardRouter::executeLine(char* line, int len) {
+    // Keep the raw line: it is forwarded verbatim and reparsed on fallback
+    reserveBytes(lineArena, lineArenaCapacity, lineArenaLength, len + 1);
+    char* raw = lineArena + lineArenaLength;
+    memcpy(raw, line, len);
+    raw[len] = '\0';
+
+    char* p = line;
+    char* end = line + len;
+    char* command = nextToken(p, end);
+    if (command == nullptr || command[0] == '#') return;
+    commandCount++;
+    lineArenaLength += len + 1;
+
+    int value = 0;
+    int second = 0;
+    char code = command[1] == '\0' ? command[0] : '?';
+    switch (code) {
+        case 'R': {
+            char* vehicleId = nextToken(p, end);
+            int zone;
+            if (vehicleId == nullptr || !parseInt(nextToken(p, end), zone)) break;
+            int shard = shardOfZone(zone);
+            addEntry('R', send(shard >= 0 ? shard : 0, raw, len), raw, len);
+            if (entryCount == WINDOW) flushWindow();
+            return;
+        }
+        case 'C':
+        case 'L':
+            if (!parseInt(nextToken(p, end), value)) break;
+            forwardById(code, raw, len, value);
+            if (entryCount == WINDOW) flushWindow();
+            return;
+        case 'B':
+            if (!parseInt(nextToken(p, end), value)) break;
+            flushWindow();
+            rollback(value);
+            return;
+        case 'Z':
+            flushWindow();
+            broadcastZones();
+            return;
+        case 'Q':
+            if (!parseInt(nextToken(p, end), value) || !parseInt(nextToken(p, end), second)) break;
+            flushWindow();
+            broadcastRange(value, second);
+            return;
+        case 'S':
+            flushWindow();
+            broadcastStats();
+            return;
+    }
+
+    addEntry('E', -1, raw, len);
+    if (entryCount == WINDOW) flushWindow();
+}
+
+// Cancel and release name a global ID; one not yet numbered (its request
+// is still in the window) waits for the window to finish first
+void ShardRouter::forwardById(char command, char* line, int len, int globalId) {
+    if (globalId >= nextGlobalId && entryCount > 0) {
+        flushWindow();
+    }
+    if (globalId <= 0 || globalId >= nextGlobalId) {
+        addEntry('N', -1, line, len);
+        return;
+    }
+
+    const ShardRoute& route = routes[globalId];
+    char text[32];
+    int textLen = snprintf(text, sizeof(text), "%c %d", command, route.localId);
+    addEntry(command, send(route.shard, text, textLen), line, len);
+}
+
+// Sends everything in the window, waits for all the answers, then writes
+// the outputs in input order
+void ShardRouter::flushWindow() {
+    if (entryCount == 0 || failed) return;
+    if (!drain()) return;
+    for (int i = 0; i < entryCount && !failed; i++) {
+        finishEntry(entries[i]);
+    }
+    drain();    // fallback leaves aborts and owner cancellations in flight
+
+    entryCount = 0;
+    exchangeCount = 0;
+    lineArenaLength = 0;
+    responseArenaLength = 0;
+}
+
+void ShardRouter::finishEntry(const RouterEntry& entry) {
+    int len;
+    switch (entry.command) {
+        case 'R':
+            finishRequest(entry);
+            return;
+        case 'C':
+        case 'L': {
+            const char* response = responseOf(entry.exchange, len);
+            out.append(response, len);
+            out.append('\n');
+            return;
+        }
+        case 'N':
+            out.append("ERR\n");
+            return;
+    }
+    errorCount++;
+    out.append("ERR syntax\n");
+}
+
+void ShardRouter::finishRequest(const RouterEntry& entry) {
+    int len;
+    const char* response = responseOf(entry.exchange, len);
+    int shard = exchanges[entry.exchange].shard;
+    bool full = strncmp(response, "FULL ", 5) == 0;
+    bool allocated = strncmp(response, "OK ", 3) == 0 || strncmp(response, "CROSS ", 6) == 0;
+    if (!full && !allocated) {
+        errorCount++;
+        out.append(response, len);
+        out.append('\n');
+        return;
+    }
+
+    // "<status> <localId> [<zone> <slot>]"
+    char* p = (char*)strchr(response, ' ') + 1;
+    int localId = (int)strtol(p, &p, 10);
+    int globalId = nextGlobalId++;
+    setRoute(globalId, shard, localId);
+
+    int zone = 0;
+    int slot = 0;
+    bool cross = !full && response[0] == 'C';
+    if (allocated) {
+        zone = (int)strtol(p, &p, 10);
+        slot = (int)strtol(p, &p, 10);
+    } else {
+        char* line = lineArena + entry.lineOffset;
+        allocated = fallBackAcrossShards(shard, localId, globalId, line, entry.lineLength,
+                                         zone, slot);
+        cross = allocated;
+    }
+
+    if (!allocated) {
+        out.append("FULL ");
+        out.appendInt(globalId);
+        out.append('\n');
+        return;
+    }
+    pushAllocation(globalId);
+    out.append(cross ? "CROSS " : "OK ");
+    out.appendInt(globalId);
+    out.append(' ');
+    out.appendInt(zone);
+    out.append(' ');
+    out.appendInt(slot);
+    out.append('\n');
+}
+
+// Phase one asks every other shard to reserve its slot nearest the
+// requested zone; phase two confirms the nearest and aborts the rest
+bool ShardRouter::fallBackAcrossShards(int owner, int ownerLocalId, int globalId,
+                                       const char* line, int len, int& zone, int& slot) {
+    if (shardCount < 2) return false;
+
+    char* copy = new char[len + 1];
+    memcpy(copy, line, len + 1);
+    char* p = copy;
+    char* end = copy + len;
+    nextToken(p, end);
+    char* vehicleId = nextToken(p, end);
+    int requestedZone = 0;
+    parseInt(nextToken(p, end), requestedZone);
+    char* className = nextToken(p, end);
+    if (className == nullptr) className = (char*)"standard";
+
+    if (requestedZone < 0 || requestedZone >= zoneCapacity || !zoneLocated[requestedZone]) {
+        delete[] copy;
+        return false;
+    }
+
+    char text[160];
+    int* reserveExchange = new int[shardCount];
+    for (int i = 0; i < shardCount; i++) {
+        reserveExchange[i] = -1;
+        if (i == owner) continue;
+        int textLen = snprintf(text, sizeof(text), "V %.3f %.3f %s", zoneX[requestedZone],
+                               zoneY[requestedZone], className);
+        reserveExchange[i] = send(i, text, textLen);
+    }
+    bool ok = drain();
+
+    // "V <token> <zone> <slot> <distance>" or "V -"
+    int best = -1;
+    int bestToken = 0;
+    double bestDistance = 0;
+    int* tokens = new int[shardCount];
+    for (int i = 0; ok && i < shardCount; i++) {
+        tokens[i] = 0;
+        if (reserveExchange[i] < 0) continue;
+        int responseLen;
+        const char* response = responseOf(reserveExchange[i], responseLen);
+        if (strncmp(response, "V ", 2) != 0 || response[2] == '-') continue;
+
+        char* q = (char*)response + 2;
+        tokens[i] = (int)strtol(q, &q, 10);
+        strtol(q, &q, 10);
+        strtol(q, &q, 10);
+        double distance = strtod(q, &q);
+        if (best < 0 || distance < bestDistance) {
+            best = i;
+            bestToken = tokens[i];
+            bestDistance = distance;
+        }
+    }
+
+    int confirmExchange = -1;
+    for (int i = 0; ok && i < shardCount; i++) {
+        if (tokens[i] == 0) continue;
+        int textLen;
+        if (i == best) {
+            textLen = snprintf(text, sizeof(text), "K %d %s %d %s", bestToken, vehicleId,
+                               requestedZone, className);
+            confirmExchange = send(i, text, textLen);
+        } else {
+            textLen = snprintf(text, sizeof(text), "X %d", tokens[i]);
+            send(i, text, textLen);
+        }
+    }
+
+    bool allocated = false;
+    if (confirmExchange >= 0 && drain()) {
+        int responseLen;
+        const char* response = responseOf(confirmExchange, responseLen);
+        if (strncmp(response, "CROSS ", 6) == 0) {
+            char* q = (char*)response + 6;
+            int localId = (int)strtol(q, &q, 10);
+            zone = (int)strtol(q, &q, 10);
+            slot = (int)strtol(q, &q, 10);
+            setRoute(globalId, best, localId);
+
+            // The request now lives on the other shard; retire the owner's
+            // failed attempt so it is not left waiting
+            int textLen = snprintf(text, sizeof(text), "C %d", ownerLocalId);
+            send(owner, text, textLen);
+            crossShardCount++;
+            allocated = true;
+        }
+    }
+
+    delete[] tokens;
+    delete[] reserveExchange;
+    delete[] copy;
+    return allocated;
+}
+
+void ShardRouter::setRoute(int globalId, int shard, int localId) {
+    if (globalId >= routeCapacity) {
+        int newCapacity = routeCapacity * 2;
+        while (newCapacity <= globalId) newCapacity *= 2;
+        ShardRoute* grown = new ShardRoute[newCapacity];
+        for (int i = 0; i < routeCapacity; i++) {
+            grown[i] = routes[i];
+        }
+        delete[] routes;
+        routes = grown;
+        routeCapacity = newCapacity;
+    }
+    routes[globalId].shard = shard;
+    routes[globalId].localId = localId;
+}
+
+void ShardRouter::pushAllocation(int globalId) {
+    if (stackSize == stackCapacity) {
+        int newCapacity = stackCapacity * 2;
+        int* grown = new int[newCapacity];
+        for (int i = 0; i < stackSize; i++) {
+            grown[i] = allocationStack[i];
+        }
+        delete[] allocationStack;
+        allocationStack = grown;
+        stackCapacity = newCapacity;
+    }
+    allocationStack[stackSize++] = globalId;
+}
+
+// Same contract as ParkingSystem::rollbackAllocations over the global
+// allocation order; each shard skips requests that are no longer active
+void ShardRouter::rollback(int k) {
+    if (k <= 0 || k > stackSize) {
+        out.append("ERR\n");
+        return;
+    }
+    char text[32];
+    for (int i = 0; i < k; i++) {
+        const ShardRoute& route = routes[allocationStack[--stackSize]];
+        int textLen = snprintf(text, sizeof(text), "C %d", route.localId);
+        send(route.shard, text, textLen);
+    }
+    out.append(drain() ? "OK\n" : "ERR\n");
+    exchangeCount = 0;
+    responseArenaLength = 0;
+}
+
+void ShardRouter::broadcastZones() {
+    int firstExchange = exchangeCount;
+    for (int i = 0; i < shardCount; i++) {
+        send(i, "Z", 1);
+    }
+    if (!drain()) return;
+    out.append('Z');
+    for (int i = 0; i < shardCount; i++) {
+        int len;
+        const char* response = responseOf(firstExchange + i, len);
+        if (len > 1) out.append(response + 1, len - 1);
+    }
+    out.append('\n');
+    exchangeCount = 0;
+    responseArenaLength = 0;
+}
+
+// Zones are numbered in shard order, so each shard answers for its slice of
+// the range and the first free slot comes from the first shard that has one
+void ShardRouter::broadcastRange(int firstZone, int lastZone) {
+    if (shardOfZone(firstZone) < 0 || shardOfZone(lastZone) < 0) {
+        out.append("Q 0 -\n");
+        return;
+    }
+    char text[64];
+    int* queryExchange = new int[shardCount];
+    for (int i = 0; i < shardCount; i++) {
+        int low = firstZone > shards[i].firstZone ? firstZone : shards[i].firstZone;
+        int high = lastZone < shards[i].lastZone ? lastZone : shards[i].lastZone;
+        queryExchange[i] = -1;
+        if (low > high) continue;
+        int textLen = snprintf(text, sizeof(text), "Q %d %d", low, high);
+        queryExchange[i] = send(i, text, textLen);
+    }
+
+    if (drain()) {
+        long long total = 0;
+        const char* firstFree = nullptr;
+        for (int i = 0; i < shardCount; i++) {
+            if (queryExchange[i] < 0) continue;
+            int len;
+            char* p = (char*)responseOf(queryExchange[i], len) + 2;
+            total += strtol(p, &p, 10);
+            if (firstFree == nullptr && p[1] != '-') firstFree = p;
+        }
+        out.append("Q ");
+        out.appendInt(total);
+        out.append(firstFree != nullptr ? firstFree : " -");
+        out.append('\n');
+    }
+    delete[] queryExchange;
+    exchangeCount = 0;
+    responseArenaLength = 0;
+}
+
+void ShardRouter::broadcastStats() {
+    int firstExchange = exchangeCount;
+    for (int i = 0; i < shardCount; i++) {
+        send(i, "S", 1);
+    }
+    if (!drain()) return;
+    out.append("S [");
+    for (int i = 0; i < shardCount; i++) {
+        int len;
+        const char* response = responseOf(firstExchange + i, len);
+        if (i > 0) out.append(',');
+        if (len > 2) out.append(response + 2, len - 2);
+    }
+    out.append("]\n");
+    exchangeCount = 0;
+    responseArenaLength = 0;
+}
+
+long long ShardRouter::run(FILE* in) {
+    char* buffer = new char[INPUT_BUFFER_SIZE + 1];
+    int filled = 0;
+    int fd = fileno(in);
+
+    while (!failed) {
+        ssize_t got = read(fd, buffer + filled, INPUT_BUFFER_SIZE - filled);
+        if (got < 0 && errno == EINTR) continue;
+        if (got > 0) filled += (int)got;
+        bool atEnd = got <= 0;
+
+        int start = 0;
+        for (int i = 0; i < filled && !failed; i++) {
+            if (buffer[i] == '\n') {
+                executeLine(buffer + start, i - start);
+                start = i + 1;
+            }
+        }
+
+        if (atEnd) {
+            if (start < filled) {
+                executeLine(buffer + start, filled - start);
+            }
+            flushWindow();
+            break;
+        }
+
+        if (start == 0 && filled == INPUT_BUFFER_SIZE) {
+            executeLine(buffer, filled);
+            filled = 0;
+        } else {
+            memmove(buffer, buffer + start, filled - start);
+            filled -= start;
+        }
+        flushWindow();
+        out.flush();
+    }
+
+    delete[] buffer;
+    out.flush();
+    return commandCount;
+}
+
+long long ShardRouter::getCommandCount() const {
+    return commandCount;
+}
+
+long long ShardRouter::getErrorCount() const {
+    return errorCount;
+}
+
+long long ShardRouter::getCrossShardCount() const {
+    return crossShardCount;
+}
@@ -0,0 +1,129 @@
+#ifndef SHARDROUTER_H
+#define SHARDROUTER_H
+
+#include <cstdio>
+
+class OutputBuffer;
+
+// One worker process owning a contiguous run of zones, reached over a Unix
+// domain socket speaking the BatchRunner protocol
+struct ShardLink {
+    int fd;
+    int firstZone;
+    int lastZone;
+    char* sendBuffer;
+    int sendLength;
+    int sendOffset;
+    int sendCapacity;
+    char* receiveBuffer;
+    int receiveLength;
+    int receiveCapacity;
+    int waitingHead;        // exchanges still owed a response, oldest first
+    int waitingTail;
+};
+
+// One command sent to a shard and, once drained, its response line
+struct ShardExchange {
+    int shard;
+    int responseOffset;
+    int responseLength;
+    int nextWaiting;
+};
+
+// One input line, kept until its output can be written in input order
+struct RouterEntry {
+    char command;
+    int exchange;           // -1 if answered by the router itself
+    int lineOffset;
+    int lineLength;
+};
+
+// Where a global request ID lives
+struct ShardRoute {
+    int shard;
+    int localId;
+};
+
+// Reads batch commands and forwards each to the shard owning its zone.
+// Commands are pipelined: up to WINDOW lines are sent to all shards at once
+// and their responses written back in input order, so shards work in
+// parallel. Request IDs are renumbered into one global sequence.
+//
+// When a shard answers FULL, the router runs two-phase cross-shard fallback:
+// every other shard is asked to reserve its nearest usable slot (V), the
+// nearest reservation is confirmed (K) and the rest aborted (X), and the
+// owner's failed request is cancelled. Reservations a shard never hears
+// back about expire on their own.
+class ShardRouter {
+private:
+    ShardLink* shards;
+    int shardCount;
+    int shardCapacity;
+    OutputBuffer& out;
+
+    ShardExchange* exchanges;
+    int exchangeCount;
+    int exchangeCapacity;
+    RouterEntry* entries;
+    int entryCount;
+    char* lineArena;
+    int lineArenaLength;
+    int lineArenaCapacity;
+    char* responseArena;
+    int responseArenaLength;
+    int responseArenaCapacity;
+
+    ShardRoute* routes;     // by global request ID
+    int routeCapacity;
+    int nextGlobalId;
+    int* allocationStack;   // global IDs in allocation order, for rollback
+    int stackSize;
+    int stackCapacity;
+
+    double* zoneX;
+    double* zoneY;
+    bool* zoneLocated;
+    int zoneCapacity;
+
+    long long commandCount;
+    long long errorCount;
+    long long crossShardCount;
+    bool failed;
+
+    int shardOfZone(int zoneId) const;
+    int send(int shard, const char* text, int len);
+    bool drain();
+    bool receive(int shard);
+    const char* responseOf(int exchange, int& len) const;
+    void executeLine(char* line, int len);
+    void addEntry(char command, int exchange, const char* line, int len);
+    void flushWindow();
+    void finishEntry(const RouterEntry& entry);
+    void finishRequest(const RouterEntry& entry);
+    bool fallBackAcrossShards(int owner, int ownerLocalId, int globalId, const char* line,
+                              int len, int& zone, int& slot);
+    void pushAllocation(int globalId);
+    void setRoute(int globalId, int shard, int localId);
+    void broadcastZones();
+    void broadcastRange(int firstZone, int lastZone);
+    void broadcastStats();
+    void rollback(int k);
+    void forwardById(char command, char* line, int len, int globalId);
+
+public:
+    static const int WINDOW = 4096;
+
+    ShardRouter(OutputBuffer& output);
+    ~ShardRouter();
+
+    bool addShard(const char* socketPath, int firstZone, int lastZone);
+    void setZoneLocation(int zoneId, double x, double y);
+    int getShardCount() const;
+
+    long long run(FILE* in);
+    long long getCommandCount() const;
+    long long getErrorCount() const;
+    long long getCrossShardCount() const;
+};
+
+#endif
@@ -0,0 +1,423 @@
+#include "Simulator.h"
+#include "ParkingSystem.h"
+#include "ParkingRequest.h"
+#include "Zone.h"
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ostream>
+
+// Relative arrival rate by hour of day; scaled to a mean of 1
+static const double FLAT_PROFILE[SIM_HOURS_PER_DAY] = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1};
+static const double CITY_PROFILE[SIM_HOURS_PER_DAY] = {
+    0.20, 0.15, 0.10, 0.10, 0.15, 0.30, 0.70, 1.40, 1.90, 1.70, 1.40, 1.30,
+    1.40, 1.30, 1.20, 1.30, 1.50, 1.80, 1.60, 1.20, 0.90, 0.70, 0.50, 0.30};
+static const double OFFICE_PROFILE[SIM_HOURS_PER_DAY] = {
+    0.05, 0.05, 0.05, 0.05, 0.05, 0.10, 0.60, 2.50, 3.50, 2.50, 1.00, 0.60,
+    0.80, 0.80, 0.50, 0.40, 0.30, 0.20, 0.15, 0.10, 0.10, 0.05, 0.05, 0.05};
+
+static const char* PROFILE_NAMES[] = {"flat", "city", "office"};
+static const char* STAY_NAMES[] = {"exp", "lognormal", "fixed", "uniform"};
+
+SimConfig::SimConfig()
+    : days(1), rate(30), skew(0), profile(PROFILE_CITY), stay(STAY_LOGNORMAL), stayA(90),
+      stayB(0.8), vehicles(100000), seed(1), warmupHours(0) {}
+
+static bool parseNumber(const char* text, double& value) {
+    if (*text == '\0') return false;
+    char* end;
+    value = strtod(text, &end);
+    return *end == '\0' && value >= 0;
+}
+
+// <distribution>:<a>[:<b>]
+static bool parseStay(char* text, SimConfig& config) {
+    char* first = strchr(text, ':');
+    if (first == nullptr) return false;
+    *first++ = '\0';
+    char* second = strchr(first, ':');
+    if (second != nullptr) *second++ = '\0';
+
+    int found = -1;
+    for (int i = STAY_EXPONENTIAL; i <= STAY_UNIFORM; i++) {
+        if (strcmp(text, STAY_NAMES[i]) == 0) found = i;
+    }
+    bool twoValues = found == STAY_LOGNORMAL || found == STAY_UNIFORM;
+    if (found < 0 || (second != nullptr) != twoValues) return false;
+    config.stay = (StayDistribution)found;
+    config.stayB = 0;
+    return parseNumber(first, config.stayA) && config.stayA > 0 &&
+           (second == nullptr || (parseNumber(second, config.stayB) &&
+                                  (found != STAY_UNIFORM || config.stayB >= config.stayA)));
+}
+
+bool SimConfig::parse(const char* text, char* error, int errorSize) {
+    char term[128];
+    const char* p = text;
+    while (*p != '\0') {
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\0') break;
+        int len = 0;
+        while (p[len] != '\0' && p[len] != ' ' && p[len] != '\t') len++;
+        bool ok = len < (int)sizeof(term);
+        if (ok) {
+            memcpy(term, p, len);
+            term[len] = '\0';
+            char* value = strchr(term, '=');
+            ok = value != nullptr;
+            if (ok) {
+                *value++ = '\0';
+                double number = 0;
+                if (strcmp(term, "days") == 0) {
+                    ok = parseNumber(value, days) && days > 0;
+                } else if (strcmp(term, "rate") == 0) {
+                    ok = parseNumber(value, rate) && rate > 0;
+                } else if (strcmp(term, "skew") == 0) {
+                    ok = parseNumber(value, skew);
+                } else if (strcmp(term, "warmup") == 0) {
+                    ok = parseNumber(value, warmupHours);
+                } else if (strcmp(term, "vehicles") == 0) {
+                    ok = parseNumber(value, number) && number >= 1 && number <= 1e9;
+                    vehicles = (int)number;
+                } else if (strcmp(term, "seed") == 0) {
+                    char* end;
+                    seed = strtoull(value, &end, 10);
+                    ok = *value != '\0' && *end == '\0';
+                } else if (strcmp(term, "profile") == 0) {
+                    ok = false;
+                    for (int i = PROFILE_FLAT; i <= PROFILE_OFFICE; i++) {
+                        if (strcmp(value, PROFILE_NAMES[i]) == 0) {
+                            profile = (ArrivalProfile)i;
+                            ok = true;
+                        }
+                    }
+                } else if (strcmp(term, "stay") == 0) {
+                    ok = parseStay(value, *this);
+                } else {
+                    ok = false;
+                }
+            }
+        }
+        if (!ok) {
+            snprintf(error, errorSize, "bad term '%.*s'", len, p);
+            return false;
+        }
+        p += len;
+    }
+    if (warmupHours * SIM_HOUR >= days * SIM_DAY) {
+        snprintf(error, errorSize, "warm-up covers the whole run");
+        return false;
+    }
+    return true;
+}
+
+Simulator::Simulator(const SimConfig& simConfig)
+    : config(simConfig), heapCount(0), heapCapacity(1024) {
+    heap = new SimEvent[heapCapacity];
+    state = config.seed * 0x9E3779B97F4A7C15ULL + 0x2545F4914F6CDD1DULL;
+    if (state == 0) state = 1;
+
+    const double* shape = config.profile == PROFILE_CITY ? CITY_PROFILE
+                        : config.profile == PROFILE_OFFICE ? OFFICE_PROFILE : FLAT_PROFILE;
+    double sum = 0;
+    for (int h = 0; h < SIM_HOURS_PER_DAY; h++) {
+        sum += shape[h];
+    }
+    profilePeak = 0;
+    for (int h = 0; h < SIM_HOURS_PER_DAY; h++) {
+        profile[h] = shape[h] * SIM_HOURS_PER_DAY / sum;
+        if (profile[h] > profilePeak) profilePeak = profile[h];
+    }
+}
+
+Simulator::~Simulator() {
+    delete[] heap;
+}
+
+static bool earlier(const SimEvent& a, const SimEvent& b) {
+    return a.time < b.time;
+}
+
+void Simulator::push(const SimEvent& event) {
+    if (heapCount == heapCapacity) {
+        int newCapacity = heapCapacity * 2;
+        SimEvent* grown = new SimEvent[newCapacity];
+        for (int i = 0; i < heapCount; i++) {
+            grown[i] = heap[i];
+        }
+        delete[] heap;
+        heap = grown;
+        heapCapacity = newCapacity;
+    }
+    int i = heapCount++;
+    while (i > 0 && earlier(event, heap[(i - 1) / 2])) {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = event;
+}
+
+SimEvent Simulator::pop() {
+    SimEvent top = heap[0];
+    SimEvent last = heap[--heapCount];
+    int i = 0;
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= heapCount) break;
+        if (child + 1 < heapCount && earlier(heap[child + 1], heap[child])) child++;
+        if (!earlier(heap[child], last)) break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    if (heapCount > 0) heap[i] = last;
+    return top;
+}
+
+// In (0, 1)
+double Simulator::uniform() {
+    state ^= state >> 12;
+    state ^= state << 25;
+    state ^= state >> 27;
+    return ((state * 0x2545F4914F6CDD1DULL >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+}
+
+double Simulator::exponential(double mean) {
+    return -mean * std::log(uniform());
+}
+
+double Simulator::normal() {
+    return std::sqrt(-2 * std::log(uniform())) * std::cos(6.283185307179586 * uniform());
+}
+
+long long Simulator::drawStay() {
+    double minutes = config.stayA;
+    switch (config.stay) {
+        case STAY_EXPONENTIAL:
+            minutes = exponential(config.stayA);
+            break;
+        case STAY_LOGNORMAL: {
+            double mu = std::log(config.stayA) - config.stayB * config.stayB / 2;
+            minutes = std::exp(mu + config.stayB * normal());
+            break;
+        }
+        case STAY_FIXED:
+            break;
+        case STAY_UNIFORM:
+            minutes = config.stayA + (config.stayB - config.stayA) * uniform();
+            break;
+    }
+    long long stay = (long long)(minutes * SIM_MINUTE);
+    return stay > 0 ? stay : 1;
+}
+
+// Accumulates slots x milliseconds held in [from, to), after warm-up only
+static void integrate(long long from, long long to, long long warmup, int occupied,
+                      double* byHour, double& total) {
+    if (from < warmup) from = warmup;
+    while (from < to) {
+        long long hourEnd = (from / SIM_HOUR + 1) * SIM_HOUR;
+        long long end = hourEnd < to ? hourEnd : to;
+        double area = (double)occupied * (end - from);
+        total += area;
+        if (byHour != nullptr) {
+            byHour[from / SIM_HOUR % SIM_HOURS_PER_DAY] += area;
+        }
+        from = end;
+    }
+}
+
+void Simulator::run(ParkingSystem& system, SimReport& report) {
+    std::chrono::steady_clock::time_point started = std::chrono::steady_clock::now();
+    memset(&report, 0, sizeof(report));
+    long long end = (long long)(config.days * SIM_DAY);
+    long long warmup = (long long)(config.warmupHours * SIM_HOUR);
+    report.simulatedMillis = end;
+    report.measuredMillis = end - warmup;
+
+    int zoneCount = system.getZoneCount();
+    double* zoneRate = new double[zoneCount];        // peak candidate arrivals per ms
+    int* zoneOccupied = new int[zoneCount];
+    long long* zoneChanged = new long long[zoneCount];
+    double* zoneArea = new double[zoneCount];
+    int* rank = new int[zoneCount];
+
+    // Popularity by a shuffled rank, so the busiest zones are spread out
+    for (int i = 0; i < zoneCount; i++) {
+        rank[i] = i;
+    }
+    for (int i = zoneCount - 1; i > 0; i--) {
+        int j = (int)(uniform() * (i + 1));
+        int swap = rank[i];
+        rank[i] = rank[j];
+        rank[j] = swap;
+    }
+    double weightSum = 0;
+    for (int i = 0; i < zoneCount; i++) {
+        weightSum += std::pow(rank[i] + 1.0, -config.skew);
+    }
+    for (int i = 0; i < zoneCount; i++) {
+        double weight = std::pow(rank[i] + 1.0, -config.skew) * zoneCount / weightSum;
+        zoneRate[i] = config.rate * weight * profilePeak / SIM_HOUR;
+        zoneOccupied[i] = 0;
+        zoneChanged[i] = 0;
+        zoneArea[i] = 0;
+        report.totalSlots += system.getZoneAt(i)->getTotalSlots();
+
+        SimEvent arrival = {(long long)exponential(1 / zoneRate[i]), i, 0};
+        push(arrival);
+    }
+
+    int occupied = 0;
+    long long now = 0;
+    double totalArea = 0;
+    double hourArea[SIM_HOURS_PER_DAY] = {0};
+    char plate[16];
+
+    while (heapCount > 0 && heap[0].time < end) {
+        SimEvent event = pop();
+        integrate(now, event.time, warmup, occupied, hourArea, totalArea);
+        now = event.time;
+        system.setVirtualTime(now);
+        report.events++;
+        bool measured = now >= warmup;
+
+        if (event.zonePosition < 0) {
+            ParkingRequest* request = system.findRequest(event.requestId);
+            int position = system.getZonePosition(request->getAllocatedZone());
+            std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+            system.releaseParking(event.requestId);
+            report.engineSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+            report.engineOps++;
+            integrate(zoneChanged[position], now, warmup, zoneOccupied[position], nullptr, zoneArea[position]);
+            zoneChanged[position] = now;
+            zoneOccupied[position]--;
+            occupied--;
+            if (measured) report.departures++;
+            continue;
+        }
+
+        // Thinning: candidates come at the peak rate and are kept in
+        // proportion to the rate at this hour
+        int position = event.zonePosition;
+        event.time = now + 1 + (long long)exponential(1 / zoneRate[position]);
+        push(event);
+        if (uniform() * profilePeak >= profile[now / SIM_HOUR % SIM_HOURS_PER_DAY]) continue;
+
+        snprintf(plate, sizeof(plate), "SIM%d", (int)(uniform() * config.vehicles));
+        std::chrono::steady_clock::time_point before = std::chrono::steady_clock::now();
+        ParkingRequest* request = system.createRequest(plate, system.getZoneAt(position)->getZoneId());
+        report.engineSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - before).count();
+        report.engineOps++;
+        int hour = (int)(now / SIM_HOUR % SIM_HOURS_PER_DAY);
+        if (measured) {
+            report.arrivals++;
+            report.hourArrivals[hour]++;
+        }
+        if (request->getState() != OCCUPIED) {
+            if (measured) {
+                report.rejected++;
+                report.hourRejected[hour]++;
+            }
+            continue;
+        }
+
+        int allocated = system.getZonePosition(request->getAllocatedZone());
+        integrate(zoneChanged[allocated], now, warmup, zoneOccupied[allocated], nullptr, zoneArea[allocated]);
+        zoneChanged[allocated] = now;
+        zoneOccupied[allocated]++;
+        occupied++;
+        if (measured) {
+            report.allocated++;
+            if (request->hasCrossZonePenalty()) report.crossZone++;
+            if (report.totalSlots > 0 && (double)occupied / report.totalSlots > report.peakUtilization) {
+                report.peakUtilization = (double)occupied / report.totalSlots;
+            }
+        }
+        SimEvent departure = {now + drawStay(), -1, request->getRequestId()};
+        push(departure);
+    }
+    integrate(now, end, warmup, occupied, hourArea, totalArea);
+
+    if (report.totalSlots > 0) {
+        report.averageUtilization = totalArea / ((double)report.totalSlots * report.measuredMillis);
+        // Each hour of the day is covered for the same time, give or take
+        // the part cut off by warm-up and the end of the run
+        for (int h = 0; h < SIM_HOURS_PER_DAY; h++) {
+            long long covered = 0;
+            for (long long day = warmup / SIM_DAY; day * SIM_DAY < end; day++) {
+                long long from = day * SIM_DAY + h * SIM_HOUR;
+                long long to = from + SIM_HOUR;
+                if (from < warmup) from = warmup;
+                if (to > end) to = end;
+                if (to > from) covered += to - from;
+            }
+            report.hourUtilization[h] = covered > 0 ? hourArea[h] / ((double)report.totalSlots * covered) : 0;
+        }
+    }
+    report.zoneMin = -1;
+    report.zoneMax = -1;
+    for (int i = 0; i < zoneCount; i++) {
+        Zone* zone = system.getZoneAt(i);
+        if (zone->getTotalSlots() == 0) continue;
+        integrate(zoneChanged[i], end, warmup, zoneOccupied[i], nullptr, zoneArea[i]);
+        double utilization = zoneArea[i] / ((double)zone->getTotalSlots() * report.measuredMillis);
+        if (report.zoneMin < 0 || utilization < report.zoneMinUtilization) {
+            report.zoneMin = zone->getZoneId();
+            report.zoneMinUtilization = utilization;
+        }
+        if (report.zoneMax < 0 || utilization > report.zoneMaxUtilization) {
+            report.zoneMax = zone->getZoneId();
+            report.zoneMaxUtilization = utilization;
+        }
+    }
+
+    delete[] zoneRate;
+    delete[] zoneOccupied;
+    delete[] zoneChanged;
+    delete[] zoneArea;
+    delete[] rank;
+    heapCount = 0;
+    report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+}
+
+static double percent(long long part, long long whole) {
+    return whole > 0 ? 100.0 * part / whole : 0;
+}
+
+void Simulator::printReport(const SimReport& report, std::ostream& out) {
+    char line[128];
+    snprintf(line, sizeof(line), "%.2f days (%.2f measured) in %.2f s",
+             report.simulatedMillis / (double)SIM_DAY, report.measuredMillis / (double)SIM_DAY,
+             report.wallSeconds);
+    out << "Simulated        : " << line << "\n";
+    out << "Events           : " << report.events << "\n";
+    snprintf(line, sizeof(line), "%lld ops, %.0f ops/s, %.0f ns/op", report.engineOps,
+             report.engineSeconds > 0 ? report.engineOps / report.engineSeconds : 0,
+             report.engineOps > 0 ? report.engineSeconds * 1e9 / report.engineOps : 0);
+    out << "Engine           : " << line << "\n";
+    out << "Slots            : " << report.totalSlots << "\n";
+    out << "Arrivals         : " << report.arrivals << "\n";
+    snprintf(line, sizeof(line), "%lld (%.2f%%)", report.rejected, percent(report.rejected, report.arrivals));
+    out << "Rejected         : " << line << "\n";
+    snprintf(line, sizeof(line), "%lld (%.2f%% of allocated)", report.crossZone,
+             percent(report.crossZone, report.allocated));
+    out << "Cross-zone       : " << line << "\n";
+    snprintf(line, sizeof(line), "%.2f%% average, %.2f%% peak", report.averageUtilization * 100,
+             report.peakUtilization * 100);
+    out << "Utilization      : " << line << "\n";
+    if (report.zoneMin >= 0) {
+        snprintf(line, sizeof(line), "%.2f%% (zone %d) to %.2f%% (zone %d)",
+                 report.zoneMinUtilization * 100, report.zoneMin, report.zoneMaxUtilization * 100,
+                 report.zoneMax);
+        out << "Zone utilization : " << line << "\n";
+    }
+    out << "Hour  Utilization  Arrivals  Rejected\n";
+    for (int h = 0; h < SIM_HOURS_PER_DAY; h++) {
+        snprintf(line, sizeof(line), "%02d    %10.2f%%  %8lld  %8lld", h, report.hourUtilization[h] * 100,
+                 report.hourArrivals[h], report.hourRejected[h]);
+        out << line << "\n";
+    }
+}
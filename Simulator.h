@@ -0,0 +1,109 @@
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <iosfwd>
+
+class ParkingSystem;
+
+enum StayDistribution {
+    STAY_EXPONENTIAL,
+    STAY_LOGNORMAL,
+    STAY_FIXED,
+    STAY_UNIFORM
+};
+
+enum ArrivalProfile {
+    PROFILE_FLAT,
+    PROFILE_CITY,       // morning and evening peaks, quiet nights
+    PROFILE_OFFICE      // one working-day block
+};
+
+const int SIM_HOURS_PER_DAY = 24;
+const long long SIM_MINUTE = 60000;
+const long long SIM_HOUR = 3600000;
+const long long SIM_DAY = 86400000;
+
+// Written as space-separated terms, e.g.
+//   days=7 rate=40 profile=city stay=lognormal:90:0.8 skew=1 warmup=24
+struct SimConfig {
+    double days;
+    double rate;                // mean arrivals per zone per hour
+    double skew;                // zone popularity ~ 1 / rank^skew, 0 = even
+    ArrivalProfile profile;
+    StayDistribution stay;
+    double stayA;               // minutes: mean (exp, lognormal, fixed) or low (uniform)
+    double stayB;               // lognormal sigma, uniform high
+    int vehicles;               // distinct plates arrivals are drawn from
+    unsigned long long seed;
+    double warmupHours;         // left out of the report
+
+    SimConfig();
+    // False, with the offending term in error, if the text does not parse
+    bool parse(const char* text, char* error, int errorSize);
+};
+
+struct SimReport {
+    long long simulatedMillis;
+    long long measuredMillis;       // after warm-up
+    long long events;
+    long long arrivals;             // after warm-up, as are the counts below
+    long long allocated;
+    long long rejected;
+    long long crossZone;
+    long long departures;
+    int totalSlots;
+    double averageUtilization;      // time-weighted, all slots
+    double peakUtilization;
+    double zoneMinUtilization;      // least and most used zone, time-weighted
+    double zoneMaxUtilization;
+    int zoneMin;
+    int zoneMax;
+    double hourUtilization[SIM_HOURS_PER_DAY];      // by hour of day
+    long long hourArrivals[SIM_HOURS_PER_DAY];
+    long long hourRejected[SIM_HOURS_PER_DAY];
+    long long engineOps;            // requests and releases, including warm-up
+    double engineSeconds;           // wall time inside the engine
+    double wallSeconds;
+};
+
+struct SimEvent {
+    long long time;
+    int zonePosition;           // arrival candidate for this zone, or -1
+    int requestId;              // departure, when zonePosition is -1
+};
+
+// Discrete-event simulation of city traffic against a real ParkingSystem on
+// a virtual millisecond clock. Each zone has its own Poisson arrival
+// process whose rate follows the profile over the day (drawn by thinning);
+// every parked car schedules its departure after a stay drawn from the
+// configured distribution. Events run in time order from a binary heap.
+class Simulator {
+private:
+    SimConfig config;
+    SimEvent* heap;
+    int heapCount;
+    int heapCapacity;
+    unsigned long long state;   // xorshift64*
+
+    double profile[SIM_HOURS_PER_DAY];
+    double profilePeak;
+
+    void push(const SimEvent& event);
+    SimEvent pop();
+    double uniform();
+    double exponential(double mean);
+    double normal();
+    long long drawStay();
+
+public:
+    Simulator(const SimConfig& simConfig);
+    ~Simulator();
+
+    // Runs the system, which must have zones and no waitlist, for the
+    // configured number of days from time 0 (midnight)
+    void run(ParkingSystem& system, SimReport& report);
+
+    static void printReport(const SimReport& report, std::ostream& out);
+};
+
+#endif
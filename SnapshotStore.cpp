@@ -0,0 +1,402 @@
+#include "SnapshotStore.h"
+#include "ParkingSystem.h"
+#include "Zone.h"
+#include <climits>
+#include <ctime>
+#include <thread>
+
+enum ReplacedKind {
+    REPLACED_ZONE,
+    REPLACED_PAGE,
+    REPLACED_CHUNK
+};
+
+static const long long PUBLISH_INTERVAL_NANOS = 1000000LL;
+
+static long long nowNanos() {
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+void ZoneView::captureCounters(const Zone* zone) {
+    zoneId = zone->getZoneId();
+    totalSlots = zone->getTotalSlots();
+    availableSlots = zone->getAvailableSlots();
+    for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+        totalByClass[c] = zone->getTotalSlots((SlotClass)c);
+        availableByClass[c] = zone->getAvailableSlots((SlotClass)c);
+    }
+    slotIds = nullptr;
+    slotClasses = nullptr;
+    freeBits = nullptr;
+    ownsLayout = false;
+}
+
+bool ZoneView::isSlotFree(int position) const {
+    return (freeBits[position >> 6] >> (position & 63)) & 1;
+}
+
+void RequestView::capture(const ParkingRequest* req) {
+    request = req;
+    allocationTime = req->getAllocationTime();
+    releaseTime = req->getReleaseTime();
+    distance = req->getCrossZoneDistance();
+    allocatedZone = req->getAllocatedZone();
+    allocatedSlotId = req->getAllocatedSlotId();
+    state = req->getState();
+    crossZone = req->hasCrossZonePenalty();
+}
+
+long long RequestView::getParkingDuration() const {
+    if (state == RELEASED && allocationTime > 0 && releaseTime > 0) {
+        return releaseTime - allocationTime;
+    }
+    return 0;
+}
+
+long long SystemSnapshot::getVersion() const {
+    return version;
+}
+
+long long SystemSnapshot::getTime() const {
+    return time;
+}
+
+int SystemSnapshot::getRollbackDepth() const {
+    return rollbackDepth;
+}
+
+int SystemSnapshot::getZoneCount() const {
+    return zoneCount;
+}
+
+const ZoneView& SystemSnapshot::getZone(int position) const {
+    return *zones[position];
+}
+
+const ZoneView* SystemSnapshot::findZone(int zoneId) const {
+    for (int i = 0; i < zoneCount; i++) {
+        if (zones[i]->zoneId == zoneId) return zones[i];
+    }
+    return nullptr;
+}
+
+int SystemSnapshot::getRequestCount() const {
+    return requestCount;
+}
+
+const RequestView& SystemSnapshot::getRequest(int requestId) const {
+    int index = requestId - 1;
+    int page = index / SNAPSHOT_PAGE_REQUESTS;
+    return chunks[page / SNAPSHOT_CHUNK_PAGES]->pages[page % SNAPSHOT_CHUNK_PAGES]
+        ->requests[index % SNAPSHOT_PAGE_REQUESTS];
+}
+
+SnapshotStore::SnapshotStore()
+    : globalEpoch(1), current(nullptr), retiredHead(nullptr), retiredTail(nullptr), nextVersion(1),
+      dirtyZoneCount(0), zoneDirtyCapacity(16), dirtyPageCount(0), pageDirtyCapacity(64),
+      dirty(true), writesSincePublish(0), lastPublishNanos(0) {
+    for (int i = 0; i < SNAPSHOT_READER_SLOTS; i++) {
+        readers[i].epoch.store(0, std::memory_order_relaxed);
+    }
+    zoneDirty = new bool[zoneDirtyCapacity];
+    dirtyZones = new int[zoneDirtyCapacity];
+    for (int i = 0; i < zoneDirtyCapacity; i++) {
+        zoneDirty[i] = false;
+    }
+    pageDirty = new bool[pageDirtyCapacity];
+    dirtyPages = new int[pageDirtyCapacity];
+    for (int i = 0; i < pageDirtyCapacity; i++) {
+        pageDirty[i] = false;
+    }
+}
+
+// Only called once no reader can be active
+SnapshotStore::~SnapshotStore() {
+    while (retiredHead != nullptr) {
+        SystemSnapshot* next = retiredHead->nextRetired;
+        freeSnapshot(retiredHead, false);
+        retiredHead = next;
+    }
+    SystemSnapshot* last = current.load();
+    if (last != nullptr) {
+        freeSnapshot(last, true);
+    }
+    delete[] zoneDirty;
+    delete[] dirtyZones;
+    delete[] pageDirty;
+    delete[] dirtyPages;
+}
+
+static void freeZone(ZoneView* view) {
+    if (view->ownsLayout) {
+        delete[] view->slotIds;
+        delete[] view->slotClasses;
+    }
+    delete[] view->freeBits;
+    delete view;
+}
+
+// A retired snapshot frees its shell and the pieces it was the last to use;
+// the final published one owns every piece it points at
+void SnapshotStore::freeSnapshot(SystemSnapshot* snapshot, bool ownsEverything) {
+    while (snapshot->replaced != nullptr) {
+        ReplacedPiece* piece = snapshot->replaced;
+        snapshot->replaced = piece->next;
+        switch (piece->kind) {
+            case REPLACED_ZONE: freeZone((ZoneView*)piece->piece); break;
+            case REPLACED_PAGE: delete (RequestPage*)piece->piece; break;
+            case REPLACED_CHUNK: delete (RequestChunk*)piece->piece; break;
+        }
+        delete piece;
+    }
+    if (ownsEverything) {
+        for (int i = 0; i < snapshot->zoneCount; i++) {
+            freeZone(snapshot->zones[i]);
+        }
+        for (int c = 0; c < snapshot->chunkCount; c++) {
+            for (int p = 0; p < SNAPSHOT_CHUNK_PAGES; p++) {
+                delete snapshot->chunks[c]->pages[p];
+            }
+            delete snapshot->chunks[c];
+        }
+    }
+    delete[] snapshot->zones;
+    delete[] snapshot->chunks;
+    delete snapshot;
+}
+
+void SnapshotStore::replace(SystemSnapshot* snapshot, int kind, void* piece) {
+    ReplacedPiece* node = new ReplacedPiece;
+    node->kind = kind;
+    node->piece = piece;
+    node->next = snapshot->replaced;
+    snapshot->replaced = node;
+}
+
+void SnapshotStore::markZone(int position) {
+    if (position >= zoneDirtyCapacity) {
+        int newCapacity = zoneDirtyCapacity * 2;
+        while (newCapacity <= position) newCapacity *= 2;
+        bool* grownFlags = new bool[newCapacity];
+        int* grownList = new int[newCapacity];
+        for (int i = 0; i < newCapacity; i++) {
+            grownFlags[i] = i < zoneDirtyCapacity ? zoneDirty[i] : false;
+        }
+        for (int i = 0; i < dirtyZoneCount; i++) {
+            grownList[i] = dirtyZones[i];
+        }
+        delete[] zoneDirty;
+        delete[] dirtyZones;
+        zoneDirty = grownFlags;
+        dirtyZones = grownList;
+        zoneDirtyCapacity = newCapacity;
+    }
+    if (!zoneDirty[position]) {
+        zoneDirty[position] = true;
+        dirtyZones[dirtyZoneCount++] = position;
+    }
+    dirty = true;
+}
+
+void SnapshotStore::markRequest(int requestId) {
+    int page = (requestId - 1) / SNAPSHOT_PAGE_REQUESTS;
+    if (page >= pageDirtyCapacity) {
+        int newCapacity = pageDirtyCapacity * 2;
+        while (newCapacity <= page) newCapacity *= 2;
+        bool* grownFlags = new bool[newCapacity];
+        int* grownList = new int[newCapacity];
+        for (int i = 0; i < newCapacity; i++) {
+            grownFlags[i] = i < pageDirtyCapacity ? pageDirty[i] : false;
+        }
+        for (int i = 0; i < dirtyPageCount; i++) {
+            grownList[i] = dirtyPages[i];
+        }
+        delete[] pageDirty;
+        delete[] dirtyPages;
+        pageDirty = grownFlags;
+        dirtyPages = grownList;
+        pageDirtyCapacity = newCapacity;
+    }
+    if (!pageDirty[page]) {
+        pageDirty[page] = true;
+        dirtyPages[dirtyPageCount++] = page;
+    }
+    dirty = true;
+}
+
+// The clock is only read every 64 writes
+bool SnapshotStore::due() {
+    if ((++writesSincePublish & 63) != 0) return false;
+    return nowNanos() - lastPublishNanos >= PUBLISH_INTERVAL_NANOS;
+}
+
+ZoneView* SnapshotStore::buildZone(const Zone* zone, ZoneView* previous) {
+    ZoneView* view = new ZoneView;
+    view->captureCounters(zone);
+    int count = view->totalSlots;
+    if (previous != nullptr && previous->totalSlots == count) {
+        view->slotIds = previous->slotIds;
+        view->slotClasses = previous->slotClasses;
+        previous->ownsLayout = false;
+    } else {
+        view->slotIds = new int[count > 0 ? count : 1];
+        view->slotClasses = new unsigned char[count > 0 ? count : 1];
+        for (int i = 0; i < count; i++) {
+            ParkingSlot* slot = zone->getSlotAt(i);
+            view->slotIds[i] = slot->getSlotId();
+            view->slotClasses[i] = (unsigned char)slot->getSlotClass();
+        }
+    }
+    view->ownsLayout = true;
+
+    int words = (count + 63) / 64;
+    view->freeBits = new unsigned long long[words > 0 ? words : 1];
+    for (int w = 0; w < words; w++) {
+        view->freeBits[w] = 0;
+    }
+    for (int i = 0; i < count; i++) {
+        if (zone->getSlotAt(i)->isAvailable()) {
+            view->freeBits[i >> 6] |= 1ULL << (i & 63);
+        }
+    }
+    return view;
+}
+
+RequestPage* SnapshotStore::buildPage(int page, const RequestStore& requests) {
+    RequestPage* built = new RequestPage;
+    int first = page * SNAPSHOT_PAGE_REQUESTS + 1;
+    for (int i = 0; i < SNAPSHOT_PAGE_REQUESTS && first + i <= requests.getCount(); i++) {
+        built->requests[i].capture(requests.get(first + i));
+    }
+    return built;
+}
+
+bool SnapshotStore::publish(Zone* const* zones, int zoneCount, const RequestStore& requests,
+                            long long time, int rollbackDepth) {
+    int requestCount = requests.getCount();
+    SystemSnapshot* previous = current.load(std::memory_order_relaxed);
+    if (!dirty && previous != nullptr && previous->rollbackDepth == rollbackDepth) {
+        return false;
+    }
+
+    SystemSnapshot* next = new SystemSnapshot;
+    next->version = nextVersion++;
+    next->time = time;
+    next->rollbackDepth = rollbackDepth;
+    next->zoneCount = zoneCount;
+    next->requestCount = requestCount;
+    next->replaced = nullptr;
+    next->retiredEpoch = 0;
+    next->nextRetired = nullptr;
+
+    next->zones = new ZoneView*[zoneCount > 0 ? zoneCount : 1];
+    for (int i = 0; i < zoneCount; i++) {
+        next->zones[i] = previous != nullptr && i < previous->zoneCount ? previous->zones[i] : nullptr;
+    }
+    for (int d = 0; d < dirtyZoneCount; d++) {
+        int position = dirtyZones[d];
+        zoneDirty[position] = false;
+        if (position >= zoneCount) continue;
+        ZoneView* old = next->zones[position];
+        next->zones[position] = buildZone(zones[position], old);
+        if (old != nullptr) replace(previous, REPLACED_ZONE, old);
+    }
+    dirtyZoneCount = 0;
+
+    int pageCount = (requestCount + SNAPSHOT_PAGE_REQUESTS - 1) / SNAPSHOT_PAGE_REQUESTS;
+    next->chunkCount = (pageCount + SNAPSHOT_CHUNK_PAGES - 1) / SNAPSHOT_CHUNK_PAGES;
+    next->chunks = new RequestChunk*[next->chunkCount > 0 ? next->chunkCount : 1];
+    for (int c = 0; c < next->chunkCount; c++) {
+        next->chunks[c] = previous != nullptr && c < previous->chunkCount ? previous->chunks[c] : nullptr;
+    }
+    for (int d = 0; d < dirtyPageCount; d++) {
+        int page = dirtyPages[d];
+        pageDirty[page] = false;
+        if (page >= pageCount) continue;
+
+        // A chunk is copied once per snapshot, however many of its pages changed
+        int c = page / SNAPSHOT_CHUNK_PAGES;
+        RequestChunk* chunk = next->chunks[c];
+        if (chunk == nullptr || chunk->version != next->version) {
+            RequestChunk* copy = new RequestChunk;
+            for (int p = 0; p < SNAPSHOT_CHUNK_PAGES; p++) {
+                copy->pages[p] = chunk != nullptr ? chunk->pages[p] : nullptr;
+            }
+            copy->version = next->version;
+            if (chunk != nullptr) replace(previous, REPLACED_CHUNK, chunk);
+            next->chunks[c] = chunk = copy;
+        }
+        RequestPage* old = chunk->pages[page % SNAPSHOT_CHUNK_PAGES];
+        chunk->pages[page % SNAPSHOT_CHUNK_PAGES] = buildPage(page, requests);
+        if (old != nullptr) replace(previous, REPLACED_PAGE, old);
+    }
+    dirtyPageCount = 0;
+    dirty = false;
+    writesSincePublish = 0;
+    lastPublishNanos = nowNanos();
+
+    // Readers that announced an epoch up to the retired one may still hold
+    // the previous snapshot; later ones can only see the new one
+    current.store(next);
+    if (previous != nullptr) {
+        previous->retiredEpoch = globalEpoch.fetch_add(1);
+        if (retiredTail == nullptr) {
+            retiredHead = retiredTail = previous;
+        } else {
+            retiredTail->nextRetired = previous;
+            retiredTail = previous;
+        }
+    }
+    collect();
+    return true;
+}
+
+void SnapshotStore::collect() {
+    long long oldest = LLONG_MAX;
+    for (int i = 0; i < SNAPSHOT_READER_SLOTS; i++) {
+        long long epoch = readers[i].epoch.load();
+        if (epoch != 0 && epoch < oldest) oldest = epoch;
+    }
+    while (retiredHead != nullptr && retiredHead->retiredEpoch < oldest) {
+        SystemSnapshot* next = retiredHead->nextRetired;
+        freeSnapshot(retiredHead, false);
+        retiredHead = next;
+    }
+    if (retiredHead == nullptr) {
+        retiredTail = nullptr;
+    }
+}
+
+// Claims a free reader slot by announcing the current epoch in it, then
+// takes the newest snapshot. Only readers ever wait here, for each other.
+int SnapshotStore::pin(const SystemSnapshot** snapshot) {
+    while (true) {
+        for (int i = 0; i < SNAPSHOT_READER_SLOTS; i++) {
+            long long expected = 0;
+            if (readers[i].epoch.load(std::memory_order_relaxed) == 0 &&
+                readers[i].epoch.compare_exchange_strong(expected, globalEpoch.load())) {
+                *snapshot = current.load();
+                return i;
+            }
+        }
+        std::this_thread::yield();
+    }
+}
+
+void SnapshotStore::unpin(int slot) {
+    readers[slot].epoch.store(0, std::memory_order_release);
+}
+
+SnapshotReader::SnapshotReader(SnapshotStore& source) : store(source) {
+    slot = store.pin(&snapshot);
+}
+
+SnapshotReader::~SnapshotReader() {
+    store.unpin(slot);
+}
+
+const SystemSnapshot& SnapshotReader::get() const {
+    return *snapshot;
+}
@@ -0,0 +1,162 @@
+#ifndef SNAPSHOTSTORE_H
+#define SNAPSHOTSTORE_H
+
+#include <atomic>
+#include "ParkingSlot.h"
+#include "ParkingRequest.h"
+
+class Zone;
+class RequestStore;
+
+// A zone as of one snapshot: its counters and every slot's availability by
+// position in the zone. Slot IDs and classes never change, so consecutive
+// versions share them and only the newest version owns them.
+struct ZoneView {
+    int zoneId;
+    int totalSlots;
+    int availableSlots;
+    int totalByClass[SLOT_CLASS_COUNT];
+    int availableByClass[SLOT_CLASS_COUNT];
+    int* slotIds;
+    unsigned char* slotClasses;
+    unsigned long long* freeBits;
+    bool ownsLayout;
+
+    void captureCounters(const Zone* zone);
+    bool isSlotFree(int position) const;
+};
+
+// A request's changing fields as of one snapshot. The request itself is only
+// read for what is fixed at creation (ID, vehicle, requested zone, class and
+// request time); requests live as long as the system.
+struct RequestView {
+    const ParkingRequest* request;
+    long long allocationTime;
+    long long releaseTime;
+    double distance;
+    int allocatedZone;
+    int allocatedSlotId;
+    RequestState state;
+    bool crossZone;
+
+    void capture(const ParkingRequest* req);
+    long long getParkingDuration() const;
+};
+
+const int SNAPSHOT_PAGE_REQUESTS = 128;
+const int SNAPSHOT_CHUNK_PAGES = 256;
+const int SNAPSHOT_READER_SLOTS = 64;
+
+struct RequestPage {
+    RequestView requests[SNAPSHOT_PAGE_REQUESTS];
+};
+
+struct RequestChunk {
+    RequestPage* pages[SNAPSHOT_CHUNK_PAGES];
+    long long version;      // snapshot that created it
+};
+
+// Pieces a snapshot shared with its predecessor until they changed
+struct ReplacedPiece {
+    int kind;
+    void* piece;
+    ReplacedPiece* next;
+};
+
+// Immutable point-in-time view of zones, slots and requests. Consecutive
+// snapshots share every zone, request page and chunk that did not change;
+// a superseded snapshot keeps the pieces its successor replaced and frees
+// them along with itself.
+class SystemSnapshot {
+    friend class SnapshotStore;
+private:
+    long long version;
+    long long time;
+    int rollbackDepth;
+    int zoneCount;
+    ZoneView** zones;
+    int requestCount;
+    RequestChunk** chunks;
+    int chunkCount;
+    ReplacedPiece* replaced;
+    long long retiredEpoch;
+    SystemSnapshot* nextRetired;
+
+public:
+    long long getVersion() const;
+    long long getTime() const;
+    int getRollbackDepth() const;
+    int getZoneCount() const;
+    const ZoneView& getZone(int position) const;
+    const ZoneView* findZone(int zoneId) const;
+    int getRequestCount() const;
+    const RequestView& getRequest(int requestId) const;
+};
+
+// Publishes snapshots from the allocating thread and hands them to readers
+// on any thread. Readers announce the epoch they started in and never wait;
+// the writer never waits either, it only frees a superseded snapshot once
+// every reader that could still hold it has finished.
+class SnapshotStore {
+private:
+    struct alignas(64) ReaderSlot {
+        std::atomic<long long> epoch;   // 0 when free
+    };
+
+    ReaderSlot readers[SNAPSHOT_READER_SLOTS];
+    std::atomic<long long> globalEpoch;
+    std::atomic<SystemSnapshot*> current;
+    SystemSnapshot* retiredHead;
+    SystemSnapshot* retiredTail;
+    long long nextVersion;
+
+    bool* zoneDirty;
+    int* dirtyZones;
+    int dirtyZoneCount;
+    int zoneDirtyCapacity;
+    bool* pageDirty;
+    int* dirtyPages;
+    int dirtyPageCount;
+    int pageDirtyCapacity;
+    bool dirty;
+    long long writesSincePublish;
+    long long lastPublishNanos;
+
+    ZoneView* buildZone(const Zone* zone, ZoneView* previous);
+    RequestPage* buildPage(int page, const RequestStore& requests);
+    void collect();
+    static void freeSnapshot(SystemSnapshot* snapshot, bool ownsEverything);
+    static void replace(SystemSnapshot* snapshot, int kind, void* piece);
+
+public:
+    SnapshotStore();
+    ~SnapshotStore();
+
+    void markZone(int position);
+    void markRequest(int requestId);
+    // True every so often during a burst of writes, so readers never fall
+    // more than about a millisecond behind
+    bool due();
+    // Publishes the current state if anything changed; writer thread only.
+    bool publish(Zone* const* zones, int zoneCount, const RequestStore& requests,
+                 long long time, int rollbackDepth);
+
+    int pin(const SystemSnapshot** snapshot);
+    void unpin(int slot);
+};
+
+// Holds one snapshot for the lifetime of the reader
+class SnapshotReader {
+private:
+    SnapshotStore& store;
+    const SystemSnapshot* snapshot;
+    int slot;
+
+public:
+    SnapshotReader(SnapshotStore& source);
+    ~SnapshotReader();
+
+    const SystemSnapshot& get() const;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "TraceRecorder.h"
+#include <chrono>
+#include <cstring>
+
+static const int TRACE_BUFFER_SIZE = 1 << 20;
+
+static long long nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TraceRecorder::TraceRecorder()
+    : file(nullptr), buffer(nullptr), startTime(0), lastTime(0), recordCount(0) {}
+
+TraceRecorder::~TraceRecorder() {
+    close();
+}
+
+bool TraceRecorder::open(const char* path) {
+    close();
+    file = fopen(path, "wb");
+    if (file == nullptr) return false;
+
+    buffer = new char[TRACE_BUFFER_SIZE];
+    setvbuf(file, buffer, _IOFBF, TRACE_BUFFER_SIZE);
+
+    fwrite("SPTR", 1, 4, file);
+    fputc(TRACE_VERSION, file);
+
+    startTime = nowNanos();
+    lastTime = startTime;
+    recordCount = 0;
+    return true;
+}
+
+void TraceRecorder::close() {
+    if (file != nullptr) {
+        fclose(file);
+        file = nullptr;
+    }
+    delete[] buffer;
+    buffer = nullptr;
+}
+
+bool TraceRecorder::isOpen() const {
+    return file != nullptr;
+}
+
+int TraceRecorder::getRecordCount() const {
+    return recordCount;
+}
+
+void TraceRecorder::recordCreate(const char* vehicleId, int zone, SlotClass slotClass, bool fallback,
+                                 int priority, bool allocated) {
+    writeRecord(TRACE_CREATE, allocated, zone, vehicleId,
+                slotClass | priority << 3 | (fallback ? 0x80 : 0));
+}
+
+void TraceRecorder::recordCancel(int requestId, bool result) {
+    writeRecord(TRACE_CANCEL, result, requestId, nullptr, 0);
+}
+
+void TraceRecorder::recordRelease(int requestId, bool result) {
+    writeRecord(TRACE_RELEASE, result, requestId, nullptr, 0);
+}
+
+void TraceRecorder::recordRollback(int k, bool result) {
+    writeRecord(TRACE_ROLLBACK, result, k, nullptr, 0);
+}
+
+void TraceRecorder::recordDrain(int zoneId, bool result) {
+    writeRecord(TRACE_DRAIN, result, zoneId, nullptr, 0);
+}
+
+void TraceRecorder::recordReopen(int zoneId, bool result) {
+    writeRecord(TRACE_REOPEN, result, zoneId, nullptr, 0);
+}
+
+void TraceRecorder::recordLease(int zoneId, SlotClass slotClass, int count, bool result) {
+    writeRecord(TRACE_LEASE, result, zoneId, nullptr, slotClass | (count - 1) << 3);
+}
+
+void TraceRecorder::recordLeasePark(int token, const char* vehicleId, bool result) {
+    writeRecord(TRACE_LEASE_PARK, result, token, vehicleId, 0);
+}
+
+void TraceRecorder::recordUnlease(int token, bool result) {
+    writeRecord(TRACE_UNLEASE, result, token, nullptr, 0);
+}
+
+void TraceRecorder::recordAddArea(int zoneId, int slotCount, SlotClass slotClass, bool located,
+                                  double x, double y, bool result) {
+    writeRecord(TRACE_ADD_AREA, result, zoneId, nullptr, slotClass | (located ? 0x80 : 0));
+    if (file == nullptr) return;
+    writeVarint((unsigned int)slotCount);
+    if (located) {
+        fwrite(&x, sizeof(x), 1, file);
+        fwrite(&y, sizeof(y), 1, file);
+    }
+}
+
+void TraceRecorder::writeRecord(TraceOp op, bool result, int arg, const char* vehicleId,
+                                int classByte) {
+    if (file == nullptr) return;
+
+    long long now = nowNanos();
+    fputc(op | (result ? 0x80 : 0), file);
+    writeVarint((unsigned long long)(now - lastTime));
+    writeVarint(((unsigned int)arg << 1) ^ (unsigned int)(arg >> 31));
+    lastTime = now;
+
+    if (op == TRACE_CREATE || op == TRACE_LEASE_PARK) {
+        int len = (int)strlen(vehicleId);
+        if (len >= TRACE_MAX_VEHICLE_ID) len = TRACE_MAX_VEHICLE_ID - 1;
+        fputc(len, file);
+        fwrite(vehicleId, 1, len, file);
+    }
+    if (op == TRACE_CREATE || op == TRACE_LEASE || op == TRACE_ADD_AREA) {
+        fputc(classByte, file);
+    }
+    recordCount++;
+}
+
+void TraceRecorder::writeVarint(unsigned long long value) {
+    while (value >= 0x80) {
+        fputc((int)(value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc((int)value, file);
+}
@@ -0,0 +1,86 @@
+#ifndef TRACERECORDER_H
+#define TRACERECORDER_H
+
+#include <cstdio>
+#include "ParkingSlot.h"
+
+// Binary trace layout:
+//   header  : "SPTR" + 1 version byte
+//   record  : op byte (bit 7 = recorded outcome)
+//             varint nanoseconds since previous record
+//             zigzag varint argument (zone, request id or k; drained or
+//             reopened zone, v4+; leased zone or lease token, v5+)
+//             CREATE only: length byte + vehicle id bytes
+//                          + class byte (bit 7 = fallback to standard; v2+;
+//                            bits 3-6 = waitlist priority, v3+)
+//             LEASE only (v5+): class byte (bits 3-7 = slots asked for - 1)
+//             LEASE_PARK only (v5+): length byte + vehicle id bytes
+//             ADD_AREA only (v6+): class byte (bit 7 = located) + varint
+//                          slot count; located: x and y as 8-byte doubles
+
+const int TRACE_VERSION = 6;
+const int TRACE_MAX_VEHICLE_ID = 64;
+
+enum TraceOp {
+    TRACE_CREATE = 1,
+    TRACE_CANCEL = 2,
+    TRACE_RELEASE = 3,
+    TRACE_ROLLBACK = 4,
+    TRACE_DRAIN = 5,
+    TRACE_REOPEN = 6,
+    TRACE_LEASE = 7,
+    TRACE_LEASE_PARK = 8,
+    TRACE_UNLEASE = 9,          // returned or expired
+    TRACE_ADD_AREA = 10
+};
+
+struct TraceEvent {
+    TraceOp op;
+    bool result;
+    long long timestamp;
+    int arg;
+    char vehicleId[TRACE_MAX_VEHICLE_ID];
+    SlotClass slotClass;
+    bool fallback;
+    int priority;
+    int count;              // LEASE: slots asked for; ADD_AREA: slots added
+    bool located;           // ADD_AREA: coordinates for a zone it creates
+    double x;
+    double y;
+};
+
+class TraceRecorder {
+private:
+    FILE* file;
+    char* buffer;
+    long long startTime;
+    long long lastTime;
+    int recordCount;
+
+    void writeRecord(TraceOp op, bool result, int arg, const char* vehicleId, int classByte);
+    void writeVarint(unsigned long long value);
+
+public:
+    TraceRecorder();
+    ~TraceRecorder();
+
+    bool open(const char* path);
+    void close();
+    bool isOpen() const;
+    int getRecordCount() const;
+
+    void recordCreate(const char* vehicleId, int zone, SlotClass slotClass, bool fallback,
+                      int priority, bool allocated);
+    void recordCancel(int requestId, bool result);
+    void recordRelease(int requestId, bool result);
+    void recordRollback(int k, bool result);
+    void recordDrain(int zoneId, bool result);
+    void recordReopen(int zoneId, bool result);
+    void recordLease(int zoneId, SlotClass slotClass, int count, bool result);
+    void recordLeasePark(int token, const char* vehicleId, bool result);
+    void recordUnlease(int token, bool result);
+    void recordAddArea(int zoneId, int slotCount, SlotClass slotClass, bool located, double x,
+                       double y, bool result);
+};
+
+#endif
@@ -0,0 +1,309 @@
+#include "TraceReplayer.h"
+#include "ParkingSystem.h"
+#include "Zone.h"
+#include "ParkingArea.h"
+#include "ParkingSlot.h"
+#include "ParkingRequest.h"
+#include <algorithm>
+#include <chrono>
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+static long long nowNanos() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static bool readVarint(const unsigned char*& p, const unsigned char* end, unsigned long long& value) {
+    value = 0;
+    int shift = 0;
+    while (p < end && shift < 64) {
+        unsigned char byte = *p++;
+        value |= (unsigned long long)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) return true;
+        shift += 7;
+    }
+    return false;
+}
+
+TraceReplayer::TraceReplayer() : events(nullptr), eventCount(0), eventCapacity(0) {}
+
+TraceReplayer::~TraceReplayer() {
+    delete[] events;
+}
+
+void TraceReplayer::appendEvent(const TraceEvent& event) {
+    if (eventCount == eventCapacity) {
+        int newCapacity = eventCapacity == 0 ? 1024 : eventCapacity * 2;
+        TraceEvent* grown = new TraceEvent[newCapacity];
+        for (int i = 0; i < eventCount; i++) {
+            grown[i] = events[i];
+        }
+        delete[] events;
+        events = grown;
+        eventCapacity = newCapacity;
+    }
+    events[eventCount++] = event;
+}
+
+bool TraceReplayer::load(const char* path) {
+    FILE* file = fopen(path, "rb");
+    if (file == nullptr) return false;
+
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size < 5) {
+        fclose(file);
+        return false;
+    }
+
+    unsigned char* data = new unsigned char[size];
+    bool readOk = fread(data, 1, size, file) == (size_t)size;
+    fclose(file);
+    // Version 1 traces predate slot classes; their creates are all standard
+    int version = readOk && size >= 5 ? data[4] : 0;
+    if (!readOk || memcmp(data, "SPTR", 4) != 0 || version < 1 || version > TRACE_VERSION) {
+        delete[] data;
+        return false;
+    }
+
+    eventCount = 0;
+    const unsigned char* p = data + 5;
+    const unsigned char* end = data + size;
+    long long timestamp = 0;
+    bool ok = true;
+
+    while (p < end) {
+        TraceEvent event;
+        unsigned char opByte = *p++;
+        event.op = (TraceOp)(opByte & 0x7F);
+        event.result = (opByte & 0x80) != 0;
+        event.vehicleId[0] = '\0';
+        event.slotClass = SLOT_STANDARD;
+        event.fallback = false;
+        event.priority = 0;
+        event.count = 0;
+        event.located = false;
+        event.x = 0;
+        event.y = 0;
+
+        unsigned long long delta, zigzag;
+        if (!readVarint(p, end, delta) || !readVarint(p, end, zigzag)) {
+            ok = false;
+            break;
+        }
+        timestamp += (long long)delta;
+        event.timestamp = timestamp;
+        event.arg = (int)((unsigned int)(zigzag >> 1) ^ (0u - (unsigned int)(zigzag & 1)));
+
+        if (event.op == TRACE_CREATE || event.op == TRACE_LEASE_PARK) {
+            if (p >= end || p + 1 + *p > end) {
+                ok = false;
+                break;
+            }
+            int len = *p++;
+            memcpy(event.vehicleId, p, len);
+            event.vehicleId[len] = '\0';
+            p += len;
+        }
+        if (event.op == TRACE_CREATE && version >= 2) {
+            if (p >= end || (*p & 0x07) >= SLOT_CLASS_COUNT) {
+                ok = false;
+                break;
+            }
+            event.slotClass = (SlotClass)(*p & 0x07);
+            event.fallback = (*p & 0x80) != 0;
+            event.priority = (*p >> 3) & 0x0F;
+            p++;
+        } else if (event.op == TRACE_LEASE) {
+            if (p >= end || (*p & 0x07) >= SLOT_CLASS_COUNT) {
+                ok = false;
+                break;
+            }
+            event.slotClass = (SlotClass)(*p & 0x07);
+            event.count = (*p >> 3) + 1;
+            p++;
+        } else if (event.op == TRACE_ADD_AREA) {
+            unsigned long long slots;
+            if (p >= end || (*p & 0x07) >= SLOT_CLASS_COUNT) {
+                ok = false;
+                break;
+            }
+            event.slotClass = (SlotClass)(*p & 0x07);
+            event.located = (*p & 0x80) != 0;
+            p++;
+            if (!readVarint(p, end, slots) || slots > INT_MAX ||
+                (event.located && end - p < 2 * (long)sizeof(double))) {
+                ok = false;
+                break;
+            }
+            event.count = (int)slots;
+            if (event.located) {
+                memcpy(&event.x, p, sizeof(double));
+                memcpy(&event.y, p + sizeof(double), sizeof(double));
+                p += 2 * sizeof(double);
+            }
+        } else if (event.op < TRACE_CREATE || event.op > TRACE_ADD_AREA) {
+            ok = false;
+            break;
+        }
+        appendEvent(event);
+    }
+
+    delete[] data;
+    return ok;
+}
+
+int TraceReplayer::getEventCount() const {
+    return eventCount;
+}
+
+const TraceEvent& TraceReplayer::getEvent(int index) const {
+    return events[index];
+}
+
+bool TraceReplayer::apply(ParkingSystem& system, const TraceEvent& event) {
+    switch (event.op) {
+        case TRACE_CREATE:
+            return system.createRequest(event.vehicleId, event.arg, event.slotClass,
+                                        event.fallback, event.priority)->getState() == OCCUPIED;
+        case TRACE_CANCEL:
+            return system.cancelRequest(event.arg);
+        case TRACE_RELEASE:
+            return system.releaseParking(event.arg);
+        case TRACE_ROLLBACK:
+            return system.rollbackAllocations(event.arg);
+        case TRACE_DRAIN:
+            return system.drainZone(event.arg);
+        case TRACE_REOPEN:
+            return system.reopenZone(event.arg);
+        case TRACE_LEASE:
+            return system.leaseSlots(event.arg, event.slotClass, event.count, LLONG_MAX) != 0;
+        case TRACE_LEASE_PARK:
+            return system.parkLeased(event.arg, event.vehicleId) != nullptr;
+        case TRACE_UNLEASE:
+            return system.returnLease(event.arg);
+        case TRACE_ADD_AREA:
+            return system.addArea(event.arg, event.count, event.slotClass, event.located, event.x,
+                                  event.y) != nullptr;
+    }
+    return false;
+}
+
+ReplayReport TraceReplayer::replay(ParkingSystem& system) const {
+    ReplayReport report = {};
+    report.operations = eventCount;
+    if (eventCount == 0) return report;
+
+    long long* latencies = new long long[eventCount];
+    long long start = nowNanos();
+    for (int i = 0; i < eventCount; i++) {
+        long long before = nowNanos();
+        bool result = apply(system, events[i]);
+        latencies[i] = nowNanos() - before;
+        if (result != events[i].result) {
+            report.outcomeMismatches++;
+        }
+    }
+    long long elapsed = nowNanos() - start;
+
+    std::sort(latencies, latencies + eventCount);
+    report.elapsedSeconds = elapsed / 1e9;
+    report.opsPerSecond = elapsed > 0 ? eventCount / report.elapsedSeconds : 0.0;
+    report.p50Ns = latencies[(long long)(eventCount - 1) * 50 / 100];
+    report.p90Ns = latencies[(long long)(eventCount - 1) * 90 / 100];
+    report.p99Ns = latencies[(long long)(eventCount - 1) * 99 / 100];
+    report.p999Ns = latencies[(long long)(eventCount - 1) * 999 / 1000];
+    report.maxNs = latencies[eventCount - 1];
+
+    delete[] latencies;
+    return report;
+}
+
+int TraceReplayer::diff(ParkingSystem& first, ParkingSystem& second, std::ostream& out) const {
+    int differences = 0;
+
+    // Replay in lockstep so the first diverging decision is reported
+    for (int i = 0; i < eventCount; i++) {
+        bool a = apply(first, events[i]);
+        bool b = apply(second, events[i]);
+        if (a != b) {
+            if (differences == 0) {
+                out << "First divergence at operation #" << i << "\n";
+            }
+            differences++;
+        }
+    }
+    if (differences > 0) {
+        out << differences << " operation outcome(s) differ\n";
+    }
+
+    // Final slot states
+    if (first.getZoneCount() != second.getZoneCount()) {
+        out << "Zone count differs: " << first.getZoneCount()
+            << " vs " << second.getZoneCount() << "\n";
+        return differences + 1;
+    }
+    for (int z = 0; z < first.getZoneCount(); z++) {
+        Zone* za = first.getZoneAt(z);
+        Zone* zb = second.getZoneAt(z);
+        if (za->getZoneId() != zb->getZoneId() || za->getAreaCount() != zb->getAreaCount()) {
+            out << "Zone layout differs at index " << z << "\n";
+            differences++;
+            continue;
+        }
+        for (int a = 0; a < za->getAreaCount(); a++) {
+            ParkingArea* aa = za->getParkingArea(a);
+            ParkingArea* ab = zb->getParkingArea(a);
+            int slots = aa->getSlotCount() < ab->getSlotCount() ? aa->getSlotCount() : ab->getSlotCount();
+            for (int s = 0; s < slots; s++) {
+                ParkingSlot* sa = aa->getSlot(s);
+                ParkingSlot* sb = ab->getSlot(s);
+                if (sa->getSlotId() != sb->getSlotId() || sa->isAvailable() != sb->isAvailable()) {
+                    out << "Slot " << sa->getSlotId() << " in Zone " << za->getZoneId()
+                        << ": " << (sa->isAvailable() ? "free" : "taken")
+                        << " vs " << (sb->isAvailable() ? "free" : "taken") << "\n";
+                    differences++;
+                }
+            }
+        }
+    }
+
+    // Final request states
+    const RequestStore& ha = first.getRequests();
+    const RequestStore& hb = second.getRequests();
+    for (int id = 1; id <= ha.getCount() && id <= hb.getCount(); id++) {
+        ParkingRequest* ra = ha.get(id);
+        ParkingRequest* rb = hb.get(id);
+        if (ra->getState() != rb->getState() ||
+            ra->getAllocatedZone() != rb->getAllocatedZone() ||
+            ra->getAllocatedSlotId() != rb->getAllocatedSlotId() ||
+            ra->hasCrossZonePenalty() != rb->hasCrossZonePenalty()) {
+            out << "Request #" << ra->getRequestId() << ": state " << ra->getState()
+                << " slot " << ra->getAllocatedSlotId() << " vs state " << rb->getState()
+                << " slot " << rb->getAllocatedSlotId() << "\n";
+            differences++;
+        }
+    }
+    if (ha.getCount() != hb.getCount()) {
+        out << "Request history lengths differ\n";
+        differences++;
+    }
+
+    return differences;
+}
+
+void TraceReplayer::printReport(const ReplayReport& report, std::ostream& out) {
+    out << "Operations       : " << report.operations << "\n";
+    out << "Elapsed          : " << report.elapsedSeconds << " s\n";
+    out << "Throughput       : " << (long long)report.opsPerSecond << " ops/s\n";
+    out << "Latency p50      : " << report.p50Ns << " ns\n";
+    out << "Latency p90      : " << report.p90Ns << " ns\n";
+    out << "Latency p99      : " << report.p99Ns << " ns\n";
+    out << "Latency p99.9    : " << report.p999Ns << " ns\n";
+    out << "Latency max      : " << report.maxNs << " ns\n";
+    out << "Outcome mismatch : " << report.outcomeMismatches << "\n";
+}
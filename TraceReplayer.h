@@ -0,0 +1,44 @@
+#ifndef TRACEREPLAYER_H
+#define TRACEREPLAYER_H
+
+#include <iosfwd>
+#include "TraceRecorder.h"
+
+class ParkingSystem;
+
+struct ReplayReport {
+    int operations;
+    int outcomeMismatches;     // results that differ from the recorded ones
+    double elapsedSeconds;
+    double opsPerSecond;
+    long long p50Ns;
+    long long p90Ns;
+    long long p99Ns;
+    long long p999Ns;
+    long long maxNs;
+};
+
+class TraceReplayer {
+private:
+    TraceEvent* events;
+    int eventCount;
+    int eventCapacity;
+
+    void appendEvent(const TraceEvent& event);
+    static bool apply(ParkingSystem& system, const TraceEvent& event);
+
+public:
+    TraceReplayer();
+    ~TraceReplayer();
+
+    bool load(const char* path);
+    int getEventCount() const;
+    const TraceEvent& getEvent(int index) const;
+
+    ReplayReport replay(ParkingSystem& system) const;
+    int diff(ParkingSystem& first, ParkingSystem& second, std::ostream& out) const;
+
+    static void printReport(const ReplayReport& report, std::ostream& out);
+};
+
+#endif
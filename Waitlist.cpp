@@ -0,0 +1,177 @@
+#include "Waitlist.h"
+#include "RequestStore.h"
+#include <cstring>
+#include "MemoryStats.h"
+
+static void initHeap(WaitHeap& heap) {
+    heap.entries = nullptr;
+    heap.count = 0;
+    heap.capacity = 0;
+}
+
+Waitlist::Waitlist(const RequestStore& store, WaitlistMode waitMode)
+    : requests(store), mode(waitMode), zoneHeaps(nullptr), zonePositions(0), nextArrival(0),
+      waiting(0) {
+    for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+        initHeap(anyHeaps[c]);
+    }
+}
+
+Waitlist::~Waitlist() {
+    for (int i = 0; i < zonePositions * SLOT_CLASS_COUNT; i++) {
+        MemoryStats::freed(MEMORY_WAITLIST, 0, zoneHeaps[i].count);
+        trackedFree(MEMORY_WAITLIST, zoneHeaps[i].entries, zoneHeaps[i].capacity);
+    }
+    trackedFree(MEMORY_WAITLIST, zoneHeaps, zonePositions * SLOT_CLASS_COUNT);
+    for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+        MemoryStats::freed(MEMORY_WAITLIST, 0, anyHeaps[c].count);
+        trackedFree(MEMORY_WAITLIST, anyHeaps[c].entries, anyHeaps[c].capacity);
+    }
+}
+
+bool Waitlist::before(const WaitEntry& a, const WaitEntry& b) {
+    if (a.priority != b.priority) return a.priority > b.priority;
+    return a.arrival < b.arrival;
+}
+
+void Waitlist::push(WaitHeap& heap, const WaitEntry& entry) {
+    if (heap.count == heap.capacity) {
+        int newCapacity = heap.capacity > 0 ? heap.capacity * 2 : 16;
+        WaitEntry* grown = trackedArray<WaitEntry>(MEMORY_WAITLIST, newCapacity);
+        for (int i = 0; i < heap.count; i++) {
+            grown[i] = heap.entries[i];
+        }
+        trackedFree(MEMORY_WAITLIST, heap.entries, heap.capacity);
+        heap.entries = grown;
+        heap.capacity = newCapacity;
+    }
+    int i = heap.count++;
+    MemoryStats::allocated(MEMORY_WAITLIST, 0, 1);
+    while (i > 0 && before(entry, heap.entries[(i - 1) / 2])) {
+        heap.entries[i] = heap.entries[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap.entries[i] = entry;
+}
+
+void Waitlist::pop(WaitHeap& heap) {
+    WaitEntry last = heap.entries[--heap.count];
+    MemoryStats::freed(MEMORY_WAITLIST, 0, 1);
+    int i = 0;
+    while (true) {
+        int child = 2 * i + 1;
+        if (child >= heap.count) break;
+        if (child + 1 < heap.count && before(heap.entries[child + 1], heap.entries[child])) child++;
+        if (!before(heap.entries[child], last)) break;
+        heap.entries[i] = heap.entries[child];
+        i = child;
+    }
+    if (heap.count > 0) heap.entries[i] = last;
+}
+
+// Served and cancelled waiters leave their other entries behind
+const WaitEntry* Waitlist::head(WaitHeap& heap) {
+    while (heap.count > 0 && requests.get(heap.entries[0].requestId)->getState() != REQUESTED) {
+        pop(heap);
+    }
+    return heap.count > 0 ? &heap.entries[0] : nullptr;
+}
+
+void Waitlist::coverZone(int zonePosition) {
+    if (zonePosition < zonePositions) return;
+    int newPositions = zonePositions > 0 ? zonePositions * 2 : 16;
+    while (newPositions <= zonePosition) newPositions *= 2;
+    WaitHeap* grown = trackedArray<WaitHeap>(MEMORY_WAITLIST, newPositions * SLOT_CLASS_COUNT);
+    for (int i = 0; i < newPositions * SLOT_CLASS_COUNT; i++) {
+        if (i < zonePositions * SLOT_CLASS_COUNT) {
+            grown[i] = zoneHeaps[i];
+        } else {
+            initHeap(grown[i]);
+        }
+    }
+    trackedFree(MEMORY_WAITLIST, zoneHeaps, zonePositions * SLOT_CLASS_COUNT);
+    zoneHeaps = grown;
+    zonePositions = newPositions;
+}
+
+// Same slot classes the allocation engine would hand the request
+void Waitlist::queue(WaitHeap* heaps, const WaitEntry& entry, SlotClass slotClass, bool fallback) {
+    push(heaps[slotClass], entry);
+    if (fallback && slotClass != SLOT_STANDARD) {
+        push(heaps[SLOT_STANDARD], entry);
+    }
+}
+
+bool Waitlist::add(const ParkingRequest* request, int zonePosition, int priority) {
+    if (mode == WAITLIST_OFF || (zonePosition < 0 && mode != WAITLIST_ANY)) return false;
+
+    WaitEntry entry;
+    entry.requestId = request->getRequestId();
+    entry.priority = priority;
+    entry.arrival = nextArrival++;
+    SlotClass slotClass = request->getRequiredClass();
+    bool fallback = request->allowsFallback();
+    if (zonePosition >= 0) {
+        coverZone(zonePosition);
+        queue(zoneHeaps + zonePosition * SLOT_CLASS_COUNT, entry, slotClass, fallback);
+    }
+    if (mode == WAITLIST_ANY) {
+        queue(anyHeaps, entry, slotClass, fallback);
+    }
+    waiting++;
+    return true;
+}
+
+int Waitlist::take(int zonePosition, SlotClass slotClass) {
+    if (waiting == 0) return 0;
+    WaitHeap* local = nullptr;
+    if (zonePosition >= 0 && zonePosition < zonePositions) {
+        local = &zoneHeaps[zonePosition * SLOT_CLASS_COUNT + slotClass];
+    }
+    const WaitEntry* best = local != nullptr ? head(*local) : nullptr;
+    WaitHeap* from = local;
+    if (mode == WAITLIST_ANY) {
+        const WaitEntry* other = head(anyHeaps[slotClass]);
+        if (other != nullptr && (best == nullptr || before(*other, *best))) {
+            best = other;
+            from = &anyHeaps[slotClass];
+        }
+    }
+    if (best == nullptr) return 0;
+
+    int requestId = best->requestId;
+    pop(*from);
+    waiting--;
+    return requestId;
+}
+
+void Waitlist::leave() {
+    if (waiting > 0) waiting--;
+}
+
+int Waitlist::getWaitingCount() const {
+    return waiting;
+}
+
+WaitlistMode Waitlist::getMode() const {
+    return mode;
+}
+
+const char* Waitlist::modeName(WaitlistMode mode) {
+    switch (mode) {
+        case WAITLIST_OFF: return "off";
+        case WAITLIST_ZONE: return "zone";
+        case WAITLIST_ANY: return "any";
+    }
+    return "unknown";
+}
+
+bool Waitlist::parseMode(const char* name, WaitlistMode& mode) {
+    for (int i = WAITLIST_OFF; i <= WAITLIST_ANY; i++) {
+        if (strcmp(name, modeName((WaitlistMode)i)) == 0) {
+            mode = (WaitlistMode)i;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,73 @@
+#ifndef WAITLIST_H
+#define WAITLIST_H
+
+#include "ParkingSlot.h"
+
+class ParkingRequest;
+class RequestStore;
+
+enum WaitlistMode {
+    WAITLIST_OFF,
+    WAITLIST_ZONE,      // wait for a slot in the requested zone
+    WAITLIST_ANY        // take the first usable slot freed in any zone
+};
+
+// Priorities share the spare bits of the trace and replication class byte
+const int WAITLIST_MAX_PRIORITY = 15;
+
+struct WaitEntry {
+    int requestId;
+    int priority;
+    long long arrival;
+};
+
+// Binary heap; the head is the highest priority, earliest arrival first
+struct WaitHeap {
+    WaitEntry* entries;
+    int count;
+    int capacity;
+};
+
+// Requests no zone had room for, queued until a slot they can use is
+// freed. There is one heap per zone and slot class, plus one per class for
+// waiters that take any zone. A waiter that can use two classes, or any
+// zone, is queued in several heaps; once it is served (or cancelled) it is
+// no longer REQUESTED and its other entries are dropped when they reach a
+// head.
+class Waitlist {
+private:
+    const RequestStore& requests;
+    WaitlistMode mode;
+    WaitHeap* zoneHeaps;            // zone position * SLOT_CLASS_COUNT + class
+    int zonePositions;
+    WaitHeap anyHeaps[SLOT_CLASS_COUNT];
+    long long nextArrival;
+    int waiting;
+
+    static bool before(const WaitEntry& a, const WaitEntry& b);
+    static void push(WaitHeap& heap, const WaitEntry& entry);
+    static void pop(WaitHeap& heap);
+    const WaitEntry* head(WaitHeap& heap);
+    void coverZone(int zonePosition);
+    void queue(WaitHeap* heaps, const WaitEntry& entry, SlotClass slotClass, bool fallback);
+
+public:
+    Waitlist(const RequestStore& store, WaitlistMode waitMode);
+    ~Waitlist();
+
+    // zonePosition is where the requested zone sits in the system, -1 if
+    // there is no such zone. False if the request has nowhere to wait.
+    bool add(const ParkingRequest* request, int zonePosition, int priority);
+    // Removes and returns the waiter that gets a free slot of this class in
+    // the zone at zonePosition, or 0 if nobody can use it
+    int take(int zonePosition, SlotClass slotClass);
+    // A waiting request was cancelled; its entries are dropped lazily
+    void leave();
+    int getWaitingCount() const;
+    WaitlistMode getMode() const;
+
+    static const char* modeName(WaitlistMode mode);
+    static bool parseMode(const char* name, WaitlistMode& mode);
+};
+
+#endif
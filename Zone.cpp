@@ -1,9 +1,21 @@
 #include "Zone.h"
 #include "ParkingArea.h"
+#include "ParkingSlot.h"
+#include "MemoryStats.h"
 
-Zone::Zone(int id, int maxAreas) : zoneId(id), areaCount(0), areaCapacity(maxAreas) {
-    parkingAreas = new ParkingArea*[maxAreas];
-    for (int i = 0; i < maxAreas; i++) {
+Zone::Zone(int id, int initialAreas)
+    : zoneId(id), areaCount(0), areaCapacity(initialAreas > 0 ? initialAreas : 1), totalSlots(0), availableSlots(0),
+      listener(nullptr), position(-1), x(0), y(0), located(false), closed(false),
+      positionCapacity(16) {
+    slotsByPosition = trackedArray<ParkingSlot*>(MEMORY_TOPOLOGY, positionCapacity);
+    for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+        freeSlots[c] = nullptr;
+        freeCount[c] = 0;
+        freeCapacity[c] = 0;
+        totalByClass[c] = 0;
+    }
+    parkingAreas = trackedArray<ParkingArea*>(MEMORY_TOPOLOGY, areaCapacity);
+    for (int i = 0; i < areaCapacity; i++) {
         parkingAreas[i] = nullptr;
     }
 }
@@ -12,19 +24,36 @@ Zone::~Zone() {
     for (int i = 0; i < areaCount; i++) {
         delete parkingAreas[i];
     }
-    delete[] parkingAreas;
+    trackedFree(MEMORY_TOPOLOGY, parkingAreas, areaCapacity);
+    trackedFree(MEMORY_TOPOLOGY, slotsByPosition, positionCapacity);
+    for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+        trackedFree(MEMORY_TOPOLOGY, freeSlots[c], freeCapacity[c]);
+    }
 }
 
 int Zone::getZoneId() const {
     return zoneId;
 }
 
+// Areas may be added while the zone is serving: every slot of the new area
+// goes through onSlotAdded, so counters and listeners see it at once
 bool Zone::addParkingArea(ParkingArea* area) {
-    if (areaCount < areaCapacity) {
-        parkingAreas[areaCount++] = area;
-        return true;
+    if (areaCount == areaCapacity) {
+        int newCapacity = areaCapacity * 2;
+        ParkingArea** grown = trackedArray<ParkingArea*>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < newCapacity; i++) {
+            grown[i] = i < areaCount ? parkingAreas[i] : nullptr;
+        }
+        trackedFree(MEMORY_TOPOLOGY, parkingAreas, areaCapacity);
+        parkingAreas = grown;
+        areaCapacity = newCapacity;
     }
-    return false;
+    parkingAreas[areaCount++] = area;
+    area->setZone(this);
+    for (int i = 0; i < area->getSlotCount(); i++) {
+        onSlotAdded(area->getSlot(i));
+    }
+    return true;
 }
 
 ParkingArea* Zone::getParkingArea(int index) const {
@@ -32,28 +61,159 @@ ParkingArea* Zone::getParkingArea(int index) const {
         return parkingAreas[index];
     }
     return nullptr;
-};;;;;
+}
 
 int Zone::getAreaCount() const {
     return areaCount;
 }
 
 int Zone::getTotalSlots() const {
-    int total = 0;
-    for (int i = 0; i < areaCount; i++) {
-        total += parkingAreas[i]->getTotalSlots();
-    }
-    return total;
+    return totalSlots;
 }
 
 int Zone::getAvailableSlots() const {
-    int available = 0;
-    for (int i = 0; i < areaCount; i++) {
-        available += parkingAreas[i]->getAvailableSlots();
-    }
-    return available;
+    return availableSlots;
 }
 
 bool Zone::isFull() const {
-    return getAvailableSlots() == 0;
+    return availableSlots == 0;
+}
+
+void Zone::setListener(SlotListener* slotListener) {
+    listener = slotListener;
+}
+
+int Zone::getTotalSlots(SlotClass slotClass) const {
+    return totalByClass[slotClass];
+}
+
+int Zone::getAvailableSlots(SlotClass slotClass) const {
+    return freeCount[slotClass];
+}
+
+ParkingSlot* Zone::peekFreeSlot(SlotClass slotClass) const {
+    int count = freeCount[slotClass];
+    return count > 0 ? freeSlots[slotClass][count - 1] : nullptr;
+}
+
+// Lowest-positioned free slot whose class bit is in classMask
+ParkingSlot* Zone::findFirstFreeSlot(unsigned classMask) const {
+    int found = freeTree.findFirst(0, totalSlots - 1, classMask);
+    return found >= 0 ? slotsByPosition[found] : nullptr;
+}
+
+ParkingSlot* Zone::getSlotAt(int position) const {
+    return slotsByPosition[position];
+}
+
+unsigned Zone::getFreeClassMask() const {
+    unsigned mask = 0;
+    for (int c = 0; c < SLOT_CLASS_COUNT; c++) {
+        if (freeCount[c] > 0) mask |= 1u << c;
+    }
+    return mask;
+}
+
+int Zone::getPosition() const {
+    return position;
+}
+
+void Zone::setPosition(int index) {
+    position = index;
+}
+
+bool Zone::isClosed() const {
+    return closed;
+}
+
+void Zone::setClosed(bool status) {
+    closed = status;
+}
+
+void Zone::setLocation(double xCoord, double yCoord) {
+    x = xCoord;
+    y = yCoord;
+    located = true;
+}
+
+bool Zone::hasLocation() const {
+    return located;
+}
+
+double Zone::getX() const {
+    return x;
+}
+
+double Zone::getY() const {
+    return y;
+}
+
+void Zone::addFree(ParkingSlot* slot) {
+    SlotClass c = slot->getSlotClass();
+    if (freeCount[c] == freeCapacity[c]) {
+        int newCapacity = freeCapacity[c] > 0 ? freeCapacity[c] * 2 : 16;
+        ParkingSlot** grown = trackedArray<ParkingSlot*>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < freeCount[c]; i++) {
+            grown[i] = freeSlots[c][i];
+        }
+        trackedFree(MEMORY_TOPOLOGY, freeSlots[c], freeCapacity[c]);
+        freeSlots[c] = grown;
+        freeCapacity[c] = newCapacity;
+    }
+    slot->setFreeIndex(freeCount[c]);
+    freeSlots[c][freeCount[c]++] = slot;
+}
+
+void Zone::removeFree(ParkingSlot* slot) {
+    SlotClass c = slot->getSlotClass();
+    int index = slot->getFreeIndex();
+    if (index < 0) return;
+    
+    // Swap the last free slot into the hole
+    ParkingSlot* last = freeSlots[c][--freeCount[c]];
+    freeSlots[c][index] = last;
+    last->setFreeIndex(index);
+    slot->setFreeIndex(-1);
+}
+
+void Zone::onSlotChanged(ParkingSlot* slot) {
+    if (slot->isAvailable()) {
+        availableSlots++;
+        addFree(slot);
+        freeTree.set(slot->getZonePosition(), 1, 1u << slot->getSlotClass());
+    } else {
+        availableSlots--;
+        removeFree(slot);
+        freeTree.set(slot->getZonePosition(), 0, 0);
+    }
+    if (listener != nullptr) {
+        listener->onSlotChanged(this, slot);
+    }
+}
+
+void Zone::onSlotAdded(ParkingSlot* slot) {
+    if (totalSlots == positionCapacity) {
+        int newCapacity = positionCapacity * 2;
+        ParkingSlot** grown = trackedArray<ParkingSlot*>(MEMORY_TOPOLOGY, newCapacity);
+        for (int i = 0; i < totalSlots; i++) {
+            grown[i] = slotsByPosition[i];
+        }
+        trackedFree(MEMORY_TOPOLOGY, slotsByPosition, positionCapacity);
+        slotsByPosition = grown;
+        positionCapacity = newCapacity;
+    }
+    slot->setZonePosition(totalSlots);
+    slotsByPosition[totalSlots] = slot;
+    freeTree.resize(totalSlots + 1);
+    
+    totalSlots++;
+    totalByClass[slot->getSlotClass()]++;
+    if (slot->isAvailable()) {
+        availableSlots++;
+        addFree(slot);
+        freeTree.set(slot->getZonePosition(), 1, 1u << slot->getSlotClass());
+    }
+    if (listener != nullptr) {
+        listener->onSlotAdded(this, slot);
+    }
 }
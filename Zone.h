@@ -1,17 +1,54 @@
 #ifndef ZONE_H
 #define ZONE_H
 
+#include "ParkingSlot.h"
+#include "AvailabilityTree.h"
+
 class ParkingArea;
+class Zone;
+
+// Notified after any slot in a zone changes availability
+class SlotListener {
+public:
+    virtual ~SlotListener() {}
+    virtual void onSlotChanged(Zone* zone, ParkingSlot* slot) = 0;
+    virtual void onSlotAdded(Zone*, ParkingSlot*) {}
+};
 
-class Zone {
+class Zone : public Tracked<MEMORY_TOPOLOGY> {
 private:
     int zoneId;
     ParkingArea** parkingAreas;
     int areaCount;
     int areaCapacity;
+    int totalSlots;
+    int availableSlots;
+    SlotListener* listener;
+    int position;           // index in the owning system's zone array
+    double x;               // map coordinates, used for nearest-zone fallback
+    double y;
+    bool located;
+    bool closed;            // drained: the allocator does not hand out its slots
+    
+    // Every slot in the order it was added (area by area), with a segment
+    // tree over that order for first-free and range-count queries
+    ParkingSlot** slotsByPosition;
+    int positionCapacity;
+    AvailabilityTree freeTree;
+    
+    // Free slots of each class, unordered; a slot's own freeIndex locates it
+    // so both insert and remove are O(1)
+    ParkingSlot** freeSlots[SLOT_CLASS_COUNT];
+    int freeCount[SLOT_CLASS_COUNT];
+    int freeCapacity[SLOT_CLASS_COUNT];
+    int totalByClass[SLOT_CLASS_COUNT];
+    
+    void addFree(ParkingSlot* slot);
+    void removeFree(ParkingSlot* slot);
 
 public:
-    Zone(int id, int maxAreas);
+    // initialAreas is a capacity hint; the zone grows as areas are added
+    Zone(int id, int initialAreas);
     ~Zone();
     
     int getZoneId() const;
@@ -21,6 +58,24 @@ public:
     int getTotalSlots() const;
     int getAvailableSlots() const;
     bool isFull() const;
+    int getTotalSlots(SlotClass slotClass) const;
+    int getAvailableSlots(SlotClass slotClass) const;
+    ParkingSlot* peekFreeSlot(SlotClass slotClass) const;
+    ParkingSlot* findFirstFreeSlot(unsigned classMask) const;
+    ParkingSlot* getSlotAt(int position) const;
+    unsigned getFreeClassMask() const;
+    int getPosition() const;
+    void setPosition(int index);
+    void setLocation(double xCoord, double yCoord);
+    bool hasLocation() const;
+    double getX() const;
+    double getY() const;
+    bool isClosed() const;
+    void setClosed(bool status);
+    
+    void setListener(SlotListener* slotListener);
+    void onSlotChanged(ParkingSlot* slot);
+    void onSlotAdded(ParkingSlot* slot);
 };
 
 #endif
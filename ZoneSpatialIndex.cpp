@@ -0,0 +1,236 @@
+#include "ZoneSpatialIndex.h"
+#include "Zone.h"
+#include "MemoryStats.h"
+#include <algorithm>
+#include <cmath>
+
+ZoneSpatialIndex::ZoneSpatialIndex()
+    : nodes(nullptr), nodeCount(0), nodeOfZone(nullptr), capacity(0), xs(nullptr), ys(nullptr),
+      root(-1), builtCount(0) {}
+
+ZoneSpatialIndex::~ZoneSpatialIndex() {
+    trackedFree(MEMORY_TOPOLOGY, nodes, capacity);
+    trackedFree(MEMORY_TOPOLOGY, nodeOfZone, capacity);
+    trackedFree(MEMORY_TOPOLOGY, xs, capacity);
+    trackedFree(MEMORY_TOPOLOGY, ys, capacity);
+}
+
+bool ZoneSpatialIndex::rebuild(Zone** zones, int count) {
+    nodeCount = 0;
+    root = -1;
+    for (int i = 0; i < count; i++) {
+        if (!zones[i]->hasLocation()) return false;
+    }
+    if (count == 0) return false;
+
+    if (count > capacity) {
+        trackedFree(MEMORY_TOPOLOGY, nodes, capacity);
+        trackedFree(MEMORY_TOPOLOGY, nodeOfZone, capacity);
+        trackedFree(MEMORY_TOPOLOGY, xs, capacity);
+        trackedFree(MEMORY_TOPOLOGY, ys, capacity);
+        capacity = count * 2;
+        nodes = trackedArray<KdNode>(MEMORY_TOPOLOGY, capacity);
+        nodeOfZone = trackedArray<int>(MEMORY_TOPOLOGY, capacity);
+        xs = trackedArray<double>(MEMORY_TOPOLOGY, capacity);
+        ys = trackedArray<double>(MEMORY_TOPOLOGY, capacity);
+    }
+
+    int* positions = new int[count];
+    for (int i = 0; i < count; i++) {
+        positions[i] = i;
+        xs[i] = zones[i]->getX();
+        ys[i] = zones[i]->getY();
+    }
+    root = build(positions, count, 0, -1);
+    builtCount = count;
+    delete[] positions;
+
+    for (int i = 0; i < count; i++) {
+        update(i, zones[i]->isClosed() ? 0 : zones[i]->getFreeClassMask());
+    }
+    return true;
+}
+
+// Descends to the leaf whose cell holds the new zone, widening bounding
+// boxes on the way. Inserting costs O(depth); rebuilding whenever the tree
+// has doubled keeps the depth O(log Z) at O(log Z) amortized per zone
+bool ZoneSpatialIndex::insert(Zone** zones, int count) {
+    if (root < 0 || nodeCount != count - 1 || count > 2 * builtCount) {
+        return rebuild(zones, count);
+    }
+    Zone* zone = zones[count - 1];
+    if (!zone->hasLocation()) {
+        nodeCount = 0;
+        root = -1;
+        return false;
+    }
+    if (count > capacity) {
+        grow(count * 2);
+    }
+
+    int position = count - 1;
+    double x = zone->getX();
+    double y = zone->getY();
+    xs[position] = x;
+    ys[position] = y;
+
+    int parent = root;
+    while (true) {
+        KdNode& node = nodes[parent];
+        node.minX = std::min(node.minX, x);
+        node.minY = std::min(node.minY, y);
+        node.maxX = std::max(node.maxX, x);
+        node.maxY = std::max(node.maxY, y);
+        double split = node.axis == 0 ? xs[node.zonePosition] : ys[node.zonePosition];
+        int& child = (node.axis == 0 ? x : y) < split ? node.left : node.right;
+        if (child < 0) {
+            child = nodeCount;
+            break;
+        }
+        parent = child;
+    }
+
+    int index = nodeCount++;
+    KdNode& node = nodes[index];
+    node.zonePosition = position;
+    node.left = -1;
+    node.right = -1;
+    node.parent = parent;
+    node.axis = 1 - nodes[parent].axis;
+    node.ownMask = 0;
+    node.subtreeMask = 0;
+    node.minX = node.maxX = x;
+    node.minY = node.maxY = y;
+    nodeOfZone[position] = index;
+    update(position, zone->isClosed() ? 0 : zone->getFreeClassMask());
+    return true;
+}
+
+void ZoneSpatialIndex::grow(int newCapacity) {
+    KdNode* grownNodes = trackedArray<KdNode>(MEMORY_TOPOLOGY, newCapacity);
+    int* grownNodeOfZone = trackedArray<int>(MEMORY_TOPOLOGY, newCapacity);
+    double* grownXs = trackedArray<double>(MEMORY_TOPOLOGY, newCapacity);
+    double* grownYs = trackedArray<double>(MEMORY_TOPOLOGY, newCapacity);
+    for (int i = 0; i < nodeCount; i++) {
+        grownNodes[i] = nodes[i];
+        grownNodeOfZone[i] = nodeOfZone[i];
+        grownXs[i] = xs[i];
+        grownYs[i] = ys[i];
+    }
+    trackedFree(MEMORY_TOPOLOGY, nodes, capacity);
+    trackedFree(MEMORY_TOPOLOGY, nodeOfZone, capacity);
+    trackedFree(MEMORY_TOPOLOGY, xs, capacity);
+    trackedFree(MEMORY_TOPOLOGY, ys, capacity);
+    nodes = grownNodes;
+    nodeOfZone = grownNodeOfZone;
+    xs = grownXs;
+    ys = grownYs;
+    capacity = newCapacity;
+}
+
+// Median split on alternating axes; each call places one node
+int ZoneSpatialIndex::build(int* positions, int count, int depth, int parent) {
+    if (count <= 0) return -1;
+
+    int axis = depth % 2;
+    int mid = count / 2;
+    const double* key = axis == 0 ? xs : ys;
+    std::nth_element(positions, positions + mid, positions + count,
+                     [key](int a, int b) { return key[a] < key[b]; });
+
+    int index = nodeCount++;
+    KdNode& node = nodes[index];
+    node.zonePosition = positions[mid];
+    node.parent = parent;
+    node.axis = axis;
+    node.ownMask = 0;
+    node.subtreeMask = 0;
+    node.minX = node.maxX = xs[positions[mid]];
+    node.minY = node.maxY = ys[positions[mid]];
+    nodeOfZone[positions[mid]] = index;
+
+    int left = build(positions, mid, depth + 1, index);
+    int right = build(positions + mid + 1, count - mid - 1, depth + 1, index);
+    nodes[index].left = left;
+    nodes[index].right = right;
+    for (int child : {left, right}) {
+        if (child < 0) continue;
+        KdNode& self = nodes[index];
+        self.minX = std::min(self.minX, nodes[child].minX);
+        self.minY = std::min(self.minY, nodes[child].minY);
+        self.maxX = std::max(self.maxX, nodes[child].maxX);
+        self.maxY = std::max(self.maxY, nodes[child].maxY);
+    }
+    return index;
+}
+
+bool ZoneSpatialIndex::isActive() const {
+    return root >= 0;
+}
+
+void ZoneSpatialIndex::update(int zonePosition, unsigned freeMask) {
+    if (root < 0) return;
+    int index = nodeOfZone[zonePosition];
+    if (nodes[index].ownMask == freeMask) return;
+
+    nodes[index].ownMask = freeMask;
+    // Recompute ORs up the path, stopping once nothing changes
+    while (index >= 0) {
+        KdNode& node = nodes[index];
+        unsigned mask = node.ownMask;
+        if (node.left >= 0) mask |= nodes[node.left].subtreeMask;
+        if (node.right >= 0) mask |= nodes[node.right].subtreeMask;
+        if (mask == node.subtreeMask && index != nodeOfZone[zonePosition]) break;
+        node.subtreeMask = mask;
+        index = node.parent;
+    }
+}
+
+double ZoneSpatialIndex::boxDistance(const KdNode& node, double x, double y) {
+    double dx = x < node.minX ? node.minX - x : (x > node.maxX ? x - node.maxX : 0);
+    double dy = y < node.minY ? node.minY - y : (y > node.maxY ? y - node.maxY : 0);
+    return dx * dx + dy * dy;
+}
+
+// Nearest zone (other than excludePosition) with a free slot in mask, or -1
+int ZoneSpatialIndex::findNearest(double x, double y, unsigned mask, int excludePosition) const {
+    int best = -1;
+    double bestDistance = 0;
+    if (root >= 0) {
+        search(root, x, y, mask, excludePosition, best, bestDistance);
+    }
+    return best;
+}
+
+void ZoneSpatialIndex::search(int index, double x, double y, unsigned mask, int excludePosition,
+                              int& best, double& bestDistance) const {
+    const KdNode& node = nodes[index];
+    if ((node.subtreeMask & mask) == 0) return;
+    if (best >= 0 && boxDistance(node, x, y) > bestDistance) return;
+
+    int position = node.zonePosition;
+    if ((node.ownMask & mask) != 0 && position != excludePosition) {
+        double dx = xs[position] - x;
+        double dy = ys[position] - y;
+        double distance = dx * dx + dy * dy;
+        // Ties go to the lower zone position, matching array-order fallback
+        if (best < 0 || distance < bestDistance || (distance == bestDistance && position < best)) {
+            best = position;
+            bestDistance = distance;
+        }
+    }
+
+    // Visit the side of the split containing the query point first
+    double split = node.axis == 0 ? xs[position] : ys[position];
+    double coordinate = node.axis == 0 ? x : y;
+    int nearSide = coordinate < split ? node.left : node.right;
+    int farSide = coordinate < split ? node.right : node.left;
+    if (nearSide >= 0) search(nearSide, x, y, mask, excludePosition, best, bestDistance);
+    if (farSide >= 0) search(farSide, x, y, mask, excludePosition, best, bestDistance);
+}
+
+double ZoneSpatialIndex::distanceBetween(int firstPosition, int secondPosition) const {
+    double dx = xs[firstPosition] - xs[secondPosition];
+    double dy = ys[firstPosition] - ys[secondPosition];
+    return std::sqrt(dx * dx + dy * dy);
+}
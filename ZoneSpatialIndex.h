@@ -0,0 +1,54 @@
+#ifndef ZONESPATIALINDEX_H
+#define ZONESPATIALINDEX_H
+
+class Zone;
+
+struct KdNode {
+    int zonePosition;
+    int left;
+    int right;
+    int parent;
+    int axis;               // 0 = x, 1 = y
+    double minX, minY, maxX, maxY;  // bounding box of the subtree
+    unsigned ownMask;       // free slot classes in this node's zone
+    unsigned subtreeMask;   // OR over the subtree
+};
+
+// Balanced k-d tree over zone coordinates. Each node carries the OR of the
+// free-class masks below it, so a nearest-zone-with-space query prunes both
+// by distance and by "nothing free down there" and visits O(log Z) nodes in
+// the usual case. Zones added later go in as leaves, with a balanced rebuild
+// each time the tree doubles; masks are patched in place as slots change.
+class ZoneSpatialIndex {
+private:
+    KdNode* nodes;
+    int nodeCount;
+    int* nodeOfZone;        // zone position -> node index
+    int capacity;
+    double* xs;
+    double* ys;
+    int root;
+    int builtCount;         // zones at the last balanced rebuild
+
+    void grow(int newCapacity);
+    int build(int* positions, int count, int depth, int parent);
+    void search(int node, double x, double y, unsigned mask, int excludePosition,
+                int& best, double& bestDistance) const;
+    static double boxDistance(const KdNode& node, double x, double y);
+
+public:
+    ZoneSpatialIndex();
+    ~ZoneSpatialIndex();
+
+    // Indexes zones[0..count); returns false (and indexes nothing) if any
+    // zone has no location
+    bool rebuild(Zone** zones, int count);
+    // Adds zones[count - 1], the only zone not yet indexed
+    bool insert(Zone** zones, int count);
+    bool isActive() const;
+    void update(int zonePosition, unsigned freeMask);
+    int findNearest(double x, double y, unsigned mask, int excludePosition) const;
+    double distanceBetween(int firstPosition, int secondPosition) const;
+};
+
+#endif